@@ -24,6 +24,8 @@ typedef struct iovec socket_bufvec_t;
 #define OS_SOCKET_TYPE
 #endif /* OS_SOCKET_TYPE */
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -66,11 +68,48 @@ typedef void (*aio_onrecv)(void* param, int code, size_t bytes);
 /// @param[in] addrlen peer socket address length in bytes
 typedef void (*aio_onrecvfrom)(void* param, int code, size_t bytes, const struct sockaddr* addr, socklen_t addrlen);
 
+/// aio_socket_recvmmsg/aio_socket_sendmmsg datagram
+struct aio_socket_mmsg_t
+{
+	void* buffer;
+	size_t bytes; // recvmmsg: in-buffer size, out-datagram length; sendmmsg: datagram length
+	struct sockaddr_storage addr; // recvmmsg: peer address; sendmmsg: destination address
+	socklen_t addrlen; // recvmmsg: out-only; sendmmsg: 0-connected socket
+	unsigned int segment; // UDP GSO/GRO segment size, 0-single datagram(see aio_socket_sendmmsg/aio_socket_recvmmsg)
+};
+
+/// aio_socket_recvmmsg/aio_socket_sendmmsg callback
+/// @param[in] param user-defined parameter
+/// @param[in] code 0-ok, other-error
+/// @param[in] msgs datagram array(same as request)
+/// @param[in] n transferred datagram count, msgs[0] ~ msgs[n-1] valid
+typedef void (*aio_onmmsg)(void* param, int code, struct aio_socket_mmsg_t* msgs, int n);
+
 /// aio initialization
 /// @param[in] threads max concurrent thread call aio_socket_process
 /// @return 0-ok, other-error
 int aio_socket_init(int threads);
 
+/// aio_socket_init2 flags
+#define AIO_SOCKET_SHARD	0x0001 // epoll instance per aio_socket_process thread, socket pinned to one shard(linux only)
+#define AIO_SOCKET_SPECULATIVE	0x0002 // recv/send(_v) issued in callback try the syscall first, wait epoll only if would block(linux only)
+
+/// aio initialization with batched event harvesting
+/// @param[in] threads max concurrent thread call aio_socket_process
+/// @param[in] events max events dispatched per aio_socket_process call(1~64), 1-same as aio_socket_init(epoll/io_uring only, ignored by kqueue/iocp)
+/// @param[in] flags AIO_SOCKET_XXX, 0-all threads share one epoll instance(same as aio_socket_init)
+/// @return 0-ok, other-error
+/// Remark: 1. batched events are dispatched in the calling thread one by one, 
+///            a slow callback delays the other events in the same batch
+///         2. AIO_SOCKET_SHARD: every shard MUST have a thread call aio_socket_process, 
+///            so the number of aio_socket_process threads must be at least threads
+///         3. AIO_SOCKET_SPECULATIVE: inline completion callback is called after the current callback return,
+///            never in aio_socket_recv/aio_socket_send, request from other thread always wait epoll
+int aio_socket_init2(int threads, int events, int flags);
+
+/// @return shard count(AIO_SOCKET_SHARD), 1-all threads share one instance
+int aio_socket_shards(void);
+
 /// aio cleanup
 /// @return 0-ok, other-error
 int aio_socket_clean(void);
@@ -84,6 +123,18 @@ int aio_socket_process(int timeout);
 /// @return NULL-error, other-ok
 aio_socket_t aio_socket_create(socket_t socket, int own);
 
+/// @param[in] own 1-close socket on aio_socket_close, 0-don't close socket
+/// @param[in] shard pin socket to shard(0 ~ aio_socket_shards()-1), -1-current aio_socket_process thread shard or round-robin
+/// @return NULL-error, other-ok
+aio_socket_t aio_socket_create2(socket_t socket, int own, int shard);
+
+/// Edge-triggered mode for long-lived socket: register EPOLLIN|EPOLLOUT|EPOLLET once, 
+/// recv/send request don't need epoll_ctl(linux only)
+/// Remark: 1. MUST be called before any request, socket set to non-blocking
+///         2. every epoll instance processed by one thread only(AIO_SOCKET_SHARD or aio_socket_init with 1-thread)
+/// @return 0-ok, ENOTSUP-backend don't support or epoll instance shared by threads, EBUSY-socket in use
+int aio_socket_edge_triggered(aio_socket_t socket);
+
 /// close aio-socket
 /// Remark: don't call any callback after this function
 /// @return 0-ok, other-error
@@ -112,6 +163,8 @@ int aio_socket_connect(aio_socket_t socket, const struct sockaddr *addr, socklen
 /// @return 0-ok, <0-error, don't call proc if return error
 int aio_socket_send(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param);
 
+/// Remark: zero-byte recv(bytes = 0) callback when the socket is readable(data or FIN) without consume data,
+///         so caller can allocate the buffer after that(IOCP zero-byte WSARecv)
 /// @return 0-ok, <0-error, don't call proc if return error
 int aio_socket_recv(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecv proc, void* param);
 
@@ -125,6 +178,28 @@ int aio_socket_send_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onse
 /// @param[in] n vec item number
 int aio_socket_recv_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecv proc, void* param);
 
+/// zero-copy send(MSG_ZEROCOPY), callback after kernel released the buffer(data acknowledged by peer)
+/// Remark: 1. keep buffer(vec) unchanged until callback, don't call aio_socket_send/send_zc before callback
+///         2. for large buffer only(e.g. >= 10KB), small buffer is faster with aio_socket_send
+///         3. falls back to aio_socket_send/aio_socket_send_v on backends without zero-copy support(kqueue/iocp/io_uring) or old kernel
+///         4. socket error before notification, callback with error code(buffer maybe still referenced by kernel)
+/// @param[in] buffer/vec outgoing buffer
+/// @param[in] proc callback procedure
+/// @param[in] param user-defined parameter
+/// @return 0-ok, <0-error, don't call proc if return error
+int aio_socket_send_zc(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param);
+int aio_socket_send_v_zc(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param);
+
+/// send file data to peer(sendfile), file data don't copy to user space
+/// @param[in] socket aio socket
+/// @param[in] fd file descriptor, must valid before aio_onsend callback
+/// @param[in] offset file offset in bytes, fd file position don't change
+/// @param[in] bytes max bytes to send
+/// @param[in] proc user-defined callback, bytes maybe less than request bytes(call again for remain data)
+/// @param[in] param user-defined parameter
+/// @return 0-ok, ENOTSUP-backend don't support(use aio_socket_send), <0-error, don't call proc if return error
+int aio_socket_sendfile(aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param);
+
 /// aio udp send
 /// @param[in] socket aio socket
 /// @param[in] addr peer socket address(IPv4 or IPv6)
@@ -164,6 +239,26 @@ int aio_socket_sendto_v(aio_socket_t socket, const struct sockaddr *addr, sockle
 /// @return 0-ok, <0-error, don't call proc if return error
 int aio_socket_recvfrom_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecvfrom proc, void* param);
 
+/// aio udp batched recv(recvmmsg), one callback for all received datagrams
+/// Remark: UDP GRO(socket_setudpgro): a message maybe coalesced datagrams, segment is the datagram size(except the last one)
+/// @param[in] socket aio socket
+/// @param[in] msgs datagram array(buffer/bytes), must valid before proc callback
+/// @param[in] n msgs count(1~64)
+/// @param[in] proc user-defined callback, callback when 1 ~ n datagrams received
+/// @param[in] param user-defined parameter
+/// @return 0-ok, ENOTSUP-backend don't support(use aio_socket_recvfrom), <0-error, don't call proc if return error
+int aio_socket_recvmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param);
+
+/// aio udp batched send(sendmmsg), one callback for all datagrams
+/// Remark: UDP GSO: message segment > 0, kernel split the buffer to segment size datagrams(the last one maybe shorter)
+/// @param[in] socket aio socket
+/// @param[in] msgs datagram array(buffer/bytes/addr/addrlen/segment), must valid before proc callback
+/// @param[in] n msgs count(1~64)
+/// @param[in] proc user-defined callback, n maybe less than request count(send remain again)
+/// @param[in] param user-defined parameter
+/// @return 0-ok, ENOTSUP-backend don't support(use aio_socket_sendto), <0-error, don't call proc if return error
+int aio_socket_sendmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param);
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,6 +11,7 @@ typedef void* systimer_t;
 typedef void (*systimer_proc)(systimer_t id, void* param);
 
 /// timer initialize
+/// @param[in] pool timer callback thread pool(Linux: NULL-callback in timer thread)
 /// @return 0-ok, <0-error
 int systimer_init(thread_pool_t pool);
 
@@ -0,0 +1,46 @@
+#ifndef _slab_cache_h_
+#define _slab_cache_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Fixed-size object cache: cache-line aligned objects, per-thread bounded free list
+/// 1. alloc/free in the same thread don't take any lock(no malloc lock contention)
+/// 2. object freed in other thread is cached by the freeing thread
+/// 3. cached objects are released on thread exit or slab_cache_destroy
+typedef struct slab_cache_t slab_cache_t;
+
+/// Remark: per-thread counters are plain integers(no atomic on the alloc/free path),
+///         other threads counters are approximate while they alloc/free, exact after they exited
+struct slab_cache_stats_t
+{
+	int64_t alloc; // slab_cache_alloc count
+	int64_t hit; // alloc from thread free list
+	int64_t free; // slab_cache_free count
+	int64_t cached; // objects in thread free lists
+};
+
+/// @param[in] size object size in bytes, rounded up to cache line size
+/// @param[in] capacity max cached objects per thread, 0-don't cache(malloc/free only)
+/// @return NULL-error, other-ok
+slab_cache_t* slab_cache_create(size_t size, int capacity);
+
+/// Remark: all threads MUST stop using the cache
+void slab_cache_destroy(slab_cache_t* cache);
+
+/// @return zero-filled object, NULL-out of memory
+void* slab_cache_alloc(slab_cache_t* cache);
+
+void slab_cache_free(slab_cache_t* cache, void* ptr);
+
+/// statistics snapshot(see slab_cache_stats_t Remark), e.g. hit rate = hit / alloc
+void slab_cache_stats(slab_cache_t* cache, struct slab_cache_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !_slab_cache_h_ */
@@ -49,6 +49,15 @@ typedef struct iovec socket_bufvec_t;
 #define socket_invalid	-1
 #define socket_error	-1
 
+#if defined(OS_LINUX)
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103 // linux/udp.h, GSO since linux 4.18
+#endif
+#if !defined(UDP_GRO)
+#define UDP_GRO 104 // linux/udp.h, GRO since linux 5.0
+#endif
+#endif
+
 #endif
 
 #include <assert.h>
@@ -150,6 +159,7 @@ static inline int socket_setttl6(IN socket_t sock, IN int ttl); // ipv6 only
 static inline int socket_getttl6(IN socket_t sock, OUT int* ttl); // ipv6 only
 static inline int socket_setdontfrag(IN socket_t sock, IN int dontfrag); // ipv4 udp only
 static inline int socket_getdontfrag(IN socket_t sock, OUT int* dontfrag); // ipv4 udp only
+static inline int socket_setudpgro(IN socket_t sock, IN int enable); // udp receive offload(coalesce datagrams), linux 5.0+ only
 
 // socket status
 // @return 0-ok, <0-socket_error(by socket_geterror())
@@ -859,6 +869,17 @@ static inline int socket_getdontfrag(IN socket_t sock, OUT int* dontfrag)
 	return r;
 }
 
+// udp only, see aio_socket_recvmmsg
+static inline int socket_setudpgro(IN socket_t sock, IN int enable)
+{
+#if defined(OS_LINUX)
+	return setsockopt(sock, IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable));
+#else
+	(void)sock, (void)enable;
+	return -1;
+#endif
+}
+
 static inline int socket_setttl(IN socket_t sock, IN int ttl)
 {
 	return setsockopt(sock, IPPROTO_IP, IP_TTL, (const char*)&ttl, sizeof(ttl));
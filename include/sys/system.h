@@ -34,6 +34,7 @@ typedef void (*funcptr_t)(void);
 // void system_sleep(useconds_t millisecond);
 // uint64_t system_time(void);
 // uint64_t system_clock(void);
+// uint64_t system_clock_us(void);
 // int64_t system_getcyclecount(void);
 // size_t system_getcpucount(void);
 //
@@ -171,6 +172,34 @@ static inline uint64_t system_clock(void)
 #endif
 }
 
+///@return microseconds(relative time)
+static inline uint64_t system_clock_us(void)
+{
+#if defined(OS_WINDOWS)
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(count.QuadPart / freq.QuadPart * 1000000 + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#elif defined(OS_MAC)
+	uint64_t tick;
+	mach_timebase_info_data_t timebase;
+	tick = mach_absolute_time();
+	mach_timebase_info(&timebase);
+	return tick * timebase.numer / timebase.denom / 1000;
+#else
+#if defined(CLOCK_MONOTONIC)
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+#endif
+}
+
 #if defined(_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable: 4996) // GetVersionEx
@@ -7,14 +7,31 @@
 extern "C" {
 #endif
 
+enum { PRIORITY_IDLE=0, PRIORITY_LOWEST, PRIORITY_NORMAL, PRIORITY_CRITICAL };
+
 typedef void* task_queue_t;
 typedef void (*task_proc)(void* param);
 
 task_queue_t task_queue_create(thread_pool_t pool, int maxWorker);
 int task_queue_destroy(task_queue_t taskQ);
 
+/// post a normal priority task without deadline
 int task_queue_post(task_queue_t taskQ, task_proc proc, void* param);
 
+/// post a task with priority and deadline
+/// @param[in] priority PRIORITY_IDLE ~ PRIORITY_CRITICAL, higher priority task run first
+/// @param[in] deadline ms from now, the task is dropped(proc not called) if it don't start in time, 0-no deadline
+/// @return 0-ok, <0-error code
+int task_queue_post2(task_queue_t taskQ, int priority, int deadline, task_proc proc, void* param);
+
+/// post tasks with one lock
+/// @return >=0-posted task count(less than n only if out of memory), <0-error code
+int task_queue_post_batch(task_queue_t taskQ, const task_proc procs[], void* const params[], int n);
+
+/// get task queue statistics(wait: post to start, dropped: deadline expired, threads: max worker)
+/// @return 0-ok, <0-error code
+int task_queue_stats(task_queue_t taskQ, struct thread_pool_stats_t* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,8 @@
 #ifndef _threadpool_h_
 #define _threadpool_h_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,7 +17,45 @@ typedef void* thread_pool_t;
 ///@return 0-error, other-thread pool id
 thread_pool_t thread_pool_create(int num, int min, int max);
 
-///destroy thread pool
+/// worker thread cpu placement policy
+enum {
+	THREAD_AFFINITY_NONE = 0,	// don't bind
+	THREAD_AFFINITY_COMPACT,	// fill one NUMA node then the next one(share cache)
+	THREAD_AFFINITY_SCATTER,	// round-robin NUMA nodes(memory bandwidth)
+	THREAD_AFFINITY_LIST		// explicit cpu list
+};
+
+struct thread_affinity_t
+{
+	int policy; // THREAD_AFFINITY_XXX
+	const int* cpus; // THREAD_AFFINITY_LIST only: worker i run on cpus[i % count]
+	int count;
+};
+
+///@param[in] affinity cpu placement, NULL-don't bind
+///@param[in] idx worker index
+///@return cpu id of the worker, -1-don't bind
+int thread_affinity_cpu(const struct thread_affinity_t* affinity, int idx);
+
+///override the cpu topology read from system(e.g. cpuset of a container, test)
+///Remark: call before any worker created with THREAD_AFFINITY_COMPACT/THREAD_AFFINITY_SCATTER
+///@param[in] cpus cpu ids sorted by NUMA node, NULL-reload from system
+///@param[in] sizes cpu count of each node, sum of sizes is the cpus count
+///@param[in] nodes NUMA node count
+///@return 0-ok, EINVAL-bad topology
+int thread_affinity_topology(const int cpus[], const int sizes[], int nodes);
+
+///bind current thread to the cpu(Linux/Windows only)
+///@return 0-ok, other-error code
+int thread_affinity_bind(int cpu);
+
+///create thread pool with worker cpu affinity, worker slot i(0 ~ max-1) bind to thread_affinity_cpu(affinity, i)
+///@param[in] affinity cpu placement, NULL-don't bind(the same as thread_pool_create)
+thread_pool_t thread_pool_create2(int num, int min, int max, const struct thread_affinity_t* affinity);
+
+///destroy thread pool, pending tasks are dropped(not run)
+///Remark: parallel_for chunks are not dropped, they run in this thread(a task maybe wait for them),
+///        other tasks waited by a latch MUST be done before destroy
 ///@param[in] pool thread pool id
 void thread_pool_destroy(thread_pool_t pool);
 
@@ -29,12 +69,89 @@ int thread_pool_threads_count(thread_pool_t pool);
 typedef void (*thread_pool_proc)(void *param);
 
 ///push a task to thread pool
+///Remark: tasks have no execution order. Pushed from a worker thread: run by the worker LIFO(the latest first,
+///        cache hot) unless stolen by idle workers(the oldest first). Pushed from other threads: roughly FIFO.
 ///@param[in] pool thread pool id
 ///@param[in] proc task procedure
 ///@param[in] param user parameter
 ///@return =0-ok, <0-error code
 int thread_pool_push(thread_pool_t pool, thread_pool_proc proc, void *param);
 
+///push tasks to thread pool, wake up workers once for all tasks
+///@param[in] pool thread pool id
+///@param[in] procs task procedures
+///@param[in] params user parameters
+///@param[in] n task count
+///@return >=0-pushed task count(less than n only if out of memory), <0-error code
+int thread_pool_push_batch(thread_pool_t pool, const thread_pool_proc procs[], void* const params[], int n);
+
+
+typedef void* thread_pool_latch_t;
+
+///completion latch(count down), e.g. wait for a group of tasks
+///@param[in] count initialize count
+///@return NULL-error, other-latch id
+thread_pool_latch_t thread_pool_latch_create(int count);
+
+///destroy latch, wait for the thread_pool_latch_done calls in progress
+void thread_pool_latch_destroy(thread_pool_latch_t latch);
+
+///add count before push tasks
+void thread_pool_latch_add(thread_pool_latch_t latch, int n);
+
+///count down, call it once per task at the task end
+void thread_pool_latch_done(thread_pool_latch_t latch);
+
+///wait for the count down to zero, one waiter only
+///called from a worker thread, run the pool tasks while waiting(nested fan-out don't deadlock)
+///@param[in] timeout wait timeout(ms), <0-infinite
+///@return 0-ok, ETIMEDOUT-timeout
+int thread_pool_latch_wait(thread_pool_latch_t latch, int timeout);
+
+
+///range procedure, run [begin, end) indexes
+typedef void (*thread_pool_range_proc)(void *param, int64_t begin, int64_t end);
+
+///split [begin, end) into grain size chunks and run them in thread pool, the caller runs chunks too
+///@param[in] pool thread pool id
+///@param[in] begin/end index range, end - begin <= INT64_MAX
+///@param[in] grain chunk size, <=0-auto(about 4 chunks per thread)
+///@param[in] proc range procedure
+///@param[in] param user parameter
+///@return 0-ok(all chunks done), <0-error code
+int thread_pool_parallel_for(thread_pool_t pool, int64_t begin, int64_t end, int64_t grain, thread_pool_range_proc proc, void *param);
+
+
+
+#define THREAD_POOL_HISTOGRAM 256 // log-linear buckets: 8 sub-buckets per power of 2(12.5% precision)
+
+/// pool(or task queue) statistics
+struct thread_pool_stats_t
+{
+	uint64_t submitted; // pushed tasks(include dropped)
+	uint64_t completed; // done tasks
+	uint64_t dropped; // push failed(thread pool), deadline expired(task queue)
+	int depth; // queued tasks(not started)
+	int threads; // worker count(thread pool), max worker(task queue)
+	int busy; // running tasks
+
+	uint64_t wait[THREAD_POOL_HISTOGRAM]; // queue delay(us) histogram, push to start(thread pool: sampled)
+	uint64_t run[THREAD_POOL_HISTOGRAM]; // run time(us) histogram(thread pool: sampled)
+};
+
+///get thread pool statistics, per-thread counters merged on read(approximate while the pool running)
+///@param[in] pool thread pool id
+///@param[out] stats statistics
+///@return 0-ok, <0-error code
+int thread_pool_stats(thread_pool_t pool, struct thread_pool_stats_t* stats);
+
+///add a value to histogram
+void thread_pool_stats_add(uint64_t histogram[THREAD_POOL_HISTOGRAM], uint64_t us);
+
+///get percentile value of histogram
+///@param[in] percentile 0.0~100.0, e.g. 99.9
+///@return bucket upper bound value(us), 0 if histogram is empty
+uint64_t thread_pool_stats_percentile(const uint64_t histogram[THREAD_POOL_HISTOGRAM], double percentile);
 
 #ifdef __cplusplus
 }
@@ -19,10 +19,16 @@ struct twtimer_t
 };
 
 typedef struct time_wheel_t time_wheel_t;
+/// 64ms per bucket
 time_wheel_t* time_wheel_create(uint64_t clock);
+/// @param[in] resolution bucket time(ms), round down to power of 2, 1 ~ 1024
+time_wheel_t* time_wheel_create2(uint64_t clock, int resolution);
 int time_wheel_destroy(time_wheel_t* tm);
 
-/// @return sleep time(ms)
+/// @return bucket time(ms)
+int time_wheel_resolution(time_wheel_t* tm);
+
+/// @return sleep time(ms) to the next timer bucket
 int twtimer_process(time_wheel_t* tm, uint64_t clock);
 
 /// one-shoot timeout timer
@@ -8,10 +8,13 @@ extern "C" {
 #endif
 
 /// Start Accept client
+/// With AIO_SOCKET_SHARD(aio_socket_init2), one SO_REUSEPORT listen socket is created per shard
+/// on the same address, kernel balance new connections between them
+/// @param[in] socket listen socket, own by aio_accept
 void* aio_accept_start(socket_t socket, aio_onaccept onaccept, void* param);
 
 /// Cancel Accept
-/// It will call aio_onaccept with code != 0 (in this or anthor thread)
+/// It will call aio_onaccept with code != 0 (in this or anthor thread), once per listen socket
 /// @param[in] aio create by aio_accept_start
 int aio_accept_stop(void* aio, aio_ondestroy ondestroy, void* param);
 
@@ -8,12 +8,14 @@ extern "C" {
 #endif
 
 /// Connect to host
-/// @param[in] host IPv4/IPv6/DNS address
+/// Happy Eyeballs(RFC 8305): resolved addresses are interleaved by family and tried in parallel,
+/// a new attempt is started every 250ms(or when the previous one failed), the first success wins
+/// @param[in] host IPv4/IPv6/DNS address(resolved by aio_resolve, don't block the calling thread)
 /// @param[in] port tcp port
-/// @param[in] timeout connect timeout(MS)
+/// @param[in] timeout connect timeout(MS) of every address attempt
 /// @param[in] onconnect user-defined callback, can't be NULL
 /// @param[in] param user-defined parameter
-/// @return 0-ok, other-error
+/// @return 0-ok, other-error(e.g. resolver EAI_XXX failure in the call), onconnect will not be called
 int aio_connect(const char* host, int port, int timeout, void (*onconnect)(void* param, int code, aio_socket_t aio), void* param);
 
 #ifdef __cplusplus
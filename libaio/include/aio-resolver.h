@@ -0,0 +1,46 @@
+#ifndef _aio_resolver_h_
+#define _aio_resolver_h_
+
+#include "sys/sock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @param[in] code 0-ok, other-getaddrinfo error code(EAI_XXX, e.g. EAI_MEMORY if out of memory)
+/// @param[in] addr address list with port, free by aio_resolver_free, NULL if code != 0
+typedef void (*aio_onresolve)(void* param, int code, struct addrinfo* addr);
+
+/// Resolve host(SOCK_STREAM) without blocking the calling thread
+/// 1. IPv4/IPv6 address, cache hit(both resolved and failed host) or local error: callback in the calling thread
+/// 2. otherwise getaddrinfo in resolver threads, concurrent queries of the same host are merged
+/// @param[in] host IPv4/IPv6/DNS address
+/// @param[in] port tcp port
+/// @param[in] onresolve user-defined callback, can't be NULL, called once(every failure is reported by the callback)
+/// @param[in] param user-defined parameter
+/// @return 0 always
+int aio_resolve(const char* host, int port, aio_onresolve onresolve, void* param);
+
+/// free aio_onresolve address list
+void aio_resolver_free(struct addrinfo* addr);
+
+/// cache time of resolved(default 60s) and failed(default 5s) host
+/// Remark: getaddrinfo don't report the DNS record TTL
+void aio_resolver_setttl(int ttlMS, int negativeMS);
+
+/// max cached hosts(default 4096), the expired or the earliest expiring one is evicted if full
+void aio_resolver_setcapacity(int hosts);
+
+/// static host entry(like hosts file), resolved to the address list in order, never expire(not flushed)
+/// @param[in] host host name
+/// @param[in] ips IPv4/IPv6 address list separated by comma(16 at most), e.g. "::1,127.0.0.1", NULL or ""-remove the entry
+/// @return 0-ok, EINVAL-invalid address, ENOMEM-out of memory
+int aio_resolver_sethost(const char* host, const char* ips);
+
+/// remove all cached results(don't affect the queries in progress)
+void aio_resolver_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !_aio_resolver_h_ */
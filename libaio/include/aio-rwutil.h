@@ -20,6 +20,11 @@ int aio_socket_send_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t so
 /// @param[in] vec vec value may be changed, and must be valid until proc callback
 int aio_socket_send_v_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param);
 
+/// send file [offset, offset + bytes) to peer, callback after all data sent
+/// @param[in] fd file descriptor, must be valid until proc callback
+/// @return 0-ok, ENOTSUP-backend don't support, other-error
+int aio_socket_sendfile_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param);
+
 #if defined(__cplusplus)
 }
 #endif
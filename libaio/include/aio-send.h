@@ -23,6 +23,7 @@ int aio_send(struct aio_send_t* send, int timeout, aio_socket_t aio, const void*
 int aio_send_v(struct aio_send_t* send, int timeout, aio_socket_t aio, socket_bufvec_t* vec, int n, aio_onsend onsend, void* param);
 int aio_sendto(struct aio_send_t* send, int timeout, aio_socket_t aio, const struct sockaddr *addr, socklen_t addrlen, const void* buffer, size_t bytes, aio_onsend onsend, void* param);
 int aio_sendto_v(struct aio_send_t* send, int timeout, aio_socket_t aio, const struct sockaddr *addr, socklen_t addrlen, socket_bufvec_t* vec, int n, aio_onsend onsend, void* param);
+int aio_sendfile(struct aio_send_t* send, int timeout, aio_socket_t aio, int fd, int64_t offset, size_t bytes, aio_onsend onsend, void* param);
 
 #if defined(__cplusplus)
 }
@@ -32,6 +32,10 @@ aio_tcp_transport_t* aio_tcp_transport_create2(aio_socket_t aio, struct aio_tcp_
 /// cancel tcp transport recv/send
 int aio_tcp_transport_destroy(aio_tcp_transport_t* transport);
 
+/// release the transport caches(called by aio_worker_clean), created again by the next aio_tcp_transport_create
+/// Remark: all transports MUST be destroyed(ondestroy called)
+void aio_tcp_transport_clean(void);
+
 /// recv data
 int aio_tcp_transport_recv(aio_tcp_transport_t* transport, void* data, size_t bytes);
 int aio_tcp_transport_recv_v(aio_tcp_transport_t* transport, socket_bufvec_t *vec, int n);
@@ -48,6 +52,53 @@ int aio_tcp_transport_send(aio_tcp_transport_t* transport, const void* data, siz
 /// @return 0-ok, other-error
 int aio_tcp_transport_send_v(aio_tcp_transport_t* transport, socket_bufvec_t *vec, int n);
 
+/// Send file data to peer(sendfile), onsend after all bytes sent
+/// @param[in] fd file descriptor, MUST BE VALID until onsend
+/// @param[in] offset file offset in bytes
+/// @param[in] bytes file data length in byte
+/// @return 0-ok, ENOTSUP-aio backend don't support(use aio_tcp_transport_send), other-error
+int aio_tcp_transport_sendfile(aio_tcp_transport_t* transport, int fd, int64_t offset, size_t bytes);
+
+/// aio_tcp_transport_recv_pooled callback
+/// @param[in] code 0-ok, other-error
+/// @param[in] data received data(transport-owned buffer), valid in callback only, NULL if code != 0
+/// @param[in] bytes data length in byte, 0-peer closed
+typedef void (*aio_tcp_transport_ondata)(void* param, int code, const void* data, size_t bytes);
+
+/// Recv data with transport-owned buffer(instead of aio_tcp_transport_recv/recv_v, handler onrecv isn't called)
+/// 1. wait the socket readable without buffer(zero-byte recv), then read into a buffer from the shared size-classed pool(2KB~64KB)
+/// 2. read size grow if the read filled the buffer(read again immediately), shrink if the read is small
+/// 3. the buffer return to the pool after ondata if the socket is drained, so idle connection don't hold any buffer
+/// @param[in] ondata data callback, call aio_tcp_transport_recv_pooled again(in or after callback) for more data
+/// @param[in] param ondata parameter
+/// @return 0-ok, other-error, ondata will not be called
+int aio_tcp_transport_recv_pooled(aio_tcp_transport_t* transport, aio_tcp_transport_ondata ondata, void* param);
+
+/// aio_tcp_transport_post callback, one per buffer
+/// @param[in] code 0-buffer sent, other-error(the buffer maybe partially sent)
+/// @param[in] data/bytes aio_tcp_transport_post buffer
+typedef void (*aio_tcp_transport_onpost)(void* param, int code, const void* data, size_t bytes);
+
+/// Queue data send to peer, queued buffers are coalesced into one writev(send_v)
+/// 1. multiple buffers in flight, sent in post order, callback per buffer(handler onsend isn't called)
+/// 2. don't mix with aio_tcp_transport_send/send_v/sendfile until all posted buffers callback
+/// @param[in] data buffer send to peer, MUST BE VALID until onpost
+/// @param[in] bytes data length in byte
+/// @param[in] onpost buffer sent callback, NULL-no callback
+/// @param[in] param onpost parameter
+/// @return 0-ok, other-error, onpost will not be called
+int aio_tcp_transport_post(aio_tcp_transport_t* transport, const void* data, size_t bytes, aio_tcp_transport_onpost onpost, void* param);
+
+/// Opt-in edge-triggered mode for long-lived connection(see aio_socket_edge_triggered), the socket is set to non-blocking
+/// Remark: MUST be called before any recv/send/post
+/// @return 0-ok, ENOTSUP-backend don't support or epoll instance shared by threads(transport still work), other-error
+int aio_tcp_transport_edge_triggered(aio_tcp_transport_t* transport);
+
+/// aio_tcp_transport_post coalescing options
+/// @param[in] bytes max bytes per writev(default 64KB, IOV_MAX buffers at most), 0-default
+/// @param[in] cork 1-TCP_CORK while more buffers are queued behind the writev batch(aio_tcp_transport_create only), 0-don't cork(default)
+void aio_tcp_transport_set_coalesce(aio_tcp_transport_t* transport, size_t bytes, int cork);
+
 /// @param[in] recvMS recv/send timeout(millisecond), default 4min, 0-infinite
 void aio_tcp_transport_set_timeout(aio_tcp_transport_t* transport, int recvMS, int sendMS);
 void aio_tcp_transport_get_timeout(aio_tcp_transport_t* transport, int *recvMS, int* sendMS);
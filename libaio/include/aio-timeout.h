@@ -12,10 +12,23 @@ struct aio_timeout_t
 	uint8_t reserved[64]; // internal use only
 };
 
-void aio_timeout_process(void);
+/// wheel not processed in the period(ms) is treated as exited thread wheel, adopted by other aio_timeout_process threads
+/// aio_timeout_process thread MUST call it well within the period(e.g. AIO_TIMEOUT_STALE/2) even if idle
+#define AIO_TIMEOUT_STALE 1000
+
+/// timer resolution, default 64ms
+/// MUST be called before any other aio_timeout_xxx function
+/// @param[in] resolutionMS 1 ~ 1024ms, round down to power of 2
+void aio_timeout_set_resolution(int resolutionMS);
+
+/// expire timers of the calling thread wheel(and timers started by non-worker threads)
+/// timers started in the worker thread are processed by the same thread
+/// @return sleep time(ms) to the next timer, e.g. aio_socket_process timeout
+int aio_timeout_process(void);
 
 /// aio timer start/stop
 /// every start MUST call stop once
+/// stop can be called in any thread, return 0-stopped, other-timer have triggered or will be triggered
 int aio_timeout_start(struct aio_timeout_t* timeout, int timeoutMS, void(*notify)(void* param), void* param);
 int aio_timeout_stop(struct aio_timeout_t* timeout);
 
@@ -8,6 +8,17 @@ extern "C" {
 /// call aio_socket_init and create aio worker thread(aio_socket_process)
 /// @param[in] num aio worker thread count
 void aio_worker_init(int num);
+
+/// call aio_socket_init2 and create aio worker thread(aio_socket_process)
+/// @param[in] num aio worker thread count
+/// @param[in] events max events per aio_socket_process
+/// @param[in] flags aio_socket_init2 flags, e.g. AIO_SOCKET_SHARD: one epoll instance per worker thread
+void aio_worker_init2(int num, int events, int flags);
+
+struct thread_affinity_t;
+/// aio_worker_init2 and bind worker thread i to thread_affinity_cpu(affinity, i)
+/// @param[in] affinity cpu placement(see thread-pool.h), NULL-don't bind
+void aio_worker_init3(int num, int events, int flags, const struct thread_affinity_t* affinity);
 void aio_worker_clean(int num);
 
 #if defined(__cplusplus)
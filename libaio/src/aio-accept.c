@@ -1,37 +1,51 @@
 #include "aio-accept.h"
 #include "sys/locker.h"
+#include "sys/atomic.h"
+#include "sys/sock.h"
 #include <assert.h>
 #include <stdlib.h>
 
+struct aio_accept_t;
+struct aio_accept_listen_t
+{
+	struct aio_accept_t* accept;
+	aio_socket_t socket;
+};
+
 struct aio_accept_t
 {
 	locker_t locker;
-	aio_socket_t socket;
+	int32_t ref; // listen socket count
 
 	aio_onaccept onaccpet;
 	void* param;
 
 	aio_ondestroy ondestroy;
 	void* param2;
+
+	int count;
+	struct aio_accept_listen_t listen[1]; // one listen socket per aio shard
 };
 
 static void aio_accept_onclient(void* param, int code, socket_t socket, const struct sockaddr* addr, socklen_t addrlen)
 {
 	int r;
 	struct aio_accept_t* aio;
-	aio = (struct aio_accept_t*)param;
+	struct aio_accept_listen_t* listen;
+	listen = (struct aio_accept_listen_t*)param;
+	aio = listen->accept;
 
 	r = code;
 	if (0 == code)
 	{
 		// continue accept
 		locker_lock(&aio->locker);
-		if (invalid_aio_socket != aio->socket)
-			r = aio_socket_accept(aio->socket, aio_accept_onclient, aio);
+		if (invalid_aio_socket != listen->socket)
+			r = aio_socket_accept(listen->socket, aio_accept_onclient, listen);
 		else
 			r = -1; // destroy
 		locker_unlock(&aio->locker);
-		
+
 		aio->onaccpet(aio->param, code, socket, addr, addrlen);
 	}
 
@@ -46,32 +60,122 @@ static void aio_accept_ondestroy(void* param)
 {
 	struct aio_accept_t* aio;
 	aio = (struct aio_accept_t*)param;
+	if (0 != atomic_decrement32(&aio->ref))
+		return; // wait for other listen socket
+
 	if (aio->ondestroy)
-		aio->ondestroy(aio->param);
+		aio->ondestroy(aio->param2);
 
-	assert(invalid_aio_socket == aio->socket);
 	locker_destroy(&aio->locker);
 	free(aio);
 }
 
+#if defined(SO_REUSEPORT)
+/// create another listen socket on the same address(SO_REUSEPORT), kernel balance connections between them
+static socket_t aio_accept_reuseport(socket_t server)
+{
+	int v6only;
+	socket_t s;
+	socklen_t len;
+	struct sockaddr_storage addr;
+
+	len = sizeof(addr);
+	if (0 != getsockname(server, (struct sockaddr*)&addr, &len))
+		return socket_invalid;
+
+	s = socket(addr.ss_family, SOCK_STREAM, 0);
+	if (socket_invalid == s)
+		return socket_invalid;
+
+	v6only = 0;
+	if (AF_INET6 == addr.ss_family)
+	{
+		len = sizeof(v6only);
+		getsockopt(server, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&v6only, &len);
+	}
+
+	if (0 != socket_setreuseaddr(s, 1)
+		|| 0 != socket_setreuseport(s, 1)
+		|| (AF_INET6 == addr.ss_family && 0 != socket_setipv6only(s, v6only))
+		|| 0 != socket_bind(s, (struct sockaddr*)&addr, socket_addr_len((struct sockaddr*)&addr))
+		|| 0 != socket_listen(s, SOMAXCONN))
+	{
+		socket_close(s);
+		return socket_invalid;
+	}
+	return s;
+}
+#endif
+
 void* aio_accept_start(socket_t socket, aio_onaccept onaccept, void* param)
 {
+	int i, n;
+	socket_t s;
+	aio_socket_t listen;
 	struct aio_accept_t* aio;
 
 	if (NULL == onaccept)
 		return NULL;
 
-	aio = (struct aio_accept_t*)calloc(1, sizeof(*aio));
+	n = aio_socket_shards();
+	n = n > 1 ? n : 1;
+#if defined(SO_REUSEPORT)
+	// SO_REUSEPORT can be enabled after listen(linux)
+	if (n > 1 && 0 != socket_setreuseport(socket, 1))
+		n = 1;
+#else
+	n = 1;
+#endif
+
+	aio = (struct aio_accept_t*)calloc(1, sizeof(*aio) + sizeof(aio->listen[0]) * (n - 1));
 	if (NULL == aio)
 		return NULL;
 
 	aio->param = param;
 	aio->onaccpet = onaccept;
 	locker_create(&aio->locker);
-	aio->socket = aio_socket_create(socket, 1);
-	if (0 != aio_socket_accept(aio->socket, aio_accept_onclient, aio))
+
+	// user socket pinned to shard 0, other shards listen on the same address
+	for (i = 0; i < n; i++)
 	{
-		aio_accept_stop(aio, NULL, NULL);
+#if defined(SO_REUSEPORT)
+		s = 0 == i ? socket : aio_accept_reuseport(socket);
+		if (socket_invalid == s)
+			break;
+#else
+		s = socket;
+#endif
+
+		listen = aio_socket_create2(s, 1, i);
+		if (invalid_aio_socket == listen)
+		{
+			if (0 != i) socket_close(s);
+			break;
+		}
+
+		aio->listen[i].accept = aio;
+		aio->listen[i].socket = listen;
+		aio->count = i + 1;
+		atomic_increment32(&aio->ref);
+		if (0 != aio_socket_accept(listen, aio_accept_onclient, &aio->listen[i]))
+		{
+			if (0 == i)
+			{
+				aio_accept_stop(aio, NULL, NULL);
+				return NULL;
+			}
+
+			// other shards still accept on the user socket
+			aio->listen[i].socket = invalid_aio_socket;
+			aio_socket_destroy(listen, aio_accept_ondestroy, aio);
+			break;
+		}
+	}
+
+	if (aio->count < 1)
+	{
+		locker_destroy(&aio->locker);
+		free(aio);
 		return NULL;
 	}
 
@@ -80,16 +184,22 @@ void* aio_accept_start(socket_t socket, aio_onaccept onaccept, void* param)
 
 int aio_accept_stop(void* p, aio_ondestroy ondestroy, void* param)
 {
+	int i;
 	aio_socket_t socket;
 	struct aio_accept_t* aio;
 	aio = (struct aio_accept_t*)p;
 	aio->ondestroy = ondestroy;
 	aio->param2 = param;
 
-	socket = aio->socket;
-	locker_lock(&aio->locker);
-	aio->socket = invalid_aio_socket;
-	locker_unlock(&aio->locker);
+	for (i = 0; i < aio->count; i++)
+	{
+		locker_lock(&aio->locker);
+		socket = aio->listen[i].socket;
+		aio->listen[i].socket = invalid_aio_socket;
+		locker_unlock(&aio->locker);
 
-	return aio_socket_destroy(socket, aio_accept_ondestroy, aio);
+		if (invalid_aio_socket != socket)
+			aio_socket_destroy(socket, aio_accept_ondestroy, aio);
+	}
+	return 0;
 }
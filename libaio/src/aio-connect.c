@@ -1,4 +1,5 @@
 #include "aio-connect.h"
+#include "aio-resolver.h"
 #include "aio-timeout.h"
 #include "aio-socket.h"
 #include "sys/atomic.h"
@@ -6,125 +7,370 @@
 #include "sockutil.h"
 #include <stdlib.h>
 #include <errno.h>
+#include <assert.h>
 
-struct aio_connect_t
+// Happy Eyeballs(RFC 8305)
+// 1. interleave address families, the first family of the resolved list first
+// 2. start the next attempt after Connection Attempt Delay, or immediately if the last one failed
+// 3. the first success wins, the others are canceled by aio_socket_destroy
+
+#define AIO_CONNECT_DELAY 250 // RFC 8305 Connection Attempt Delay(ms)
+
+#define AIO_CONNECT_IDLE	0
+#define AIO_CONNECT_PENDING	1
+#define AIO_CONNECT_DONE	2
+
+struct aio_connect_t;
+struct aio_connect_attempt_t
 {
-	u_short port;
+	struct aio_connect_t* conn;
+	struct addrinfo* addr;
 	socket_t socket;
 	aio_socket_t aio;
-	struct addrinfo *addr, *ptr;
 	struct aio_timeout_t timer;
+	int state; // AIO_CONNECT_XXX
+};
+
+struct aio_connect_t
+{
+	int32_t ref; // 1-result callback, +1 per attempt socket, +1 per armed timer
+	locker_t locker;
+
+	u_short port;
+	struct addrinfo* addr;
+	struct aio_connect_attempt_t* attempts; // interleaved address list
+	int count;
+	int next; // next attempt
+	int pending; // attempts in progress
+	int finished; // result callback
+	int code; // last error
+	int resolving; // in aio_resolve call: resolver failure is returned by aio_connect
+	int error; // resolver failure in aio_resolve call
+
+	struct aio_timeout_t delay; // Connection Attempt Delay
+	int delaying;
 	int timeout;
 
 	void (*onconnect)(void* param, int code, aio_socket_t aio);
 	void* param;
 };
 
-static void aio_connect_addr(struct aio_connect_t* conn, int code);
-static void aio_connect_finish(struct aio_connect_t* conn, int code);
 static void aio_connect_onconnect(void* param, int code);
 static void aio_connect_ontimeout(void* param);
+static void aio_connect_ondelay(void* param);
 
-static void aio_connect_finish(struct aio_connect_t* conn, int code)
+static void aio_connect_release(struct aio_connect_t* conn)
 {
-	conn->onconnect(conn->param, code, conn->aio);
+	if (0 != atomic_decrement32(&conn->ref))
+		return;
 
 	if (conn->addr)
-		freeaddrinfo(conn->addr);
+		aio_resolver_free(conn->addr);
+	if (conn->attempts)
+		free(conn->attempts);
+	locker_destroy(&conn->locker);
 	free(conn);
 }
 
+static void aio_connect_finish(struct aio_connect_t* conn, int code, aio_socket_t aio)
+{
+	conn->onconnect(conn->param, code, aio);
+	aio_connect_release(conn);
+}
+
 static void aio_connect_ondestroy(void* param)
 {
+	struct aio_connect_attempt_t* attempt;
+	attempt = (struct aio_connect_attempt_t*)param;
+	aio_connect_release(attempt->conn);
+}
+
+/// cancel attempt in progress(with locker)
+static void aio_connect_cancel(struct aio_connect_attempt_t* attempt)
+{
+	struct aio_connect_t* conn;
+	conn = attempt->conn;
+	assert(AIO_CONNECT_PENDING == attempt->state);
+	attempt->state = AIO_CONNECT_DONE;
+	conn->pending--;
+
+	if (0 == aio_timeout_stop(&attempt->timer))
+		atomic_decrement32(&conn->ref); // socket reference still held
+	aio_socket_destroy(attempt->aio, aio_connect_ondestroy, attempt);
+}
+
+/// start the next attempt(with locker)
+/// @return 0-attempt in progress, other-all attempts failed
+static int aio_connect_next(struct aio_connect_t* conn)
+{
+	int r;
+	struct addrinfo *addr;
+	struct aio_connect_attempt_t* attempt;
+
+	while (conn->next < conn->count)
+	{
+		attempt = &conn->attempts[conn->next++];
+		addr = attempt->addr;
+		attempt->socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (socket_invalid == attempt->socket)
+		{
+			conn->code = socket_geterror();
+			continue;
+		}
+
+		// fixed ios getaddrinfo don't set port if nodename is ipv4 address
+		socket_addr_setport(addr->ai_addr, addr->ai_addrlen, conn->port);
+
+#if defined(OS_WINDOWS)
+		socket_bind_any(attempt->socket, 0);
+#endif
+		socket_setnonblock(attempt->socket, 1); // don't block in connect, attempts run in parallel
+		attempt->aio = aio_socket_create(attempt->socket, 1);
+		if (invalid_aio_socket == attempt->aio)
+		{
+			socket_close(attempt->socket);
+			conn->code = ENOMEM;
+			continue;
+		}
+
+		atomic_add32(&conn->ref, 2); // socket + timer
+		attempt->state = AIO_CONNECT_PENDING;
+		conn->pending++;
+		r = aio_timeout_start(&attempt->timer, conn->timeout, aio_connect_ontimeout, attempt);
+		if (0 != r)
+		{
+			atomic_decrement32(&conn->ref); // timer
+			attempt->state = AIO_CONNECT_DONE;
+			conn->pending--;
+			conn->code = r;
+			aio_socket_destroy(attempt->aio, aio_connect_ondestroy, attempt);
+			continue;
+		}
+
+		r = aio_socket_connect(attempt->aio, addr->ai_addr, addr->ai_addrlen, aio_connect_onconnect, attempt);
+		if (0 != r)
+		{
+			conn->code = r;
+			aio_connect_cancel(attempt);
+			continue;
+		}
+
+		if (conn->next < conn->count && !conn->delaying)
+		{
+			atomic_increment32(&conn->ref);
+			conn->delaying = 1;
+			if (0 != aio_timeout_start(&conn->delay, AIO_CONNECT_DELAY, aio_connect_ondelay, conn))
+			{
+				atomic_decrement32(&conn->ref); // start the next one after this failed
+				conn->delaying = 0;
+			}
+		}
+		return 0;
+	}
+
+	return conn->pending > 0 ? 0 : (0 != conn->code ? conn->code : ECONNREFUSED);
+}
+
+static void aio_connect_ondelay(void* param)
+{
+	int r;
 	struct aio_connect_t* conn;
 	conn = (struct aio_connect_t*)param;
-	aio_connect_addr(conn, ETIMEDOUT); // try next addr
+
+	locker_lock(&conn->locker);
+	conn->delaying = 0;
+	r = conn->finished ? 0 : aio_connect_next(conn);
+	if (0 != r)
+		conn->finished = 1;
+	locker_unlock(&conn->locker);
+
+	if (0 != r)
+		aio_connect_finish(conn, r, invalid_aio_socket);
+	aio_connect_release(conn); // delay timer
 }
 
 static void aio_connect_ontimeout(void* param)
 {
+	int r;
 	struct aio_connect_t* conn;
-	conn = (struct aio_connect_t*)param;
-	aio_socket_destroy(conn->aio, aio_connect_ondestroy, conn); // cancel
+	struct aio_connect_attempt_t* attempt;
+	attempt = (struct aio_connect_attempt_t*)param;
+	conn = attempt->conn;
+
+	r = 0;
+	locker_lock(&conn->locker);
+	if (AIO_CONNECT_PENDING == attempt->state)
+	{
+		attempt->state = AIO_CONNECT_DONE;
+		conn->pending--;
+		conn->code = ETIMEDOUT;
+		aio_socket_destroy(attempt->aio, aio_connect_ondestroy, attempt); // cancel
+
+		r = conn->finished ? 0 : aio_connect_next(conn);
+		if (0 != r)
+			conn->finished = 1;
+	}
+	locker_unlock(&conn->locker);
+
+	if (0 != r)
+		aio_connect_finish(conn, r, invalid_aio_socket);
+	aio_connect_release(conn); // attempt timer
 }
 
 static void aio_connect_onconnect(void* param, int code)
 {
+	int i, r;
+	aio_socket_t aio;
 	struct aio_connect_t* conn;
-	conn = (struct aio_connect_t*)param;
-	if (0 != aio_timeout_stop(&conn->timer))
-		return;
+	struct aio_connect_attempt_t* attempt;
+	attempt = (struct aio_connect_attempt_t*)param;
+	conn = attempt->conn;
 
-	if (0 == code)
+	r = 0;
+	aio = invalid_aio_socket;
+	atomic_increment32(&conn->ref); // socket reference is held by the caller
+	locker_lock(&conn->locker);
+	if (AIO_CONNECT_PENDING == attempt->state)
 	{
-		aio_connect_finish(conn, code);
+		assert(!conn->finished);
+		attempt->state = AIO_CONNECT_DONE;
+		conn->pending--;
+		if (0 == aio_timeout_stop(&attempt->timer))
+			atomic_decrement32(&conn->ref);
+
+		if (0 == code)
+		{
+			// the winner, socket owned by user now
+			aio = attempt->aio;
+			socket_setnonblock(attempt->socket, 0);
+			atomic_decrement32(&conn->ref);
+			conn->finished = 1;
+
+			for (i = 0; i < conn->next; i++)
+			{
+				if (AIO_CONNECT_PENDING == conn->attempts[i].state)
+					aio_connect_cancel(&conn->attempts[i]);
+			}
+
+			if (conn->delaying && 0 == aio_timeout_stop(&conn->delay))
+			{
+				conn->delaying = 0;
+				atomic_decrement32(&conn->ref);
+			}
+		}
+		else
+		{
+			conn->code = code;
+			aio_socket_destroy(attempt->aio, aio_connect_ondestroy, attempt);
+
+			r = aio_connect_next(conn);
+			if (0 != r)
+				conn->finished = 1;
+		}
 	}
-	else
+	// else: timeout or canceled, aio_socket_destroy have been called
+	locker_unlock(&conn->locker);
+
+	if (invalid_aio_socket != aio)
+		aio_connect_finish(conn, 0, aio);
+	else if (0 != r)
+		aio_connect_finish(conn, r, invalid_aio_socket);
+	aio_connect_release(conn);
+}
+
+/// next address with(same = 1) or without(same = 0) the family
+static struct addrinfo* aio_connect_family(struct addrinfo* addr, int family, int same)
+{
+	for (; addr && (addr->ai_family == family) != same; addr = addr->ai_next)
 	{
-		aio_socket_destroy(conn->aio, NULL, NULL);
-		aio_connect_addr(conn, code);
 	}
+	return addr;
 }
 
-static void aio_connect_addr(struct aio_connect_t* conn, int code)
+static void aio_connect_onresolve(void* param, int code, struct addrinfo* addr)
 {
-	struct addrinfo *addr;
-
-	for(addr = conn->ptr; NULL != addr; addr = conn->ptr)
+	int i, n, family;
+	struct addrinfo *ai, *first, *second;
+	struct aio_connect_t* conn;
+	conn = (struct aio_connect_t*)param;
+	if (0 != code)
 	{
-		conn->ptr = conn->ptr->ai_next;
-		conn->socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-		if (socket_invalid == conn->socket)
-			continue;
-
-		// fixed ios getaddrinfo don't set port if nodename is ipv4 address
-		socket_addr_setport(addr->ai_addr, addr->ai_addrlen, conn->port);
+		locker_lock(&conn->locker);
+		n = conn->resolving;
+		conn->error = code;
+		locker_unlock(&conn->locker);
+		if (!n)
+			aio_connect_finish(conn, code, invalid_aio_socket);
+		return;
+	}
 
-#if defined(OS_WINDOWS)
-		socket_bind_any(conn->socket, 0);
-#endif
-		//socket_setnonblock(conn->socket, 1);
-		//socket_setnondelay(conn->socket, 1);
-		conn->aio = aio_socket_create(conn->socket, 1);
+	conn->addr = addr;
+	for (n = 0, ai = addr; ai; ai = ai->ai_next)
+		n++;
+	conn->attempts = (struct aio_connect_attempt_t*)calloc(n, sizeof(struct aio_connect_attempt_t));
+	if (NULL == conn->attempts)
+	{
+		aio_connect_finish(conn, ENOMEM, invalid_aio_socket);
+		return;
+	}
 
-		// TODO: lock
-		code = aio_timeout_start(&conn->timer, conn->timeout, aio_connect_ontimeout, conn);
-		code = aio_socket_connect(conn->aio, addr->ai_addr, addr->ai_addrlen, aio_connect_onconnect, conn);
-		if (0 == code)
-			return;
+	// RFC 8305 4. Sorting Addresses: interleave families, e.g. IPv6, IPv4, IPv6, IPv4, ...
+	family = addr->ai_family;
+	first = addr;
+	second = aio_connect_family(addr, family, 0);
+	for (i = 0; i < n; i++)
+	{
+		if (first && (0 == i % 2 || NULL == second))
+		{
+			ai = first;
+			first = aio_connect_family(first->ai_next, family, 1);
+		}
+		else
+		{
+			ai = second;
+			second = aio_connect_family(second->ai_next, family, 0);
+		}
 
-		aio_timeout_stop(&conn->timer);
-		aio_socket_destroy(conn->aio, NULL, NULL); // try next addr
+		conn->attempts[i].conn = conn;
+		conn->attempts[i].addr = ai;
 	}
+	conn->count = n;
 
-	aio_connect_finish(conn, code);
+	locker_lock(&conn->locker);
+	code = aio_connect_next(conn);
+	if (0 != code)
+		conn->finished = 1;
+	locker_unlock(&conn->locker);
+
+	if (0 != code)
+		aio_connect_finish(conn, code, invalid_aio_socket);
 }
 
 int aio_connect(const char* host, int port, int timeout, void (*onconnect)(void* param, int code, aio_socket_t aio), void* param)
 {
 	int r;
-	char portstr[16];
 	struct aio_connect_t* conn;
-	struct addrinfo hints, *addr;
-
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = PF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-//	hints.ai_flags = AI_V4MAPPED | AI_ADDRCONFIG;
-	snprintf(portstr, sizeof(portstr), "%d", port);
-	r = getaddrinfo(host, portstr, &hints, &addr);
-	if (0 != r)
-		return r;
 
 	conn = calloc(1, sizeof(*conn));
     if (!conn) return ENOMEM;
 
+	conn->ref = 2; // +1 aio_connect call(the result maybe callback in other thread before aio_resolve return)
 	conn->onconnect = onconnect;
 	conn->param = param;
-	conn->addr = addr;
-	conn->ptr = addr;
 	conn->port = (u_short)port;
 	conn->timeout = timeout;
-	aio_connect_addr(conn, -1);
-	return 0;
+	locker_create(&conn->locker);
+
+	// DNS query in resolver thread
+	conn->resolving = 1;
+	aio_resolve(host, port, aio_connect_onresolve, conn);
+
+	locker_lock(&conn->locker);
+	conn->resolving = 0;
+	r = conn->error;
+	locker_unlock(&conn->locker);
+	if (0 != r)
+		aio_connect_release(conn); // onconnect will not be called
+	aio_connect_release(conn);
+	return r;
 }
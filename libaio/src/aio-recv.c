@@ -5,14 +5,14 @@
 #include <string.h>
 #include <errno.h>
 
-enum { AIO_STATUS_INIT = 0, AIO_STATUS_START, AIO_STATUS_TIMEOUT };
+enum { AIO_STATUS_INIT = 0, AIO_STATUS_START, AIO_STATUS_TIMEOUT, AIO_STATUS_INFINITE };
 
 #define AIO_RECV_START(recv) {assert(AIO_STATUS_INIT == recv->status);recv->status = AIO_STATUS_START;}
 
 #define AIO_START_TIMEOUT(aio, timeout, callback)	\
 	if (timeout > 0) {								\
 		aio_timeout_start(&aio->timeout, timeout, callback, aio); \
-	} else {}
+	} else { aio->status = AIO_STATUS_INFINITE; }
 
 #define AIO_STOP_TIMEOUT_ON_FAILED(aio, r, timeout)	\
 	if (0 != r) aio->status = AIO_STATUS_INIT;		\
@@ -40,6 +40,10 @@ static void aio_timeout_udp(void* param)
 
 static int aio_handler_check(struct aio_recv_t* recv)
 {
+	// no timer
+	if (atomic_cas32(&recv->status, AIO_STATUS_INFINITE, AIO_STATUS_INIT))
+		return 1;
+
 	while (AIO_STATUS_START == atomic_load32(&recv->status))
 	{
 		// Thread 1 -> timeout, change status to AIO_STATUS_TIMEOUT
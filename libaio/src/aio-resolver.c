@@ -0,0 +1,427 @@
+#include "aio-resolver.h"
+#include "thread-pool.h"
+#include "hash-list.h"
+#include "jhash.h"
+#include "sys/locker.h"
+#include "sys/system.h"
+#include "sys/onetime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+// Resolver: getaddrinfo in thread pool(don't block aio worker), with positive/negative cache
+
+#define AIO_RESOLVER_BUCKETS	256
+#define AIO_RESOLVER_MAX		4096 // max cached hosts
+#define AIO_RESOLVER_THREADS	8
+#define AIO_RESOLVER_HOST_IPS	16 // aio_resolver_sethost max addresses
+
+struct aio_resolver_waiter_t
+{
+	struct aio_resolver_waiter_t* next;
+	int port;
+	aio_onresolve onresolve;
+	void* param;
+
+	int code;
+	struct addrinfo* addr;
+};
+
+struct aio_resolver_entry_t
+{
+	struct hash_node_t link;
+	uint32_t hash;
+	uint64_t expire; // cache expire clock
+	int pending; // getaddrinfo in progress
+	int code; // getaddrinfo result
+	struct addrinfo* addr;
+	struct aio_resolver_waiter_t* waiters;
+	char host[1];
+};
+
+// static host(aio_resolver_sethost)
+struct aio_resolver_host_t
+{
+	struct aio_resolver_host_t* next;
+	struct addrinfo* addr; // aio_resolver_copy
+	char host[1];
+};
+
+static struct
+{
+	locker_t locker;
+	thread_pool_t pool;
+	struct hash_head_t buckets[AIO_RESOLVER_BUCKETS];
+	int count;
+	int capacity;
+	struct aio_resolver_host_t* hosts;
+
+	int ttl;
+	int negative;
+} s_resolver;
+
+static onetime_t s_init = ONETIME_INIT;
+
+static void aio_resolver_init(void)
+{
+	locker_create(&s_resolver.locker);
+	s_resolver.pool = thread_pool_create(1, 1, AIO_RESOLVER_THREADS);
+	s_resolver.ttl = s_resolver.ttl ? s_resolver.ttl : 60 * 1000;
+	s_resolver.negative = s_resolver.negative ? s_resolver.negative : 5 * 1000;
+	s_resolver.capacity = s_resolver.capacity ? s_resolver.capacity : AIO_RESOLVER_MAX;
+}
+
+#define AIO_RESOLVER_ALIGN(n) (((n) + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*))
+
+/// copy address list in one memory block, set port
+static struct addrinfo* aio_resolver_copy(const struct addrinfo* addr, int port)
+{
+	size_t n;
+	uint8_t* ptr;
+	struct addrinfo* ai;
+	struct addrinfo* list;
+	struct addrinfo** pnext;
+	const struct addrinfo* it;
+
+	for (n = 0, it = addr; it; it = it->ai_next)
+		n += AIO_RESOLVER_ALIGN(sizeof(struct addrinfo) + it->ai_addrlen);
+
+	list = NULL;
+	pnext = &list;
+	ptr = n > 0 ? (uint8_t*)malloc(n) : NULL;
+	for (it = addr; ptr && it; it = it->ai_next)
+	{
+		ai = (struct addrinfo*)ptr;
+		memcpy(ai, it, sizeof(struct addrinfo));
+		ai->ai_canonname = NULL;
+		ai->ai_next = NULL;
+		ai->ai_addr = (struct sockaddr*)(ai + 1);
+		memcpy(ai->ai_addr, it->ai_addr, it->ai_addrlen);
+		socket_addr_setport(ai->ai_addr, (socklen_t)ai->ai_addrlen, (u_short)port);
+
+		*pnext = ai;
+		pnext = &ai->ai_next;
+		ptr += AIO_RESOLVER_ALIGN(sizeof(struct addrinfo) + it->ai_addrlen);
+	}
+	return list;
+}
+
+void aio_resolver_free(struct addrinfo* addr)
+{
+	free(addr); // aio_resolver_copy memory block
+}
+
+static int aio_resolver_getaddrinfo(const char* host, int flags, struct addrinfo** addr)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = PF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = flags;
+//	hints.ai_flags = AI_V4MAPPED | AI_ADDRCONFIG;
+	return getaddrinfo(host, NULL, &hints, addr);
+}
+
+static struct aio_resolver_entry_t* aio_resolver_find(const char* host, uint32_t hash)
+{
+	struct hash_node_t* pos;
+	struct aio_resolver_entry_t* entry;
+	hash_list_for_each(pos, &s_resolver.buckets[hash % AIO_RESOLVER_BUCKETS])
+	{
+		entry = hash_list_entry(pos, struct aio_resolver_entry_t, link);
+		if (entry->hash == hash && 0 == strcmp(entry->host, host))
+			return entry;
+	}
+	return NULL;
+}
+
+static void aio_resolver_remove(struct aio_resolver_entry_t* entry)
+{
+	assert(0 == entry->pending && NULL == entry->waiters);
+	hash_list_unlink(&entry->link);
+	--s_resolver.count;
+	if (entry->addr)
+		freeaddrinfo(entry->addr);
+	free(entry);
+}
+
+/// remove expired entries, or anyone if all entries are valid
+static void aio_resolver_evict(uint64_t clock)
+{
+	int i;
+	struct hash_node_t *pos, *next;
+	struct aio_resolver_entry_t* entry;
+	struct aio_resolver_entry_t* victim;
+
+	victim = NULL;
+	for (i = 0; i < AIO_RESOLVER_BUCKETS; i++)
+	{
+		hash_list_for_each_safe(pos, next, &s_resolver.buckets[i])
+		{
+			entry = hash_list_entry(pos, struct aio_resolver_entry_t, link);
+			if (entry->pending)
+				continue;
+			if (entry->expire < clock)
+				aio_resolver_remove(entry);
+			else if (NULL == victim || entry->expire < victim->expire)
+				victim = entry;
+		}
+	}
+
+	if (s_resolver.count >= s_resolver.capacity && victim)
+		aio_resolver_remove(victim);
+}
+
+static void aio_resolver_worker(void* param)
+{
+	int code;
+	struct addrinfo* addr;
+	struct aio_resolver_entry_t* entry;
+	struct aio_resolver_waiter_t* waiter;
+	struct aio_resolver_waiter_t* waiters;
+
+	entry = (struct aio_resolver_entry_t*)param;
+	code = aio_resolver_getaddrinfo(entry->host, 0, &addr);
+
+	locker_lock(&s_resolver.locker);
+	if (entry->addr)
+		freeaddrinfo(entry->addr);
+	entry->addr = 0 == code ? addr : NULL;
+	entry->code = code;
+	entry->expire = system_clock() + (0 == code ? s_resolver.ttl : s_resolver.negative);
+	entry->pending = 0;
+	waiters = entry->waiters;
+	entry->waiters = NULL;
+
+	// copy result before unlock(entry maybe evicted)
+	for (waiter = waiters; waiter; waiter = waiter->next)
+	{
+		waiter->addr = 0 == code ? aio_resolver_copy(entry->addr, waiter->port) : NULL;
+		waiter->code = (0 == code && NULL == waiter->addr) ? EAI_MEMORY : code;
+	}
+	locker_unlock(&s_resolver.locker);
+
+	while (waiters)
+	{
+		waiter = waiters;
+		waiters = waiters->next;
+		waiter->onresolve(waiter->param, waiter->code, waiter->addr);
+		free(waiter);
+	}
+}
+
+/// static host lookup
+/// @return 0-found(*addr NULL if out of memory), -1-not found
+static int aio_resolver_static(const char* host, int port, struct addrinfo** addr)
+{
+	struct aio_resolver_host_t* h;
+	if (NULL == s_resolver.hosts)
+		return -1; // plain read: set before the queries
+
+	locker_lock(&s_resolver.locker);
+	for (h = s_resolver.hosts; h && 0 != strcmp(h->host, host); h = h->next)
+	{
+	}
+	*addr = h ? aio_resolver_copy(h->addr, port) : NULL;
+	locker_unlock(&s_resolver.locker);
+	return h ? 0 : -1;
+}
+
+/// callback the result in the calling thread
+static int aio_resolver_callback(aio_onresolve onresolve, void* param, int code, struct addrinfo* addr)
+{
+	onresolve(param, code, 0 == code ? addr : NULL);
+	return 0;
+}
+
+int aio_resolve(const char* host, int port, aio_onresolve onresolve, void* param)
+{
+	int r;
+	size_t n;
+	uint32_t hash;
+	uint64_t clock;
+	struct addrinfo* addr;
+	struct addrinfo* result;
+	struct aio_resolver_entry_t* entry;
+	struct aio_resolver_waiter_t* waiter;
+
+	// IPv4/IPv6 address: don't need DNS
+	if (0 == aio_resolver_getaddrinfo(host, AI_NUMERICHOST, &addr))
+	{
+		result = aio_resolver_copy(addr, port);
+		freeaddrinfo(addr);
+		return aio_resolver_callback(onresolve, param, result ? 0 : EAI_MEMORY, result);
+	}
+
+	onetime_exec(&s_init, aio_resolver_init);
+	if (0 == aio_resolver_static(host, port, &result))
+		return aio_resolver_callback(onresolve, param, result ? 0 : EAI_MEMORY, result);
+	if (NULL == s_resolver.pool)
+		return aio_resolver_callback(onresolve, param, EAI_MEMORY, NULL);
+
+	n = strlen(host);
+	hash = jhash(host, (uint32_t)n, 0);
+	waiter = (struct aio_resolver_waiter_t*)calloc(1, sizeof(*waiter));
+	if (NULL == waiter)
+		return aio_resolver_callback(onresolve, param, EAI_MEMORY, NULL);
+	waiter->port = port;
+	waiter->onresolve = onresolve;
+	waiter->param = param;
+
+	clock = system_clock();
+	locker_lock(&s_resolver.locker);
+	entry = aio_resolver_find(host, hash);
+	if (entry && !entry->pending && entry->expire >= clock)
+	{
+		// cache hit(positive or negative)
+		r = entry->code;
+		result = 0 == r ? aio_resolver_copy(entry->addr, port) : NULL;
+		locker_unlock(&s_resolver.locker);
+		free(waiter);
+		return aio_resolver_callback(onresolve, param, (0 == r && NULL == result) ? EAI_MEMORY : r, result);
+	}
+
+	if (NULL == entry)
+	{
+		if (s_resolver.count >= s_resolver.capacity)
+			aio_resolver_evict(clock);
+
+		entry = (struct aio_resolver_entry_t*)calloc(1, sizeof(*entry) + n);
+		if (NULL == entry)
+		{
+			locker_unlock(&s_resolver.locker);
+			free(waiter);
+			return aio_resolver_callback(onresolve, param, EAI_MEMORY, NULL);
+		}
+		memcpy(entry->host, host, n + 1);
+		entry->hash = hash;
+		hash_list_link(&s_resolver.buckets[hash % AIO_RESOLVER_BUCKETS], &entry->link);
+		++s_resolver.count;
+	}
+
+	// merge the same host queries
+	waiter->next = entry->waiters;
+	entry->waiters = waiter;
+	if (!entry->pending)
+	{
+		entry->pending = 1;
+		r = thread_pool_push(s_resolver.pool, aio_resolver_worker, entry);
+		if (0 != r)
+		{
+			entry->pending = 0;
+			entry->waiters = NULL;
+			entry->expire = 0; // remove on next evict
+			locker_unlock(&s_resolver.locker);
+			free(waiter);
+			return aio_resolver_callback(onresolve, param, EAI_AGAIN, NULL);
+		}
+	}
+	locker_unlock(&s_resolver.locker);
+	return 0;
+}
+
+void aio_resolver_setttl(int ttlMS, int negativeMS)
+{
+	s_resolver.ttl = ttlMS > 0 ? ttlMS : 1;
+	s_resolver.negative = negativeMS > 0 ? negativeMS : 1;
+}
+
+void aio_resolver_setcapacity(int hosts)
+{
+	s_resolver.capacity = hosts > 0 ? hosts : AIO_RESOLVER_MAX;
+}
+
+int aio_resolver_sethost(const char* host, const char* ips)
+{
+	int i, n, r;
+	size_t len;
+	char ip[SOCKET_ADDRLEN];
+	const char* p;
+	struct addrinfo* lists[AIO_RESOLVER_HOST_IPS];
+	struct addrinfo* tails[AIO_RESOLVER_HOST_IPS];
+	struct aio_resolver_host_t *h, *old;
+	struct aio_resolver_host_t** pp;
+
+	// parse the ip list, link the getaddrinfo lists to copy them in one block
+	r = 0;
+	for (n = 0, p = ips ? ips : ""; *p && 0 == r; p += len + (',' == p[len] ? 1 : 0))
+	{
+		len = strcspn(p, ",");
+		if (len >= sizeof(ip) || n >= AIO_RESOLVER_HOST_IPS)
+			r = EINVAL;
+		else
+		{
+			memcpy(ip, p, len);
+			ip[len] = 0;
+			r = 0 == aio_resolver_getaddrinfo(ip, AI_NUMERICHOST, &lists[n]) ? 0 : EINVAL;
+		}
+
+		if (0 == r)
+		{
+			for (tails[n] = lists[n]; tails[n]->ai_next; tails[n] = tails[n]->ai_next)
+			{
+			}
+			if (n > 0)
+				tails[n - 1]->ai_next = lists[n];
+			n++;
+		}
+	}
+
+	h = NULL;
+	if (0 == r && n > 0)
+	{
+		len = strlen(host);
+		h = (struct aio_resolver_host_t*)calloc(1, sizeof(*h) + len);
+		if (h)
+		{
+			memcpy(h->host, host, len + 1);
+			h->addr = aio_resolver_copy(lists[0], 0);
+		}
+		if (h && NULL == h->addr)
+		{
+			free(h);
+			h = NULL;
+		}
+		r = h ? 0 : ENOMEM;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		tails[i]->ai_next = NULL;
+		freeaddrinfo(lists[i]);
+	}
+	if (0 != r)
+		return r;
+
+	// replace(or remove if the ip list is empty)
+	onetime_exec(&s_init, aio_resolver_init);
+	locker_lock(&s_resolver.locker);
+	for (pp = &s_resolver.hosts; *pp && 0 != strcmp((*pp)->host, host); pp = &(*pp)->next)
+	{
+	}
+	old = *pp;
+	if (old)
+		*pp = old->next;
+	if (h)
+	{
+		h->next = s_resolver.hosts;
+		s_resolver.hosts = h;
+	}
+	locker_unlock(&s_resolver.locker);
+
+	if (old)
+	{
+		aio_resolver_free(old->addr);
+		free(old);
+	}
+	return 0;
+}
+
+void aio_resolver_flush(void)
+{
+	onetime_exec(&s_init, aio_resolver_init);
+	locker_lock(&s_resolver.locker);
+	aio_resolver_evict((uint64_t)-1); // pending entries are kept
+	locker_unlock(&s_resolver.locker);
+}
@@ -31,6 +31,10 @@ struct aio_socket_ptr_t
 	socket_bufvec_t* vec;
 	int count;
 
+	int fd; // sendfile
+	int64_t offset;
+	size_t bytes;
+
 	socket_bufvec_t __vec[1];
 	size_t __n; // reserved internal use, don't change it value
 };
@@ -113,6 +117,35 @@ static void aio_socket_onsend_v(void* param, int code, size_t bytes)
 		ptr->on.onsend(ptr->param, code, ptr->__n);
 }
 
+static void aio_socket_onsendfile(void* param, int code, size_t bytes)
+{
+	struct aio_socket_ptr_t* ptr;
+	ptr = (struct aio_socket_ptr_t*)param;
+	if (0 == code)
+	{
+		ptr->__n += bytes;
+		ptr->offset += bytes;
+		ptr->bytes -= bytes < ptr->bytes ? bytes : ptr->bytes;
+
+		if (0 == ptr->bytes)
+		{
+			ptr->on.onsend(ptr->param, code, ptr->__n);
+		}
+		else if (0 == bytes)
+		{
+			code = EPIPE; // file truncated
+		}
+		else
+		{
+			// large file: timeout per sendfile call(no progress), not the whole transfer
+			code = aio_sendfile(&ptr->u.send, ptr->timeout, ptr->socket, ptr->fd, ptr->offset, ptr->bytes, aio_socket_onsendfile, ptr);
+		}
+	}
+
+	if (0 != code)
+		ptr->on.onsend(ptr->param, code, ptr->__n);
+}
+
 int aio_socket_recv_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t socket, void* buffer, size_t bytes, aio_onrecv proc, void* param)
 {
 	struct aio_socket_ptr_t* ptr;
@@ -160,3 +193,19 @@ int aio_socket_send_v_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t
 	ptr->__n = 0;
 	return aio_send_v(&ptr->u.send, timeout, ptr->socket, ptr->vec, ptr->count, aio_socket_onsend_v, ptr);
 }
+
+int aio_socket_sendfile_all(struct aio_socket_rw_t* rw, int timeout, aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param)
+{
+	struct aio_socket_ptr_t* ptr;
+	ptr = (struct aio_socket_ptr_t*)rw;
+	ptr->clock = system_clock();
+	ptr->timeout = timeout;
+	ptr->socket = socket;
+	ptr->on.onsend = proc;
+	ptr->param = param;
+	ptr->fd = fd;
+	ptr->offset = offset;
+	ptr->bytes = bytes;
+	ptr->__n = 0;
+	return aio_sendfile(&ptr->u.send, timeout, ptr->socket, ptr->fd, ptr->offset, ptr->bytes, aio_socket_onsendfile, ptr);
+}
@@ -89,3 +89,16 @@ int aio_sendto_v(struct aio_send_t* send, int timeout, aio_socket_t aio, const s
 	AIO_STOP_TIMEOUT_ON_FAILED(send, r, timeout);
 	return r;
 }
+
+int aio_sendfile(struct aio_send_t* send, int timeout, aio_socket_t aio, int fd, int64_t offset, size_t bytes, aio_onsend onsend, void* param)
+{
+	int r;
+	AIO_SEND_START(send);
+	send->param = param;
+	send->onsend = onsend;
+	memset(&send->timeout, 0, sizeof(send->timeout));
+	AIO_START_TIMEOUT(send, timeout, aio_send_timeout);
+	r = aio_socket_sendfile(aio, fd, offset, bytes, aio_send_handler, send);
+	AIO_STOP_TIMEOUT_ON_FAILED(send, r, timeout);
+	return r;
+}
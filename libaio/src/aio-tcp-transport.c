@@ -5,12 +5,43 @@
 #include "sys/atomic.h"
 #include "sys/system.h"
 #include "sys/spinlock.h"
+#include "sys/locker.h"
+#include "sys/onetime.h"
+#include "slab-cache.h"
+#include "sys/sock.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
 #include <assert.h>
+#if !defined(OS_WINDOWS)
+#include <sys/uio.h>
+#endif
 
 #define TIMEOUT_RECV (4 * 60 * 1000) // 4min
 #define TIMEOUT_SEND (2 * 60 * 1000) // 2min
+#define MAX_CACHE 1024 // max cached transport per thread
+#define MAX_POST_CACHE 4096 // max cached post buffer node per thread
+#define COALESCE_BYTES (64 * 1024) // default max bytes per writev
+#define RECV_CLASSES 6 // pooled recv buffer size classes: 2KB ~ 64KB
+#define RECV_CLASS_BYTES(c) ((size_t)(2 * 1024) << (c))
+
+#if !defined(IOV_MAX)
+#if defined(UIO_MAXIOV)
+#define IOV_MAX UIO_MAXIOV
+#else
+#define IOV_MAX 64
+#endif
+#endif
+
+struct aio_tcp_transport_post_t
+{
+	struct aio_tcp_transport_post_t* next;
+	const void* data;
+	size_t bytes;
+	aio_tcp_transport_onpost onpost;
+	void* param;
+};
 
 struct aio_tcp_transport_t
 {
@@ -24,6 +55,28 @@ struct aio_tcp_transport_t
 	struct aio_recv_t recv;
 	struct aio_socket_rw_t send;
 
+	// send queue(aio_tcp_transport_post)
+	socket_t fd; // for TCP_CORK, socket_invalid if created by aio_socket_t
+	struct aio_tcp_transport_post_t* head; // the first nbatch buffers in flight
+	struct aio_tcp_transport_post_t** tail;
+	int nbatch;
+	int completing; // onpost callback in progress, the next batch wait for it(keep callback order)
+	socket_bufvec_t* vec;
+	int capacity; // vec capacity
+	size_t coalesce; // max bytes per writev
+	int cork;
+	int corked;
+
+	// pooled recv(aio_tcp_transport_recv_pooled)
+	aio_tcp_transport_ondata ondata;
+	void* dparam;
+	void* rbuffer; // hold only while the socket has more data
+	int rbclass; // rbuffer size class
+	int rclass; // next read size class
+	int rmore; // last read filled the buffer, read without wait readable
+	int rbusy; // ondata callback in progress
+	int rnext; // recv_pooled in ondata callback
+
 	struct aio_tcp_transport_handler_t handler;
 	void* param;
 };
@@ -34,21 +87,83 @@ struct aio_tcp_transport_t
 static void aio_socket_onclose(void* param);
 static void aio_socket_onrecv(void* param, int code, size_t bytes);
 static void aio_socket_onsend(void* param, int code, size_t bytes);
+static void aio_socket_onpost(void* param, int code, size_t bytes);
+static void aio_socket_onready(void* param, int code, size_t bytes);
+static void aio_socket_onpooled(void* param, int code, size_t bytes);
 static void aio_tcp_transport_release(struct aio_tcp_transport_t*);
 
+static slab_cache_t* s_cache;
+static slab_cache_t* s_posts;
+static slab_cache_t* s_rbuffers[RECV_CLASSES];
+static int32_t s_ready; // caches created, until aio_tcp_transport_clean
+static locker_t s_locker;
+static onetime_t s_init = ONETIME_INIT;
+
+static void aio_tcp_transport_once(void)
+{
+	locker_create(&s_locker);
+}
+
+static void aio_tcp_transport_init(void)
+{
+	int i;
+	if (atomic_load32(&s_ready))
+		return;
+
+	onetime_exec(&s_init, aio_tcp_transport_once);
+	locker_lock(&s_locker);
+	if (0 == s_ready)
+	{
+		s_cache = slab_cache_create(sizeof(struct aio_tcp_transport_t), MAX_CACHE);
+		s_posts = slab_cache_create(sizeof(struct aio_tcp_transport_post_t), MAX_POST_CACHE);
+		for (i = 0; i < RECV_CLASSES; i++)
+			s_rbuffers[i] = slab_cache_create(RECV_CLASS_BYTES(i), 256 >> i); // 512KB per thread at most
+		atomic_increment32(&s_ready);
+	}
+	locker_unlock(&s_locker);
+}
+
+void aio_tcp_transport_clean(void)
+{
+	int i;
+	onetime_exec(&s_init, aio_tcp_transport_once);
+	locker_lock(&s_locker);
+	if (s_ready)
+	{
+		if (s_cache)
+			slab_cache_destroy(s_cache);
+		if (s_posts)
+			slab_cache_destroy(s_posts);
+		for (i = 0; i < RECV_CLASSES; i++)
+		{
+			if (s_rbuffers[i])
+				slab_cache_destroy(s_rbuffers[i]);
+			s_rbuffers[i] = NULL;
+		}
+		s_cache = s_posts = NULL;
+		atomic_decrement32(&s_ready);
+	}
+	locker_unlock(&s_locker);
+}
+
 struct aio_tcp_transport_t* aio_tcp_transport_create(socket_t socket, struct aio_tcp_transport_handler_t *handler, void* param)
 {
 	aio_socket_t aio;
+	struct aio_tcp_transport_t* t;
 	aio = aio_socket_create(socket, 1);
 	if (invalid_aio_socket == aio)
 		return NULL;
-	return aio_tcp_transport_create2(aio, handler, param);
+	t = aio_tcp_transport_create2(aio, handler, param);
+	if (t)
+		t->fd = socket;
+	return t;
 }
 
 struct aio_tcp_transport_t* aio_tcp_transport_create2(aio_socket_t aio, struct aio_tcp_transport_handler_t *handler, void* param)
 {
 	struct aio_tcp_transport_t* t;
-	t = (struct aio_tcp_transport_t*)calloc(1, sizeof(*t));
+	aio_tcp_transport_init();
+	t = (struct aio_tcp_transport_t*)(s_cache ? slab_cache_alloc(s_cache) : calloc(1, sizeof(*t)));
 	if (!t) return NULL;
 
 	t->ref = 1;
@@ -56,6 +171,24 @@ struct aio_tcp_transport_t* aio_tcp_transport_create2(aio_socket_t aio, struct a
 	t->param = param;
 	t->rtimeout = TIMEOUT_RECV;
 	t->wtimeout = TIMEOUT_SEND;
+	t->fd = socket_invalid;
+	t->head = NULL;
+	t->tail = &t->head;
+	t->nbatch = 0;
+	t->completing = 0;
+	t->vec = NULL;
+	t->capacity = 0;
+	t->coalesce = COALESCE_BYTES;
+	t->cork = 0;
+	t->corked = 0;
+	t->ondata = NULL;
+	t->dparam = NULL;
+	t->rbuffer = NULL;
+	t->rbclass = 0;
+	t->rclass = 0;
+	t->rmore = 0;
+	t->rbusy = 0;
+	t->rnext = 0;
 	spinlock_create(&t->locker);
 	memcpy(&t->handler, handler, sizeof(t->handler));
 	return t;
@@ -79,16 +212,142 @@ static void aio_tcp_transport_release(struct aio_tcp_transport_t* t)
 	if (0 == atomic_decrement32(&t->ref))
 	{
 		assert(invalid_aio_socket == t->socket);
+		assert(NULL == t->head);
 		if (t->handler.ondestroy)
 			t->handler.ondestroy(t->param);
 
+		if (t->vec)
+			free(t->vec);
+		if (t->rbuffer)
+			slab_cache_free(s_rbuffers[t->rbclass], t->rbuffer);
+
 		spinlock_destroy(&t->locker);
 #if defined(DEBUG) || defined(_DEBUG)
 		memset(t, 0xCC, sizeof(*t));
 #endif
-		free(t);
+		if (s_cache)
+			slab_cache_free(s_cache, t);
+		else
+			free(t);
+	}
+}
+
+static struct aio_tcp_transport_post_t* aio_tcp_transport_post_alloc(void)
+{
+	return (struct aio_tcp_transport_post_t*)(s_posts ? slab_cache_alloc(s_posts) : calloc(1, sizeof(struct aio_tcp_transport_post_t)));
+}
+
+static void aio_tcp_transport_post_free(struct aio_tcp_transport_post_t* post)
+{
+	if (s_posts)
+		slab_cache_free(s_posts, post);
+	else
+		free(post);
+}
+
+/// send queued buffers in one writev(with locker)
+/// @return 0-ok, other-error
+static int aio_tcp_transport_flush(struct aio_tcp_transport_t* t)
+{
+	int n, r;
+	size_t bytes;
+	socket_bufvec_t* vec;
+	struct aio_tcp_transport_post_t* post;
+
+	assert(0 == t->nbatch && t->head);
+	if (invalid_aio_socket == t->socket)
+		return -1;
+
+	// the first buffer always be sent even if it is larger than coalesce bytes
+	for (n = 0, bytes = 0, post = t->head; post && n < IOV_MAX && (0 == n || bytes + post->bytes <= t->coalesce); post = post->next, n++)
+	{
+		if (n >= t->capacity)
+		{
+			r = t->capacity > 0 ? t->capacity * 2 : 8;
+			r = r < IOV_MAX ? r : IOV_MAX;
+			vec = (socket_bufvec_t*)realloc(t->vec, r * sizeof(socket_bufvec_t));
+			if (NULL == vec)
+			{
+				if (0 == n)
+					return ENOMEM;
+				break; // send the others next time
+			}
+			t->vec = vec;
+			t->capacity = r;
+		}
+
+		socket_setbufvec(t->vec, n, (void*)post->data, post->bytes);
+		bytes += post->bytes;
+	}
+
+#if defined(TCP_CORK)
+	// cork while more buffers wait behind the batch, uncork the last one to push the tail
+	if (t->cork && socket_invalid != t->fd && (post ? 1 : 0) != t->corked)
+	{
+		t->corked = post ? 1 : 0;
+		socket_setcork(t->fd, t->corked);
+	}
+#endif
+
+	AIO_TRANSPORT_ADDREF(t);
+	r = aio_socket_send_v_all(&t->send, t->wtimeout, t->socket, t->vec, n, aio_socket_onpost, t);
+	if (0 == r)
+		t->nbatch = n;
+	AIO_TRANSPORT_ONFAIL(t, r);
+	return r;
+}
+
+int aio_tcp_transport_post(struct aio_tcp_transport_t* t, const void* data, size_t bytes, aio_tcp_transport_onpost onpost, void* param)
+{
+	int r;
+	struct aio_tcp_transport_post_t* post;
+	post = aio_tcp_transport_post_alloc();
+	if (!post) return ENOMEM;
+
+	post->next = NULL;
+	post->data = data;
+	post->bytes = bytes;
+	post->onpost = onpost;
+	post->param = param;
+
+	AIO_TRANSPORT_ADDREF(t);
+	spinlock_lock(&t->locker);
+	*t->tail = post;
+	t->tail = &post->next;
+	r = (t->nbatch > 0 || t->completing) ? 0 : aio_tcp_transport_flush(t);
+	if (0 != r)
+	{
+		// idle queue: the post is the only one
+		assert(t->head == post);
+		t->head = NULL;
+		t->tail = &t->head;
 	}
+	spinlock_unlock(&t->locker);
+	aio_tcp_transport_release(t);
+
+	if (0 != r)
+		aio_tcp_transport_post_free(post);
+	return r;
 }
+
+int aio_tcp_transport_edge_triggered(struct aio_tcp_transport_t* t)
+{
+	int r = -1;
+	spinlock_lock(&t->locker);
+	if (invalid_aio_socket != t->socket)
+		r = aio_socket_edge_triggered(t->socket);
+	spinlock_unlock(&t->locker);
+	return r;
+}
+
+void aio_tcp_transport_set_coalesce(struct aio_tcp_transport_t* t, size_t bytes, int cork)
+{
+	spinlock_lock(&t->locker);
+	t->coalesce = bytes > 0 ? bytes : COALESCE_BYTES;
+	t->cork = cork;
+	spinlock_unlock(&t->locker);
+}
+
 int aio_tcp_transport_send(struct aio_tcp_transport_t* t, const void* data, size_t bytes)
 {
 	int r = -1;
@@ -113,6 +372,18 @@ int aio_tcp_transport_send_v(struct aio_tcp_transport_t* t, socket_bufvec_t *vec
 	return r;
 }
 
+int aio_tcp_transport_sendfile(struct aio_tcp_transport_t* t, int fd, int64_t offset, size_t bytes)
+{
+	int r = -1;
+	AIO_TRANSPORT_ADDREF(t);
+	spinlock_lock(&t->locker);
+	if (invalid_aio_socket != t->socket)
+		r = aio_socket_sendfile_all(&t->send, t->wtimeout, t->socket, fd, offset, bytes, aio_socket_onsend, t);
+	spinlock_unlock(&t->locker);
+	AIO_TRANSPORT_ONFAIL(t, r);
+	return r;
+}
+
 int aio_tcp_transport_recv(struct aio_tcp_transport_t* t, void* data, size_t bytes)
 {
 	int r = -1;
@@ -138,6 +409,49 @@ int aio_tcp_transport_recv_v(struct aio_tcp_transport_t* t, socket_bufvec_t *vec
 	return r;
 }
 
+/// read into a pooled buffer if the socket has more data, otherwise wait readable without buffer(with locker)
+static int aio_tcp_transport_recv_next(struct aio_tcp_transport_t* t)
+{
+	if (invalid_aio_socket == t->socket)
+		return -1;
+	if (!t->rmore)
+		return aio_recv(&t->recv, t->rtimeout, t->socket, NULL, 0, aio_socket_onready, t);
+
+	if (t->rbuffer && t->rbclass != t->rclass)
+	{
+		slab_cache_free(s_rbuffers[t->rbclass], t->rbuffer);
+		t->rbuffer = NULL;
+	}
+	if (NULL == t->rbuffer)
+	{
+		t->rbuffer = s_rbuffers[t->rclass] ? slab_cache_alloc(s_rbuffers[t->rclass]) : NULL;
+		if (NULL == t->rbuffer)
+			return ENOMEM;
+		t->rbclass = t->rclass;
+	}
+	return aio_recv(&t->recv, t->rtimeout, t->socket, t->rbuffer, RECV_CLASS_BYTES(t->rbclass), aio_socket_onpooled, t);
+}
+
+int aio_tcp_transport_recv_pooled(struct aio_tcp_transport_t* t, aio_tcp_transport_ondata ondata, void* param)
+{
+	int r = 0;
+	spinlock_lock(&t->locker);
+	t->ondata = ondata;
+	t->dparam = param;
+	if (t->rbusy)
+	{
+		t->rnext = 1; // start after the ondata callback returned(buffer in use)
+		spinlock_unlock(&t->locker);
+		return 0;
+	}
+
+	AIO_TRANSPORT_ADDREF(t);
+	r = aio_tcp_transport_recv_next(t);
+	spinlock_unlock(&t->locker);
+	AIO_TRANSPORT_ONFAIL(t, r);
+	return r;
+}
+
 void aio_tcp_transport_get_timeout(struct aio_tcp_transport_t* t, int *recvMS, int *sendMS)
 {
 	if(sendMS) *sendMS = t->wtimeout;
@@ -154,25 +468,102 @@ void aio_tcp_transport_set_timeout(struct aio_tcp_transport_t* t, int recvMS, in
 	t->wtimeout = sendMS;
 }
 
+/// @return 1-recv timeout retried, 0-callback
+static int aio_tcp_transport_retry(struct aio_tcp_transport_t* t, int code)
+{
+	// if we have active send connection, recv timeout maybe normal case
+	// e.g. RTMP play session
+	return (ETIMEDOUT == code
+		&& t->wclock + t->rtimeout > system_clock()
+		&& 0 == aio_recv_retry(&t->recv, t->rtimeout)) ? 1 : 0;
+}
+
 static void aio_socket_onrecv(void* param, int code, size_t bytes)
 {
 	struct aio_tcp_transport_t* t;
 	t = (struct aio_tcp_transport_t*)param;
 
-	if (ETIMEDOUT == code 
-		&& t->wclock + t->rtimeout > system_clock() 
-		&& 0 == aio_recv_retry(&t->recv, t->rtimeout))
-	{
-		// if we have active send connection, recv timeout maybe normal case
-		// e.g. RTMP play session
+	if (aio_tcp_transport_retry(t, code))
 		return;
-	}
 
 	// enable bytes = 0 callback to notify socket close
 	t->handler.onrecv(t->param, code, bytes);
 	aio_tcp_transport_release(t);
 }
 
+static void aio_socket_onready(void* param, int code, size_t bytes)
+{
+	struct aio_tcp_transport_t* t;
+	t = (struct aio_tcp_transport_t*)param;
+	assert(0 != code || 0 == bytes);
+
+	if (aio_tcp_transport_retry(t, code))
+		return;
+
+	if (0 == code)
+	{
+		// readable: read with buffer now
+		spinlock_lock(&t->locker);
+		t->rmore = 1;
+		code = aio_tcp_transport_recv_next(t);
+		spinlock_unlock(&t->locker);
+		if (0 == code)
+			return;
+	}
+
+	t->ondata(t->dparam, code, NULL, 0);
+	aio_tcp_transport_release(t);
+}
+
+static void aio_socket_onpooled(void* param, int code, size_t bytes)
+{
+	int r;
+	struct aio_tcp_transport_t* t;
+	t = (struct aio_tcp_transport_t*)param;
+
+	if (aio_tcp_transport_retry(t, code))
+		return;
+
+	// adaptive read size: grow if the read filled the buffer, shrink if less than a quarter
+	if (0 == code && bytes >= RECV_CLASS_BYTES(t->rbclass))
+	{
+		t->rmore = 1;
+		t->rclass = t->rbclass + 1 < RECV_CLASSES ? t->rbclass + 1 : t->rbclass;
+	}
+	else
+	{
+		t->rmore = 0;
+		if (0 == code && bytes < RECV_CLASS_BYTES(t->rbclass) / 4 && t->rbclass > 0)
+			t->rclass = t->rbclass - 1;
+	}
+
+	t->rbusy = 1;
+	t->ondata(t->dparam, code, 0 == code ? t->rbuffer : NULL, bytes);
+
+	spinlock_lock(&t->locker);
+	t->rbusy = 0;
+	if (!t->rmore && t->rbuffer)
+	{
+		// socket drained: return the buffer to the pool
+		slab_cache_free(s_rbuffers[t->rbclass], t->rbuffer);
+		t->rbuffer = NULL;
+	}
+
+	r = 1;
+	if (t->rnext)
+	{
+		t->rnext = 0;
+		r = aio_tcp_transport_recv_next(t); // the callback reference is transferred
+	}
+	spinlock_unlock(&t->locker);
+
+	if (0 == r)
+		return;
+	if (1 != r)
+		t->ondata(t->dparam, r, NULL, 0); // recv_pooled in callback have returned ok
+	aio_tcp_transport_release(t);
+}
+
 static void aio_socket_onsend(void* param, int code, size_t bytes)
 {
 	struct aio_tcp_transport_t* t;
@@ -182,6 +573,62 @@ static void aio_socket_onsend(void* param, int code, size_t bytes)
 	aio_tcp_transport_release(t);
 }
 
+static void aio_socket_onpost(void* param, int code, size_t bytes)
+{
+	int i, r;
+	struct aio_tcp_transport_t* t;
+	struct aio_tcp_transport_post_t* post;
+	struct aio_tcp_transport_post_t* sent;
+	struct aio_tcp_transport_post_t* failed;
+	t = (struct aio_tcp_transport_t*)param;
+	t->wclock = system_clock();
+	(void)bytes;
+
+	spinlock_lock(&t->locker);
+	assert(t->nbatch > 0);
+	sent = t->head;
+	for (i = 1, post = sent; i < t->nbatch; i++)
+		post = post->next;
+	t->head = post->next;
+	post->next = NULL;
+	if (NULL == t->head)
+		t->tail = &t->head;
+	t->nbatch = 0;
+	t->completing = 1;
+	spinlock_unlock(&t->locker);
+
+	for (post = sent; post; post = sent)
+	{
+		sent = post->next;
+		if (post->onpost)
+			post->onpost(post->param, code, post->data, post->bytes);
+		aio_tcp_transport_post_free(post);
+	}
+
+	// next batch include the buffers posted in callback
+	failed = NULL;
+	spinlock_lock(&t->locker);
+	t->completing = 0;
+	r = t->head ? (0 == code ? aio_tcp_transport_flush(t) : code) : 0;
+	if (0 != r)
+	{
+		failed = t->head;
+		t->head = NULL;
+		t->tail = &t->head;
+	}
+	spinlock_unlock(&t->locker);
+
+	for (post = failed; post; post = failed)
+	{
+		failed = post->next;
+		if (post->onpost)
+			post->onpost(post->param, r, post->data, post->bytes);
+		aio_tcp_transport_post_free(post);
+	}
+
+	aio_tcp_transport_release(t);
+}
+
 static void aio_socket_onclose(void* param)
 {
 	struct aio_tcp_transport_t* t;
@@ -1,49 +1,305 @@
 #include "aio-timeout.h"
-#include "sys/locker.h"
 #include "sys/atomic.h"
+#include "sys/locker.h"
 #include "sys/system.h"
 #include "sys/onetime.h"
+#include "sys/tls.h"
 #include "twtimer.h"
+#include <stdlib.h>
+#include <errno.h>
 #include <assert.h>
 
-static time_wheel_t* s_timer;
+// Per-thread timing wheel
+// 1. every aio_timeout_process thread(aio worker) own a wheel, timers started in the thread use it
+// 2. timers started in other threads use the shared wheel, processed by all workers
+// 3. aio_timeout_stop is lock-free(any thread): CAS timer state, the wheel owner unlink it later
+// 4. timer node is type-stable(never free to system), stale handle rejected by generation
+// 5. wheel not processed for a long time(thread exit) is adopted by other workers
+
+#define AIO_TIMER_ARMED		1
+#define AIO_TIMER_FIRED		2
+#define AIO_TIMER_CANCELED	3
+#define AIO_TIMER_STATE(gen, st) ((int32_t)(((uint32_t)(gen) << 2) | (st)))
+#define AIO_TIMER_GENERATION(state) ((uint32_t)(state) >> 2)
+
+#define AIO_TIMER_CHUNK 64 // timer nodes per malloc
+#define AIO_WHEEL_STALE AIO_TIMEOUT_STALE // ms
+
+struct aio_wheel_t;
+struct aio_timer_t
+{
+	struct twtimer_t timer;
+	struct aio_wheel_t* wheel;
+	volatile int32_t state; // generation << 2 | AIO_TIMER_XXX
+
+	void (*notify)(void* param);
+	void* param;
+
+	struct aio_timer_t* next; // free list or cancel list
+};
+
+struct aio_wheel_t
+{
+	struct aio_wheel_t* next; // all wheels, never removed
+	time_wheel_t* wheel;
+	int shared;
+	locker_t locker; // shared wheel alloc only
+
+	volatile int32_t busy; // processing
+	volatile int64_t active; // last process clock
+
+	struct aio_timer_t* frees; // free list, owner thread only
+	struct aio_timer_t* volatile released; // free by other threads
+	struct aio_timer_t* volatile cancels; // stop by any thread
+};
+
+// struct aio_timeout_t reserved
+struct aio_timeout_handle_t
+{
+	struct aio_timer_t* timer;
+	int32_t state; // armed state(with generation)
+};
+
+static int s_resolution = 64;
+static tlskey_t s_key;
+static struct aio_wheel_t* s_shared;
+static struct aio_wheel_t* volatile s_wheels;
+static volatile int64_t s_scan;
 static onetime_t s_init = ONETIME_INIT;
 
+static void aio_timer_push(struct aio_timer_t* volatile* list, struct aio_timer_t* timer)
+{
+	struct aio_timer_t* head;
+	do
+	{
+		head = *list;
+		timer->next = head;
+	} while (!atomic_cas_ptr((void* volatile*)list, head, timer));
+}
+
+/// single consumer only
+static struct aio_timer_t* aio_timer_pop_all(struct aio_timer_t* volatile* list)
+{
+	struct aio_timer_t* head;
+	do
+	{
+		head = *list;
+	} while (head && !atomic_cas_ptr((void* volatile*)list, head, NULL));
+	return head;
+}
+
+static struct aio_timer_t* aio_timer_alloc(struct aio_wheel_t* w)
+{
+	int i;
+	struct aio_timer_t* timer;
+
+	if (w->shared)
+		locker_lock(&w->locker);
+
+	if (NULL == w->frees)
+		w->frees = aio_timer_pop_all(&w->released);
+
+	if (NULL == w->frees)
+	{
+		timer = (struct aio_timer_t*)calloc(AIO_TIMER_CHUNK, sizeof(*timer));
+		for (i = 0; timer && i < AIO_TIMER_CHUNK; i++)
+		{
+			timer[i].wheel = w;
+			timer[i].next = i + 1 < AIO_TIMER_CHUNK ? &timer[i + 1] : NULL;
+		}
+		w->frees = timer;
+	}
+
+	timer = w->frees;
+	if (timer)
+		w->frees = timer->next;
+
+	if (w->shared)
+		locker_unlock(&w->locker);
+	return timer;
+}
+
+static void aio_timer_free(struct aio_timer_t* timer)
+{
+	struct aio_wheel_t* w;
+	w = timer->wheel;
+	if (!w->shared && w == (struct aio_wheel_t*)tls_getvalue(s_key))
+	{
+		timer->next = w->frees;
+		w->frees = timer;
+	}
+	else
+	{
+		aio_timer_push(&w->released, timer);
+	}
+}
+
+static void aio_timer_ontimeout(void* param)
+{
+	int32_t state;
+	struct aio_timer_t* timer;
+	timer = (struct aio_timer_t*)param;
+
+	state = atomic_load32(&timer->state);
+	if (AIO_TIMER_ARMED == (state & 0x03)
+		&& atomic_cas32(&timer->state, state, AIO_TIMER_STATE(AIO_TIMER_GENERATION(state), AIO_TIMER_FIRED)))
+	{
+		timer->notify(timer->param);
+		aio_timer_free(timer);
+	}
+	// else: canceled, free after unlink(see aio_wheel_process)
+}
+
+static struct aio_wheel_t* aio_wheel_create(int shared)
+{
+	struct aio_wheel_t* w;
+	w = (struct aio_wheel_t*)calloc(1, sizeof(*w));
+	if (NULL == w)
+		return NULL;
+
+	w->shared = shared;
+	w->active = (int64_t)system_clock();
+	w->wheel = time_wheel_create2((uint64_t)w->active, s_resolution);
+	if (NULL == w->wheel)
+	{
+		free(w);
+		return NULL;
+	}
+
+	if (shared)
+		locker_create(&w->locker);
+
+	do
+	{
+		w->next = s_wheels;
+	} while (!atomic_cas_ptr((void* volatile*)&s_wheels, w->next, w));
+	return w;
+}
+
+/// @return sleep time(ms) to the next timer
+static int aio_wheel_process(struct aio_wheel_t* w, uint64_t clock)
+{
+	int r;
+	struct aio_timer_t* timer;
+	struct aio_timer_t* next;
+
+	if (!atomic_cas32(&w->busy, 0, 1))
+		return time_wheel_resolution(w->wheel); // other thread processing
+
+	w->active = (int64_t)clock;
+
+	// unlink stopped timers
+	for (timer = aio_timer_pop_all(&w->cancels); timer; timer = next)
+	{
+		next = timer->next;
+		twtimer_stop(w->wheel, &timer->timer);
+		aio_timer_free(timer);
+	}
+
+	r = twtimer_process(w->wheel, clock);
+	atomic_cas32(&w->busy, 1, 0);
+	return r;
+}
+
 static void aio_timeout_init(void)
 {
-	s_timer = time_wheel_create(system_clock());
+	tls_create(&s_key);
+	s_scan = (int64_t)system_clock();
+	s_shared = aio_wheel_create(1);
 }
 
-static void aio_timeout_clean(void)
+void aio_timeout_set_resolution(int resolutionMS)
 {
-	time_wheel_destroy(s_timer);
+	s_resolution = resolutionMS > 0 ? resolutionMS : 1;
 }
 
-void aio_timeout_process(void)
+int aio_timeout_process(void)
 {
+	int r, shared;
+	int64_t scan;
+	uint64_t clock;
+	struct aio_wheel_t* w;
+
 	onetime_exec(&s_init, aio_timeout_init);
 
-	twtimer_process(s_timer, system_clock());
+	w = (struct aio_wheel_t*)tls_getvalue(s_key);
+	if (NULL == w)
+	{
+		w = aio_wheel_create(0);
+		if (NULL == w || 0 != tls_setvalue(s_key, w))
+			return s_resolution;
+	}
+
+	clock = system_clock();
+	r = aio_wheel_process(w, clock);
+	if (s_shared)
+	{
+		shared = aio_wheel_process(s_shared, clock);
+		r = r < shared ? r : shared;
+	}
+
+	// adopt the wheel of exited thread
+	scan = atomic_load64(&s_scan);
+	if ((int64_t)clock - scan > AIO_WHEEL_STALE && atomic_cas64(&s_scan, scan, (int64_t)clock))
+	{
+		for (w = s_wheels; w; w = w->next)
+		{
+			if ((int64_t)clock - atomic_load64(&w->active) > AIO_WHEEL_STALE)
+				aio_wheel_process(w, clock);
+		}
+	}
+	return r;
 }
 
 int aio_timeout_start(struct aio_timeout_t* timeout, int timeoutMS, void (*notify)(void* param), void* param)
 {
-	struct twtimer_t* timer;
-	timer = (struct twtimer_t*)timeout->reserved;
-	assert(sizeof(struct twtimer_t) <= sizeof(timeout->reserved));
+	int r;
+	struct aio_wheel_t* w;
+	struct aio_timer_t* timer;
+	struct aio_timeout_handle_t* handle;
+	handle = (struct aio_timeout_handle_t*)timeout->reserved;
+	assert(sizeof(struct aio_timeout_handle_t) <= sizeof(timeout->reserved));
 
 	onetime_exec(&s_init, aio_timeout_init);
 
+	w = (struct aio_wheel_t*)tls_getvalue(s_key);
+	w = w ? w : s_shared;
+	timer = w ? aio_timer_alloc(w) : NULL;
+	if (NULL == timer)
+		return ENOMEM;
+
+	timer->notify = notify;
 	timer->param = param;
-	timer->ontimeout = notify;
-	timer->expire = system_clock() + timeoutMS;
-	return twtimer_start(s_timer, timer);
+	timer->timer.ontimeout = aio_timer_ontimeout;
+	timer->timer.param = timer;
+	timer->timer.expire = system_clock() + timeoutMS;
+	timer->state = AIO_TIMER_STATE(AIO_TIMER_GENERATION(timer->state) + 1, AIO_TIMER_ARMED);
+
+	handle->timer = timer;
+	handle->state = timer->state;
+	r = twtimer_start(w->wheel, &timer->timer);
+	if (0 != r)
+	{
+		handle->timer = NULL;
+		timer->state = AIO_TIMER_STATE(AIO_TIMER_GENERATION(timer->state), AIO_TIMER_FIRED);
+		aio_timer_free(timer);
+	}
+	return r;
 }
 
 int aio_timeout_stop(struct aio_timeout_t* timeout)
 {
-	struct twtimer_t* timer;
-	timer = (struct twtimer_t*)timeout->reserved;
-	assert(sizeof(struct twtimer_t) <= sizeof(timeout->reserved));
-	return twtimer_stop(s_timer, timer);
+	struct aio_timer_t* timer;
+	struct aio_timeout_handle_t* handle;
+	handle = (struct aio_timeout_handle_t*)timeout->reserved;
+	assert(sizeof(struct aio_timeout_handle_t) <= sizeof(timeout->reserved));
+
+	// timer node memory is always valid, generation check the owner
+	timer = handle->timer;
+	if (NULL == timer || !atomic_cas32(&timer->state, handle->state, AIO_TIMER_STATE(AIO_TIMER_GENERATION(handle->state), AIO_TIMER_CANCELED)))
+		return -1; // timer have triggered or will be triggered
+
+	handle->timer = NULL;
+	aio_timer_push(&timer->wheel->cancels, timer);
+	return 0;
 }
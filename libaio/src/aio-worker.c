@@ -1,27 +1,41 @@
 #include "aio-worker.h"
 #include "aio-socket.h"
 #include "aio-timeout.h"
+#include "aio-tcp-transport.h"
+#include "thread-pool.h"
 #include "sys/thread.h"
 #include <stdio.h>
 #include <errno.h>
 
 #define VMIN(a, b)	((a) < (b) ? (a) : (b))
 
+// timers started by non-worker threads(shared wheel) can't wake up epoll_wait,
+// worker 0 check them at least every 64ms,
+// idle workers wake up within AIO_TIMEOUT_STALE, otherwise their wheels are adopted by other workers
+#define AIO_WORKER_WAIT(idx) ((idx) ? AIO_TIMEOUT_STALE / 2 : 64)
+
 static int s_running;
 static pthread_t s_thread[1000];
+static int s_cpus[sizeof(s_thread) / sizeof(s_thread[0])];
+static struct thread_affinity_t s_affinity;
 
 static int STDCALL aio_worker(void* param)
 {
-	int i = 0, r = 0;
+	int r = 0, timeout = 0;
 	int idx = (int)(intptr_t)param;
+
+	// bind before the first aio_socket_process: per-thread caches and buffers allocated in callbacks are first touched on the local node
+	r = thread_affinity_cpu(&s_affinity, idx);
+	if (r >= 0)
+		thread_affinity_bind(r);
+
+	r = 0;
 	while (s_running && (r >= 0 || errno == EINTR)) // ignore epoll EINTR
 	{
-		r = aio_socket_process(idx ? 2000 : 64);
-		if (0 == idx && (0 == r || i++ > 100))
-		{
-			i = 0;
-			aio_timeout_process();
-		}
+		// every worker expire its own timers, wait until the nearest one
+		r = aio_socket_process(timeout);
+		timeout = aio_timeout_process();
+		timeout = VMIN(timeout, AIO_WORKER_WAIT(idx));
 	}
 
 	printf("%s[%d] exit => %d.\n", __FUNCTION__, idx, errno);
@@ -30,9 +44,27 @@ static int STDCALL aio_worker(void* param)
 
 void aio_worker_init(int num)
 {
+	aio_worker_init2(num, 1, 0);
+}
+
+void aio_worker_init2(int num, int events, int flags)
+{
+	aio_worker_init3(num, events, flags, NULL);
+}
+
+void aio_worker_init3(int num, int events, int flags, const struct thread_affinity_t* affinity)
+{
+	int i;
+
+	s_affinity.policy = affinity ? affinity->policy : THREAD_AFFINITY_NONE;
+	s_affinity.cpus = s_cpus;
+	s_affinity.count = 0;
+	for (i = 0; affinity && THREAD_AFFINITY_LIST == affinity->policy && i < affinity->count && i < (int)(sizeof(s_cpus) / sizeof(s_cpus[0])); i++)
+		s_cpus[s_affinity.count++] = affinity->cpus[i];
+
 	s_running = 1;
 	num = VMIN(num, sizeof(s_thread) / sizeof(s_thread[0]));
-	aio_socket_init(num);
+	aio_socket_init2(num, events, flags);
 
 	while (num-- > 0)
 	{
@@ -50,4 +82,5 @@ void aio_worker_clean(int num)
 	}
 
 	aio_socket_clean();
+	aio_tcp_transport_clean();
 }
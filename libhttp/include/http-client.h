@@ -17,6 +17,14 @@ struct http_header_t
 
 typedef void(*http_client_onreply)(void *param, int code);
 
+/// Response body callback(stream mode)
+/// @param[in] param user-defined parameter of the request(same as onreply)
+/// @param[in] data body data(chunked data decoded), valid in callback only
+/// @param[in] bytes data size in byte
+/// @return 0-continue, other-pause receiving until http_client_resume(aio mode only)
+///         the pause is ignored on the last body data(e.g. the final chunk received with the last-chunk): onreply follows immediately
+typedef int(*http_client_ondata)(void *param, const void* data, size_t bytes);
+
 /// create HTTP client
 /// @param[in] ip HTTP service ip
 /// @param[in] port HTTP Service port
@@ -32,6 +40,28 @@ void http_client_destroy(http_client_t* http);
 /// @param[in] send socket write timeout(MS)
 void http_client_set_timeout(http_client_t* http, int conn, int recv, int send);
 
+/// Stream response body(apply to the next requests): body data is passed to ondata as soon as received
+/// instead of buffering the whole body, onreply is called after the last data(or on error)
+/// Remark: http_client_get_header is valid in ondata, http_client_get_content don't return body in stream mode
+/// @param[in] ondata NULL-buffer the whole body(default)
+void http_client_set_ondata(http_client_t* http, http_client_ondata ondata);
+
+/// Continue receiving the responses paused by ondata(aio mode only)
+/// Remark: call after ondata returned, block io mode: ondata block the receiving, return value is ignored
+void http_client_resume(http_client_t* http);
+
+/// Connection pool(aio mode only): http clients of the same host:port share keep-alive connections,
+/// every request borrow a connection and return it after the response
+/// @param[in] maxActive max connections per host, requests wait for a connection if reached, 0-unlimited(default)
+/// @param[in] maxIdle max keep-alive connections per host(default 16), 0-close connection after response
+/// @param[in] idleTimeout close idle connection after idleTimeout(MS), default 60s
+void http_client_pool_config(int maxActive, int maxIdle, int idleTimeout);
+
+/// HTTP/1.1 pipelining(aio mode only): queue requests on a busy keep-alive connection
+/// if the pool is full(maxActive), responses are matched in request order
+/// @param[in] depth max in-flight requests per connection, 1-no pipelining(default)
+void http_client_pool_pipeline(int depth);
+
 /// HTTP GET Request
 /// r = http_client_get(handle, "/webservice/api/version", NULL, 0, OnVersion, param)
 /// @param[in] http HTTP handler created by http_client_create
@@ -40,6 +70,7 @@ void http_client_set_timeout(http_client_t* http, int conn, int recv, int send);
 /// @param[in] n HTTP request header count
 /// @param[in] onreply user-defined callback function(maybe callback in other thread if in aio mode)
 /// @param[in] param user-defined callback parameter
+/// Remark: aio mode: multiple requests can be in flight, every request callback its own onreply/param
 int http_client_get(http_client_t* http, const char* uri, const struct http_header_t *headers, size_t n, http_client_onreply onreply, void* param);
 
 /// HTTP POST Request
@@ -58,12 +89,14 @@ int http_client_post(http_client_t* http, const char* uri, const struct http_hea
 // Response
 
 /// Get server response HTTP header field by name
+/// Remark: aio mode: valid in onreply callback only(response of the callback request)
 /// @param[in] http HTTP client handler
 /// @param[in] name request http header field name
 /// @return NULL-don't found field, other-header value
 const char* http_client_get_header(http_client_t* http, const char *name);
 
 /// Get server response data(raw data)
+/// Remark: aio mode: valid in onreply callback only(response of the callback request)
 /// @param[in] http HTTP client handle
 /// @param[out] content response body pointer(don't need free)
 /// @param[out] bytes response body size
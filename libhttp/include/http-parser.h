@@ -2,6 +2,7 @@
 #define _http_parser_h_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +38,13 @@ void http_parser_clear(http_parser_t* parser);
 /// @return 1-need more data, 0-receive done, <0-error
 int http_parser_input(http_parser_t* parser, const void* data, size_t *bytes);
 
+/// Stream mode: fetch body data received(chunked data decoded) instead of buffering the whole body,
+/// the fetched data is removed from parser by next http_parser_input/http_parser_fetch
+/// @param[out] data body data received after the last fetch
+/// @param[out] bytes data size in byte, 0 if don't have new data
+/// @return 0-ok, <0-header don't finished
+int http_parser_fetch(http_parser_t* parser, const void** data, size_t* bytes);
+
 /// HTTP start-line
 int http_get_version(const http_parser_t* parser, char protocol[64], int *major, int *minor);
 int http_get_status_code(const http_parser_t* parser);
@@ -56,8 +64,8 @@ int http_get_header(const http_parser_t* parser, int idx, const char** name, con
 const char* http_get_header_by_name(const http_parser_t* parser, const char* name);
 /// @return 0-ok, <0-don't have header
 int http_get_header_by_name2(const http_parser_t* parser, const char* name, int *value);
-/// @return >=0-content-length, <0-don't have content-length header
-int http_get_content_length(const http_parser_t* parser);
+/// @return >=0-content-length(stream mode: body bytes buffered and don't fetched), <0-don't have content-length header
+int64_t http_get_content_length(const http_parser_t* parser);
 /// @return 1-close, 0-keep-alive, <0-don't have connection header
 int http_get_connection(const http_parser_t* parser);
 /// @return Content-Type, NULL-don't have this header
@@ -1,166 +1,976 @@
 #include "http-client-internal.h"
 #include "aio-client.h"
+#include "aio-timeout.h"
+#include "sys/onetime.h"
+#include "list.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
-#define http_entry(ptr, type, member) ((type*)((char*)ptr-(ptrdiff_t)(&((type*)0)->member)))
+// Per-host connection pool
+// 1. http clients of the same host:port share keep-alive connections, request borrow one
+// 2. idle connection closed after idle timeout(aio_timeout)
+// 3. idle connection keep a recv pending as health check: peer close or unexpected data close it
+// 4. no more than max-active connections, other requests wait for a connection returned
+// 5. pipelining: requests queued on a busy connection(up to pipeline depth) are sent one by one,
+//    responses are matched in order, requests without response are resent if the connection closed
+// 6. stream mode: body data callback on recv, ondata pause the connection(don't recv) until resume
 
-struct http_client_aio_t
+#define HTTP_POOL_MAX_ACTIVE	0 // unlimited
+#define HTTP_POOL_MAX_IDLE		16
+#define HTTP_POOL_IDLE_TIMEOUT	(60 * 1000)
+#define HTTP_POOL_PIPELINE		1 // don't pipeline
+
+enum { HTTP_CONN_ACTIVE = 0, HTTP_CONN_IDLE, HTTP_CONN_EXPIRED, HTTP_CONN_CLOSED };
+enum { HTTP_REQUEST_QUEUED = 0, HTTP_REQUEST_SENDING, HTTP_REQUEST_SENT };
+enum { HTTP_TIMER_NONE = 0, HTTP_TIMER_ARMED, HTTP_TIMER_STOPPING };
+
+struct http_pool_t
+{
+	struct list_head link; // s_pool.pools
+	int ref; // clients + connections, with s_pool.locker
+
+	locker_t locker;
+	struct list_head idles; // struct http_pool_conn_t
+	struct list_head actives; // struct http_pool_conn_t
+	struct list_head waiters; // struct http_client_request_t
+	int active; // connections(include idle)
+	int idle;
+
+	unsigned short port;
+	char host[128];
+};
+
+struct http_pool_conn_t
 {
+	struct list_head link; // pool idles or actives
+	struct http_pool_t* pool;
 	aio_client_t* client;
-	char buffer[2 * 1024];
+	int32_t ref; // 1-aio client, +1 per armed timer
+
+	int state; // HTTP_CONN_XXX
+	int recving; // recv in progress(response or health check)
+	int sending; // request send in progress
+	int received; // head response received bytes(any)
+	int reused; // response received, keep-alive connection
+	int closing; // Connection: close, don't send more request
+	int done; // head response finished(wait for onsend)
+	int keepalive;
+	int error; // request timeout or connection error
+	int paused; // stream mode: ondata paused receiving
+	struct list_head pause; // http_client_aio_t paused
 
+	struct list_head requests; // struct http_client_request_t, in request order
 	int count;
+
+	struct aio_timeout_t idle; // idle timeout
+	struct aio_timeout_t timer; // response timeout
+	int timing; // HTTP_TIMER_XXX
+
+	http_parser_t* parser;
 	socket_bufvec_t vec[2];
+	char buffer[2 * 1024];
+};
 
-	int error;
-	int retry;
+// per http client
+struct http_client_aio_t
+{
+	struct http_pool_t* pool;
+	struct list_head paused; // struct http_pool_conn_t, with pool locker
 };
 
-static void http_ondestroy(void* param);
-static void http_onrecv(void* param, int code, size_t bytes);
-static void http_onsend(void* param, int code, size_t bytes);
+static struct
+{
+	locker_t locker;
+	struct list_head pools;
+
+	int max_active;
+	int max_idle;
+	int idle_timeout;
+	int pipeline;
+} s_pool;
 
-static void* http_aio_create(struct http_client_t *http)
+static onetime_t s_init = ONETIME_INIT;
+
+static void http_pool_conn_ondestroy(void* param);
+static void http_pool_conn_onrecv(void* param, int code, size_t bytes);
+static void http_pool_conn_onsend(void* param, int code, size_t bytes);
+static void http_pool_conn_onidle(void* param);
+static void http_pool_conn_ontimeout(void* param);
+static int http_pool_dispatch(struct http_pool_t* pool, struct http_client_request_t* req);
+static void http_conn_send(struct http_pool_conn_t* conn, struct http_client_request_t* req);
+
+static void http_pool_init(void)
 {
-	struct http_client_aio_t* aio;
-	aio = calloc(1, sizeof(struct http_client_aio_t));
-	if (aio)
+	locker_create(&s_pool.locker);
+	LIST_INIT_HEAD(&s_pool.pools);
+	s_pool.max_active = s_pool.max_active ? s_pool.max_active : HTTP_POOL_MAX_ACTIVE;
+	s_pool.max_idle = s_pool.max_idle ? s_pool.max_idle : HTTP_POOL_MAX_IDLE;
+	s_pool.idle_timeout = s_pool.idle_timeout ? s_pool.idle_timeout : HTTP_POOL_IDLE_TIMEOUT;
+	s_pool.pipeline = s_pool.pipeline ? s_pool.pipeline : HTTP_POOL_PIPELINE;
+}
+
+void http_client_pool_config(int maxActive, int maxIdle, int idleTimeout)
+{
+	s_pool.max_active = maxActive > 0 ? maxActive : -1; // -1: unlimited
+	s_pool.max_idle = maxIdle > 0 ? maxIdle : -1; // -1: don't keep-alive
+	s_pool.idle_timeout = idleTimeout > 0 ? idleTimeout : HTTP_POOL_IDLE_TIMEOUT;
+}
+
+void http_client_pool_pipeline(int depth)
+{
+	s_pool.pipeline = depth > 1 ? depth : 1;
+}
+
+static struct http_pool_t* http_pool_fetch(const char* host, unsigned short port)
+{
+	struct list_head* pos;
+	struct http_pool_t* pool;
+
+	onetime_exec(&s_init, http_pool_init);
+	locker_lock(&s_pool.locker);
+	list_for_each(pos, &s_pool.pools)
 	{
-		struct aio_client_handler_t handler;
-		memset(&handler, 0, sizeof(handler));
-		handler.ondestroy = http_ondestroy;
-		handler.onrecv = http_onrecv;
-		handler.onsend = http_onsend;
-		aio->client = aio_client_create(http->host, http->port, &handler, &http->connection);
+		pool = list_entry(pos, struct http_pool_t, link);
+		if (pool->port == port && 0 == strcmp(pool->host, host))
+		{
+			pool->ref++;
+			locker_unlock(&s_pool.locker);
+			return pool;
+		}
 	}
-	return aio;
+
+	pool = (struct http_pool_t*)calloc(1, sizeof(*pool));
+	if (pool)
+	{
+		pool->ref = 1;
+		pool->port = port;
+		snprintf(pool->host, sizeof(pool->host), "%s", host);
+		locker_create(&pool->locker);
+		LIST_INIT_HEAD(&pool->idles);
+		LIST_INIT_HEAD(&pool->actives);
+		LIST_INIT_HEAD(&pool->waiters);
+		list_insert_after(&pool->link, &s_pool.pools);
+	}
+	locker_unlock(&s_pool.locker);
+	return pool;
 }
 
-static void http_aio_destroy(struct http_client_t* http)
+static void http_pool_release(struct http_pool_t* pool)
 {
-	struct http_client_aio_t* aio;
-	aio = (struct http_client_aio_t*)http->connection;
+	locker_lock(&s_pool.locker);
+	if (0 != --pool->ref)
+	{
+		locker_unlock(&s_pool.locker);
+		return;
+	}
+	list_remove(&pool->link);
+	locker_unlock(&s_pool.locker);
+
+	assert(0 == pool->active && 0 == pool->idle);
+	assert(list_empty(&pool->idles) && list_empty(&pool->actives) && list_empty(&pool->waiters));
+	locker_destroy(&pool->locker);
+	free(pool);
+}
 
-	if (aio->client)
+static int http_pool_full(struct http_pool_t* pool)
+{
+	return s_pool.max_active > 0 && pool->active >= s_pool.max_active;
+}
+
+/// new active connection(with pool locker)
+static struct http_pool_conn_t* http_pool_conn_create(struct http_pool_t* pool)
+{
+	struct http_pool_conn_t* conn;
+	struct aio_client_handler_t handler;
+
+	conn = (struct http_pool_conn_t*)calloc(1, sizeof(*conn));
+	if (!conn)
+		return NULL;
+
+	conn->parser = http_parser_create(HTTP_PARSER_CLIENT);
+	if (!conn->parser)
 	{
-		aio_client_destroy(aio->client);
-		aio->client = NULL;
+		free(conn);
+		return NULL;
 	}
-	free(aio);
-	http->connection = NULL;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.ondestroy = http_pool_conn_ondestroy;
+	handler.onrecv = http_pool_conn_onrecv;
+	handler.onsend = http_pool_conn_onsend;
+	conn->client = aio_client_create(pool->host, pool->port, &handler, conn);
+	if (!conn->client)
+	{
+		http_parser_destroy(conn->parser);
+		free(conn);
+		return NULL;
+	}
+
+	locker_lock(&s_pool.locker);
+	pool->ref++;
+	locker_unlock(&s_pool.locker);
+
+	conn->ref = 1;
+	conn->pool = pool;
+	conn->state = HTTP_CONN_ACTIVE;
+	LIST_INIT_HEAD(&conn->requests);
+	list_insert_after(&conn->link, &pool->actives);
+	pool->active++;
+	return conn;
 }
 
-static void http_aio_timeout(struct http_client_t* http, int conn, int recv, int send)
+static void http_pool_conn_release(struct http_pool_conn_t* conn)
 {
-	struct http_client_aio_t* aio;
-	aio = (struct http_client_aio_t*)http->connection;
-	aio_client_settimeout(aio->client, conn, recv, send);
+	if (0 != atomic_decrement32(&conn->ref))
+		return;
+
+	assert(list_empty(&conn->requests));
+	http_pool_release(conn->pool);
+	http_parser_destroy(conn->parser);
+	free(conn);
 }
 
-static void http_ondestroy(void* param)
+static void http_pool_conn_ondestroy(void* param)
 {
-	//struct http_client_aio_t* aio;
-	//aio = *(struct http_client_aio_t**)param;
-	(void)param;
+	http_pool_conn_release((struct http_pool_conn_t*)param);
 }
 
-static void http_onrecv(void* param, int code, size_t bytes)
+/// start response timer of the head request(with pool locker)
+static void http_conn_timer_start(struct http_pool_conn_t* conn)
 {
-	struct http_client_t* http;
-	struct http_client_aio_t *aio;
-	aio = *(struct http_client_aio_t**)param;
-	http = http_entry(param, struct http_client_t, connection);
-	assert(http->connection == aio);
+	struct http_client_request_t* req;
+	if (HTTP_TIMER_NONE != conn->timing || list_empty(&conn->requests))
+		return; // restart in timeout callback if stopping
 
-	if (0 == code)
+	req = list_entry(conn->requests.next, struct http_client_request_t, link);
+	if (req->http->timeout.recv < 1)
+		return;
+
+	atomic_increment32(&conn->ref);
+	conn->timing = HTTP_TIMER_ARMED;
+	if (0 != aio_timeout_start(&conn->timer, req->http->timeout.recv, http_pool_conn_ontimeout, conn))
+	{
+		conn->timing = HTTP_TIMER_NONE;
+		atomic_decrement32(&conn->ref);
+	}
+}
+
+/// stop response timer(with pool locker)
+static void http_conn_timer_stop(struct http_pool_conn_t* conn)
+{
+	if (HTTP_TIMER_ARMED != conn->timing)
+		return;
+
+	if (0 == aio_timeout_stop(&conn->timer))
+	{
+		conn->timing = HTTP_TIMER_NONE;
+		atomic_decrement32(&conn->ref); // aio client reference still held
+	}
+	else
 	{
-		size_t n = bytes;
-		code = http_parser_input(http->parser, aio->buffer, &n);
-		if (code <= 0)
+		conn->timing = HTTP_TIMER_STOPPING; // timeout callback in progress
+	}
+}
+
+/// queue request on the connection(with pool locker)
+static void http_conn_assign(struct http_pool_conn_t* conn, struct http_client_request_t* req)
+{
+	req->sent = HTTP_REQUEST_QUEUED;
+	list_insert_before(&req->link, &conn->requests);
+	if (1 == ++conn->count)
+	{
+		aio_client_settimeout(conn->client, req->http->timeout.conn, 0, req->http->timeout.send); // recv: response timer
+		http_conn_timer_start(conn);
+	}
+}
+
+/// the next request to send, requests are sent one by one(with pool locker)
+/// @return NULL-send in progress or all requests have been sent
+static struct http_client_request_t* http_conn_next(struct http_pool_conn_t* conn)
+{
+	struct list_head* pos;
+	struct http_client_request_t* req;
+	if (conn->sending || conn->closing || 0 != conn->error || HTTP_CONN_ACTIVE != conn->state)
+		return NULL;
+
+	list_for_each(pos, &conn->requests)
+	{
+		req = list_entry(pos, struct http_client_request_t, link);
+		if (HTTP_REQUEST_QUEUED == req->sent)
 		{
-			// Connection: close
-			if (code < 0 || 1 == http_get_connection(http->parser))
-			{
-				aio_client_disconnect(aio->client);
-			}
-			assert(0 == n);
-			http_client_handle(http, code);
-			return;
+			req->sent = HTTP_REQUEST_SENDING;
+			conn->sending = 1;
+			return req;
 		}
-		else
+	}
+	return NULL;
+}
+
+/// close active connection(with pool locker)
+static void http_conn_close(struct http_pool_conn_t* conn)
+{
+	struct http_pool_t* pool;
+	pool = conn->pool;
+	assert(HTTP_CONN_ACTIVE == conn->state);
+	conn->state = HTTP_CONN_CLOSED;
+	list_remove(&conn->link);
+	pool->active--;
+	http_conn_timer_stop(conn);
+	if (conn->paused)
+	{
+		conn->paused = 0;
+		list_remove(&conn->pause);
+	}
+}
+
+/// take waiters on a new connection while the pool have room, send the first requests
+static void http_pool_serve(struct http_pool_t* pool)
+{
+	struct http_pool_conn_t* conn;
+	struct http_client_request_t* req;
+
+	do
+	{
+		conn = NULL;
+		req = NULL;
+		locker_lock(&pool->locker);
+		if (!list_empty(&pool->waiters) && !http_pool_full(pool))
 		{
-			if (0 != bytes)
+			conn = http_pool_conn_create(pool);
+			while (conn && conn->count < s_pool.pipeline && !list_empty(&pool->waiters))
+			{
+				req = list_entry(pool->waiters.next, struct http_client_request_t, link);
+				list_remove(&req->link);
+				http_conn_assign(conn, req);
+			}
+
+			if (conn)
 			{
-				// read more
-				code = aio_client_recv(aio->client, aio->buffer, sizeof(aio->buffer));
+				req = http_conn_next(conn);
 			}
 			else
 			{
-				if (1 == aio->retry)
-				{
-					// try resend
-					aio->retry = 0;
-					code = aio_client_send_v(aio->client, aio->vec, aio->count);
-				}
-				else
-				{
-					code = ECONNRESET; // peer close
-				}
+				req = list_entry(pool->waiters.next, struct http_client_request_t, link);
+				list_remove(&req->link);
 			}
 		}
+		locker_unlock(&pool->locker);
+
+		if (req && !conn)
+			http_client_handle(req, NULL, ENOMEM);
+		else if (req)
+			http_conn_send(conn, req);
+	} while (req);
+}
+
+/// close the connection: the head request failed if response partially received,
+/// others have no response, resend on another connection(once)
+static void http_conn_error(struct http_pool_conn_t* conn, int code)
+{
+	int r, first, received, reused;
+	struct list_head requests;
+	struct list_head *pos, *next;
+	struct http_pool_t* pool;
+	struct http_client_request_t* req;
+	pool = conn->pool;
+
+	locker_lock(&pool->locker);
+	if (HTTP_CONN_ACTIVE != conn->state)
+	{
+		locker_unlock(&pool->locker);
+		return;
 	}
-	
-	if(0 != code)
+
+	if (0 == conn->error)
+		conn->error = code;
+	if (conn->sending)
 	{
-		http_client_handle(http, code);
+		// cancel send, close in onsend
+		locker_unlock(&pool->locker);
+		aio_client_disconnect(conn->client);
+		return;
+	}
+
+	code = conn->error;
+	received = conn->received;
+	reused = conn->reused;
+	http_conn_close(conn);
+	LIST_INIT_HEAD(&requests);
+	if (!list_empty(&conn->requests))
+	{
+		requests.next = conn->requests.next;
+		requests.prev = conn->requests.prev;
+		requests.next->prev = &requests;
+		requests.prev->next = &requests;
+		LIST_INIT_HEAD(&conn->requests);
+	}
+	conn->count = 0;
+	locker_unlock(&pool->locker);
+
+	aio_client_destroy(conn->client);
+
+	first = 1;
+	list_for_each_safe(pos, next, &requests)
+	{
+		req = list_entry(pos, struct http_client_request_t, link);
+		list_remove(&req->link);
+		if (ETIMEDOUT != code && req->retry && reused && !(first && received))
+		{
+			// keep-alive connection closed by peer, try resend
+			req->retry = 0;
+			r = http_pool_dispatch(pool, req);
+			if (0 != r)
+				http_client_handle(req, NULL, r);
+		}
+		else
+		{
+			http_client_handle(req, NULL, code);
+		}
+		first = 0;
+	}
+
+	http_pool_serve(pool);
+}
+
+static void http_conn_send(struct http_pool_conn_t* conn, struct http_client_request_t* req)
+{
+	int r, count;
+	socket_setbufvec(conn->vec, 0, req->header, req->nheader);
+	socket_setbufvec(conn->vec, 1, (void*)req->msg, req->bytes);
+	count = req->bytes > 0 ? 2 : 1;
+
+	// connect on the first send, connection is closed on error(don't reconnect)
+	r = aio_client_send_v(conn->client, conn->vec, count);
+	if (0 != r)
+	{
+		locker_lock(&conn->pool->locker);
+		conn->sending = 0;
+		locker_unlock(&conn->pool->locker);
+		http_conn_error(conn, r);
 	}
 }
 
-static void http_onsend(void* param, int code, size_t bytes)
+static void http_conn_recv(struct http_pool_conn_t* conn)
 {
-	struct http_client_t* http;
-	struct http_client_aio_t *aio;
-	aio = *(struct http_client_aio_t**)param;
-	http = http_entry(param, struct http_client_t, connection);
-	assert(http->connection == aio);
+	int r;
+	locker_lock(&conn->pool->locker);
+	r = conn->recving || (HTTP_CONN_ACTIVE != conn->state && HTTP_CONN_IDLE != conn->state);
+	conn->recving = 1;
+	locker_unlock(&conn->pool->locker);
+	if (r)
+		return; // recv pending or connection closed
+
+	r = aio_client_recv(conn->client, conn->buffer, sizeof(conn->buffer));
+	if (0 != r)
+	{
+		locker_lock(&conn->pool->locker);
+		conn->recving = 0;
+		locker_unlock(&conn->pool->locker);
+		http_conn_error(conn, r);
+	}
+}
+
+/// put connection into the idle list(with pool locker)
+static int http_pool_idle(struct http_pool_conn_t* conn)
+{
+	struct http_pool_t* pool;
+	pool = conn->pool;
+	if (s_pool.max_idle < 1 || pool->idle >= s_pool.max_idle || HTTP_TIMER_NONE != conn->timing)
+		return -1;
+
+	atomic_increment32(&conn->ref);
+	if (0 != aio_timeout_start(&conn->idle, s_pool.idle_timeout, http_pool_conn_onidle, conn))
+	{
+		atomic_decrement32(&conn->ref);
+		return -1;
+	}
+
+	conn->state = HTTP_CONN_IDLE;
+	list_remove(&conn->link);
+	list_insert_after(&conn->link, &pool->idles);
+	pool->idle++;
+	return 0;
+}
+
+/// after response: pipeline waiters, keep-alive(idle) or close
+/// @param[in] more unparsed response data
+/// @return 0-read more(response or idle health check), other-connection closed
+static int http_conn_continue(struct http_pool_conn_t* conn, int more)
+{
+	int close;
+	struct http_pool_t* pool;
+	struct http_client_request_t* req;
+	pool = conn->pool;
+
+	locker_lock(&pool->locker);
+	close = conn->closing || 0 != conn->error || (more && 0 == conn->count) || HTTP_CONN_ACTIVE != conn->state;
+	while (!close && conn->count < s_pool.pipeline && !list_empty(&pool->waiters))
+	{
+		req = list_entry(pool->waiters.next, struct http_client_request_t, link);
+		list_remove(&req->link);
+		http_conn_assign(conn, req);
+	}
+
+	if (!close && 0 == conn->count)
+		close = 0 != http_pool_idle(conn);
+	http_conn_timer_start(conn);
+	req = close ? NULL : http_conn_next(conn);
+	locker_unlock(&pool->locker);
 
+	if (close)
+	{
+		// Connection: close, resend the others
+		http_conn_error(conn, ECONNRESET);
+		return -1;
+	}
+
+	if (req)
+		http_conn_send(conn, req);
+	return 0;
+}
+
+/// head request finished(both response received and request sent)
+static int http_conn_finish(struct http_pool_conn_t* conn, int keepalive, int more)
+{
+	struct http_client_request_t* req;
+
+	locker_lock(&conn->pool->locker);
+	assert(!list_empty(&conn->requests));
+	req = list_entry(conn->requests.next, struct http_client_request_t, link);
+	list_remove(&req->link);
+	conn->count--;
+	conn->received = 0;
+	conn->done = 0;
+	conn->reused = 1;
+	conn->closing = conn->closing || !keepalive;
+	http_conn_timer_stop(conn);
+	locker_unlock(&conn->pool->locker);
+
+	http_client_handle(req, conn->parser, 0);
+	http_parser_clear(conn->parser);
+	return http_conn_continue(conn, more);
+}
+
+/// head response received
+/// @return 0-read more, other-stop(wait for onsend or connection closed)
+static int http_conn_onresponse(struct http_pool_conn_t* conn, int keepalive, int more)
+{
+	int r;
+	struct http_client_request_t* req;
+
+	locker_lock(&conn->pool->locker);
+	r = HTTP_CONN_ACTIVE == conn->state && !list_empty(&conn->requests) ? 0 : ECONNRESET;
+	if (0 == r)
+	{
+		req = list_entry(conn->requests.next, struct http_client_request_t, link);
+		if (HTTP_REQUEST_SENT != req->sent)
+		{
+			// response received before onsend
+			conn->done = 1;
+			conn->keepalive = keepalive && !more;
+			conn->recving = 0; // recv in onsend
+			r = -1;
+		}
+	}
+	locker_unlock(&conn->pool->locker);
+
+	if (ECONNRESET == r)
+		http_conn_error(conn, r); // unexpected response
+	return 0 == r ? http_conn_finish(conn, keepalive, more) : r;
+}
+
+/// stream mode: callback the head response body
+/// @param[in] more 1-wait more body data, 0-response completed(or peer closed), ignore ondata pause
+/// @return 0-continue, other-paused
+static int http_conn_stream(struct http_pool_conn_t* conn, int more)
+{
+	struct http_client_aio_t* aio;
+	struct http_client_request_t* req;
+
+	locker_lock(&conn->pool->locker);
+	req = list_empty(&conn->requests) ? NULL : list_entry(conn->requests.next, struct http_client_request_t, link);
+	locker_unlock(&conn->pool->locker);
+	if (!req || !req->ondata || 0 == http_client_stream(req, conn->parser) || !more)
+		return 0; // completed response: finish it now, resume has nothing to do
+
+	// keep recving flag, http_client_resume post recv
+	aio = (struct http_client_aio_t*)req->http->connection;
+	locker_lock(&conn->pool->locker);
+	assert(!conn->paused && HTTP_CONN_ACTIVE == conn->state);
+	conn->paused = 1;
+	list_insert_after(&conn->pause, &aio->paused);
+	http_conn_timer_stop(conn); // don't timeout by user
+	locker_unlock(&conn->pool->locker);
+	return 1;
+}
+
+/// parse responses in buffer, one recv maybe have more than one pipelined responses
+/// @return 0-read more, 1-stop, other-error
+static int http_conn_input(struct http_pool_conn_t* conn, size_t bytes)
+{
+	int r;
+	size_t n;
+	const char* data;
+
+	data = conn->buffer;
+	do
+	{
+		n = bytes - (data - conn->buffer);
+		r = http_parser_input(conn->parser, data, &n);
+		if (bytes > 0)
+		{
+			locker_lock(&conn->pool->locker);
+			conn->received = 1;
+			locker_unlock(&conn->pool->locker);
+		}
+
+		if (r < 0)
+			return r;
+		if (0 != http_conn_stream(conn, r > 0 && bytes > 0 ? 1 : 0))
+			return 1; // paused
+		if (r > 0)
+			return 0 == bytes ? ECONNRESET : 0; // peer close or read more
+
+		data = conn->buffer + bytes - n;
+		if (0 != http_conn_onresponse(conn, 0 != bytes && 1 != http_get_connection(conn->parser), n > 0 ? 1 : 0))
+			return 1;
+	} while (n > 0);
+	return 0;
+}
+
+/// idle connection peer closed(with pool locker)
+/// @return 1-close connection, 0-closed by idle timeout callback
+static int http_pool_expire(struct http_pool_conn_t* conn)
+{
+	struct http_pool_t* pool;
+	pool = conn->pool;
+	assert(HTTP_CONN_IDLE == conn->state);
+	list_remove(&conn->link);
+	pool->idle--;
+
+	if (0 != aio_timeout_stop(&conn->idle))
+	{
+		conn->state = HTTP_CONN_EXPIRED;
+		return 0;
+	}
+
+	atomic_decrement32(&conn->ref); // idle timer
+	conn->state = HTTP_CONN_CLOSED;
+	pool->active--;
+	return 1;
+}
+
+static void http_pool_conn_onidle(void* param)
+{
+	int close;
+	struct http_pool_t* pool;
+	struct http_pool_conn_t* conn;
+	conn = (struct http_pool_conn_t*)param;
+	pool = conn->pool;
+
+	locker_lock(&pool->locker);
+	if (HTTP_CONN_IDLE == conn->state)
+	{
+		list_remove(&conn->link);
+		pool->idle--;
+	}
+
+	close = HTTP_CONN_IDLE == conn->state || HTTP_CONN_EXPIRED == conn->state;
+	if (close)
+	{
+		conn->state = HTTP_CONN_CLOSED;
+		pool->active--;
+	}
+	locker_unlock(&pool->locker);
+
+	if (close)
+	{
+		aio_client_destroy(conn->client);
+		http_pool_serve(pool);
+	}
+	http_pool_conn_release(conn); // idle timer
+}
+
+static void http_pool_conn_ontimeout(void* param)
+{
+	int timeout;
+	struct http_pool_conn_t* conn;
+	conn = (struct http_pool_conn_t*)param;
+
+	locker_lock(&conn->pool->locker);
+	timeout = HTTP_TIMER_ARMED == conn->timing && HTTP_CONN_ACTIVE == conn->state;
+	if (HTTP_TIMER_STOPPING == conn->timing)
+	{
+		// stopped after response, restart for the next request
+		conn->timing = HTTP_TIMER_NONE;
+		if (HTTP_CONN_ACTIVE == conn->state && !conn->paused)
+			http_conn_timer_start(conn);
+	}
+	else
+	{
+		conn->timing = HTTP_TIMER_NONE;
+	}
+	locker_unlock(&conn->pool->locker);
+
+	if (timeout)
+		http_conn_error(conn, ETIMEDOUT);
+	http_pool_conn_release(conn); // response timer
+}
+
+/// borrow an idle connection, create a new one, or pipeline on a busy one(with pool locker)
+/// @return 0-ok(conn NULL if wait for connection), other-error
+static int http_pool_get(struct http_pool_t* pool, struct http_client_request_t* req, struct http_pool_conn_t** conn)
+{
+	struct list_head* pos;
+	struct http_pool_conn_t* c;
+
+	*conn = NULL;
+	while (!list_empty(&pool->idles))
+	{
+		// LIFO: the most recently used connection is the most likely to alive
+		c = list_entry(pool->idles.next, struct http_pool_conn_t, link);
+		list_remove(&c->link);
+		pool->idle--;
+
+		if (0 != aio_timeout_stop(&c->idle))
+		{
+			c->state = HTTP_CONN_EXPIRED; // closed by idle timeout callback
+			continue;
+		}
+
+		atomic_decrement32(&c->ref); // idle timer
+		c->state = HTTP_CONN_ACTIVE;
+		list_insert_after(&c->link, &pool->actives);
+		http_conn_assign(c, req);
+		*conn = c;
+		return 0;
+	}
+
+	if (!http_pool_full(pool) && list_empty(&pool->waiters))
+	{
+		c = http_pool_conn_create(pool);
+		if (!c)
+			return ENOMEM;
+		http_conn_assign(c, req);
+		*conn = c;
+		return 0;
+	}
+
+	// pipelining: the least busy connection
+	list_for_each(pos, &pool->actives)
+	{
+		c = list_entry(pos, struct http_pool_conn_t, link);
+		if (c->count < s_pool.pipeline && !c->closing && 0 == c->error && (!*conn || c->count < (*conn)->count))
+			*conn = c;
+	}
+
+	if (*conn)
+		http_conn_assign(*conn, req);
+	else
+		list_insert_before(&req->link, &pool->waiters);
+	return 0;
+}
+
+static int http_pool_dispatch(struct http_pool_t* pool, struct http_client_request_t* req)
+{
+	int r;
+	struct http_pool_conn_t* conn;
+	struct http_client_request_t* next;
+
+	locker_lock(&pool->locker);
+	r = http_pool_get(pool, req, &conn);
+	next = (0 == r && conn) ? http_conn_next(conn) : NULL;
+	locker_unlock(&pool->locker);
+
+	if (next)
+		http_conn_send(conn, next);
+	return r; // request owned by pool if 0 == r
+}
+
+static void http_pool_conn_onrecv(void* param, int code, size_t bytes)
+{
+	int state, close;
+	struct http_pool_t* pool;
+	struct http_pool_conn_t* conn;
+	conn = (struct http_pool_conn_t*)param;
+	pool = conn->pool;
+
+	close = 0;
+	locker_lock(&pool->locker);
+	state = conn->state;
+	if (HTTP_CONN_ACTIVE != state)
+	{
+		conn->recving = 0;
+		if (HTTP_CONN_IDLE == state)
+			close = http_pool_expire(conn);
+	}
+	if (0 != conn->error)
+		code = conn->error;
+	locker_unlock(&pool->locker);
+
+	if (HTTP_CONN_ACTIVE != state)
+	{
+		// idle connection health check failed
+		if (close)
+		{
+			aio_client_destroy(conn->client);
+			http_pool_serve(pool);
+		}
+		return;
+	}
+
+	// keep recving flag: pipelined onsend don't post recv during parse
 	if (0 == code)
-		code = aio_client_recv(aio->client, aio->buffer, sizeof(aio->buffer));
+	{
+		code = http_conn_input(conn, bytes);
+		if (1 == code)
+			return;
+		if (0 == code)
+			code = aio_client_recv(conn->client, conn->buffer, sizeof(conn->buffer));
+		if (0 == code)
+			return;
+	}
 
-	if (0 != code && 1 == aio->retry)
+	locker_lock(&pool->locker);
+	conn->recving = 0;
+	locker_unlock(&pool->locker);
+	http_conn_error(conn, code);
+}
+
+static void http_pool_conn_onsend(void* param, int code, size_t bytes)
+{
+	int done, keepalive;
+	struct list_head* pos;
+	struct http_pool_conn_t* conn;
+	struct http_client_request_t* req;
+	struct http_client_request_t* next;
+	conn = (struct http_pool_conn_t*)param;
+
+	next = NULL;
+	locker_lock(&conn->pool->locker);
+	conn->sending = 0;
+	if (0 != conn->error)
+		code = conn->error;
+	done = conn->done;
+	keepalive = conn->keepalive;
+	if (0 == code && HTTP_CONN_ACTIVE == conn->state)
 	{
-		// try resend
-		aio->retry = 0;
-		code = aio_client_send_v(aio->client, aio->vec, aio->count);
+		list_for_each(pos, &conn->requests)
+		{
+			req = list_entry(pos, struct http_client_request_t, link);
+			if (HTTP_REQUEST_SENDING == req->sent)
+			{
+				req->sent = HTTP_REQUEST_SENT;
+				break;
+			}
+		}
+
+		if (!done)
+			next = http_conn_next(conn); // pipelining
 	}
+	locker_unlock(&conn->pool->locker);
 
 	if (0 != code)
 	{
-		http_client_handle(http, code);
+		http_conn_error(conn, code);
+		return;
 	}
 
+	if (done && 0 != http_conn_finish(conn, keepalive, 0))
+		return; // response received before onsend
+	if (next)
+		http_conn_send(conn, next);
+	http_conn_recv(conn);
 	(void)bytes;
 }
 
-static int http_aio_request(struct http_client_t* http, const char* req, size_t nreq, const void* msg, size_t bytes)
+static void* http_aio_create(struct http_client_t *http)
+{
+	struct http_client_aio_t* aio;
+	aio = calloc(1, sizeof(struct http_client_aio_t));
+	if (aio)
+	{
+		LIST_INIT_HEAD(&aio->paused);
+		aio->pool = http_pool_fetch(http->host, http->port);
+		if (!aio->pool)
+		{
+			free(aio);
+			return NULL;
+		}
+	}
+
+	// aio_client default timeout
+	http->timeout.conn = 2 * 60 * 1000;
+	http->timeout.recv = 4 * 60 * 1000;
+	http->timeout.send = 2 * 60 * 1000;
+	return aio;
+}
+
+static void http_aio_destroy(struct http_client_t* http)
+{
+	struct http_client_aio_t* aio;
+	aio = (struct http_client_aio_t*)http->connection;
+
+	// request hold the http client reference, no request in pool
+	http_pool_release(aio->pool);
+	free(aio);
+	http->connection = NULL;
+}
+
+static void http_aio_timeout(struct http_client_t* http, int conn, int recv, int send)
 {
+	// apply to the connection on request
+	http->timeout.conn = conn;
+	http->timeout.recv = recv;
+	http->timeout.send = send;
+}
+
+static void http_aio_resume(struct http_client_t* http)
+{
+	int r;
+	struct list_head *pos, *next;
+	struct list_head resumes;
+	struct http_pool_conn_t* conn;
 	struct http_client_aio_t* aio;
 	aio = (struct http_client_aio_t*)http->connection;
-	http_parser_clear(http->parser); // clear http parser status
 
-	socket_setbufvec(aio->vec, 0, (char*)req, nreq);
-	socket_setbufvec(aio->vec, 1, (void*)msg, bytes);
-	aio->count = bytes > 0 ? 2 : 1;
+	LIST_INIT_HEAD(&resumes);
+	locker_lock(&aio->pool->locker);
+	list_for_each_safe(pos, next, &aio->paused)
+	{
+		conn = list_entry(pos, struct http_pool_conn_t, pause);
+		list_remove(&conn->pause);
+		list_insert_before(&conn->pause, &resumes);
+		conn->paused = 0;
+		http_conn_timer_start(conn);
+		atomic_increment32(&conn->ref);
+	}
+	locker_unlock(&aio->pool->locker);
 
-	aio->retry = 1; // try again if send failed
-	if (0 != aio_client_send_v(aio->client, aio->vec, aio->count))
+	list_for_each_safe(pos, next, &resumes)
 	{
-		// connection reset ???
-		aio->retry = 0;
-		return aio_client_send_v(aio->client, aio->vec, aio->count);
+		conn = list_entry(pos, struct http_pool_conn_t, pause);
+		list_remove(&conn->pause);
+		r = aio_client_recv(conn->client, conn->buffer, sizeof(conn->buffer));
+		if (0 != r)
+		{
+			locker_lock(&conn->pool->locker);
+			conn->recving = 0;
+			locker_unlock(&conn->pool->locker);
+			http_conn_error(conn, r);
+		}
+		http_pool_conn_release(conn);
 	}
-	return 0;
+}
+
+static int http_aio_request(struct http_client_t* http, struct http_client_request_t* req)
+{
+	struct http_client_aio_t* aio;
+	aio = (struct http_client_aio_t*)http->connection;
+	req->retry = 1; // resend once if keep-alive connection closed
+	return http_pool_dispatch(aio->pool, req);
 }
 
 struct http_client_connection_t* http_client_connection_aio(void)
@@ -170,6 +980,7 @@ struct http_client_connection_t* http_client_connection_aio(void)
 		http_aio_destroy,
 		http_aio_timeout,
 		http_aio_request,
+		http_aio_resume,
 	};
 	return &conn;
 }
@@ -50,7 +50,7 @@ static int http_socket_send(socket_t socket, int timeout, const char* req, size_
 	return ((int)(nreq + bytes) == socket_send_v_all_by_time(socket, vec, bytes > 0 ? 2 : 1, 0, timeout)) ? 0 : -1;
 }
 
-static int http_socket_request(http_client_t* http, const char* req, size_t nreq, const void* msg, size_t bytes)
+static int http_socket_request(http_client_t* http, struct http_client_request_t* req)
 {
 	int r = -1;
 	int tryagain = 0; // retry connection
@@ -65,7 +65,7 @@ RETRY_REQUEST:
 	if(0 != r) return r;
 
 	// send request
-	r = http_socket_send(http->socket, http->timeout.send, req, nreq, msg, bytes);
+	r = http_socket_send(http->socket, http->timeout.send, req->header, req->nheader, req->msg, req->bytes);
 	if(0 != r)
 	{
 		socket_close(http->socket);
@@ -85,6 +85,8 @@ RETRY_REQUEST:
 			int state;
 			size_t n = (size_t)r;
 			state = http_parser_input(http->parser, buffer, &n);
+			if(state >= 0)
+				http_client_stream(req, http->parser); // block io: don't pause
 			if(state <= 0)
 			{
 				// Connection: close
@@ -94,7 +96,7 @@ RETRY_REQUEST:
 					http->socket = socket_invalid;
 				}
 				assert(0 == n);
-				http_client_handle(http, state);
+				http_client_handle(req, http->parser, state);
 				return 0;
 			}
 		}
@@ -111,6 +113,11 @@ RETRY_REQUEST:
 	return r;
 }
 
+static void http_socket_resume(struct http_client_t* http)
+{
+	(void)http; // ondata block the receiving
+}
+
 static void http_socket_timeout(struct http_client_t* http, int conn, int recv, int send)
 {
 	assert(conn >= 0 && recv >= 0 && send >= 0);
@@ -126,6 +133,7 @@ struct http_client_connection_t* http_client_connection(void)
 		http_socket_destroy,
 		http_socket_timeout,
 		http_socket_request,
+		http_socket_resume,
 	};
 	return &conn;
 }
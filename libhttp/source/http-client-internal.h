@@ -7,11 +7,31 @@
 #include "sys/locker.h"
 #include "http-parser.h"
 #include "http-request.h"
+#include "list.h"
 
-struct http_client_t
+/// per-request context, free by http_client_handle
+struct http_client_request_t
 {
+	struct list_head link; // connection pipeline or pool waiters
+	struct http_client_t* http;
 	http_client_onreply onreply;
-	void *cbparam;
+	http_client_ondata ondata; // stream mode
+	void* param;
+
+	const void* msg; // POST content
+	size_t bytes;
+	size_t nheader;
+	char* header; // request header copy
+
+	int sent; // connection internal: 0-queued, 1-sending, 2-sent
+	int retry; // connection internal: resend on another connection
+};
+
+struct http_client_t
+{
+	int closed; // http_client_destroy, don't callback any more
+	http_parser_t* reply; // current response(onreply callback)
+	http_client_ondata ondata; // stream mode for the next requests
 
 	volatile int32_t ref;
 	locker_t locker;
@@ -41,13 +61,19 @@ struct http_client_connection_t
 	void (*destroy)(struct http_client_t *http);
 	void (*timeout)(struct http_client_t *http, int conn, int recv, int send);
 	
-	int (*request)(struct http_client_t *http, const char* req, size_t nreq, const void* msg, size_t bytes);
+	int (*request)(struct http_client_t *http, struct http_client_request_t* req);
+	void (*resume)(struct http_client_t *http);
 };
 
 struct http_client_connection_t* http_client_connection(void);
 struct http_client_connection_t* http_client_connection_aio(void);
 
 void http_client_release(struct http_client_t* http);
-void http_client_handle(struct http_client_t *http, int code);
+/// request finished: callback with the response, free request
+/// @param[in] parser response parser, valid in onreply callback
+void http_client_handle(struct http_client_request_t* req, http_parser_t* parser, int code);
+/// stream mode: callback body data received
+/// @return 0-continue, other-pause receiving
+int http_client_stream(struct http_client_request_t* req, http_parser_t* parser);
 
 #endif /* !_http_client_internal_h_ */
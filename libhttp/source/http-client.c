@@ -76,13 +76,17 @@ static int http_make_request(struct http_client_t *http, int method, const char*
 	return r;
 }
 
-void http_client_handle(struct http_client_t *http, int code)
+void http_client_handle(struct http_client_request_t* req, http_parser_t* parser, int code)
 {
 	int len;
 	char buffer[512];
 	const char* cookie;
+	http_parser_t* reply;
+	struct http_client_t* http;
+	http = req->http;
 
-	if(0 == code)
+	locker_lock(&http->locker);
+	if(0 == code && parser)
 	{
 		// FIXME: 
 		// 1. only handle one cookie item
@@ -91,7 +95,7 @@ void http_client_handle(struct http_client_t *http, int code)
 		// 4. check cookie secure
 
 		// handle cookie
-		cookie = http_get_cookie(http->parser);
+		cookie = http_get_cookie(parser);
 		if(cookie)
 		{
 			http_cookie_t* ck;
@@ -112,32 +116,81 @@ void http_client_handle(struct http_client_t *http, int code)
 		}
 	}
 
-	locker_lock(&http->locker);
-	if(http->onreply)
-		http->onreply(http->cbparam, code);
+	// callbacks of the same client are serialized by the locker
+	reply = http->reply;
+	http->reply = parser;
+	if(!http->closed && req->onreply)
+		req->onreply(req->param, code);
+	http->reply = reply;
 	locker_unlock(&http->locker);
 
+	free(req);
 	http_client_release(http);
 }
 
+int http_client_stream(struct http_client_request_t* req, http_parser_t* parser)
+{
+	int r;
+	size_t bytes;
+	const void* data;
+	http_parser_t* reply;
+	struct http_client_t* http;
+	http = req->http;
+
+	if (!req->ondata || 0 != http_parser_fetch(parser, &data, &bytes) || 0 == bytes)
+		return 0;
+
+	r = 0;
+	locker_lock(&http->locker);
+	reply = http->reply;
+	http->reply = parser;
+	if (!http->closed)
+		r = req->ondata(req->param, data, bytes);
+	http->reply = reply;
+	locker_unlock(&http->locker);
+	return r;
+}
+
 static int http_client_request(struct http_client_t *http, int method, const char* uri, const struct http_header_t *headers, size_t n, const void* msg, size_t bytes, http_client_onreply onreply, void* param)
 {
 	int r, len;
 	const char* header;
+	struct http_client_request_t* req;
 
+	// request builder and cookie are shared by all requests
+	locker_lock(&http->locker);
 	if(0 != http_make_request(http, method, uri, headers, n, bytes))
 	{
+		locker_unlock(&http->locker);
 		return -1;
 	}
 	header = http_request_get(http->req, &len);
-	
-	http->cbparam = param;
-	http->onreply = onreply;
+
+	req = (struct http_client_request_t*)calloc(1, sizeof(*req) + len + 1);
+	if (req)
+	{
+		req->header = (char*)(req + 1);
+		memcpy(req->header, header, len);
+		req->nheader = len;
+		req->ondata = http->ondata;
+	}
+	locker_unlock(&http->locker);
+	if (!req)
+		return -1;
+
+	req->http = http;
+	req->onreply = onreply;
+	req->param = param;
+	req->msg = msg;
+	req->bytes = bytes;
 
 	atomic_increment32(&http->ref);
-	r = http->conn->request(http, header, len, msg, bytes);
+	r = http->conn->request(http, req);
 	if (0 != r)
+	{
+		free(req);
 		http_client_release(http);
+	}
 	return r;
 }
 
@@ -157,9 +210,10 @@ struct http_client_t* http_client_create(const char* ip, unsigned short port, in
 	locker_create(&http->locker);
 	http->ref = 1;
 	http->req = http_request_create(HTTP_1_1);
-	http->parser = http_parser_create(HTTP_PARSER_CLIENT);
+	http->parser = flags ? http_parser_create(HTTP_PARSER_CLIENT) : NULL; // aio: parser per connection
+	http->reply = http->parser;
 	http->connection = http->conn->create(http);
-	if (r <= 0 || r >= sizeof(http->host) || !http->parser || !http->req || !http->connection)
+	if (r <= 0 || r >= sizeof(http->host) || (flags && !http->parser) || !http->req || !http->connection)
 	{
 		http_client_release(http);
 		return NULL;
@@ -170,9 +224,12 @@ struct http_client_t* http_client_create(const char* ip, unsigned short port, in
 void http_client_destroy(struct http_client_t* http)
 {
 	locker_lock(&http->locker);
-	http->onreply = NULL; // disable future callback
+	http->closed = 1; // disable future callback
 	locker_unlock(&http->locker);
 
+	// drain paused responses without callback
+	http->conn->resume(http);
+
 	http_client_release(http);
 }
 
@@ -216,6 +273,18 @@ void http_client_set_timeout(struct http_client_t* http, int conn, int recv, int
 	http->conn->timeout(http, conn, recv, send);
 }
 
+void http_client_set_ondata(struct http_client_t* http, http_client_ondata ondata)
+{
+	locker_lock(&http->locker);
+	http->ondata = ondata;
+	locker_unlock(&http->locker);
+}
+
+void http_client_resume(struct http_client_t* http)
+{
+	http->conn->resume(http);
+}
+
 int http_client_get(struct http_client_t* http, const char* uri, const struct http_header_t *headers, size_t n, http_client_onreply onreply, void* param)
 {
 	return http_client_request(http, HTTP_GET, uri, headers, n, NULL, 0, onreply, param);
@@ -228,12 +297,14 @@ int http_client_post(struct http_client_t* http, const char* uri, const struct h
 
 const char* http_client_get_header(struct http_client_t* http, const char *name)
 {
-	return http_get_header_by_name(http->parser, name);
+	return http->reply ? http_get_header_by_name(http->reply, name) : NULL;
 }
 
 int http_client_get_content(struct http_client_t* http, const void **content, size_t *bytes)
 {
-	*bytes = http_get_content_length(http->parser);
-	*content = http_get_content(http->parser);
+	if (!http->reply)
+		return -1;
+	*bytes = (size_t)http_get_content_length(http->reply);
+	*content = http_get_content(http->reply);
 	return 0;
 }
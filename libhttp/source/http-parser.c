@@ -72,12 +72,16 @@ struct http_parser_t
 	struct http_header_t *headers;
 	int header_size; // the number of HTTP header
 	int header_capacity;
-	int content_length; // -1-don't have header, >=0-Content-Length
+	int64_t content_length; // -1-don't have header, >=0-Content-Length(chunked: decoded bytes in raw)
 	int connection_close; // 1-close, 0-keep-alive, <0-don't set
 	int content_encoding;
 	int transfer_encoding;
 	int cookie;
 	int location;
+
+	// stream mode(http_parser_fetch)
+	size_t fetched; // body bytes fetched, discard on next input
+	int64_t discarded; // body bytes have been discarded
 };
 
 static size_t s_body_max_size = 0*MB;
@@ -202,8 +206,8 @@ static int http_header_handler(struct http_parser_t *http, size_t npos, size_t v
 		if(is_transfer_encoding_chunked(http))
 			http->content_length = -1;
 		else
-			http->content_length = atoi(value);
-		assert(http->content_length >= 0 && (0==s_body_max_size || http->content_length < (int)s_body_max_size));
+			http->content_length = strtoll(value, NULL, 10);
+		assert(http->content_length >= 0 && (0==s_body_max_size || http->content_length < (int64_t)s_body_max_size));
 	}
 	else if(0 == strcasecmp("Connection", name))
 	{
@@ -724,6 +728,8 @@ static int http_parse_chunked(struct http_parser_t *http)
 		CHUNK_EXTENSION,
 		CHUNK_EXTENSION_CR,
 		CHUNK_DATA,
+		CHUNK_DATA_CR,
+		CHUNK_DATA_LF,
 		CHUNK_TRAILER_START,
 		CHUNK_TRAILER,
 		CHUNK_TRAILER_CR,
@@ -732,6 +738,7 @@ static int http_parse_chunked(struct http_parser_t *http)
 	};
 
 	char c;
+	size_t n;
 	assert(is_transfer_encoding_chunked(http));
 	if(0 == http->chunk.offset)
 	{
@@ -834,24 +841,41 @@ static int http_parse_chunked(struct http_parser_t *http)
 			break;
 
 		case CHUNK_DATA:
+			// decode received data, don't wait for the whole chunk(stream mode)
 			assert(http->chunk.len > 0);
-			assert(0 != http->chunk.pos);
-			if(http->chunk.pos + http->chunk.len + 2 > http->raw_size)
+			assert(http->chunk.pos == http->chunk.offset);
+			n = http->raw_size - http->chunk.offset;
+			n = n < http->chunk.len ? n : http->chunk.len;
+			memmove(http->raw+http->offset+http->content_length, http->raw+http->chunk.offset, n);
+			http->content_length += n;
+			http->raw[http->offset+http->content_length] = '\0';
+			http->chunk.len -= n;
+			http->chunk.offset += n;
+			http->chunk.pos = http->chunk.offset;
+			if(http->chunk.len > 0)
 				return 0; // wait for more data
 
-			if('\r' != http->raw[http->chunk.pos + http->chunk.len] || '\n' != http->raw[http->chunk.pos + http->chunk.len + 1])
+			http->stateM = CHUNK_DATA_CR;
+			http->chunk.offset -= 1; // go back
+			break;
+
+		case CHUNK_DATA_CR:
+			if('\r' != c)
 			{
 				assert(0);
 				return -1;
 			}
+			http->stateM = CHUNK_DATA_LF;
+			break;
 
-			memmove(http->raw+http->offset+http->content_length, http->raw+http->chunk.pos, http->chunk.len);
-			http->raw[http->offset+http->content_length+http->chunk.len] = '\0';
-			http->content_length += http->chunk.len;
+		case CHUNK_DATA_LF:
+			if('\n' != c)
+			{
+				assert(0);
+				return -1;
+			}
 			http->stateM = CHUNK_START;
-
-			http->chunk.offset += http->chunk.len + 1; // skip \r\n
-			http->chunk.pos = http->chunk.len = 0; // reuse chunk
+			http->chunk.pos = 0; // reuse chunk
 			break;
 
 		case CHUNK_TRAILER_START:
@@ -979,6 +1003,57 @@ void http_parser_clear(struct http_parser_t* http)
 	http->transfer_encoding = 0;
 	http->cookie = 0;
 	http->location = 0;
+	http->fetched = 0;
+	http->discarded = 0;
+}
+
+/// remove fetched body data from raw buffer(stream mode)
+static void http_body_discard(struct http_parser_t* http)
+{
+	size_t n;
+	n = http->fetched;
+	if(0 == n)
+		return;
+
+	assert(http->offset + n <= http->raw_size);
+	memmove(http->raw + http->offset, http->raw + http->offset + n, http->raw_size - http->offset - n);
+	http->raw_size -= n;
+	http->raw[http->raw_size] = '\0';
+	http->discarded += n;
+	http->fetched = 0;
+
+	if(is_transfer_encoding_chunked(http))
+	{
+		// decoded data in front of the chunk parse position
+		assert(http->content_length >= (int64_t)n && http->chunk.offset >= http->offset + n);
+		http->content_length -= n;
+		http->chunk.offset -= n;
+		if(http->chunk.pos > 0)
+			http->chunk.pos -= n;
+	}
+}
+
+int http_parser_fetch(struct http_parser_t* http, const void** data, size_t* bytes)
+{
+	int64_t n;
+	http_body_discard(http);
+	if(http->stateM < SM_BODY)
+		return -1;
+
+	if(is_transfer_encoding_chunked(http))
+		n = http->content_length > 0 ? http->content_length : 0; // decoded bytes
+	else if(http->content_length >= 0)
+		n = http->content_length - http->discarded; // the next message maybe follow the body
+	else
+		n = -1; // until connection closed
+
+	if(n < 0 || n > (int64_t)(http->raw_size - http->offset))
+		n = (int64_t)(http->raw_size - http->offset);
+
+	*data = http->raw + http->offset;
+	*bytes = (size_t)n;
+	http->fetched = (size_t)n;
+	return 0;
 }
 
 int http_parser_input(struct http_parser_t* http, const void* data, size_t *bytes)
@@ -987,6 +1062,9 @@ int http_parser_input(struct http_parser_t* http, const void* data, size_t *byte
 
 	int r;
 
+	// stream mode: fetched body don't need any more
+	http_body_discard(http);
+
 	// save raw data
 	r = http_rawdata(http, data, *bytes);
 	if(0 != r)
@@ -1027,7 +1105,7 @@ int http_parser_input(struct http_parser_t* http, const void* data, size_t *byte
 					// receive all until socket closed
 					if(0 == *bytes /*|| http->raw_size == http->offset*/)
 					{
-						http->content_length = http->raw_size - http->offset;
+						http->content_length = http->raw_size - http->offset + http->discarded;
 						http->stateM = SM_DONE;
 					}
 				}
@@ -1044,8 +1122,8 @@ int http_parser_input(struct http_parser_t* http, const void* data, size_t *byte
 			}
 			else
 			{
-				assert(http->raw_size <= http->offset + http->content_length);
-				if(http->raw_size >= http->offset + http->content_length)
+				// pipelining: the next message maybe follow the body
+				if((int64_t)(http->raw_size - http->offset) + http->discarded >= http->content_length)
 					http->stateM = SM_DONE;
 			}
 		}
@@ -1057,8 +1135,17 @@ int http_parser_input(struct http_parser_t* http, const void* data, size_t *byte
 	*bytes = 0;
 	if (SM_DONE == http->stateM)
 	{
-		assert(http->content_length < 0 || http->raw_size - http->offset >= (size_t)http->content_length);
-		*bytes = http->raw_size - http->offset - ((http->content_length >= 0) ? http->content_length : 0);
+		if (is_transfer_encoding_chunked(http))
+		{
+			// chunked body is decoded in place, the next message follow the last chunk
+			assert(http->raw_size >= http->chunk.offset);
+			*bytes = http->raw_size - http->chunk.offset;
+		}
+		else
+		{
+			assert(http->content_length < 0 || (int64_t)(http->raw_size - http->offset) + http->discarded >= http->content_length);
+			*bytes = http->raw_size - http->offset - (size_t)((http->content_length >= 0) ? http->content_length - http->discarded : 0);
+		}
 	}
 	return http->stateM == SM_DONE ? INPUT_DONE : (SM_BODY == http->stateM ? INPUT_HEADER : INPUT_NEEDMORE);
 }
@@ -1115,8 +1202,8 @@ const char* http_get_request_uri(const struct http_parser_t* http)
 const void* http_get_content(const struct http_parser_t* http)
 {
 	assert(http->stateM>=SM_BODY);
-	assert(http->offset <= http->raw_size);
-	return http->raw + http->offset;
+	assert(http->offset + http->fetched <= http->raw_size);
+	return http->raw + http->offset + http->fetched;
 }
 
 int http_get_header_count(const struct http_parser_t* http)
@@ -1171,15 +1258,19 @@ int http_get_header_by_name2(const struct http_parser_t* http, const char* name,
 	return -1;
 }
 
-int http_get_content_length(const struct http_parser_t* http)
+int64_t http_get_content_length(const struct http_parser_t* http)
 {
 	assert(http->stateM>=SM_BODY);
 	if(-1 == http->content_length)
 	{
 		assert(!is_server_mode(http));
-		return http->raw_size - http->offset;
+		return (int64_t)(http->raw_size - http->offset - http->fetched);
 	}
-	return http->content_length;
+
+	// stream mode: fetched/discarded body isn't in the buffer any more
+	if(is_transfer_encoding_chunked(http))
+		return http->content_length - http->fetched; // decoded bytes, discarded removed already
+	return http->content_length - http->discarded - http->fetched;
 }
 
 int http_get_connection(const struct http_parser_t* http)
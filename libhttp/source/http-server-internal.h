@@ -51,6 +51,11 @@ struct http_server_t
 
 int http_session_create(struct http_server_t *server, socket_t socket, const struct sockaddr* sa, socklen_t salen);
 
+/// session cache reference, held by every http server and session
+/// the cache is created by the first one and destroyed with the last one
+void http_session_cache_acquire(void);
+void http_session_cache_release(void);
+
 int http_session_add_header(struct http_session_t* session, const char* name, const char* value, size_t bytes);
 
 #endif /* !_http_server_internal_h_ */
@@ -8,12 +8,15 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-#define N_SENDFILE (2 * 1024 * 1024)
+#define N_SENDFILE (2 * 1024 * 1024) // read buffer, aio backend don't support sendfile only
 
 #if defined(OS_WINDOWS)
 #define fseek _fseeki64
+#define fileno _fileno
 #endif
 
+static const char* s_http_last_chunk = "\r\n0\r\n\r\n"; // chunk-data CRLF + last-chunk + CRLF
+
 struct http_sendfile_t
 {
 	struct http_session_t* session;
@@ -21,39 +24,40 @@ struct http_sendfile_t
 	void* param;
 
 	int code;
+	int chunked; // 1-last chunk don't sent
 	FILE* fp;
-	size_t capacity;
-	size_t bytes;
+	int64_t offset; // file offset(Range)
 	int64_t sent;
 	int64_t total;
-	uint8_t* ptr;
+
+	uint8_t* ptr; // fallback read buffer
+	size_t capacity;
+	char chunk[64]; // chunk-size line, Content-Length/Content-Range value
 };
 
 static struct http_sendfile_t* http_file_open(const char* filename)
 {
 	FILE* fp;
 	int64_t size;
-	size_t capacity;
 	struct http_sendfile_t* sendfile;
 
 	size = path_filesize(filename);
 	fp = fopen(filename, "rb");
 	if (NULL == fp || size < 0)
+	{
+		if (fp) fclose(fp);
 		return NULL;
+	}
 
-	capacity = (size_t)(size < N_SENDFILE ? size : N_SENDFILE);
-	sendfile = (struct http_sendfile_t*)malloc(sizeof(*sendfile) + capacity + 10 /*chunk*/ + 5 /*last chunk*/);
+	sendfile = (struct http_sendfile_t*)calloc(1, sizeof(*sendfile));
 	if (NULL == sendfile)
 	{
 		fclose(fp);
 		return NULL;
 	}
 
-	memset(sendfile, 0, sizeof(*sendfile));
 	sendfile->fp = fp;
-	sendfile->ptr = (uint8_t*)(sendfile + 1);
 	sendfile->total = size;
-	sendfile->capacity = capacity;
 	sendfile->code = 200;
 	return sendfile;
 }
@@ -65,58 +69,44 @@ static void http_file_close(struct http_sendfile_t* sendfile)
 		fclose(sendfile->fp);
 		sendfile->fp = NULL;
 	}
+	if (sendfile->ptr)
+	{
+		free(sendfile->ptr);
+		sendfile->ptr = NULL;
+	}
 	free(sendfile);
 }
 
-static void http_file_read(struct http_sendfile_t* sendfile)
+/// send the remain file data, sendfile(zero-copy) if aio backend support, otherwise read into buffer
+/// @return 0-ok, other-error
+static int http_file_send(struct http_sendfile_t* sendfile)
 {
-    size_t size;
-	static const char* hex = "0123456789ABCDEF";
-
-    size = (sendfile->total - sendfile->sent) > (int64_t)sendfile->capacity ? sendfile->capacity : (size_t)(sendfile->total - sendfile->sent);
+	int r;
+	size_t size;
 
-    if (1 == sendfile->session->http_transfer_encoding_flag)
+	if (NULL == sendfile->ptr)
 	{
-		sendfile->bytes = fread(sendfile->ptr + 8, 1, size, sendfile->fp);
-		sendfile->sent += sendfile->bytes;
-
-        if (sendfile->bytes > 0)
+		r = aio_tcp_transport_sendfile(sendfile->session->transport, fileno(sendfile->fp), sendfile->offset + sendfile->sent, (size_t)(sendfile->total - sendfile->sent));
+		if (0 == r)
 		{
-			// chunk
-			assert(sendfile->bytes < (1 << 24));
-			sendfile->ptr[0] = (uint8_t)hex[(sendfile->bytes >> 20) & 0x0F];
-			sendfile->ptr[1] = (uint8_t)hex[(sendfile->bytes >> 16) & 0x0F];
-			sendfile->ptr[2] = (uint8_t)hex[(sendfile->bytes >> 12) & 0x0F];
-			sendfile->ptr[3] = (uint8_t)hex[(sendfile->bytes >> 8) & 0x0F];
-			sendfile->ptr[4] = (uint8_t)hex[(sendfile->bytes >> 4) & 0x0F];
-			sendfile->ptr[5] = (uint8_t)hex[sendfile->bytes & 0x0F];
-			sendfile->ptr[6] = '\r';
-			sendfile->ptr[7] = '\n';
-			sendfile->ptr[sendfile->bytes + 8] = '\r';
-			sendfile->ptr[sendfile->bytes + 9] = '\n';
-			sendfile->bytes += 10;
+			sendfile->sent = sendfile->total;
+			return 0;
 		}
 
-        if (0 == sendfile->bytes || sendfile->sent == sendfile->total)
-        {
-            assert(0 != sendfile->bytes || feof(sendfile->fp));
-
-            // last-chunk
-            sendfile->ptr[sendfile->bytes + 0] = '0'; // length
-            sendfile->ptr[sendfile->bytes + 1] = '\r';
-            sendfile->ptr[sendfile->bytes + 2] = '\n';
-
-            // \r\n
-            sendfile->ptr[sendfile->bytes + 3] = '\r';
-            sendfile->ptr[sendfile->bytes + 4] = '\n';
-            sendfile->bytes += 5;
-        }
-	}
-	else
-	{
-		sendfile->bytes = fread(sendfile->ptr, 1, size, sendfile->fp);
-		sendfile->sent += sendfile->bytes;
+		// ENOTSUP: fallback to read/send, send return the same error if transport failed
+		sendfile->capacity = (size_t)(sendfile->total - sendfile->sent < N_SENDFILE ? sendfile->total - sendfile->sent : N_SENDFILE);
+		sendfile->ptr = (uint8_t*)malloc(sendfile->capacity);
+		if (NULL == sendfile->ptr)
+			return -ENOMEM;
+		fseek(sendfile->fp, sendfile->offset + sendfile->sent, SEEK_SET);
 	}
+
+	size = (sendfile->total - sendfile->sent) > (int64_t)sendfile->capacity ? sendfile->capacity : (size_t)(sendfile->total - sendfile->sent);
+	size = fread(sendfile->ptr, 1, size, sendfile->fp);
+	if (0 == size)
+		return -EIO; // file truncated
+	sendfile->sent += size;
+	return aio_tcp_transport_send(sendfile->session->transport, sendfile->ptr, size);
 }
 
 static int http_server_onsendfile(void* param, int code, size_t bytes)
@@ -124,19 +114,25 @@ static int http_server_onsendfile(void* param, int code, size_t bytes)
 	struct http_sendfile_t* sendfile;
 	sendfile = (struct http_sendfile_t*)param;
 
+	(void)bytes; // http header + content, or content only
 	if (0 == code)
 	{
-		assert(sendfile->bytes <= bytes); // bytes: http header + content
-		if (sendfile->sent == sendfile->total)
+		if (sendfile->sent < sendfile->total)
+		{
+			code = http_file_send(sendfile);
+		}
+		else if (sendfile->chunked)
+		{
+			sendfile->chunked = 0;
+			code = aio_tcp_transport_send(sendfile->session->transport, s_http_last_chunk, strlen(s_http_last_chunk));
+		}
+		else
 		{
 			if (sendfile->onsend)
 				code = sendfile->onsend(sendfile->param, 0, (size_t)sendfile->total);
 			http_file_close(sendfile);
 			return code;
 		}
-		
-		http_file_read(sendfile);
-		code = aio_tcp_transport_send(sendfile->session->transport, sendfile->ptr, sendfile->bytes);
 	}
 
 	if(0 != code)
@@ -193,10 +189,10 @@ static int http_session_range(struct http_sendfile_t* sendfile)
 		}
 
 		assert(range[0].start <= range[0].end);
-		n = snprintf((char*)sendfile->ptr, sendfile->capacity, "bytes %" PRId64 "-%" PRId64 "/%" PRId64, range[0].start, range[0].end, sendfile->total);
-		http_session_add_header(sendfile->session, "Content-Range", (char*)sendfile->ptr, n);
+		n = snprintf(sendfile->chunk, sizeof(sendfile->chunk), "bytes %" PRId64 "-%" PRId64 "/%" PRId64, range[0].start, range[0].end, sendfile->total);
+		http_session_add_header(sendfile->session, "Content-Range", sendfile->chunk, n);
 
-		fseek(sendfile->fp, range[0].start, SEEK_SET);
+		sendfile->offset = range[0].start;
 		sendfile->total = range[0].end + 1 - range[0].start;
 		assert(sendfile->total > 0);
 		sendfile->code = 206;
@@ -227,17 +223,35 @@ int http_server_sendfile(struct http_session_t* session, const char* localpath,
 
 	if (0 != http_session_range(sendfile))
 	{
+		http_file_close(sendfile);
+
 		// 416 Requested Range Not Satisfiable
-		return http_server_send(sendfile->session, 416, NULL, 0, NULL, NULL);
+		return http_server_send(session, 416, NULL, 0, NULL, NULL);
 	}
 
 	if (0 == session->http_content_length_flag)
 	{
-		n = snprintf((char*)sendfile->ptr, sendfile->capacity, "%" PRId64, sendfile->total);
-		http_session_add_header(session, "Content-Length", (char*)sendfile->ptr, n);
+		n = snprintf(sendfile->chunk, sizeof(sendfile->chunk), "%" PRId64, sendfile->total);
+		http_session_add_header(session, "Content-Length", sendfile->chunk, n);
 	}
 
-	http_file_read(sendfile);
+	// send with http header: chunk-size line(whole file as one chunk)
+	n = 0;
+	if (1 == session->http_transfer_encoding_flag)
+	{
+		if (sendfile->total > 0)
+		{
+			n = snprintf(sendfile->chunk, sizeof(sendfile->chunk), "%" PRIX64 "\r\n", sendfile->total);
+			sendfile->chunked = 1;
+		}
+		else
+		{
+			n = snprintf(sendfile->chunk, sizeof(sendfile->chunk), "0\r\n\r\n"); // last-chunk only
+		}
+	}
 
-	return http_server_send(session, sendfile->code, sendfile->ptr, sendfile->bytes, http_server_onsendfile, sendfile);
+	n = http_server_send(session, sendfile->code, sendfile->chunk, n, http_server_onsendfile, sendfile);
+	if (0 != n)
+		http_file_close(sendfile);
+	return n;
 }
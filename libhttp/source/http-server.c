@@ -57,6 +57,7 @@ static void http_server_ondestroy(void* param)
 	struct http_server_t *server;
 	server = (struct http_server_t *)param;
 	free(server);
+	http_session_cache_release();
 }
 
 struct http_server_t* http_server_create(const char* ip, int port)
@@ -66,6 +67,7 @@ struct http_server_t* http_server_create(const char* ip, int port)
 	http = (struct http_server_t*)calloc(1, sizeof(*http));
 	if (http)
 	{
+		http_session_cache_acquire();
 		if (0 != http_server_listen(http, ip, port))
 		{
 			http_server_ondestroy(http);
@@ -104,7 +106,7 @@ const char* http_server_get_header(struct http_session_t *session, const char *n
 int http_server_get_content(struct http_session_t *session, void **content, size_t *length)
 {
 	*content = (void*)http_get_content(session->parser);
-	*length = http_get_content_length(session->parser);
+	*length = (size_t)http_get_content_length(session->parser);
 	return 0;
 }
 
@@ -2,6 +2,10 @@
 #include "aio-tcp-transport.h"
 #include "http-reason.h"
 #include "http-parser.h"
+#include "sys/atomic.h"
+#include "sys/locker.h"
+#include "sys/onetime.h"
+#include "slab-cache.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -14,12 +18,61 @@
 #endif
 
 #define HTTP_RECV_BUFFER (2*1024)
+#define HTTP_SESSION_SIZE (sizeof(struct http_session_t) + 2 * 1024 + HTTP_RECV_BUFFER)
+#define HTTP_SESSION_CACHE 256 // max cached session per thread
+
+static slab_cache_t* s_cache;
+static int32_t s_ref; // http servers and sessions
+static locker_t s_locker;
+static onetime_t s_init = ONETIME_INIT;
 
 static socket_bufvec_t* socket_bufvec_alloc(struct http_session_t *session, int count);
 static int http_session_data(struct http_session_t *session, const struct http_vec_t* vec, int num);
 
 static const char* s_http_header_end = "\r\n";
 
+static void http_session_init(void)
+{
+	locker_create(&s_locker);
+}
+
+void http_session_cache_acquire(void)
+{
+	int32_t ref;
+	// fast path: the cache is alive(held by http server)
+	for (ref = atomic_load32(&s_ref); ref > 0; ref = atomic_load32(&s_ref))
+	{
+		if (atomic_cas32(&s_ref, ref, ref + 1))
+			return;
+	}
+
+	onetime_exec(&s_init, http_session_init);
+	locker_lock(&s_locker);
+	if (0 == s_ref)
+		s_cache = slab_cache_create(HTTP_SESSION_SIZE, HTTP_SESSION_CACHE);
+	atomic_increment32(&s_ref);
+	locker_unlock(&s_locker);
+}
+
+void http_session_cache_release(void)
+{
+	int32_t ref;
+	for (ref = atomic_load32(&s_ref); ref > 1; ref = atomic_load32(&s_ref))
+	{
+		if (atomic_cas32(&s_ref, ref, ref - 1))
+			return;
+	}
+
+	// the last one: all servers and sessions have been destroyed
+	locker_lock(&s_locker);
+	if (0 == atomic_decrement32(&s_ref) && s_cache)
+	{
+		slab_cache_destroy(s_cache);
+		s_cache = NULL;
+	}
+	locker_unlock(&s_locker);
+}
+
 static void http_session_ondestroy(void* param)
 {
 	struct http_session_t *session;
@@ -51,7 +104,11 @@ static void http_session_ondestroy(void* param)
 #if defined(DEBUG) || defined(_DEBUG)
 	memset(session, 0xCC, sizeof(*session));
 #endif
-	free(session);
+	if (s_cache)
+		slab_cache_free(s_cache, session);
+	else
+		free(session);
+	http_session_cache_release();
 }
 
 static void http_session_reset(struct http_session_t *session)
@@ -143,10 +200,14 @@ int http_session_create(struct http_server_t *server, socket_t socket, const str
 	handler.onrecv = http_session_onrecv;
 	handler.onsend = http_session_onsend;
 
-	session = (struct http_session_t *)malloc(sizeof(*session) + 2 * 1024 + HTTP_RECV_BUFFER);
-	if (!session) return -1;
+	http_session_cache_acquire();
+	session = (struct http_session_t *)(s_cache ? slab_cache_alloc(s_cache) : calloc(1, HTTP_SESSION_SIZE));
+	if (!session)
+	{
+		http_session_cache_release();
+		return -1;
+	}
 
-	memset(session, 0, sizeof(*session));
 	session->header = (char*)(session + 1);
 	session->header_capacity = 2 * 1024;
 	session->data = session->header + session->header_capacity;
@@ -23,10 +23,15 @@ static void worker(void* param)
 	} while(*(int*)param && -1 != r);
 }
 
-static int init()
+static int init(int affinity)
 {
+	struct thread_affinity_t cpus;
 	int cpu = (int)system_getcpucount();
-	s_pool = thread_pool_create(cpu, 1, 64);
+
+	// pool worker slot i bind to cpu by policy, aio workers are the first cpu threads
+	memset(&cpus, 0, sizeof(cpus));
+	cpus.policy = affinity;
+	s_pool = thread_pool_create2(cpu, 1, 64, &cpus);
 	aio_socket_init(cpu);
 
 	s_running = 1;
@@ -53,12 +58,14 @@ static int handler(void* param, http_session_t* session, const char* method, con
 	return http_server_send(session, 200, msg, strlen(msg), NULL, NULL);
 }
 
-void http_benchmark()
+/// @param[in] affinity THREAD_AFFINITY_NONE/THREAD_AFFINITY_COMPACT/THREAD_AFFINITY_SCATTER, compare the same load with different placement
+void http_benchmark2(int affinity)
 {
 	void *http;
 	const char* hello = "Hello World!";
 
-	init();
+	printf("http benchmark: port 8888, affinity: %s\n", THREAD_AFFINITY_COMPACT == affinity ? "compact" : (THREAD_AFFINITY_SCATTER == affinity ? "scatter" : "none"));
+	init(affinity);
 
 	http = http_server_create(NULL, 8888);
 	http_server_set_handler(http, handler, (void*)hello);
@@ -69,4 +76,9 @@ void http_benchmark()
 	}
 }
 
+void http_benchmark()
+{
+	http_benchmark2(THREAD_AFFINITY_NONE);
+}
+
 #endif
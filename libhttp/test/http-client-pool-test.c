@@ -0,0 +1,306 @@
+#include "sockutil.h"
+#include "sys/thread.h"
+#include "sys/system.h"
+#include "aio-worker.h"
+#include "http-client.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// connection pool on loopback(aio mode, maxActive = 1):
+// 1. keep-alive connection is reused by the next request(of any client)
+// 2. requests wait for the busy connection in FIFO order
+// 3. reused connection closed by peer without response: the request is resent on a new connection
+// 4. idle connection is closed after idleTimeout
+// 5. pipelining(depth 3): requests in flight on one connection, replies in request order
+// 6. pipelined requests behind a Connection: close reply are resent on a new connection exactly once
+
+#define POOL_IDLE_TIMEOUT 500
+#define POOL_PIPELINE 3
+
+struct http_client_test_pool_request_t
+{
+	http_client_t* http;
+	const char* uri;
+	int code;
+};
+
+static struct
+{
+	socket_t listen;
+	volatile int running;
+	volatile int accepts; // connections accepted
+	volatile int closed; // connections closed by client
+	volatile int drop; // close the reused connection on the next request without response
+	volatile int drops;
+	volatile int batch; // don't reply until the connection received batch requests(pipelined)
+	volatile int batched; // max requests received before reply
+	const char* close; // reply Connection: close and close the connection on the uri
+	volatile uint64_t clock; // client closed time
+	volatile uint64_t replied; // the last onreply time
+
+	char uris[32][32]; // served requests
+	int conns[32]; // served request connection index
+	volatile int requests;
+
+	const char* replies[32]; // onreply order
+	volatile int onreply;
+} s_pool;
+
+static int http_client_test_pool_count(const char* buffer)
+{
+	int n;
+	for (n = 0; NULL != (buffer = strstr(buffer, "\r\n\r\n")); n++)
+		buffer += 4;
+	return n;
+}
+
+/// serve one connection, until peer closed, drop or Connection: close
+static void http_client_test_pool_serve(socket_t client)
+{
+	int r, n, served, close;
+	char buffer[2048];
+	char reply[128];
+	char *p, *uri;
+
+	n = 0;
+	served = 0;
+	while (s_pool.running)
+	{
+		r = socket_recv_by_time(client, buffer + n, sizeof(buffer) - n - 1, 0, 100);
+		if (SOCKET_TIMEDOUT == r)
+			continue;
+		if (r <= 0)
+		{
+			s_pool.clock = system_clock();
+			s_pool.closed++;
+			break;
+		}
+
+		n += r;
+		buffer[n] = 0;
+		r = http_client_test_pool_count(buffer);
+		s_pool.batched = r > s_pool.batched ? r : s_pool.batched;
+		if (r < s_pool.batch)
+			continue; // wait for the pipelined requests
+		s_pool.batch = 0;
+
+		while (NULL != (p = strstr(buffer, "\r\n\r\n")))
+		{
+			if (s_pool.drop && served > 0)
+			{
+				s_pool.drop = 0;
+				s_pool.drops++;
+				return;
+			}
+
+			// GET /uri HTTP/1.1
+			uri = strchr(buffer, ' ') + 1;
+			*strchr(uri, ' ') = 0;
+			assert(s_pool.requests < sizeof(s_pool.uris) / sizeof(s_pool.uris[0]));
+			snprintf(s_pool.uris[s_pool.requests], sizeof(s_pool.uris[0]), "%s", uri);
+			s_pool.conns[s_pool.requests] = s_pool.accepts;
+			s_pool.requests++;
+
+			close = s_pool.close && 0 == strcmp(s_pool.close, uri);
+			r = snprintf(reply, sizeof(reply), "HTTP/1.1 200 OK\r\n%sContent-Length: %d\r\n\r\n%s", close ? "Connection: close\r\n" : "", (int)strlen(uri), uri);
+			assert(r == socket_send_all_by_time(client, reply, r, 0, 1000));
+			served++;
+			if (close)
+				return; // the other pipelined requests are dropped without reply
+
+			p += 4;
+			n -= (int)(p - buffer);
+			memmove(buffer, p, n + 1);
+		}
+	}
+}
+
+static int STDCALL http_client_test_pool_server(void* param)
+{
+	socket_t client;
+	socklen_t len;
+	struct sockaddr_storage ss;
+	(void)param;
+
+	// maxActive = 1: one connection at a time
+	while (s_pool.running)
+	{
+		if (1 != socket_select_read(s_pool.listen, 100))
+			continue;
+
+		client = socket_accept(s_pool.listen, &ss, &len);
+		assert(socket_invalid != client);
+		s_pool.accepts++;
+		http_client_test_pool_serve(client);
+		socket_close(client);
+	}
+	return 0;
+}
+
+static void http_client_test_pool_onreply(void* param, int code)
+{
+	size_t bytes;
+	const void* content;
+	struct http_client_test_pool_request_t* req;
+	req = (struct http_client_test_pool_request_t*)param;
+
+	req->code = code;
+	if (0 == code)
+	{
+		// body is the request uri
+		assert(0 == http_client_get_content(req->http, &content, &bytes));
+		assert(bytes == strlen(req->uri) && 0 == memcmp(content, req->uri, bytes));
+	}
+	s_pool.replied = system_clock();
+	s_pool.replies[s_pool.onreply] = req->uri;
+	s_pool.onreply++;
+}
+
+static void http_client_test_pool_wait(volatile int* v, int n)
+{
+	uint64_t clock;
+	clock = system_clock();
+	while (*v < n && system_clock() - clock < 5000)
+		system_sleep(5);
+	assert(*v >= n);
+}
+
+static void http_client_test_pool_get(struct http_client_test_pool_request_t* req, http_client_t* http, const char* uri)
+{
+	req->http = http;
+	req->uri = uri;
+	req->code = -1;
+	assert(0 == http_client_get(http, uri, NULL, 0, http_client_test_pool_onreply, req));
+}
+
+static int http_client_test_pool_served(const char* uri)
+{
+	int i, n;
+	for (n = i = 0; i < s_pool.requests; i++)
+		n += 0 == strcmp(uri, s_pool.uris[i]) ? 1 : 0;
+	return n;
+}
+
+static void http_client_test_pool_pipeline(u_short port)
+{
+	int i, accepts, requests;
+	http_client_t* https[4];
+	struct http_client_test_pool_request_t reqs[4];
+	static const char* s_uris[] = { "/p1", "/p2", "/p3", "/c1", "/c2", "/c3", "/c4" };
+
+	http_client_pool_pipeline(POOL_PIPELINE);
+	for (i = 0; i < 4; i++)
+		https[i] = http_client_create("127.0.0.1", port, 0);
+
+	// 5. server reply after all 3 requests received: pipelined on one connection, in order
+	s_pool.onreply = 0;
+	s_pool.batched = 0;
+	s_pool.batch = POOL_PIPELINE;
+	accepts = s_pool.accepts;
+	requests = s_pool.requests;
+	for (i = 0; i < 3; i++)
+		http_client_test_pool_get(&reqs[i], https[i], s_uris[i]);
+	http_client_test_pool_wait(&s_pool.onreply, 3);
+	assert(POOL_PIPELINE == s_pool.batched && accepts + 1 == s_pool.accepts && requests + 3 == s_pool.requests);
+	for (i = 0; i < 3; i++)
+	{
+		assert(0 == reqs[i].code && reqs[i].uri == s_pool.replies[i]);
+		assert(0 == strcmp(s_uris[i], s_pool.uris[requests + i]) && s_pool.accepts == s_pool.conns[requests + i]);
+	}
+
+	// 6. /c2 reply Connection: close, /c3 have been sent(pipelined) without reply, /c4 wait for the connection
+	s_pool.onreply = 0;
+	s_pool.batch = POOL_PIPELINE;
+	s_pool.close = "/c2";
+	accepts = s_pool.accepts;
+	requests = s_pool.requests;
+	for (i = 0; i < 4; i++)
+		http_client_test_pool_get(&reqs[i], https[i], s_uris[3 + i]);
+	http_client_test_pool_wait(&s_pool.onreply, 4);
+	system_sleep(200); // no more request
+	assert(4 == s_pool.onreply && requests + 4 == s_pool.requests);
+	for (i = 0; i < 4; i++)
+	{
+		assert(0 == reqs[i].code && reqs[i].uri == s_pool.replies[i]);
+		assert(1 == http_client_test_pool_served(s_uris[3 + i])); // exactly once
+		assert(s_pool.conns[requests + i] == accepts + (i < 2 ? 0 : 1)); // keep-alive connection of 5, then a new one
+	}
+	assert(accepts + 1 == s_pool.accepts);
+	s_pool.close = NULL;
+
+	for (i = 0; i < 4; i++)
+		http_client_destroy(https[i]);
+	http_client_pool_pipeline(1); // default
+}
+
+void http_client_test_pool(void)
+{
+	int i;
+	u_short port;
+	pthread_t thread;
+	char ip[SOCKET_ADDRLEN];
+	http_client_t *http1, *http2;
+	struct http_client_test_pool_request_t reqs[3];
+
+	socket_init();
+	aio_worker_init(2);
+	http_client_pool_config(1, 16, POOL_IDLE_TIMEOUT);
+
+	memset(&s_pool, 0, sizeof(s_pool));
+	s_pool.listen = socket_tcp_listen("127.0.0.1", 0, SOMAXCONN);
+	assert(socket_invalid != s_pool.listen);
+	socket_getname(s_pool.listen, ip, &port);
+	s_pool.running = 1;
+	thread_create(&thread, http_client_test_pool_server, NULL);
+
+	http1 = http_client_create("127.0.0.1", port, 0);
+	http2 = http_client_create("127.0.0.1", port, 0);
+
+	// 1. keep-alive: the second client borrow the same connection
+	http_client_test_pool_get(&reqs[0], http1, "/a");
+	http_client_test_pool_wait(&s_pool.onreply, 1);
+	http_client_test_pool_get(&reqs[1], http2, "/b");
+	http_client_test_pool_wait(&s_pool.onreply, 2);
+	assert(0 == reqs[0].code && 0 == reqs[1].code);
+	assert(1 == s_pool.accepts && 2 == s_pool.requests && 1 == s_pool.conns[1]);
+
+	// 2. maxActive: waiters served in request order on the only connection
+	s_pool.onreply = 0;
+	http_client_test_pool_get(&reqs[0], http1, "/1");
+	http_client_test_pool_get(&reqs[1], http2, "/2");
+	http_client_test_pool_get(&reqs[2], http1, "/3");
+	http_client_test_pool_wait(&s_pool.onreply, 3);
+	for (i = 0; i < 3; i++)
+	{
+		assert(0 == reqs[i].code && reqs[i].uri == s_pool.replies[i]);
+		assert(0 == strcmp(reqs[i].uri, s_pool.uris[2 + i]) && 1 == s_pool.conns[2 + i]);
+	}
+	assert(1 == s_pool.accepts && 5 == s_pool.requests);
+
+	// 3. peer close the reused connection: resend once on a new connection
+	s_pool.onreply = 0;
+	s_pool.drop = 1;
+	http_client_test_pool_get(&reqs[0], http1, "/r");
+	http_client_test_pool_wait(&s_pool.onreply, 1);
+	assert(0 == reqs[0].code && 1 == s_pool.drops);
+	assert(2 == s_pool.accepts && 6 == s_pool.requests && 2 == s_pool.conns[5] && 0 == strcmp("/r", s_pool.uris[5]));
+
+	// 4. idle timeout: client close the keep-alive connection
+	assert(0 == s_pool.closed);
+	http_client_test_pool_wait(&s_pool.closed, 1);
+	assert(s_pool.clock - s_pool.replied + 50 /*timer resolution*/ >= POOL_IDLE_TIMEOUT);
+
+	// 5/6. pipelining
+	http_client_test_pool_pipeline(port);
+
+	http_client_destroy(http1);
+	http_client_destroy(http2);
+	s_pool.running = 0;
+	thread_destroy(thread);
+	socket_close(s_pool.listen);
+	aio_worker_clean(2);
+	http_client_pool_config(0, 16, 0); // default
+	socket_cleanup();
+	printf("http client pool test ok\n");
+}
@@ -0,0 +1,197 @@
+#include "sockutil.h"
+#include "sys/thread.h"
+#include "sys/system.h"
+#include "aio-worker.h"
+#include "http-client.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// stream mode pause/resume on loopback(aio mode):
+// 1. ondata pause on the last body data is ignored, onreply follow immediately
+// 2. the keep-alive connection is reused after that(don't stay paused)
+// 3. ondata pause in the middle of the body hold the response until http_client_resume
+// 4. chunked: pause on the final chunk(with the last-chunk) is ignored too, pause on the other chunks hold the response
+
+#define STREAM_BODY	"0123456789"
+
+static struct
+{
+	socket_t listen;
+	volatile int running;
+
+	volatile int ondata;
+	volatile int onreply;
+	volatile int code;
+	size_t bytes;
+	size_t content; // http_client_get_content in onreply
+	char body[64];
+	http_client_t* http;
+} s_stream;
+
+static int STDCALL http_client_test_stream_server(void* param)
+{
+	int r, n;
+	char req[1024];
+	socket_t client;
+	socklen_t len;
+	struct sockaddr_storage ss;
+	static const char* s_reply = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n";
+	static const char* s_chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\n01234\r\n";
+	static const char* s_final = "5\r\n56789\r\n0\r\n\r\n"; // final chunk and last-chunk
+	(void)param;
+
+	client = socket_accept(s_stream.listen, &ss, &len);
+	assert(socket_invalid != client);
+	while (s_stream.running)
+	{
+		// one request per recv(test client don't pipeline)
+		n = socket_recv_by_time(client, req, sizeof(req) - 1, 0, 100);
+		if (SOCKET_TIMEDOUT == n)
+			continue;
+		if (n <= 0)
+			break;
+		req[n] = 0;
+
+		if (strstr(req, "GET /chunked "))
+		{
+			snprintf(req, sizeof(req), "%s%s", s_chunked, s_final);
+			r = socket_send_all_by_time(client, req, strlen(req), 0, 1000);
+			assert(r == (int)strlen(s_chunked) + (int)strlen(s_final));
+		}
+		else if (strstr(req, "GET /chunked-split "))
+		{
+			r = socket_send_all_by_time(client, s_chunked, strlen(s_chunked), 0, 1000);
+			system_sleep(200);
+			r += socket_send_all_by_time(client, s_final, strlen(s_final), 0, 1000);
+			assert(r == (int)strlen(s_chunked) + (int)strlen(s_final));
+		}
+		else if (strstr(req, "GET /split "))
+		{
+			// header + half body, then the other half later
+			r = socket_send_all_by_time(client, s_reply, strlen(s_reply), 0, 1000);
+			r += socket_send_all_by_time(client, STREAM_BODY, 5, 0, 1000);
+			system_sleep(200);
+			r += socket_send_all_by_time(client, STREAM_BODY + 5, 5, 0, 1000);
+			assert(r == (int)strlen(s_reply) + 10);
+		}
+		else
+		{
+			memcpy(req, s_reply, strlen(s_reply));
+			memcpy(req + strlen(s_reply), STREAM_BODY, 10);
+			r = socket_send_all_by_time(client, req, strlen(s_reply) + 10, 0, 1000);
+			assert(r == (int)strlen(s_reply) + 10);
+		}
+	}
+
+	socket_close(client);
+	return 0;
+}
+
+static int http_client_test_stream_ondata(void* param, const void* data, size_t bytes)
+{
+	(void)param;
+	assert(s_stream.bytes + bytes <= sizeof(s_stream.body));
+	memcpy(s_stream.body + s_stream.bytes, data, bytes);
+	s_stream.bytes += bytes;
+	s_stream.ondata++;
+	return 1; // always pause
+}
+
+static void http_client_test_stream_onreply(void* param, int code)
+{
+	size_t bytes;
+	const void* content;
+	(void)param;
+
+	// stream mode: body have been passed to ondata
+	bytes = (size_t)-1;
+	if (0 == code)
+		assert(0 == http_client_get_content(s_stream.http, &content, &bytes));
+	s_stream.content = bytes;
+	s_stream.code = code;
+	s_stream.onreply++;
+}
+
+static void http_client_test_stream_wait(volatile int* v, int n)
+{
+	uint64_t clock;
+	clock = system_clock();
+	while (*v < n && system_clock() - clock < 5000)
+		system_sleep(5);
+	assert(*v >= n);
+}
+
+static void http_client_test_stream_get(const char* uri)
+{
+	s_stream.ondata = s_stream.onreply = 0;
+	s_stream.bytes = 0;
+	s_stream.content = 0;
+	s_stream.code = -1;
+	assert(0 == http_client_get(s_stream.http, uri, NULL, 0, http_client_test_stream_onreply, NULL));
+}
+
+void http_client_test_stream(void)
+{
+	char ip[SOCKET_ADDRLEN];
+	u_short port;
+	pthread_t thread;
+
+	socket_init();
+	aio_worker_init(2);
+
+	s_stream.listen = socket_tcp_listen("127.0.0.1", 0, SOMAXCONN);
+	assert(socket_invalid != s_stream.listen);
+	socket_getname(s_stream.listen, ip, &port);
+	s_stream.running = 1;
+	thread_create(&thread, http_client_test_stream_server, NULL);
+
+	s_stream.http = http_client_create("127.0.0.1", port, 0);
+	http_client_set_ondata(s_stream.http, http_client_test_stream_ondata);
+
+	// pause on the last data: the response completed anyway
+	http_client_test_stream_get("/small");
+	http_client_test_stream_wait(&s_stream.onreply, 1);
+	assert(0 == s_stream.code && 1 == s_stream.ondata && 10 == s_stream.bytes && 0 == s_stream.content);
+	assert(0 == memcmp(s_stream.body, STREAM_BODY, 10));
+
+	// same connection again(the first one isn't paused)
+	http_client_test_stream_get("/small");
+	http_client_test_stream_wait(&s_stream.onreply, 1);
+	assert(0 == s_stream.code && 1 == s_stream.ondata && 10 == s_stream.bytes && 0 == s_stream.content);
+	http_client_resume(s_stream.http); // nothing paused
+
+	// pause in the middle: no more data until resume
+	http_client_test_stream_get("/split");
+	http_client_test_stream_wait(&s_stream.ondata, 1);
+	system_sleep(500);
+	assert(1 == s_stream.ondata && 5 == s_stream.bytes && 0 == s_stream.onreply);
+	http_client_resume(s_stream.http);
+	http_client_test_stream_wait(&s_stream.onreply, 1);
+	assert(0 == s_stream.code && 2 == s_stream.ondata && 10 == s_stream.bytes && 0 == s_stream.content);
+	assert(0 == memcmp(s_stream.body, STREAM_BODY, 10));
+
+	// chunked: the whole response in one recv, pause on the final chunk is ignored
+	http_client_test_stream_get("/chunked");
+	http_client_test_stream_wait(&s_stream.onreply, 1);
+	assert(0 == s_stream.code && 1 == s_stream.ondata && 10 == s_stream.bytes && 0 == s_stream.content);
+	assert(0 == memcmp(s_stream.body, STREAM_BODY, 10));
+
+	// chunked: pause on the first chunk hold the response, pause on the final chunk is ignored
+	http_client_test_stream_get("/chunked-split");
+	http_client_test_stream_wait(&s_stream.ondata, 1);
+	system_sleep(500);
+	assert(1 == s_stream.ondata && 5 == s_stream.bytes && 0 == s_stream.onreply);
+	http_client_resume(s_stream.http);
+	http_client_test_stream_wait(&s_stream.onreply, 1);
+	assert(0 == s_stream.code && 2 == s_stream.ondata && 10 == s_stream.bytes && 0 == s_stream.content);
+	assert(0 == memcmp(s_stream.body, STREAM_BODY, 10));
+
+	http_client_destroy(s_stream.http);
+	s_stream.running = 0;
+	thread_destroy(thread);
+	socket_close(s_stream.listen);
+	aio_worker_clean(2);
+	socket_cleanup();
+	printf("http client stream test ok\n");
+}
@@ -121,9 +121,142 @@ static void sip_response_test(void)
 	http_parser_destroy(parser);
 }
 
+// pipelined responses: chunked(extension, trailer), Content-Length, chunked, no body
+static const char* s_pipeline = "HTTP/1.1 200 OK\r\n" \
+	"Transfer-Encoding: chunked\r\n" \
+	"\r\n" \
+	"5;name=value\r\nhello\r\n7\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n" \
+	"HTTP/1.1 201 Created\r\n" \
+	"Content-Length: 6\r\n" \
+	"\r\n" \
+	"abcdef" \
+	"HTTP/1.1 202 Accepted\r\n" \
+	"Transfer-Encoding: chunked\r\n" \
+	"\r\n" \
+	"a\r\n0123456789\r\n0\r\n\r\n" \
+	"HTTP/1.1 204 No Content\r\n" \
+	"\r\n";
+
+static const int s_pipeline_code[] = { 200, 201, 202, 204 };
+static const char* s_pipeline_body[] = { "hello, world", "abcdef", "0123456789", "" };
+
+/// feed s_pipeline step bytes per input, the remain bytes of a finished response feed the next one
+static void http_pipeline_parse(http_parser_t* parser, size_t step)
+{
+	int r, count;
+	size_t i, n, len, bytes;
+
+	count = 0;
+	len = strlen(s_pipeline);
+	for (i = 0; i < len; i += n - bytes)
+	{
+		n = step < len - i ? step : len - i;
+		bytes = n;
+		r = http_parser_input(parser, s_pipeline + i, &bytes);
+		assert(r >= 0 && bytes <= n);
+		if (r > 0)
+		{
+			assert(0 == bytes);
+			continue; // need more data
+		}
+
+		// one byte a time: the last byte finish the response, nothing remain
+		assert(1 != step || 0 == bytes);
+		assert(count < sizeof(s_pipeline_code) / sizeof(s_pipeline_code[0]));
+		assert(s_pipeline_code[count] == http_get_status_code(parser));
+		assert((int64_t)strlen(s_pipeline_body[count]) == http_get_content_length(parser));
+		assert(0 == memcmp(s_pipeline_body[count], http_get_content(parser), strlen(s_pipeline_body[count])));
+		http_parser_clear(parser);
+		count++;
+	}
+	assert(count == sizeof(s_pipeline_code) / sizeof(s_pipeline_code[0]));
+}
+
+static void http_pipeline_test(void)
+{
+	size_t step;
+	http_parser_t* parser;
+
+	parser = http_parser_create(HTTP_PARSER_CLIENT);
+	for (step = 1; step <= strlen(s_pipeline); step++)
+		http_pipeline_parse(parser, step);
+	http_parser_destroy(parser);
+}
+
+/// stream mode: fetch body after every input, the parser don't keep the fetched body
+static void http_fetch_parse(http_parser_t* parser, size_t step)
+{
+	int r, count;
+	char body[64];
+	const void* data;
+	size_t i, n, m, k, len, bytes;
+
+	m = 0;
+	count = 0;
+	len = strlen(s_pipeline);
+	for (i = 0; i < len; i += n - bytes)
+	{
+		n = step < len - i ? step : len - i;
+		bytes = n;
+		r = http_parser_input(parser, s_pipeline + i, &bytes);
+		assert(r >= 0 && bytes <= n);
+		if (0 == http_parser_fetch(parser, &data, &k))
+		{
+			assert(m + k <= sizeof(body));
+			memcpy(body + m, data, k);
+			m += k;
+		}
+		if (r > 0)
+			continue; // need more data
+
+		assert(count < sizeof(s_pipeline_code) / sizeof(s_pipeline_code[0]));
+		assert(s_pipeline_code[count] == http_get_status_code(parser));
+		assert(m == strlen(s_pipeline_body[count]) && 0 == memcmp(s_pipeline_body[count], body, m));
+		assert(0 == http_get_content_length(parser)); // all fetched
+		http_parser_clear(parser);
+		count++;
+		m = 0;
+	}
+	assert(count == sizeof(s_pipeline_code) / sizeof(s_pipeline_code[0]));
+}
+
+static void http_fetch_test(void)
+{
+	size_t n, step;
+	const void* data;
+	http_parser_t* parser;
+	static const char* s_large = "HTTP/1.1 200 OK\r\n" \
+		"Content-Length: 5000000000\r\n" \
+		"\r\n" \
+		"0123456789";
+
+	parser = http_parser_create(HTTP_PARSER_CLIENT);
+	n = 5;
+	assert(1 == http_parser_input(parser, s_large, &n));
+	assert(-1 == http_parser_fetch(parser, &data, &n)); // header don't finished
+	http_parser_clear(parser);
+
+	for (step = 1; step <= strlen(s_pipeline); step++)
+		http_fetch_parse(parser, step);
+
+	// 64-bit Content-Length: buffered body only after fetch
+	n = strlen(s_large);
+	assert(0 < http_parser_input(parser, s_large, &n));
+	assert(5000000000LL == http_get_content_length(parser));
+	assert(0 == http_parser_fetch(parser, &data, &n) && 10 == n && 0 == memcmp(data, "0123456789", 10));
+	assert(5000000000LL - 10 == http_get_content_length(parser));
+	n = 6;
+	assert(0 < http_parser_input(parser, "abcdef", &n));
+	assert(0 == http_parser_fetch(parser, &data, &n) && 6 == n && 0 == memcmp(data, "abcdef", 6));
+	assert(5000000000LL - 16 == http_get_content_length(parser));
+	http_parser_destroy(parser);
+}
+
 void http_parser_test(void)
 {
 	http_request_test();
 	rtsp_response_test();
 	sip_response_test();
+	http_pipeline_test();
+	http_fetch_test();
 }
@@ -1,9 +1,18 @@
 #include <stdio.h>
+#include <string.h>
+#include "thread-pool.h"
 
 void http_benchmark();
+void http_benchmark2(int affinity);
 
 int main(int argc, char* argv[])
 {
-	http_benchmark();
+	// benchmark [none|compact|scatter]
+	if (argc > 1 && 0 == strcmp(argv[1], "compact"))
+		http_benchmark2(THREAD_AFFINITY_COMPACT);
+	else if (argc > 1 && 0 == strcmp(argv[1], "scatter"))
+		http_benchmark2(THREAD_AFFINITY_SCATTER);
+	else
+		http_benchmark();
 	return 0;
 }
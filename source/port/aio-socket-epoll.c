@@ -1,4 +1,9 @@
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // recvmmsg/sendmmsg
+#endif
 #include "aio-socket.h"
+#include "sys/sock.h" // UDP_SEGMENT/UDP_GRO
+#include "slab-cache.h"
 #include <sys/epoll.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -8,8 +13,33 @@
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
-
-//#define MAX_EVENT 64
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#include <netinet/udp.h>
+
+#define MAX_EVENT 64
+#define MAX_SPECULATIVE 16 // max inline completions per aio_socket_process call
+#define MAX_CACHE 1024 // max cached epoll_context per thread
+#define MAX_MMSG 64 // max datagrams per recvmmsg/sendmmsg
+#define MAX_SENDFILE (1 << 20) // max bytes per sendfile call, blocking socket don't hold the epoll thread too long
+
+#define EPOLL_SPECULATIVE 2 // read/write flags: try in user thread(MSG_DONTWAIT), defer callback
+#define EPOLL_EDGE 3 // read/write flags: edge-triggered socket in epoll_wait thread, return EAGAIN without callback
+
+#define EPOLL_WOULDBLOCK(err) (EAGAIN == (err) || EWOULDBLOCK == (err))
+
+// MSG_ZEROCOPY: ctx->state EPOLLERR - wait kernel release the buffer(socket error queue notification)
+#define EPOLL_ZEROCOPY EPOLLPRI // claimed event: zero-copy send completed(never request EPOLLPRI)
+// ctx->state: atomic state word, changed by CAS only(no lock on the common path)
+// EPOLLIN/EPOLLOUT: request pending, EPOLLERR: zero-copy notification pending(see MSG_ZEROCOPY)
+#define EPOLL_STATE_EVENTS (EPOLLIN | EPOLLOUT | EPOLLERR)
+#define EPOLL_STATE_READY(flag) ((uint32_t)(flag) << 16) // edge mode: EPOLLIN/EPOLLOUT edge without pending request, or unknown after last request
+#define EPOLL_STATE_INIT 0x01000000 // epoll_ctl add
+#define EPOLL_STATE_DESTROY 0x02000000 // edge mode: aio_socket_destroy called, remove from epoll on EPOLLHUP
+
+#if !defined(MSG_ZEROCOPY)
+#define MSG_ZEROCOPY 0 // old glibc, zero-copy disabled(SO_ZEROCOPY)
+#endif
 
 // http://linux.die.net/man/2/epoll_wait see Notes
 // For a discussion of what may happen if a file descriptor in an epoll instance being monitored by epoll_wait() is closed in another thread, see select(2). 
@@ -32,8 +62,33 @@
 // SIGPIPE
 // 1. send after shutdown(SHUT_WR)
 
-static int s_epoll = -1;
+static int* s_epoll = NULL; // epoll instance per shard
+static int s_shards = 0; // epoll instance count, 1-shared by all threads
 static int s_threads = 0;
+static int s_events = 1; // max events per epoll_wait
+static uint32_t s_shard_thread = 0; // next thread shard
+static uint32_t s_shard_socket = 0; // next socket shard(round-robin)
+static pthread_key_t s_shard_key; // calling thread shard + 1, 0-unbound
+static int s_flags = 0; // AIO_SOCKET_XXX
+static pthread_key_t s_speculative_key; // struct epoll_speculative, aio_socket_process thread only
+static slab_cache_t* s_cache = NULL; // struct epoll_context
+
+// AIO_SOCKET_SPECULATIVE: recv/send issued in callback are tried at once,
+// completion callback is deferred until the current callback returned(no recursion)
+struct epoll_speculative
+{
+	int active; // in aio_socket_process dispatch
+	int count;
+	struct
+	{
+		struct epoll_context* ctx;
+		int event; // EPOLLIN/EPOLLOUT
+		int code;
+		size_t bytes;
+		aio_onrecv proc; // aio_onrecv/aio_onsend
+		void* param;
+	} completed[MAX_SPECULATIVE];
+};
 
 struct epoll_context_accept
 {
@@ -85,6 +140,23 @@ struct epoll_context_send_v
 	socklen_t addrlen;
 };
 
+struct epoll_context_sendfile
+{
+	aio_onsend proc;
+	void *param;
+	int fd;
+	off_t offset;
+	size_t bytes;
+};
+
+struct epoll_context_mmsg
+{
+	aio_onmmsg proc;
+	void *param;
+	struct aio_socket_mmsg_t *msgs;
+	int n;
+};
+
 struct epoll_context_recvfrom
 {
 	aio_onrecvfrom proc;
@@ -103,12 +175,27 @@ struct epoll_context_recvfrom_v
 
 struct epoll_context
 {
-	pthread_spinlock_t locker; // memory alignment, see more about Apple Developer spinlock
-	struct epoll_event ev;
+	volatile uint32_t state; // EPOLL_STATE_XXX
+	struct epoll_event ev; // oneshot mode registration flags(EPOLLONESHOT|EPOLLRDHUP)
 	socket_t socket;
 	volatile int32_t ref;
 	int own;
-	int init; // epoll_ctl add
+	int epoll; // pinned epoll instance(shard)
+	volatile int32_t speculative; // EPOLLIN/EPOLLOUT completed inline, wait for callback
+	int edge; // 1-EPOLLET registered once(aio_socket_edge_triggered)
+
+	struct
+	{
+		int enable; // 0-unknown, 1-SO_ZEROCOPY, -1-don't support
+		volatile int wait; // zero-copy send in progress
+		volatile int released; // kernel released the buffer of notification id
+		uint32_t next; // next notification id(kernel per-socket counter)
+		uint32_t id; // notification id of the send
+		size_t bytes;
+		struct iovec iov; // for aio_socket_send_zc
+		aio_onsend proc;
+		void* param;
+	} zc;
 
 	aio_ondestroy ondestroy;
 	void* param;
@@ -123,6 +210,7 @@ struct epoll_context
 		struct epoll_context_recv_v recv_v;
 		struct epoll_context_recvfrom recvfrom;
 		struct epoll_context_recvfrom_v recvfrom_v;
+		struct epoll_context_mmsg recvmmsg;
 	} in;
 
 	union
@@ -130,185 +218,641 @@ struct epoll_context
 		struct epoll_context_connect connect;
 		struct epoll_context_send send;
 		struct epoll_context_send_v send_v;
+		struct epoll_context_sendfile sendfile;
+		struct epoll_context_mmsg sendmmsg;
 	} out;
 };
 
 #define EPollCtrl(ctx, flag) do {				\
-	int r;										\
-	__sync_add_and_fetch_4(&ctx->ref, 1);		\
-	pthread_spin_lock(&ctx->locker);			\
-	ctx->ev.events |= flag;						\
-	if(0 == ctx->init)							\
-	{											\
-		r = epoll_ctl(s_epoll, EPOLL_CTL_ADD, ctx->socket, &ctx->ev);	\
-		ctx->init = (0 == r ? 1 : 0);			\
-	}											\
-	else										\
-	{											\
-		r = epoll_ctl(s_epoll, EPOLL_CTL_MOD, ctx->socket, &ctx->ev);	\
-	}											\
-	if(0 != r)									\
-	{											\
-		ctx->ev.events &= ~flag;				\
-		__sync_sub_and_fetch_4(&ctx->ref, 1);	\
-	}											\
-	pthread_spin_unlock(&ctx->locker);			\
-	if(0 == r) return 0;						\
+	if(0 == (ctx->edge ? epoll_edge_ctrl(ctx, flag) : epoll_oneshot_ctrl(ctx, flag)))	\
+		return 0;								\
 } while(0)
 
 #define EPollIn(ctx, callback)	ctx->read = callback; EPollCtrl(ctx, EPOLLIN)
 #define EPollOut(ctx, callback)	ctx->write = callback; EPollCtrl(ctx, EPOLLOUT)
 
+static int epoll_edge_ctrl(struct epoll_context* ctx, uint32_t flag);
+static int epoll_oneshot_ctrl(struct epoll_context* ctx, uint32_t flag);
+
+/// @return state before change
+static inline uint32_t epoll_state_change(struct epoll_context* ctx, uint32_t clear, uint32_t set)
+{
+	uint32_t old;
+	do
+	{
+		old = ctx->state;
+	} while(!__sync_bool_compare_and_swap(&ctx->state, old, (old & ~clear) | set));
+	return old;
+}
+
+/// oneshot mode: register the pending events, again if other thread add event during epoll_ctl
+/// e.g. thread-1 claim EPOLLIN then MOD(EPOLLOUT), thread-2 add EPOLLIN and MOD(EPOLLIN|EPOLLOUT) before thread-1 MOD
+/// @param[in] state state word after change
+/// @return 0-ok, -1-error(errno)
+static int epoll_oneshot_ctl(struct epoll_context* ctx, int op, uint32_t state)
+{
+	struct epoll_event ev;
+	ev.data.ptr = ctx;
+	for(;;)
+	{
+		ev.events = ctx->ev.events | (state & EPOLL_STATE_EVENTS);
+		if(0 != epoll_ctl(ctx->epoll, op, ctx->socket, &ev))
+			return -1;
+
+		// the last epoll_ctl always see the latest state
+		op = EPOLL_CTL_MOD;
+		state = __sync_fetch_and_or(&ctx->state, 0);
+		if(0 == (state & EPOLL_STATE_EVENTS & ~ev.events))
+			return 0;
+	}
+}
+
+/// oneshot mode request: add event to state word, then add/modify epoll registration
+/// INIT bit is kept on error: the socket maybe registered by a concurrent request, the next request retry EPOLL_CTL_ADD on ENOENT
+/// @return 0-ok, -1-error(errno)
+static int epoll_oneshot_ctrl(struct epoll_context* ctx, uint32_t flag)
+{
+	int r, op;
+	uint32_t old;
+
+	__sync_add_and_fetch_4(&ctx->ref, 1);
+	old = epoll_state_change(ctx, 0, flag | EPOLL_STATE_INIT);
+	op = (old & EPOLL_STATE_INIT) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	for(;;)
+	{
+		r = epoll_oneshot_ctl(ctx, op, old | flag);
+		if(0 != r && ENOENT == errno && EPOLL_CTL_MOD == op)
+			op = EPOLL_CTL_ADD; // other thread EPOLL_CTL_ADD in progress or failed, add it by self
+		else if(0 != r && EEXIST == errno && EPOLL_CTL_ADD == op)
+			op = EPOLL_CTL_MOD; // added by other thread
+		else
+			break;
+	}
+
+	if(0 != r)
+	{
+		r = errno;
+		epoll_state_change(ctx, flag, 0);
+		__sync_sub_and_fetch_4(&ctx->ref, 1);
+		errno = r;
+		return -1;
+	}
+	return 0;
+}
+
 static int aio_socket_release(struct epoll_context* ctx)
 {
 	if( 0 == __sync_sub_and_fetch_4(&ctx->ref, 1) )
 	{
-		if(0 != ctx->init && 0 != epoll_ctl(s_epoll, EPOLL_CTL_DEL, ctx->socket, &ctx->ev))
+		if((EPOLL_STATE_INIT & ctx->state) && 0 != epoll_ctl(ctx->epoll, EPOLL_CTL_DEL, ctx->socket, &ctx->ev))
 		{
-			assert(EBADF == errno); // EBADF: socket close by user
+			assert(EBADF == errno || ENOENT == errno); // EBADF: socket close by user, ENOENT: EPOLL_CTL_ADD failed
 			//		return errno;
 		}
 
 		if(ctx->own)
 			close(ctx->socket);
 
-		pthread_spin_destroy(&ctx->locker);
-
 		if (ctx->ondestroy)
 			ctx->ondestroy(ctx->param);
 
 #if defined(DEBUG) || defined(_DEBUG)
 		memset(ctx, 0xCC, sizeof(*ctx));
 #endif
-		free(ctx);
+		if (s_cache)
+			slab_cache_free(s_cache, ctx);
+		else
+			free(ctx); // release after aio_socket_clean
 	}
 	return 0;
 }
 
 int aio_socket_init(int threads)
 {
+	return aio_socket_init2(threads, 1, 0);
+}
+
+int aio_socket_init2(int threads, int events, int flags)
+{
+	int i, r;
 	s_threads = threads;
+	s_events = events < 1 ? 1 : (events > MAX_EVENT ? MAX_EVENT : events);
+	s_shards = ((AIO_SOCKET_SHARD & flags) && threads > 1) ? threads : 1;
+	s_flags = flags;
+	s_shard_thread = 0;
+	s_shard_socket = 0;
+
+	s_epoll = (int*)malloc(sizeof(int) * s_shards);
+	if (!s_epoll)
+		return ENOMEM;
+
+	for (i = 0; i < s_shards; i++)
+	{
+		// Since Linux 2.6.8, the size argument is ignored, but must be greater than zero
+		s_epoll[i] = epoll_create(10000/*10k*/);
+		if (-1 == s_epoll[i])
+		{
+			r = errno;
+			while (i-- > 0)
+				close(s_epoll[i]);
+			free(s_epoll);
+			s_epoll = NULL;
+			return r;
+		}
+	}
 
-	// Since Linux 2.6.8, the size argument is ignored, but must be greater than zero
-	s_epoll = epoll_create(10000/*10k*/);
-	return -1 == s_epoll ? errno : 0;
+	// connection churn: reuse context in the same thread, don't hit malloc lock
+	s_cache = slab_cache_create(sizeof(struct epoll_context), MAX_CACHE);
+	r = s_cache ? pthread_key_create(&s_speculative_key, free) : ENOMEM;
+	if (0 == r)
+	{
+		r = pthread_key_create(&s_shard_key, NULL);
+		if (0 == r)
+			return 0;
+		pthread_key_delete(s_speculative_key);
+	}
+
+	// unwind
+	if (s_cache)
+		slab_cache_destroy(s_cache);
+	s_cache = NULL;
+	for (i = 0; i < s_shards; i++)
+		close(s_epoll[i]);
+	free(s_epoll);
+	s_epoll = NULL;
+	return r;
 }
 
 int aio_socket_clean(void)
 {
-	if(-1 != s_epoll)
-		close(s_epoll);
+	int i;
+	if (!s_epoll)
+		return 0;
+
+	for (i = 0; i < s_shards; i++)
+		close(s_epoll[i]);
+	free(s_epoll);
+	s_epoll = NULL;
+	pthread_key_delete(s_shard_key);
+	free(pthread_getspecific(s_speculative_key)); // key delete don't call destructor(aio_socket_process in this thread)
+	pthread_key_delete(s_speculative_key);
+	slab_cache_destroy(s_cache);
+	s_cache = NULL;
 	return 0;
 }
 
-int aio_socket_process(int timeout)
+int aio_socket_shards(void)
 {
-	int i, r;
-	uint32_t userevent;
+	return s_shards;
+}
+
+/// @param[in] bind 1-bind calling thread to next shard if it don't have one
+/// @return calling thread shard, -1-unbound thread
+static int epoll_thread_shard(int bind)
+{
+	intptr_t shard;
+	if (s_shards < 2)
+		return 0;
+
+	shard = (intptr_t)pthread_getspecific(s_shard_key);
+	if (0 == shard && bind)
+	{
+		// aio_socket_process thread(s) >= shards, otherwise some shards never be processed
+		shard = (intptr_t)(__sync_fetch_and_add(&s_shard_thread, 1) % (uint32_t)s_shards) + 1;
+		pthread_setspecific(s_shard_key, (void*)shard);
+	}
+	return (int)shard - 1;
+}
+
+/// read MSG_ZEROCOPY notifications from socket error queue(maybe in different threads at the same time)
+static void epoll_zerocopy_drain(struct epoll_context* ctx)
+{
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	struct sock_extended_err* serr;
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_storage))];
+
+	for(;;)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(recvmsg(ctx->socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if(!(SOL_IP == cmsg->cmsg_level && IP_RECVERR == cmsg->cmsg_type) 
+				&& !(SOL_IPV6 == cmsg->cmsg_level && IPV6_RECVERR == cmsg->cmsg_type))
+				continue;
+
+			// notification id range [ee_info, ee_data]
+			serr = (struct sock_extended_err*)CMSG_DATA(cmsg);
+			if(SO_EE_ORIGIN_ZEROCOPY == serr->ee_origin && 0 == serr->ee_errno && ctx->zc.wait
+				&& (uint32_t)(ctx->zc.id - serr->ee_info) <= (uint32_t)(serr->ee_data - serr->ee_info))
+				__sync_fetch_and_or(&ctx->zc.released, 1); // before claim EPOLLERR, see epoll_send_zc
+		}
+	}
+}
+
+/// EPOLLERR maybe MSG_ZEROCOPY notification only
+/// @return 1-socket error, 0-notification only
+static int epoll_zerocopy_error(struct epoll_context* ctx)
+{
+	int err;
+	socklen_t len;
+	epoll_zerocopy_drain(ctx);
+
+	len = sizeof(err);
+	return (0 == getsockopt(ctx->socket, SOL_SOCKET, SO_ERROR, (void*)&err, &len) && 0 == err) ? 0 : 1;
+}
+
+/// claim zero-copy notification event(no socket error)
+/// @return 1-claimed, 0-socket error or hang up
+static int epoll_zerocopy_claim(struct epoll_context* ctx, struct epoll_event* ev)
+{
+	uint32_t old, claim;
+	if(epoll_zerocopy_error(ctx) || (ev->events & (EPOLLHUP | EPOLLRDHUP)))
+		return 0;
+
+	do
+	{
+		old = ctx->state;
+		claim = ev->events & old & (EPOLLIN | EPOLLOUT);
+		if((old & EPOLLERR) && ctx->zc.released)
+			claim |= EPOLLERR;
+	} while(!__sync_bool_compare_and_swap(&ctx->state, old, old & ~claim));
+
+	ev->events = (claim & (EPOLLIN | EPOLLOUT)) | ((claim & EPOLLERR) ? EPOLL_ZEROCOPY : 0);
+	if(old & ~claim & EPOLL_STATE_EVENTS)
+		epoll_oneshot_ctl(ctx, EPOLL_CTL_MOD, old & ~claim);
+	return 1;
+}
+
+static void epoll_edge_claim(struct epoll_event* ev);
+
+// take over the ready in/out event(s) from ctx->state
+// MUST be done for all harvested events before any callback:
+// 1. thread-1 epoll_wait -> events[0] ctx-A EPOLLIN, events[1] ctx-B EPOLLOUT
+// 2. thread-1 ctx-A read callback (long time)
+// 3. thread-2 user call aio_socket_recv(ctx-B) epoll_ctl(MOD) with EPOLLIN|EPOLLOUT, re-arm ctx-B EPOLLOUT
+// 4. thread-3 epoll_wait -> ctx-B EPOLLOUT, write callback and decrement ctx->ref
+// 5. thread-1 handle ctx-B EPOLLOUT twice (ctx-B maybe released)
+static void epoll_event_claim(struct epoll_event* ev)
+{
+	uint32_t userevent, claim;
 	struct epoll_context* ctx;
-	struct epoll_event events[1];
 
-	r = epoll_wait(s_epoll, events, 1, timeout);
-	for(i = 0; i < r; i++)
+	// EPOLLERR: Error condition happened on the associated file descriptor
+	// EPOLLHUP: Hang up happened on the associated file descriptor
+	// EPOLLRDHUP: Stream socket peer closed connection, or shut down writing half of connection. 
+	//			   (This flag is especially useful for writing simple code to detect peer shutdown when using Edge Triggered monitoring.) 
+	int flags = EPOLLERR|EPOLLHUP;
+#if defined(EPOLLRDHUP)
+	flags |= EPOLLRDHUP;
+#endif
+
+	assert(ev->data.ptr);
+	ctx = (struct epoll_context*)ev->data.ptr;
+	assert(ctx->ref > 0);
+	if(ctx->edge)
+	{
+		epoll_edge_claim(ev);
+		return;
+	}
+
+	if((ev->events & EPOLLERR) && ctx->zc.enable > 0 && epoll_zerocopy_claim(ctx, ev))
+		return; // MSG_ZEROCOPY notification
+
+	if(ev->events & flags)
 	{
-		// EPOLLERR: Error condition happened on the associated file descriptor
-		// EPOLLHUP: Hang up happened on the associated file descriptor
-		// EPOLLRDHUP: Stream socket peer closed connection, or shut down writing half of connection. 
-		//			   (This flag is especially useful for writing simple code to detect peer shutdown when using Edge Triggered monitoring.) 
-		int flags = EPOLLERR|EPOLLHUP;
+		// take over all requests
+		if(ctx->state & EPOLLERR)
+			epoll_zerocopy_drain(ctx);
+		userevent = epoll_state_change(ctx, EPOLL_STATE_EVENTS, 0);
+
+		// epoll oneshot don't need change event
+		//if(userevent & (EPOLLIN|EPOLLOUT))
+		//	epoll_ctl(ctx->epoll, EPOLL_CTL_MOD, ctx->socket, &ctx->ev); // endless loop
+
+		// error
+		ev->events = (userevent & (EPOLLIN|EPOLLOUT)) | EPOLLERR | ((userevent & EPOLLERR) ? EPOLL_ZEROCOPY : 0);
+	}
+	else
+	{
+		// claim IN/OUT event
+		// 1. thread-1 aio_socket_send() set ctx->state EPOLLOUT
+		// 2. thread-2 epoll_wait -> events[i].events EPOLLOUT
+		// 3. thread-1 aio_socket_recv() set ctx->state EPOLLOUT|EPOLLIN, epoll_ctl(MOD) re-arm EPOLLOUT
+		// 4. thread-3 epoll_wait -> events[i].events EPOLLOUT
+		// 5. thread-2/thread-3 claim EPOLLOUT, CAS make sure only one of them win
+		do
+		{
+			userevent = ctx->state;
+			claim = ev->events & userevent & (EPOLLIN | EPOLLOUT);
+		} while(!__sync_bool_compare_and_swap(&ctx->state, userevent, userevent & ~claim));
+
+		ev->events = claim;
+		if(userevent & ~claim & EPOLL_STATE_EVENTS)
+			epoll_oneshot_ctl(ctx, EPOLL_CTL_MOD, userevent & ~claim); // re-arm other event(clear in/out cause EPOLLHUP)
+	}
+}
+
 #if defined(EPOLLRDHUP)
-		flags |= EPOLLRDHUP;
+#define EPOLL_EDGE_EVENTS (EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP)
+#else
+#define EPOLL_EDGE_EVENTS (EPOLLIN | EPOLLOUT | EPOLLET)
 #endif
-		assert(events[i].data.ptr);
-		ctx = (struct epoll_context*)events[i].data.ptr;
-		assert(ctx->ref > 0);
-		if(events[i].events & flags)
+
+// Edge-triggered mode(long-lived connection):
+// 1. socket registered once with EPOLLIN|EPOLLOUT|EPOLLET, no EPOLL_CTL_MOD per request
+// 2. ctx->state EPOLLIN/EPOLLOUT: request pending, EPOLL_STATE_READY: edge came without request
+// 3. epoll instance MUST be processed by one thread(shard), so no other thread hold an event 
+//    of the socket when it removed from epoll(EPOLLHUP after aio_socket_destroy)
+
+/// edge mode request: register once, re-check the socket only if edge came before request
+/// @return 0-ok, -1-error(errno)
+static int epoll_edge_ctrl(struct epoll_context* ctx, uint32_t flag)
+{
+	int r;
+	uint32_t old;
+	struct epoll_event ev;
+
+	r = 0;
+	ev.events = EPOLL_EDGE_EVENTS;
+	ev.data.ptr = ctx;
+
+	__sync_add_and_fetch_4(&ctx->ref, 1);
+	old = epoll_state_change(ctx, EPOLL_STATE_READY(flag), flag | EPOLL_STATE_INIT);
+	if(0 == (old & EPOLL_STATE_INIT))
+	{
+		// epoll report current readiness after add
+		__sync_add_and_fetch_4(&ctx->ref, 1); // for epoll registration, release on EPOLLHUP after destroy
+		r = epoll_ctl(ctx->epoll, EPOLL_CTL_ADD, ctx->socket, &ev);
+		if(0 != r)
+			__sync_sub_and_fetch_4(&ctx->ref, 1);
+	}
+	else if(old & EPOLL_STATE_READY(flag))
+	{
+		// missed edge, EPOLL_CTL_MOD generate a new event if the socket is ready
+		r = epoll_ctl(ctx->epoll, EPOLL_CTL_MOD, ctx->socket, &ev);
+	}
+
+	if(0 != r)
+	{
+		r = errno;
+		epoll_state_change(ctx, flag | ((old & EPOLL_STATE_INIT) ? 0 : EPOLL_STATE_INIT), 0);
+		__sync_sub_and_fetch_4(&ctx->ref, 1);
+		errno = r;
+		return -1;
+	}
+	return 0;
+}
+
+static void epoll_edge_claim(struct epoll_event* ev)
+{
+	int release;
+	uint32_t old, state, claim, events;
+	struct epoll_context* ctx;
+	ctx = (struct epoll_context*)ev->data.ptr;
+
+	events = ev->events;
+	if((events & EPOLLERR) && ctx->zc.enable > 0 && 0 == epoll_zerocopy_error(ctx))
+		events &= ~EPOLLERR; // MSG_ZEROCOPY notification only
+	if(events & (EPOLLERR | EPOLLHUP))
+		events |= EPOLLIN | EPOLLOUT; // wake up all requests
+#if defined(EPOLLRDHUP)
+	if(events & EPOLLRDHUP)
+		events |= EPOLLIN; // recv 0-bytes
+#endif
+
+	do
+	{
+		old = ctx->state;
+		claim = events & old & (EPOLLIN | EPOLLOUT);
+		if((old & EPOLLERR) && (ctx->zc.released || (events & (EPOLLERR | EPOLLHUP))))
+			claim |= EPOLLERR;
+
+		// edge without request: save it for the next request
+		state = (old & ~claim) | EPOLL_STATE_READY(events & (EPOLLIN | EPOLLOUT) & ~claim);
+		release = (old & EPOLL_STATE_DESTROY) && (old & EPOLL_STATE_INIT) && (events & (EPOLLERR | EPOLLHUP));
+		if(release)
+			state &= ~EPOLL_STATE_INIT;
+	} while(!__sync_bool_compare_and_swap(&ctx->state, old, state));
+
+	ev->events = (claim & (EPOLLIN | EPOLLOUT)) | (events & EPOLLERR) | ((claim & EPOLLERR) ? EPOLL_ZEROCOPY : 0);
+	if(release)
+	{
+		// claimed request hold another ref
+		epoll_ctl(ctx->epoll, EPOLL_CTL_DEL, ctx->socket, &ctx->ev);
+		aio_socket_release(ctx);
+	}
+}
+
+static void epoll_edge_dispatch(struct epoll_context* ctx, uint32_t flag, int code)
+{
+	int r;
+	uint32_t old;
+	struct epoll_event e;
+
+	e.events = EPOLL_EDGE_EVENTS;
+	e.data.ptr = ctx;
+	r = (EPOLLIN == flag ? ctx->read : ctx->write)(ctx, EPOLL_EDGE, code);
+	if(EPOLL_WOULDBLOCK(r))
+	{
+		// spurious wakeup, keep request(and ref) and wait for next edge
+		__sync_add_and_fetch_4(&ctx->ref, 1);
+		old = epoll_state_change(ctx, EPOLL_STATE_READY(flag), flag);
+		if(old & EPOLL_STATE_READY(flag))
+			epoll_ctl(ctx->epoll, EPOLL_CTL_MOD, ctx->socket, &e); // edge came while the request was out
+	}
+	else
+	{
+		// more data(space) maybe available, next request try it
+		do
 		{
-			// save event
-			pthread_spin_lock(&ctx->locker);
-			userevent = ctx->ev.events;
-			ctx->ev.events &= ~(EPOLLIN|EPOLLOUT);
-			pthread_spin_unlock(&ctx->locker);
-
-			// epoll oneshot don't need change event
-			//if(userevent & (EPOLLIN|EPOLLOUT))
-			//	epoll_ctl(s_epoll, EPOLL_CTL_MOD, ctx->socket, &ctx->ev); // endless loop
-
-			// error
-			if(EPOLLIN & userevent)
-			{
-				assert(ctx->read);
-				ctx->read(ctx, 1, EPIPE); // EPOLLRDHUP ?
-				aio_socket_release(ctx);
-			}
+			old = ctx->state;
+		} while(!(old & flag) && !__sync_bool_compare_and_swap(&ctx->state, old, old | EPOLL_STATE_READY(flag)));
 
-			if(EPOLLOUT & userevent)
-			{
-				assert(ctx->write);
-				ctx->write(ctx, 1, EPIPE); // EPOLLRDHUP ?
-				aio_socket_release(ctx);
-			}
-		}
+		// new request in callback don't know the socket is ready
+		if(old & flag)
+			epoll_ctl(ctx->epoll, EPOLL_CTL_MOD, ctx->socket, &e);
+	}
+}
+
+// every claimed in/out event hold one ctx->ref
+static void epoll_event_dispatch(const struct epoll_event* ev)
+{
+	int code;
+	struct epoll_context* ctx;
+	ctx = (struct epoll_context*)ev->data.ptr;
+	code = (EPOLLERR & ev->events) ? EPIPE : 0; // EPOLLRDHUP ?
+
+	if(EPOLLIN & ev->events)
+	{
+		assert(ctx->read);
+		if(ctx->edge)
+			epoll_edge_dispatch(ctx, EPOLLIN, code);
 		else
-		{
-			// save event
-			// 1. thread-1 current ctx->ev.events = EPOLLIN
-			// 2. thread-2 user call aio_socket_send() set ctx->ev.events to EPOLLIN|EPOLLOUT
-			// 3. switch thread-1 call ctx->write and decrement ctx->ref
-			// 4. switch thread-2 aio_socket_send() epoll_ctl failed, then user set ctx->ev.events to EPOLLIN 
-			// 5. thread-2 redo decrement ctx->ref (decrement twice, crash)
-
-			// clear IN/OUT event
-			pthread_spin_lock(&ctx->locker);
-	
-			// 1. thread-1 aio_socket_send() set ctx->ev.events to EPOLLOUT
-			// 2. thread-2 epoll_wait -> events[i].events EPOLLOUT
-			// 3. thread-1 aio_socket_recv() set ctx->ev.events to EPOLLOUT|EPOLLIN
-			// 4. thread-1 epoll_wait -> events[i].events EPOLLOUT
-			// 5. thread-1 set ctx->ev.events to EPOLLIN
-			// 6. thread-2 check ctx->ev.events with EPOLLOUT failed
-			//assert(events[i].events == (events[i].events & ctx->ev.events));
-
-			events[i].events &= ctx->ev.events; // check events again(multi-thread condition)
-			ctx->ev.events &= ~(events[i].events & (EPOLLIN | EPOLLOUT));
-			if(ctx->ev.events & (EPOLLIN|EPOLLOUT))
-				epoll_ctl(s_epoll, EPOLL_CTL_MOD, ctx->socket, &ctx->ev); // update epoll event(clear in/out cause EPOLLHUP)
-			pthread_spin_unlock(&ctx->locker);
-
-			//if(EPOLLRDHUP & events[i].events)
-			//{
-			//	// closed
-			//	assert(EPOLLIN & events[i].events);
-			//}
-
-			if(EPOLLIN & events[i].events)
-			{
-				assert(ctx->read);
-				ctx->read(ctx, 1, 0);
-				aio_socket_release(ctx);
-			}
+			ctx->read(ctx, 1, code);
+		aio_socket_release(ctx);
+	}
 
-			if(EPOLLOUT & events[i].events)
-			{
-				assert(ctx->write);
-				ctx->write(ctx, 1, 0);
-				aio_socket_release(ctx);
-			}
+	if(EPOLLOUT & ev->events)
+	{
+		assert(ctx->write);
+		if(ctx->edge)
+			epoll_edge_dispatch(ctx, EPOLLOUT, code);
+		else
+			ctx->write(ctx, 1, code);
+		aio_socket_release(ctx);
+	}
+
+	if(EPOLL_ZEROCOPY & ev->events)
+	{
+		// buffer maybe still in use if socket error before notification
+		ctx->zc.wait = 0;
+		if(ctx->zc.released)
+			ctx->zc.proc(ctx->zc.param, 0, ctx->zc.bytes);
+		else
+			ctx->zc.proc(ctx->zc.param, code ? code : EPIPE, 0);
+		aio_socket_release(ctx);
+	}
+}
+
+/// @param[in] create 1-create for aio_socket_process thread
+/// @return current thread speculative context, NULL if not in aio_socket_process callback
+static struct epoll_speculative* epoll_speculative_get(int create)
+{
+	struct epoll_speculative* spec;
+	spec = (struct epoll_speculative*)pthread_getspecific(s_speculative_key);
+	if (NULL == spec && create)
+	{
+		spec = (struct epoll_speculative*)calloc(1, sizeof(*spec));
+		if (spec && 0 != pthread_setspecific(s_speculative_key, spec))
+		{
+			free(spec);
+			spec = NULL;
 		}
 	}
+	return (spec && (spec->active || create)) ? spec : NULL;
+}
 
+/// save inline recv/send result, callback later in epoll_speculative_dispatch
+/// @return 0-completed, EAGAIN-need epoll
+static int epoll_speculative_done(struct epoll_context* ctx, int event, ssize_t r, aio_onrecv proc, void* param)
+{
+	struct epoll_speculative* spec;
+	if (r < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno))
+		return EAGAIN;
+
+	spec = epoll_speculative_get(0);
+	assert(spec && spec->count < MAX_SPECULATIVE);
+	spec->completed[spec->count].ctx = ctx;
+	spec->completed[spec->count].event = event;
+	spec->completed[spec->count].code = r < 0 ? errno : 0;
+	spec->completed[spec->count].bytes = r < 0 ? 0 : (size_t)r;
+	spec->completed[spec->count].proc = proc;
+	spec->completed[spec->count].param = param;
+	spec->count++;
+
+	__sync_add_and_fetch_4(&ctx->ref, 1);
+	__sync_fetch_and_or(&ctx->speculative, event);
+	return 0;
+}
+
+/// try recv/send without epoll
+/// @return 0-completed(callback deferred), EAGAIN-need epoll
+static int epoll_speculative_try(struct epoll_context* ctx, uint32_t flag, int (*fn)(struct epoll_context *ctx, int flags, int code))
+{
+	int r;
+	struct epoll_speculative* spec;
+	spec = epoll_speculative_get(0);
+	if (NULL == spec || spec->count >= MAX_SPECULATIVE)
+		return EAGAIN; // not in callback or too many inline completions, let other sockets run
+
+	if (ctx->edge)
+	{
+		// edge mode: try only if the socket maybe ready, otherwise wait next edge
+		if (!(epoll_state_change(ctx, EPOLL_STATE_READY(flag), 0) & EPOLL_STATE_READY(flag)))
+			return EAGAIN;
+
+		r = fn(ctx, EPOLL_SPECULATIVE, 0);
+		if (0 == r)
+			epoll_state_change(ctx, 0, EPOLL_STATE_READY(flag));
+		return r;
+	}
+
+	if (0 == (AIO_SOCKET_SPECULATIVE & s_flags))
+		return EAGAIN;
+	return fn(ctx, EPOLL_SPECULATIVE, 0);
+}
+
+static void epoll_speculative_dispatch(struct epoll_speculative* spec)
+{
+	int i;
+	struct epoll_context* ctx;
+
+	// callback can add more completions until MAX_SPECULATIVE
+	for (i = 0; i < spec->count; i++)
+	{
+		ctx = spec->completed[i].ctx;
+		__sync_fetch_and_and(&ctx->speculative, ~spec->completed[i].event);
+		spec->completed[i].proc(spec->completed[i].param, spec->completed[i].code, spec->completed[i].bytes);
+		aio_socket_release(ctx);
+	}
+	spec->count = 0;
+}
+
+int aio_socket_process(int timeout)
+{
+	int i, r;
+	struct epoll_event events[MAX_EVENT];
+	struct epoll_speculative* spec;
+
+	r = epoll_wait(s_epoll[epoll_thread_shard(1)], events, s_events, timeout);
+
+	// claim all events first, then callback
+	for(i = 0; i < r; i++)
+		epoll_event_claim(&events[i]);
+
+	spec = epoll_speculative_get(1);
+	if (spec)
+		spec->active = 1;
+
+	for(i = 0; i < r; i++)
+		epoll_event_dispatch(&events[i]);
+
+	if (spec)
+	{
+		epoll_speculative_dispatch(spec);
+		spec->active = 0;
+	}
 	return r;
 }
 
 aio_socket_t aio_socket_create(socket_t socket, int own)
+{
+	return aio_socket_create2(socket, own, -1);
+}
+
+aio_socket_t aio_socket_create2(socket_t socket, int own, int shard)
 {
 //	int flags;
 	struct epoll_context* ctx;
-	ctx = (struct epoll_context*)calloc(1, sizeof(struct epoll_context));
+	ctx = (struct epoll_context*)slab_cache_alloc(s_cache);
 	if(!ctx)
 		return NULL;
 
-	pthread_spin_init(&ctx->locker, PTHREAD_PROCESS_PRIVATE);
+	// 1. user pinned shard
+	// 2. aio_socket_process thread shard(e.g. accept/connect callback), keep the connection cache-local
+	// 3. round-robin from other threads
+	if (shard < 0 || shard >= s_shards)
+		shard = epoll_thread_shard(0);
+	if (shard < 0)
+		shard = (int)(__sync_fetch_and_add(&s_shard_socket, 1) % (uint32_t)s_shards);
+	ctx->epoll = s_epoll[shard];
+
 	ctx->own = own;
 	ctx->ref = 1; // 1-for EPOLLHUP(no in/out, shutdown), 2-destroy release
 	ctx->socket = socket;
@@ -320,7 +864,7 @@ aio_socket_t aio_socket_create(socket_t socket, int own)
 	ctx->ev.data.ptr = ctx;
 
 	// don't add to epoll until read/write
-	//if(0 != epoll_ctl(s_epoll, EPOLL_CTL_ADD, socket, &ctx->ev))
+	//if(0 != epoll_ctl(ctx->epoll, EPOLL_CTL_ADD, socket, &ctx->ev))
 	//{
 	//	free(ctx);
 	//	return NULL;
@@ -341,12 +885,42 @@ int aio_socket_destroy(aio_socket_t socket, aio_ondestroy ondestroy, void* param
 	ctx->param = param;
 
 	shutdown(ctx->socket, SHUT_RDWR);
+	if(ctx->edge)
+	{
+		// edge mode: make sure EPOLLHUP reported, see epoll_edge_claim
+		struct epoll_event ev;
+		ev.events = EPOLL_EDGE_EVENTS;
+		ev.data.ptr = ctx;
+		if(epoll_state_change(ctx, 0, EPOLL_STATE_DESTROY) & EPOLL_STATE_INIT)
+			epoll_ctl(ctx->epoll, EPOLL_CTL_MOD, ctx->socket, &ev);
+	}
 //	close(sock); // can't close socket now, avoid socket reuse
 
 	aio_socket_release(ctx); // shutdown will generate EPOLLHUP event
 	return 0;
 }
 
+int aio_socket_edge_triggered(aio_socket_t socket)
+{
+	int flags;
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+
+	// shared epoll instance: other thread maybe hold an event of the socket after it removed
+	if (s_shards < 2 && s_threads > 1)
+		return ENOTSUP;
+
+	if (ctx->state & (EPOLL_STATE_INIT | EPOLLIN | EPOLLOUT))
+		return EBUSY;
+
+	// edge-triggered: read/write until EAGAIN
+	flags = fcntl(ctx->socket, F_GETFL, 0);
+	if (-1 == flags || -1 == fcntl(ctx->socket, F_SETFL, flags | O_NONBLOCK))
+		return errno;
+
+	ctx->edge = 1;
+	return 0;
+}
+
 static int epoll_accept(struct epoll_context* ctx, int flags, int error)
 {
 	socket_t client;
@@ -355,7 +929,7 @@ static int epoll_accept(struct epoll_context* ctx, int flags, int error)
 
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->in.accept.proc(ctx->in.accept.param, error, 0, NULL, 0);
 		return error;
 	}
@@ -369,7 +943,7 @@ static int epoll_accept(struct epoll_context* ctx, int flags, int error)
 	else
 	{
 		assert(-1 == client);
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -381,8 +955,8 @@ static int epoll_accept(struct epoll_context* ctx, int flags, int error)
 int aio_socket_accept(aio_socket_t socket, aio_onaccept proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLIN));
-	if(ctx->ev.events & EPOLLIN)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));
+	if((ctx->state | ctx->speculative) & EPOLLIN)
 		return EBUSY;
 
 	ctx->in.accept.proc = proc;
@@ -398,32 +972,28 @@ int aio_socket_accept(aio_socket_t socket, aio_onaccept proc, void* param)
 
 static int epoll_connect(struct epoll_context* ctx, int flags, int error)
 {
+	int r;
 	socklen_t len;
 
     // call in epoll_wait thread
-    assert(1 == flags);
-
-    if(0 != error)
-	{
-		ctx->out.connect.proc(ctx->out.connect.param, error);
-		return error;
-	}
-    else
-    {
-        // man connect to see more (EINPROGRESS)
-		len = sizeof(error);
-        getsockopt(ctx->socket, SOL_SOCKET, SO_ERROR, (void*)&error, &len);
-        ctx->out.connect.proc(ctx->out.connect.param, error);
-        return error;
-    }
+    assert(0 != flags);
+
+    // man connect to see more (EINPROGRESS)
+	// EPOLLERR: report the real reason(e.g. ECONNREFUSED) instead of the generic error
+	r = 0;
+	len = sizeof(r);
+	getsockopt(ctx->socket, SOL_SOCKET, SO_ERROR, (void*)&r, &len);
+	error = 0 != r ? r : error;
+	ctx->out.connect.proc(ctx->out.connect.param, error);
+	return error;
 }
 
 int aio_socket_connect(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, aio_onconnect proc, void* param)
 {
 	int r;
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLOUT));
-	if(ctx->ev.events & EPOLLOUT)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
 		return EBUSY;
 
 	ctx->out.connect.addrlen = addrlen > sizeof(ctx->out.connect.addr) ? sizeof(ctx->out.connect.addr) : addrlen;
@@ -445,16 +1015,28 @@ int aio_socket_connect(aio_socket_t socket, const struct sockaddr *addr, socklen
 static int epoll_recv(struct epoll_context* ctx, int flags, int error)
 {
 	ssize_t r;
+	char peek;
 
 	// recv socket buffer data
 	//if(0 != error)
 	//{
-	//	assert(1 == flags); // only in epoll_wait thread
+	//	assert(0 != flags); // only in epoll_wait thread
 	//	ctx->in.recv.proc(ctx->in.recv.param, error, 0);
 	//	return error;
 	//}
 
-	r = recv(ctx->socket, ctx->in.recv.buffer, ctx->in.recv.bytes, 0);
+	if(0 == ctx->in.recv.bytes)
+	{
+		// zero-byte recv: wait readable(data or FIN), don't consume data
+		r = recv(ctx->socket, &peek, 1, MSG_PEEK | (EPOLL_SPECULATIVE == flags ? MSG_DONTWAIT : 0));
+		r = r > 0 ? 0 : r;
+	}
+	else
+	{
+		r = recv(ctx->socket, ctx->in.recv.buffer, ctx->in.recv.bytes, EPOLL_SPECULATIVE == flags ? MSG_DONTWAIT : 0);
+	}
+	if(EPOLL_SPECULATIVE == flags)
+		return epoll_speculative_done(ctx, EPOLLIN, r, ctx->in.recv.proc, ctx->in.recv.param);
 	if(r >= 0)
 	{
 		ctx->in.recv.proc(ctx->in.recv.param, 0, (size_t)r);
@@ -462,7 +1044,7 @@ static int epoll_recv(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -474,8 +1056,8 @@ static int epoll_recv(struct epoll_context* ctx, int flags, int error)
 int aio_socket_recv(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecv proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLIN));
-	if(ctx->ev.events & EPOLLIN)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));
+	if((ctx->state | ctx->speculative) & EPOLLIN)
 		return EBUSY;
 
 	ctx->in.recv.proc = proc;
@@ -483,8 +1065,8 @@ int aio_socket_recv(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecv
 	ctx->in.recv.buffer = buffer;
 	ctx->in.recv.bytes = bytes;
 
-//	r = epoll_recv(ctx, 0, 0);
-//	if(EAGAIN != r) return r;
+	if(0 == epoll_speculative_try(ctx, EPOLLIN, epoll_recv))
+		return 0;
 
 	EPollIn(ctx, epoll_recv);
 	return errno; // epoll_ctl return -1
@@ -495,12 +1077,14 @@ static int epoll_send(struct epoll_context* ctx, int flags, int error)
 	ssize_t r;
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->out.send.proc(ctx->out.send.param, error, 0);
 		return error;
 	}
 
-	r = send(ctx->socket, ctx->out.send.buffer, ctx->out.send.bytes, 0);
+	r = send(ctx->socket, ctx->out.send.buffer, ctx->out.send.bytes, EPOLL_SPECULATIVE == flags ? MSG_DONTWAIT : 0);
+	if(EPOLL_SPECULATIVE == flags)
+		return epoll_speculative_done(ctx, EPOLLOUT, r, ctx->out.send.proc, ctx->out.send.param);
 	if(r >= 0)
 	{
 		ctx->out.send.proc(ctx->out.send.param, 0, (size_t)r);
@@ -508,7 +1092,7 @@ static int epoll_send(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -520,8 +1104,8 @@ static int epoll_send(struct epoll_context* ctx, int flags, int error)
 int aio_socket_send(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLOUT));
-	if(ctx->ev.events & EPOLLOUT)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
 		return EBUSY;
 
 	ctx->out.send.proc = proc;
@@ -529,8 +1113,8 @@ int aio_socket_send(aio_socket_t socket, const void* buffer, size_t bytes, aio_o
 	ctx->out.send.buffer = buffer;
 	ctx->out.send.bytes = bytes;
 
-//	r = epoll_send(ctx, 0, 0);
-//	if(EAGAIN != r) return r;
+	if(0 == epoll_speculative_try(ctx, EPOLLOUT, epoll_send))
+		return 0;
 
 	EPollOut(ctx, epoll_send);
 	return errno; // epoll_ctl return -1
@@ -544,7 +1128,7 @@ static int epoll_recv_v(struct epoll_context* ctx, int flags, int error)
 	// recv socket buffer data
 	//if(0 != error)
 	//{
-	//	assert(1 == flags); // only in epoll_wait thread
+	//	assert(0 != flags); // only in epoll_wait thread
 	//	ctx->in.recv_v.proc(ctx->in.recv_v.param, error, 0);
 	//	return error;
 	//}
@@ -553,7 +1137,9 @@ static int epoll_recv_v(struct epoll_context* ctx, int flags, int error)
 	msg.msg_iov = (struct iovec*)ctx->in.recv_v.vec;
 	msg.msg_iovlen = ctx->in.recv_v.n;
 
-	r = recvmsg(ctx->socket, &msg, 0);
+	r = recvmsg(ctx->socket, &msg, EPOLL_SPECULATIVE == flags ? MSG_DONTWAIT : 0);
+	if(EPOLL_SPECULATIVE == flags)
+		return epoll_speculative_done(ctx, EPOLLIN, r, ctx->in.recv_v.proc, ctx->in.recv_v.param);
 	if(r >= 0)
 	{
 		ctx->in.recv_v.proc(ctx->in.recv_v.param, 0, (size_t)r);
@@ -561,7 +1147,7 @@ static int epoll_recv_v(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -573,8 +1159,8 @@ static int epoll_recv_v(struct epoll_context* ctx, int flags, int error)
 int aio_socket_recv_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecv proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLIN));
-	if(ctx->ev.events & EPOLLIN)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));
+	if((ctx->state | ctx->speculative) & EPOLLIN)
 		return EBUSY;
 
 	ctx->in.recv_v.proc = proc;
@@ -582,8 +1168,8 @@ int aio_socket_recv_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onre
 	ctx->in.recv_v.vec = vec;
 	ctx->in.recv_v.n = n;
 
-//	r = epoll_recv_v(ctx, 0, 0);
-//	if(EAGAIN != r) return r;
+	if(0 == epoll_speculative_try(ctx, EPOLLIN, epoll_recv_v))
+		return 0;
 
 	EPollIn(ctx, epoll_recv_v);
 	return errno; // epoll_ctl return -1
@@ -596,7 +1182,7 @@ static int epoll_send_v(struct epoll_context* ctx, int flags, int error)
 
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->out.send_v.proc(ctx->out.send_v.param, error, 0);
 		return error;
 	}
@@ -605,7 +1191,9 @@ static int epoll_send_v(struct epoll_context* ctx, int flags, int error)
 	msg.msg_iov = (struct iovec*)ctx->out.send_v.vec;
 	msg.msg_iovlen = ctx->out.send_v.n;
 
-	r = sendmsg(ctx->socket, &msg, 0);
+	r = sendmsg(ctx->socket, &msg, EPOLL_SPECULATIVE == flags ? MSG_DONTWAIT : 0);
+	if(EPOLL_SPECULATIVE == flags)
+		return epoll_speculative_done(ctx, EPOLLOUT, r, ctx->out.send_v.proc, ctx->out.send_v.param);
 	if(r >= 0)
 	{
 		ctx->out.send_v.proc(ctx->out.send_v.param, 0, (size_t)r);
@@ -613,7 +1201,7 @@ static int epoll_send_v(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -625,8 +1213,8 @@ static int epoll_send_v(struct epoll_context* ctx, int flags, int error)
 int aio_socket_send_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLOUT));	
-	if(ctx->ev.events & EPOLLOUT)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));	
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
 		return EBUSY;
 
 	ctx->out.send_v.proc = proc;
@@ -634,8 +1222,8 @@ int aio_socket_send_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onse
 	ctx->out.send_v.vec = vec;
 	ctx->out.send_v.n = n;
 
-//	r = epoll_send_v(ctx, 0, 0);
-//	if(EAGAIN != r) return r;
+	if(0 == epoll_speculative_try(ctx, EPOLLOUT, epoll_send_v))
+		return 0;
 
 	EPollOut(ctx, epoll_send_v);
 	return errno; // epoll_ctl return -1
@@ -649,7 +1237,7 @@ static int epoll_recvfrom(struct epoll_context* ctx, int flags, int error)
 
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->in.recvfrom.proc(ctx->in.recvfrom.param, error, 0, NULL, 0);
 		return error;
 	}
@@ -662,7 +1250,7 @@ static int epoll_recvfrom(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -674,8 +1262,8 @@ static int epoll_recvfrom(struct epoll_context* ctx, int flags, int error)
 int aio_socket_recvfrom(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecvfrom proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLIN));	
-	if(ctx->ev.events & EPOLLIN)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));	
+	if((ctx->state | ctx->speculative) & EPOLLIN)
 		return EBUSY;
 
 	ctx->in.recvfrom.proc = proc;
@@ -695,7 +1283,7 @@ static int epoll_sendto(struct epoll_context* ctx, int flags, int error)
 	ssize_t r;
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->out.send.proc(ctx->out.send.param, error, 0);
 		return error;
 	}
@@ -708,7 +1296,7 @@ static int epoll_sendto(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -720,8 +1308,8 @@ static int epoll_sendto(struct epoll_context* ctx, int flags, int error)
 int aio_socket_sendto(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, const void* buffer, size_t bytes, aio_onsend proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLOUT));
-	if(ctx->ev.events & EPOLLOUT)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
 		return EBUSY;
 
 	ctx->out.send.addrlen = addrlen > sizeof(ctx->out.send.addr) ? sizeof(ctx->out.send.addr) : addrlen;
@@ -746,7 +1334,7 @@ static int epoll_recvfrom_v(struct epoll_context* ctx, int flags, int error)
 
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->in.recvfrom_v.proc(ctx->in.recvfrom_v.param, error, 0, NULL, 0);
 		return error;
 	}
@@ -766,7 +1354,7 @@ static int epoll_recvfrom_v(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -778,8 +1366,8 @@ static int epoll_recvfrom_v(struct epoll_context* ctx, int flags, int error)
 int aio_socket_recvfrom_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecvfrom proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLIN));
-	if(ctx->ev.events & EPOLLIN)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));
+	if((ctx->state | ctx->speculative) & EPOLLIN)
 		return EBUSY;
 
 	ctx->in.recvfrom_v.proc = proc;
@@ -801,7 +1389,7 @@ static int epoll_sendto_v(struct epoll_context* ctx, int flags, int error)
 
 	if(0 != error)
 	{
-		assert(1 == flags); // only in epoll_wait thread
+		assert(0 != flags); // only in epoll_wait thread
 		ctx->out.send_v.proc(ctx->out.send_v.param, error, 0);
 		return error;
 	}
@@ -820,7 +1408,7 @@ static int epoll_sendto_v(struct epoll_context* ctx, int flags, int error)
 	}
 	else
 	{
-		if(0 == flags)
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
 			return errno;
 
 		// call in epoll_wait thread
@@ -832,8 +1420,8 @@ static int epoll_sendto_v(struct epoll_context* ctx, int flags, int error)
 int aio_socket_sendto_v(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
 {
 	struct epoll_context* ctx = (struct epoll_context*)socket;
-	assert(0 == (ctx->ev.events & EPOLLOUT));	
-	if(ctx->ev.events & EPOLLOUT)
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));	
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
 		return EBUSY;
 
 	ctx->out.send_v.addrlen = addrlen > sizeof(ctx->out.send_v.addr) ? sizeof(ctx->out.send_v.addr) : addrlen;
@@ -849,3 +1437,326 @@ int aio_socket_sendto_v(aio_socket_t socket, const struct sockaddr *addr, sockle
 	EPollOut(ctx, epoll_sendto_v);
 	return errno; // epoll_ctl return -1
 }
+
+// cmsg buffer per datagram: UDP_SEGMENT(uint16_t)/UDP_GRO(int)
+#define EPOLL_MMSG_CONTROL CMSG_SPACE(sizeof(int))
+
+static int epoll_recvmmsg(struct epoll_context* ctx, int flags, int error)
+{
+	int i, r;
+	struct cmsghdr* cmsg;
+	struct mmsghdr hdr[MAX_MMSG];
+	struct iovec iov[MAX_MMSG];
+	union { char buf[EPOLL_MMSG_CONTROL]; struct cmsghdr align; } control[MAX_MMSG];
+	struct aio_socket_mmsg_t* msgs;
+
+	msgs = ctx->in.recvmmsg.msgs;
+	if(0 != error)
+	{
+		assert(0 != flags); // only in epoll_wait thread
+		ctx->in.recvmmsg.proc(ctx->in.recvmmsg.param, error, msgs, 0);
+		return error;
+	}
+
+	memset(hdr, 0, sizeof(hdr[0]) * ctx->in.recvmmsg.n);
+	for(i = 0; i < ctx->in.recvmmsg.n; i++)
+	{
+		iov[i].iov_base = msgs[i].buffer;
+		iov[i].iov_len = msgs[i].bytes;
+		hdr[i].msg_hdr.msg_name = &msgs[i].addr;
+		hdr[i].msg_hdr.msg_namelen = sizeof(msgs[i].addr);
+		hdr[i].msg_hdr.msg_iov = &iov[i];
+		hdr[i].msg_hdr.msg_iovlen = 1;
+		hdr[i].msg_hdr.msg_control = control[i].buf;
+		hdr[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+	}
+
+	// MSG_WAITFORONE: blocking socket don't wait for the whole batch
+	r = recvmmsg(ctx->socket, hdr, ctx->in.recvmmsg.n, MSG_WAITFORONE, NULL);
+	if(r >= 0)
+	{
+		for(i = 0; i < r; i++)
+		{
+			msgs[i].bytes = hdr[i].msg_len;
+			msgs[i].addrlen = hdr[i].msg_hdr.msg_namelen;
+			msgs[i].segment = 0;
+			for(cmsg = CMSG_FIRSTHDR(&hdr[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr[i].msg_hdr, cmsg))
+			{
+				if(SOL_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type)
+					msgs[i].segment = (unsigned int)*(int*)CMSG_DATA(cmsg);
+			}
+		}
+
+		ctx->in.recvmmsg.proc(ctx->in.recvmmsg.param, 0, msgs, r);
+		return 0;
+	}
+	else
+	{
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
+			return errno;
+
+		// call in epoll_wait thread
+		ctx->in.recvmmsg.proc(ctx->in.recvmmsg.param, errno, msgs, 0);
+		return 0;
+	}
+}
+
+int aio_socket_recvmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLIN));
+	if((ctx->state | ctx->speculative) & EPOLLIN)
+		return EBUSY;
+	if(n < 1 || n > MAX_MMSG)
+		return EINVAL;
+
+	ctx->in.recvmmsg.proc = proc;
+	ctx->in.recvmmsg.param = param;
+	ctx->in.recvmmsg.msgs = msgs;
+	ctx->in.recvmmsg.n = n;
+
+	EPollIn(ctx, epoll_recvmmsg);
+	return errno; // epoll_ctl return -1
+}
+
+static int epoll_sendmmsg(struct epoll_context* ctx, int flags, int error)
+{
+	int i, r;
+	struct cmsghdr* cmsg;
+	struct mmsghdr hdr[MAX_MMSG];
+	struct iovec iov[MAX_MMSG];
+	union { char buf[EPOLL_MMSG_CONTROL]; struct cmsghdr align; } control[MAX_MMSG];
+	struct aio_socket_mmsg_t* msgs;
+
+	msgs = ctx->out.sendmmsg.msgs;
+	if(0 != error)
+	{
+		assert(0 != flags); // only in epoll_wait thread
+		ctx->out.sendmmsg.proc(ctx->out.sendmmsg.param, error, msgs, 0);
+		return error;
+	}
+
+	memset(hdr, 0, sizeof(hdr[0]) * ctx->out.sendmmsg.n);
+	for(i = 0; i < ctx->out.sendmmsg.n; i++)
+	{
+		iov[i].iov_base = msgs[i].buffer;
+		iov[i].iov_len = msgs[i].bytes;
+		hdr[i].msg_hdr.msg_name = msgs[i].addrlen > 0 ? &msgs[i].addr : NULL;
+		hdr[i].msg_hdr.msg_namelen = msgs[i].addrlen;
+		hdr[i].msg_hdr.msg_iov = &iov[i];
+		hdr[i].msg_hdr.msg_iovlen = 1;
+
+		if(msgs[i].segment > 0 && msgs[i].segment < msgs[i].bytes)
+		{
+			// UDP GSO: kernel(or NIC) split the buffer
+			hdr[i].msg_hdr.msg_control = control[i].buf;
+			hdr[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+			cmsg = CMSG_FIRSTHDR(&hdr[i].msg_hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*(uint16_t*)CMSG_DATA(cmsg) = (uint16_t)msgs[i].segment;
+		}
+	}
+
+	r = sendmmsg(ctx->socket, hdr, ctx->out.sendmmsg.n, 0);
+	if(r >= 0)
+	{
+		for(i = 0; i < r; i++)
+			msgs[i].bytes = hdr[i].msg_len;
+
+		ctx->out.sendmmsg.proc(ctx->out.sendmmsg.param, 0, msgs, r);
+		return 0;
+	}
+	else
+	{
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
+			return errno;
+
+		// call in epoll_wait thread
+		ctx->out.sendmmsg.proc(ctx->out.sendmmsg.param, errno, msgs, 0);
+		return 0;
+	}
+}
+
+int aio_socket_sendmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
+		return EBUSY;
+	if(n < 1 || n > MAX_MMSG)
+		return EINVAL;
+
+	ctx->out.sendmmsg.proc = proc;
+	ctx->out.sendmmsg.param = param;
+	ctx->out.sendmmsg.msgs = msgs;
+	ctx->out.sendmmsg.n = n;
+
+	EPollOut(ctx, epoll_sendmmsg);
+	return errno; // epoll_ctl return -1
+}
+
+static int epoll_send_zc(struct epoll_context* ctx, int flags, int error)
+{
+	int copy, done;
+	uint32_t state;
+	ssize_t r;
+	struct msghdr msg;
+
+	if(0 != error)
+	{
+		assert(0 != flags); // only in epoll_wait thread
+		ctx->zc.proc(ctx->zc.param, error, 0);
+		return error;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec*)ctx->out.send_v.vec;
+	msg.msg_iovlen = ctx->out.send_v.n;
+
+	// notification maybe arrive before sendmsg return
+	ctx->zc.id = ctx->zc.next;
+	ctx->zc.released = 0;
+	ctx->zc.wait = 1;
+	__sync_synchronize();
+
+	copy = 0;
+	r = sendmsg(ctx->socket, &msg, MSG_ZEROCOPY);
+	if(r < 0 && ENOBUFS == errno)
+	{
+		// optmem limit(pinned pages), send with copy
+		copy = 1;
+		r = sendmsg(ctx->socket, &msg, 0);
+	}
+
+	if(r <= 0 || copy)
+	{
+		ctx->zc.wait = 0;
+		if(r >= 0)
+		{
+			ctx->zc.proc(ctx->zc.param, 0, (size_t)r);
+			return 0;
+		}
+
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
+			return errno;
+
+		// call in epoll_wait thread
+		ctx->zc.proc(ctx->zc.param, errno, 0);
+		return 0;
+	}
+
+	// wait for kernel release the buffer
+	done = 0;
+	ctx->zc.bytes = (size_t)r;
+	ctx->zc.next++;
+	__sync_add_and_fetch_4(&ctx->ref, 1);
+	state = epoll_state_change(ctx, 0, EPOLLERR) | EPOLLERR;
+	if(ctx->zc.released && (epoll_state_change(ctx, EPOLLERR, 0) & EPOLLERR))
+	{
+		// notification drained before EPOLLERR set, nobody claim it
+		ctx->zc.wait = 0;
+		done = 1;
+	}
+	else if(!ctx->edge) // edge mode: EPOLLERR always reported
+	{
+		epoll_oneshot_ctl(ctx, EPOLL_CTL_MOD, state);
+	}
+
+	if(done)
+	{
+		__sync_sub_and_fetch_4(&ctx->ref, 1);
+		ctx->zc.proc(ctx->zc.param, 0, (size_t)r);
+	}
+	return 0;
+}
+
+int aio_socket_send_zc(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param)
+{
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+	if((ctx->state | ctx->speculative) & (EPOLLOUT | EPOLLERR))
+		return EBUSY;
+
+	ctx->zc.iov.iov_base = (void*)buffer;
+	ctx->zc.iov.iov_len = bytes;
+	return aio_socket_send_v_zc(socket, &ctx->zc.iov, 1, proc, param);
+}
+
+int aio_socket_send_v_zc(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
+{
+	int on;
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+	assert(0 == ((ctx->state | ctx->speculative) & (EPOLLOUT | EPOLLERR)));
+	if((ctx->state | ctx->speculative) & (EPOLLOUT | EPOLLERR))
+		return EBUSY;
+
+	if(0 == ctx->zc.enable)
+	{
+#if defined(SO_ZEROCOPY)
+		// since linux 4.14
+		on = 1;
+		ctx->zc.enable = 0 == setsockopt(ctx->socket, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) ? 1 : -1;
+#else
+		(void)on;
+		ctx->zc.enable = -1;
+#endif
+	}
+
+	if(ctx->zc.enable < 0)
+		return aio_socket_send_v(socket, vec, n, proc, param);
+
+	ctx->zc.proc = proc;
+	ctx->zc.param = param;
+	ctx->out.send_v.vec = vec;
+	ctx->out.send_v.n = n;
+
+	EPollOut(ctx, epoll_send_zc);
+	return errno; // epoll_ctl return -1
+}
+
+static int epoll_sendfile(struct epoll_context* ctx, int flags, int error)
+{
+	ssize_t r;
+	if(0 != error)
+	{
+		assert(0 != flags); // only in epoll_wait thread
+		ctx->out.sendfile.proc(ctx->out.sendfile.param, error, 0);
+		return error;
+	}
+
+	// file data copied in kernel, don't need user buffer
+	r = sendfile(ctx->socket, ctx->out.sendfile.fd, &ctx->out.sendfile.offset, ctx->out.sendfile.bytes < MAX_SENDFILE ? ctx->out.sendfile.bytes : MAX_SENDFILE);
+	if(r >= 0)
+	{
+		ctx->out.sendfile.proc(ctx->out.sendfile.param, 0, (size_t)r);
+		return 0;
+	}
+	else
+	{
+		if(0 == flags || (EPOLL_EDGE == flags && EPOLL_WOULDBLOCK(errno)))
+			return errno;
+
+		// call in epoll_wait thread
+		ctx->out.sendfile.proc(ctx->out.sendfile.param, errno, 0);
+		return 0;
+	}
+}
+
+int aio_socket_sendfile(aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param)
+{
+	struct epoll_context* ctx = (struct epoll_context*)socket;
+	assert(0 == ((ctx->state | ctx->speculative) & EPOLLOUT));
+	if((ctx->state | ctx->speculative) & EPOLLOUT)
+		return EBUSY;
+
+	ctx->out.sendfile.proc = proc;
+	ctx->out.sendfile.param = param;
+	ctx->out.sendfile.fd = fd;
+	ctx->out.sendfile.offset = (off_t)offset;
+	ctx->out.sendfile.bytes = bytes;
+
+	// sendfile don't have MSG_DONTWAIT, wait EPOLLOUT always(blocking socket)
+	EPollOut(ctx, epoll_sendfile);
+	return errno; // epoll_ctl return -1
+}
@@ -136,6 +136,18 @@ int aio_socket_init(int threads)
 	return -1 == s_kqueue ? errno : 0;
 }
 
+int aio_socket_init2(int threads, int events, int flags)
+{
+	(void)events; // one event per aio_socket_process(batch harvesting is epoll/io_uring only)
+	(void)flags;
+	return aio_socket_init(threads);
+}
+
+int aio_socket_shards(void)
+{
+	return 1;
+}
+
 int aio_socket_clean(void)
 {
 	if(-1 != s_kqueue)
@@ -236,6 +248,18 @@ aio_socket_t aio_socket_create(socket_t socket, int own)
 	return ctx;
 }
 
+aio_socket_t aio_socket_create2(socket_t socket, int own, int shard)
+{
+	(void)shard;
+	return aio_socket_create(socket, own);
+}
+
+int aio_socket_edge_triggered(aio_socket_t socket)
+{
+	(void)socket;
+	return ENOTSUP; // edge mode is epoll only(see aio-socket.h)
+}
+
 int aio_socket_destroy(aio_socket_t socket, aio_ondestroy ondestroy, void* param)
 {
     struct kqueue_context* ctx = (struct kqueue_context*)socket;
@@ -784,3 +808,31 @@ int aio_socket_sendto_v(aio_socket_t socket, const struct sockaddr *addr, sockle
 
     return 0 == r ? 0 : errno;
 }
+
+int aio_socket_send_zc(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param)
+{
+	return aio_socket_send(socket, buffer, bytes, proc, param);
+}
+
+int aio_socket_send_v_zc(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
+{
+	return aio_socket_send_v(socket, vec, n, proc, param);
+}
+
+int aio_socket_sendfile(aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param)
+{
+	(void)socket, (void)fd, (void)offset, (void)bytes, (void)proc, (void)param;
+	return ENOTSUP;
+}
+
+int aio_socket_recvmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	(void)socket, (void)msgs, (void)n, (void)proc, (void)param;
+	return ENOTSUP;
+}
+
+int aio_socket_sendmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	(void)socket, (void)msgs, (void)n, (void)proc, (void)param;
+	return ENOTSUP;
+}
@@ -0,0 +1,700 @@
+#include "aio-socket.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+// io_uring backend(linux 5.11+, IORING_FEAT_EXT_ARG), build with: make AIO_SOCKET=uring
+// 1. completion based: accept/connect/recv/send are done by kernel, callback with result
+// 2. one ring shared by all aio_socket_process threads
+// 3. requests issued in callback are submitted together after the batch(one io_uring_enter),
+//    requests from other threads are submitted immediately
+
+#define MAX_EVENT 64
+#define URING_ENTRIES 1024
+
+#define URING_IN	0x01
+#define URING_OUT	0x02
+
+enum { URING_ACCEPT = 1, URING_CONNECT, URING_RECV, URING_RECVFROM, URING_SEND, URING_POLL };
+
+struct uring_context;
+struct uring_context_io
+{
+	struct uring_context* ctx;
+	int flag; // URING_IN/URING_OUT
+	int op; // URING_XXX
+
+	union
+	{
+		aio_onaccept accept;
+		aio_onconnect connect;
+		aio_onrecv recv;
+		aio_onrecvfrom recvfrom;
+		aio_onsend send;
+	} proc;
+	void* param;
+
+	// kernel access until completion
+	struct msghdr msg;
+	struct iovec iov;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+};
+
+struct uring_context
+{
+	socket_t socket;
+	volatile int32_t ref; // 1-base, +1 per in-flight request
+	volatile int32_t busy; // URING_IN|URING_OUT
+	int own;
+
+	aio_ondestroy ondestroy;
+	void* param;
+
+	struct uring_context_io in;
+	struct uring_context_io out;
+};
+
+struct uring_t
+{
+	int fd;
+	unsigned int entries;
+
+	pthread_spinlock_t sqlocker;
+	void* sqring;
+	size_t sqsize;
+	unsigned int *sqhead;
+	unsigned int *sqtail;
+	unsigned int *sqmask;
+	unsigned int *sqarray;
+	struct io_uring_sqe* sqes;
+
+	pthread_spinlock_t cqlocker;
+	void* cqring;
+	size_t cqsize;
+	unsigned int *cqhead;
+	unsigned int *cqtail;
+	unsigned int *cqmask;
+	struct io_uring_cqe* cqes;
+};
+
+static struct uring_t s_ring = { -1 };
+static int s_threads = 0;
+static int s_events = 1; // max completions per aio_socket_process
+static pthread_key_t s_defer_key; // non-NULL: in aio_socket_process callback, defer submit
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params* p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int submit, unsigned int complete, unsigned int flags, void* arg, size_t size)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, submit, complete, flags, arg, size);
+}
+
+/// submit all pending sqe, MUST hold sqlocker
+static int uring_flush(void)
+{
+	int r;
+	unsigned int n;
+	n = *s_ring.sqtail - __atomic_load_n(s_ring.sqhead, __ATOMIC_ACQUIRE);
+	if (0 == n)
+		return 0;
+
+	// kernel consume sqe in io_uring_enter(without SQPOLL),
+	// on error the sqe(s) keep in sq ring, submit by next io_uring_enter
+	r = io_uring_enter(s_ring.fd, n, 0, 0, NULL, 0);
+	return r < 0 ? errno : 0;
+}
+
+/// @return NULL-sq ring full, MUST hold sqlocker
+static struct io_uring_sqe* uring_sqe_get(void)
+{
+	unsigned int tail;
+	tail = *s_ring.sqtail;
+	if (tail - __atomic_load_n(s_ring.sqhead, __ATOMIC_ACQUIRE) >= s_ring.entries)
+	{
+		uring_flush();
+		if (tail - __atomic_load_n(s_ring.sqhead, __ATOMIC_ACQUIRE) >= s_ring.entries)
+			return NULL;
+	}
+
+	s_ring.sqarray[tail & *s_ring.sqmask] = tail & *s_ring.sqmask;
+	return &s_ring.sqes[tail & *s_ring.sqmask];
+}
+
+/// MUST hold sqlocker
+static void uring_sqe_commit(void)
+{
+	__atomic_store_n(s_ring.sqtail, *s_ring.sqtail + 1, __ATOMIC_RELEASE);
+}
+
+static int aio_socket_release(struct uring_context* ctx)
+{
+	if (0 == __sync_sub_and_fetch_4(&ctx->ref, 1))
+	{
+		if (ctx->own)
+			close(ctx->socket);
+
+		if (ctx->ondestroy)
+			ctx->ondestroy(ctx->param);
+
+#if defined(DEBUG) || defined(_DEBUG)
+		memset(ctx, 0xCC, sizeof(*ctx));
+#endif
+		free(ctx);
+	}
+	return 0;
+}
+
+/// queue request, io->proc/param/msg... MUST be set
+/// @return 0-ok, other-error, don't callback
+static int uring_submit(struct uring_context_io* io, int opcode, const void* addr, unsigned int len, uint64_t off)
+{
+	int r;
+	struct uring_context* ctx;
+	struct io_uring_sqe* sqe;
+
+	ctx = io->ctx;
+	if (__sync_fetch_and_or(&ctx->busy, io->flag) & io->flag)
+		return EBUSY;
+	__sync_add_and_fetch_4(&ctx->ref, 1);
+
+	r = 0;
+	pthread_spin_lock(&s_ring.sqlocker);
+	sqe = uring_sqe_get();
+	if (sqe)
+	{
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = (uint8_t)opcode;
+		sqe->fd = ctx->socket;
+		sqe->addr = (uint64_t)(uintptr_t)addr;
+		sqe->len = len;
+		sqe->off = off;
+		if (IORING_OP_POLL_ADD == opcode)
+		{
+			sqe->poll32_events = (uint32_t)off; // poll mask
+			sqe->off = 0;
+		}
+		sqe->user_data = (uint64_t)(uintptr_t)io;
+		uring_sqe_commit();
+
+		// batch submit after callback(s)
+		if (NULL == pthread_getspecific(s_defer_key))
+			uring_flush();
+	}
+	else
+	{
+		r = EAGAIN;
+	}
+	pthread_spin_unlock(&s_ring.sqlocker);
+
+	if (0 != r)
+	{
+		__sync_fetch_and_and(&ctx->busy, ~io->flag);
+		__sync_sub_and_fetch_4(&ctx->ref, 1);
+	}
+	return r;
+}
+
+int aio_socket_init(int threads)
+{
+	return aio_socket_init2(threads, 1, 0);
+}
+
+int aio_socket_init2(int threads, int events, int flags)
+{
+	int r;
+	struct io_uring_params p;
+
+	(void)flags; // one ring shared by all threads, AIO_SOCKET_SHARD ignored
+	s_threads = threads;
+	s_events = events < 1 ? 1 : (events > MAX_EVENT ? MAX_EVENT : events);
+
+	memset(&p, 0, sizeof(p));
+	s_ring.fd = io_uring_setup(URING_ENTRIES, &p);
+	if (s_ring.fd < 0)
+		return errno;
+
+	if (0 == (p.features & IORING_FEAT_EXT_ARG))
+	{
+		aio_socket_clean();
+		return ENOSYS; // io_uring_enter timeout
+	}
+
+	s_ring.entries = p.sq_entries;
+	s_ring.sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	s_ring.cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		s_ring.sqsize = s_ring.cqsize = s_ring.sqsize > s_ring.cqsize ? s_ring.sqsize : s_ring.cqsize;
+
+	s_ring.sqring = mmap(NULL, s_ring.sqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_ring.fd, IORING_OFF_SQ_RING);
+	if (MAP_FAILED == s_ring.sqring)
+	{
+		r = errno;
+		s_ring.sqring = NULL;
+		aio_socket_clean();
+		return r;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		s_ring.cqring = s_ring.sqring;
+	}
+	else
+	{
+		s_ring.cqring = mmap(NULL, s_ring.cqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_ring.fd, IORING_OFF_CQ_RING);
+		if (MAP_FAILED == s_ring.cqring)
+		{
+			r = errno;
+			s_ring.cqring = NULL;
+			aio_socket_clean();
+			return r;
+		}
+	}
+
+	s_ring.sqes = (struct io_uring_sqe*)mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_ring.fd, IORING_OFF_SQES);
+	if (MAP_FAILED == s_ring.sqes)
+	{
+		r = errno;
+		s_ring.sqes = NULL;
+		aio_socket_clean();
+		return r;
+	}
+
+	s_ring.sqhead = (unsigned int*)((char*)s_ring.sqring + p.sq_off.head);
+	s_ring.sqtail = (unsigned int*)((char*)s_ring.sqring + p.sq_off.tail);
+	s_ring.sqmask = (unsigned int*)((char*)s_ring.sqring + p.sq_off.ring_mask);
+	s_ring.sqarray = (unsigned int*)((char*)s_ring.sqring + p.sq_off.array);
+	s_ring.cqhead = (unsigned int*)((char*)s_ring.cqring + p.cq_off.head);
+	s_ring.cqtail = (unsigned int*)((char*)s_ring.cqring + p.cq_off.tail);
+	s_ring.cqmask = (unsigned int*)((char*)s_ring.cqring + p.cq_off.ring_mask);
+	s_ring.cqes = (struct io_uring_cqe*)((char*)s_ring.cqring + p.cq_off.cqes);
+
+	pthread_spin_init(&s_ring.sqlocker, PTHREAD_PROCESS_PRIVATE);
+	pthread_spin_init(&s_ring.cqlocker, PTHREAD_PROCESS_PRIVATE);
+	return pthread_key_create(&s_defer_key, NULL);
+}
+
+int aio_socket_clean(void)
+{
+	if (-1 == s_ring.fd)
+		return 0;
+
+	if (s_ring.sqes)
+	{
+		munmap(s_ring.sqes, s_ring.entries * sizeof(struct io_uring_sqe));
+		pthread_spin_destroy(&s_ring.sqlocker);
+		pthread_spin_destroy(&s_ring.cqlocker);
+		pthread_key_delete(s_defer_key);
+	}
+	if (s_ring.cqring && s_ring.cqring != s_ring.sqring)
+		munmap(s_ring.cqring, s_ring.cqsize);
+	if (s_ring.sqring)
+		munmap(s_ring.sqring, s_ring.sqsize);
+	close(s_ring.fd);
+
+	memset(&s_ring, 0, sizeof(s_ring));
+	s_ring.fd = -1;
+	return 0;
+}
+
+int aio_socket_shards(void)
+{
+	return 1;
+}
+
+/// copy completions out of cq ring, cqe slot can be reused by kernel after cq head update
+static int uring_harvest(struct io_uring_cqe* cqes, int count)
+{
+	int n;
+	unsigned int head, tail;
+
+	pthread_spin_lock(&s_ring.cqlocker);
+	head = *s_ring.cqhead;
+	tail = __atomic_load_n(s_ring.cqtail, __ATOMIC_ACQUIRE);
+	for (n = 0; n < count && head != tail; head++)
+		cqes[n++] = s_ring.cqes[head & *s_ring.cqmask];
+	__atomic_store_n(s_ring.cqhead, head, __ATOMIC_RELEASE);
+	pthread_spin_unlock(&s_ring.cqlocker);
+	return n;
+}
+
+static void uring_dispatch(struct uring_context_io* io, int res)
+{
+	int code;
+	size_t bytes;
+	socklen_t addrlen;
+	struct sockaddr_storage addr;
+
+	code = res < 0 ? -res : 0;
+	bytes = res < 0 ? 0 : (size_t)res;
+	switch (io->op)
+	{
+	case URING_ACCEPT:
+		// io->addr can be overwritten by next accept(other thread)
+		addrlen = io->addrlen > sizeof(addr) ? sizeof(addr) : io->addrlen;
+		memcpy(&addr, &io->addr, addrlen);
+		if (0 == code)
+			io->proc.accept(io->param, 0, (socket_t)res, (struct sockaddr*)&addr, addrlen);
+		else
+			io->proc.accept(io->param, code, 0, NULL, 0);
+		break;
+
+	case URING_CONNECT:
+		io->proc.connect(io->param, code);
+		break;
+
+	case URING_RECV:
+		io->proc.recv(io->param, code, bytes);
+		break;
+
+	case URING_RECVFROM:
+		addrlen = io->msg.msg_namelen > sizeof(addr) ? sizeof(addr) : io->msg.msg_namelen;
+		memcpy(&addr, &io->addr, addrlen);
+		if (0 == code)
+			io->proc.recvfrom(io->param, 0, bytes, (struct sockaddr*)&addr, addrlen);
+		else
+			io->proc.recvfrom(io->param, code, 0, NULL, 0);
+		break;
+
+	case URING_SEND:
+		io->proc.send(io->param, code, bytes);
+		break;
+
+	case URING_POLL:
+		io->proc.recv(io->param, code, 0); // zero-byte recv
+		break;
+
+	default:
+		assert(0);
+	}
+}
+
+int aio_socket_process(int timeout)
+{
+	int i, n, r;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	struct io_uring_cqe cqes[MAX_EVENT];
+	struct uring_context_io* io;
+	struct uring_context* ctx;
+
+	n = uring_harvest(cqes, s_events);
+	if (0 == n)
+	{
+		memset(&arg, 0, sizeof(arg));
+		arg.sigmask_sz = _NSIG / 8;
+		if (timeout >= 0)
+		{
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000;
+			arg.ts = (uint64_t)(uintptr_t)&ts;
+		}
+
+		r = io_uring_enter(s_ring.fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+		if (r < 0 && ETIME != errno && EINTR != errno)
+			return -1;
+
+		n = uring_harvest(cqes, s_events);
+	}
+
+	pthread_setspecific(s_defer_key, (void*)1);
+	for (i = 0; i < n; i++)
+	{
+		io = (struct uring_context_io*)(uintptr_t)cqes[i].user_data;
+		if (NULL == io)
+			continue; // cancel request
+
+		// user can issue new request in callback
+		ctx = io->ctx;
+		assert(ctx->busy & io->flag);
+		__sync_fetch_and_and(&ctx->busy, ~io->flag);
+		uring_dispatch(io, cqes[i].res);
+		aio_socket_release(ctx);
+	}
+	pthread_setspecific(s_defer_key, NULL);
+
+	// submit new request(s) from callback
+	pthread_spin_lock(&s_ring.sqlocker);
+	uring_flush();
+	pthread_spin_unlock(&s_ring.sqlocker);
+	return n;
+}
+
+aio_socket_t aio_socket_create(socket_t socket, int own)
+{
+	struct uring_context* ctx;
+	ctx = (struct uring_context*)calloc(1, sizeof(struct uring_context));
+	if (!ctx)
+		return NULL;
+
+	ctx->own = own;
+	ctx->ref = 1;
+	ctx->socket = socket;
+	ctx->in.ctx = ctx;
+	ctx->in.flag = URING_IN;
+	ctx->out.ctx = ctx;
+	ctx->out.flag = URING_OUT;
+	return ctx;
+}
+
+aio_socket_t aio_socket_create2(socket_t socket, int own, int shard)
+{
+	(void)shard;
+	return aio_socket_create(socket, own);
+}
+
+int aio_socket_edge_triggered(aio_socket_t socket)
+{
+	(void)socket;
+	return ENOTSUP; // completion based, request don't need re-arm(see aio-socket.h)
+}
+
+int aio_socket_destroy(aio_socket_t socket, aio_ondestroy ondestroy, void* param)
+{
+	struct io_uring_sqe* sqe;
+	struct uring_context* ctx = (struct uring_context*)socket;
+	ctx->ondestroy = ondestroy;
+	ctx->param = param;
+
+	// complete in-flight recv/send/accept with error or 0-bytes
+	shutdown(ctx->socket, SHUT_RDWR);
+
+#if defined(IORING_ASYNC_CANCEL_FD)
+	// linux 5.19+, socket don't close until all request completed, so fd can't be reused
+	if (ctx->busy)
+	{
+		pthread_spin_lock(&s_ring.sqlocker);
+		sqe = uring_sqe_get();
+		if (sqe)
+		{
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = ctx->socket;
+			sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+			sqe->user_data = 0;
+			uring_sqe_commit();
+			uring_flush(); // don't defer
+		}
+		pthread_spin_unlock(&s_ring.sqlocker);
+	}
+#else
+	(void)sqe;
+#endif
+
+	aio_socket_release(ctx);
+	return 0;
+}
+
+int aio_socket_accept(aio_socket_t socket, aio_onaccept proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_IN));
+	if (ctx->busy & URING_IN)
+		return EBUSY;
+
+	ctx->in.op = URING_ACCEPT;
+	ctx->in.proc.accept = proc;
+	ctx->in.param = param;
+	ctx->in.addrlen = sizeof(ctx->in.addr);
+	return uring_submit(&ctx->in, IORING_OP_ACCEPT, &ctx->in.addr, 0, (uint64_t)(uintptr_t)&ctx->in.addrlen);
+}
+
+int aio_socket_connect(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, aio_onconnect proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_OUT));
+	if (ctx->busy & URING_OUT)
+		return EBUSY;
+
+	ctx->out.addrlen = addrlen > sizeof(ctx->out.addr) ? sizeof(ctx->out.addr) : addrlen;
+	memcpy(&ctx->out.addr, addr, ctx->out.addrlen);
+	ctx->out.op = URING_CONNECT;
+	ctx->out.proc.connect = proc;
+	ctx->out.param = param;
+	return uring_submit(&ctx->out, IORING_OP_CONNECT, &ctx->out.addr, 0, ctx->out.addrlen);
+}
+
+int aio_socket_recv(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecv proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_IN));
+	if (ctx->busy & URING_IN)
+		return EBUSY;
+
+	ctx->in.op = URING_RECV;
+	ctx->in.proc.recv = proc;
+	ctx->in.param = param;
+	if (0 == bytes)
+	{
+		// zero-byte recv: wait readable only, IORING_OP_RECV complete immediately
+		ctx->in.op = URING_POLL;
+		return uring_submit(&ctx->in, IORING_OP_POLL_ADD, NULL, 0, POLLIN);
+	}
+	return uring_submit(&ctx->in, IORING_OP_RECV, buffer, bytes > UINT_MAX ? UINT_MAX : (unsigned int)bytes, 0);
+}
+
+int aio_socket_send(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_OUT));
+	if (ctx->busy & URING_OUT)
+		return EBUSY;
+
+	ctx->out.op = URING_SEND;
+	ctx->out.proc.send = proc;
+	ctx->out.param = param;
+	return uring_submit(&ctx->out, IORING_OP_SEND, buffer, bytes > UINT_MAX ? UINT_MAX : (unsigned int)bytes, 0);
+}
+
+int aio_socket_recv_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecv proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_IN));
+	if (ctx->busy & URING_IN)
+		return EBUSY;
+
+	memset(&ctx->in.msg, 0, sizeof(ctx->in.msg));
+	ctx->in.msg.msg_iov = (struct iovec*)vec;
+	ctx->in.msg.msg_iovlen = n;
+	ctx->in.op = URING_RECV;
+	ctx->in.proc.recv = proc;
+	ctx->in.param = param;
+	return uring_submit(&ctx->in, IORING_OP_RECVMSG, &ctx->in.msg, 1, 0);
+}
+
+int aio_socket_send_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_OUT));
+	if (ctx->busy & URING_OUT)
+		return EBUSY;
+
+	memset(&ctx->out.msg, 0, sizeof(ctx->out.msg));
+	ctx->out.msg.msg_iov = (struct iovec*)vec;
+	ctx->out.msg.msg_iovlen = n;
+	ctx->out.op = URING_SEND;
+	ctx->out.proc.send = proc;
+	ctx->out.param = param;
+	return uring_submit(&ctx->out, IORING_OP_SENDMSG, &ctx->out.msg, 1, 0);
+}
+
+int aio_socket_recvfrom(aio_socket_t socket, void* buffer, size_t bytes, aio_onrecvfrom proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_IN));
+	if (ctx->busy & URING_IN)
+		return EBUSY;
+
+	ctx->in.iov.iov_base = buffer;
+	ctx->in.iov.iov_len = bytes;
+	memset(&ctx->in.msg, 0, sizeof(ctx->in.msg));
+	ctx->in.msg.msg_name = &ctx->in.addr;
+	ctx->in.msg.msg_namelen = sizeof(ctx->in.addr);
+	ctx->in.msg.msg_iov = &ctx->in.iov;
+	ctx->in.msg.msg_iovlen = 1;
+	ctx->in.op = URING_RECVFROM;
+	ctx->in.proc.recvfrom = proc;
+	ctx->in.param = param;
+	return uring_submit(&ctx->in, IORING_OP_RECVMSG, &ctx->in.msg, 1, 0);
+}
+
+int aio_socket_sendto(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, const void* buffer, size_t bytes, aio_onsend proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_OUT));
+	if (ctx->busy & URING_OUT)
+		return EBUSY;
+
+	ctx->out.addrlen = addrlen > sizeof(ctx->out.addr) ? sizeof(ctx->out.addr) : addrlen;
+	memcpy(&ctx->out.addr, addr, ctx->out.addrlen);
+	ctx->out.iov.iov_base = (void*)buffer;
+	ctx->out.iov.iov_len = bytes;
+	memset(&ctx->out.msg, 0, sizeof(ctx->out.msg));
+	ctx->out.msg.msg_name = &ctx->out.addr;
+	ctx->out.msg.msg_namelen = ctx->out.addrlen;
+	ctx->out.msg.msg_iov = &ctx->out.iov;
+	ctx->out.msg.msg_iovlen = 1;
+	ctx->out.op = URING_SEND;
+	ctx->out.proc.send = proc;
+	ctx->out.param = param;
+	return uring_submit(&ctx->out, IORING_OP_SENDMSG, &ctx->out.msg, 1, 0);
+}
+
+int aio_socket_recvfrom_v(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onrecvfrom proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_IN));
+	if (ctx->busy & URING_IN)
+		return EBUSY;
+
+	memset(&ctx->in.msg, 0, sizeof(ctx->in.msg));
+	ctx->in.msg.msg_name = &ctx->in.addr;
+	ctx->in.msg.msg_namelen = sizeof(ctx->in.addr);
+	ctx->in.msg.msg_iov = (struct iovec*)vec;
+	ctx->in.msg.msg_iovlen = n;
+	ctx->in.op = URING_RECVFROM;
+	ctx->in.proc.recvfrom = proc;
+	ctx->in.param = param;
+	return uring_submit(&ctx->in, IORING_OP_RECVMSG, &ctx->in.msg, 1, 0);
+}
+
+int aio_socket_sendto_v(aio_socket_t socket, const struct sockaddr *addr, socklen_t addrlen, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
+{
+	struct uring_context* ctx = (struct uring_context*)socket;
+	assert(0 == (ctx->busy & URING_OUT));
+	if (ctx->busy & URING_OUT)
+		return EBUSY;
+
+	ctx->out.addrlen = addrlen > sizeof(ctx->out.addr) ? sizeof(ctx->out.addr) : addrlen;
+	memcpy(&ctx->out.addr, addr, ctx->out.addrlen);
+	memset(&ctx->out.msg, 0, sizeof(ctx->out.msg));
+	ctx->out.msg.msg_name = &ctx->out.addr;
+	ctx->out.msg.msg_namelen = ctx->out.addrlen;
+	ctx->out.msg.msg_iov = (struct iovec*)vec;
+	ctx->out.msg.msg_iovlen = n;
+	ctx->out.op = URING_SEND;
+	ctx->out.proc.send = proc;
+	ctx->out.param = param;
+	return uring_submit(&ctx->out, IORING_OP_SENDMSG, &ctx->out.msg, 1, 0);
+}
+
+int aio_socket_send_zc(aio_socket_t socket, const void* buffer, size_t bytes, aio_onsend proc, void* param)
+{
+	return aio_socket_send(socket, buffer, bytes, proc, param);
+}
+
+int aio_socket_send_v_zc(aio_socket_t socket, socket_bufvec_t* vec, int n, aio_onsend proc, void* param)
+{
+	return aio_socket_send_v(socket, vec, n, proc, param);
+}
+
+int aio_socket_sendfile(aio_socket_t socket, int fd, int64_t offset, size_t bytes, aio_onsend proc, void* param)
+{
+	(void)socket, (void)fd, (void)offset, (void)bytes, (void)proc, (void)param;
+	return ENOTSUP;
+}
+
+int aio_socket_recvmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	(void)socket, (void)msgs, (void)n, (void)proc, (void)param;
+	return ENOTSUP;
+}
+
+int aio_socket_sendmmsg(aio_socket_t socket, struct aio_socket_mmsg_t* msgs, int n, aio_onmmsg proc, void* param)
+{
+	(void)socket, (void)msgs, (void)n, (void)proc, (void)param;
+	return ENOTSUP;
+}
@@ -1,11 +1,20 @@
 #include "port/systimer.h"
 
-// Linux link with -lrt
+// Linux: one timerfd dispatcher thread + timing wheel, callback run in thread pool
 
 #if defined(OS_WINDOWS)
 #include <Windows.h>
 #pragma comment(lib, "Winmm.lib")
 #define OS_WINDOWS_TIMER
+#elif defined(OS_LINUX)
+#include "twtimer.h"
+#include "sys/atomic.h"
+#include "sys/locker.h"
+#include "sys/system.h"
+#include "sys/thread.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <time.h>
 #else
 #include <signal.h>
 #include <time.h>
@@ -30,8 +39,12 @@ typedef struct _timer_context_t
 #elif defined(OS_WINDOWS_ASYNC)
 	HANDLE timerId;
 #elif defined(OS_LINUX)
-	timer_t timerId;
-	int ontshot;
+	struct twtimer_t timer;
+	unsigned int period;
+	int oneshot;
+	volatile int32_t ref; // 1-user(stop), 1-wheel, 1-thread pool callback
+	volatile int32_t running; // callback in thread pool
+	volatile int32_t stopped;
 #endif
 } timer_context_t;
 
@@ -43,6 +56,20 @@ struct
 } g_ctx;
 
 #define TIMER_PERIOD 1000
+#elif defined(OS_LINUX)
+static struct
+{
+	thread_pool_t pool;
+	time_wheel_t* wheel;
+	int timerfd;
+	int running;
+	pthread_t thread;
+
+	locker_t locker;
+	uint64_t deadline; // timerfd expire clock
+} g_ctx;
+
+#define TIMER_RESOLUTION 1 // ms
 #endif
 
 #if defined(OS_WINDOWS_TIMER) || defined(OS_WINDOWS_ASYNC)
@@ -92,11 +119,95 @@ static void CALLBACK timer_schd_worker(UINT uTimerID, UINT uMsg, DWORD_PTR dwUse
 	}
 }
 #elif defined(OS_LINUX)
-static void timer_schd_worker(union sigval v)
+static void timer_release(timer_context_t* ctx)
 {
+	if (0 == atomic_decrement32(&ctx->ref))
+		free(ctx);
+}
+
+/// wake up dispatcher thread before deadline, MUST hold g_ctx.locker
+static void timer_setdeadline(uint64_t deadline)
+{
+	struct itimerspec tv;
+	if (deadline >= g_ctx.deadline)
+		return;
+
+	g_ctx.deadline = deadline;
+	memset(&tv, 0, sizeof(tv));
+	tv.it_value.tv_sec = deadline / 1000;
+	tv.it_value.tv_nsec = (deadline % 1000) * 1000000;
+	timerfd_settime(g_ctx.timerfd, TFD_TIMER_ABSTIME, &tv, NULL); // same clock as system_clock
+}
+
+static void timer_thread_worker(void *param)
+{
+	timer_context_t* ctx;
+	ctx = (timer_context_t*)param;
+	if (0 == atomic_load32(&ctx->stopped))
+		ctx->callback((systimer_t)ctx, ctx->cbparam);
+	atomic_cas32(&ctx->running, 1, 0);
+	timer_release(ctx);
+}
+
+// dispatcher thread, wheel lock released
+static void timer_schd_worker(void *param)
+{
+	uint64_t clock;
 	timer_context_t* ctx;
-	ctx = (timer_context_t*)v.sival_ptr;
-	ctx->callback((systimer_t)ctx, ctx->cbparam);
+	ctx = (timer_context_t*)param;
+
+	atomic_increment32(&ctx->ref); // hold, timer can be stopped by other thread
+	if (!ctx->oneshot && 0 == atomic_load32(&ctx->stopped))
+	{
+		// wheel ref for next period, skip missed periods
+		clock = system_clock();
+		ctx->timer.expire += ctx->period;
+		if (ctx->timer.expire < clock)
+			ctx->timer.expire = clock;
+		if (0 != twtimer_start(g_ctx.wheel, &ctx->timer)
+			|| (atomic_load32(&ctx->stopped) && 0 == twtimer_stop(g_ctx.wheel, &ctx->timer)))
+			timer_release(ctx);
+	}
+	else
+	{
+		timer_release(ctx); // wheel ref
+	}
+
+	// one timer only can be call in one thread
+	if (0 == atomic_load32(&ctx->stopped) && atomic_cas32(&ctx->running, 0, 1))
+	{
+		atomic_increment32(&ctx->ref);
+		if (NULL == g_ctx.pool || 0 != thread_pool_push(g_ctx.pool, timer_thread_worker, ctx))
+			timer_thread_worker(ctx); // run in dispatcher thread
+	}
+
+	timer_release(ctx);
+}
+
+static int STDCALL timer_dispatch_thread(void* param)
+{
+	int r;
+	uint64_t clock;
+	uint64_t value;
+	(void)param;
+
+	while (g_ctx.running)
+	{
+		// timer started from now on update deadline
+		locker_lock(&g_ctx.locker);
+		g_ctx.deadline = UINT64_MAX;
+		locker_unlock(&g_ctx.locker);
+
+		clock = system_clock();
+		r = twtimer_process(g_ctx.wheel, clock);
+
+		locker_lock(&g_ctx.locker);
+		timer_setdeadline(clock + r);
+		locker_unlock(&g_ctx.locker);
+
+		r = (int)read(g_ctx.timerfd, &value, sizeof(value)); // EINTR
+	}
+	return 0;
 }
 #else
 static int timer_schd_worker(void *param)
@@ -109,12 +220,49 @@ int systimer_init(thread_pool_t pool)
 #if defined(OS_WINDOWS_TIMER)
 	timeGetDevCaps(&g_ctx.tc, sizeof(TIMECAPS));
 	g_ctx.pool = pool;
+#elif defined(OS_LINUX)
+	int r;
+	g_ctx.pool = pool;
+	g_ctx.deadline = UINT64_MAX;
+	g_ctx.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (-1 == g_ctx.timerfd)
+		return -errno;
+
+	g_ctx.wheel = time_wheel_create2(system_clock(), TIMER_RESOLUTION);
+	if (NULL == g_ctx.wheel)
+	{
+		close(g_ctx.timerfd);
+		return -ENOMEM;
+	}
+
+	locker_create(&g_ctx.locker);
+	g_ctx.running = 1;
+	r = thread_create(&g_ctx.thread, timer_dispatch_thread, NULL);
+	if (0 != r)
+	{
+		locker_destroy(&g_ctx.locker);
+		time_wheel_destroy(g_ctx.wheel);
+		close(g_ctx.timerfd);
+		return -r;
+	}
 #endif
 	return 0;
 }
 
 int systimer_clean(void)
 {
+#if defined(OS_LINUX)
+	// wake up dispatcher thread
+	g_ctx.running = 0;
+	locker_lock(&g_ctx.locker);
+	timer_setdeadline(1);
+	locker_unlock(&g_ctx.locker);
+	thread_destroy(g_ctx.thread);
+
+	locker_destroy(&g_ctx.locker);
+	time_wheel_destroy(g_ctx.wheel);
+	close(g_ctx.timerfd);
+#endif
 	return 0;
 }
 
@@ -155,38 +303,31 @@ static int systimer_create(systimer_t* id, unsigned int period, int oneshot, sys
 #elif defined(OS_LINUX)
 static int systimer_create(systimer_t* id, unsigned int period, int oneshot, systimer_proc callback, void* cbparam)
 {
-	struct sigevent sev;
-	struct itimerspec tv;
 	timer_context_t* ctx;
 
 	ctx = (timer_context_t*)malloc(sizeof(timer_context_t));
 	if(!ctx)
-		return -ENOMEM;;
+		return -ENOMEM;
 
 	memset(ctx, 0, sizeof(timer_context_t));
 	ctx->callback = callback;
 	ctx->cbparam = cbparam;
+	ctx->period = period;
+	ctx->oneshot = oneshot;
+	ctx->ref = 2; // user + wheel
 
-	memset(&sev, 0, sizeof(sev));
-	sev.sigev_notify = SIGEV_THREAD;
-	sev.sigev_value.sival_ptr = ctx;
-	sev.sigev_notify_function = timer_schd_worker;
-	if(0 != timer_create(CLOCK_MONOTONIC, &sev, &ctx->timerId))
+	ctx->timer.param = ctx;
+	ctx->timer.ontimeout = timer_schd_worker;
+	ctx->timer.expire = system_clock() + period;
+	if(0 != twtimer_start(g_ctx.wheel, &ctx->timer))
 	{
 		free(ctx);
-		return -errno;
+		return -EINVAL;
 	}
 
-	tv.it_interval.tv_sec = period / 1000;
-	tv.it_interval.tv_nsec = (period % 1000) * 1000000; // 10(-9)second
-	tv.it_value.tv_sec = tv.it_interval.tv_sec;
-	tv.it_value.tv_nsec = tv.it_interval.tv_nsec;
-	if(0 != timer_settime(ctx->timerId, 0, &tv, NULL))
-	{
-		timer_delete(ctx->timerId);
-		free(ctx);
-		return -errno;
-	}
+	locker_lock(&g_ctx.locker);
+	timer_setdeadline(ctx->timer.expire);
+	locker_unlock(&g_ctx.locker);
 
 	*id = (systimer_t)ctx;
 	return 0;
@@ -255,7 +396,12 @@ int systimer_stop(systimer_t id)
 		timer_destroy(ctx);
 	return 0;
 #elif defined(OS_LINUX)
-	timer_delete(ctx->timerId);
+	if(!atomic_cas32(&ctx->stopped, 0, 1))
+		return -EINVAL;
+	if(0 == twtimer_stop(g_ctx.wheel, &ctx->timer))
+		timer_release(ctx); // wheel ref
+	timer_release(ctx); // callback maybe running in thread pool
+	return 0;
 #elif defined(OS_WINDOWS_ASYNC)
 	CloseHandle(ctx->timerId);
 #else
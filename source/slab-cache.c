@@ -0,0 +1,264 @@
+#include "slab-cache.h"
+#include "sys/locker.h"
+#include "list.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(OS_WINDOWS)
+#include <malloc.h>
+typedef DWORD slab_key_t;
+#else
+#include <pthread.h>
+typedef pthread_key_t slab_key_t;
+#endif
+
+#define SLAB_CACHE_LINE 64
+
+struct slab_object_t
+{
+	struct slab_object_t* next;
+};
+
+// one per thread per cache
+struct slab_cache_local_t
+{
+	struct list_head link;
+	struct slab_cache_t* cache;
+
+	struct slab_object_t* head;
+	int count;
+
+	int64_t alloc;
+	int64_t hit;
+	int64_t free;
+};
+
+struct slab_cache_t
+{
+	size_t size;
+	int capacity;
+	slab_key_t key;
+
+	locker_t locker;
+	struct list_head locals; // struct slab_cache_local_t
+
+	// exited threads counters
+	int64_t alloc;
+	int64_t hit;
+	int64_t free;
+};
+
+static void* slab_object_alloc(size_t size)
+{
+#if defined(OS_WINDOWS)
+	return _aligned_malloc(size, SLAB_CACHE_LINE);
+#else
+	void* ptr;
+	return 0 == posix_memalign(&ptr, SLAB_CACHE_LINE, size) ? ptr : NULL;
+#endif
+}
+
+static void slab_object_free(void* ptr)
+{
+#if defined(OS_WINDOWS)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+static void slab_cache_local_clear(struct slab_cache_local_t* local)
+{
+	struct slab_object_t* obj;
+	while (local->head)
+	{
+		obj = local->head;
+		local->head = obj->next;
+		slab_object_free(obj);
+	}
+	local->count = 0;
+}
+
+// thread exit
+#if defined(OS_WINDOWS)
+static void WINAPI slab_cache_local_ondestroy(void* param)
+#else
+static void slab_cache_local_ondestroy(void* param)
+#endif
+{
+	struct slab_cache_t* cache;
+	struct slab_cache_local_t* local;
+	local = (struct slab_cache_local_t*)param;
+	if (NULL == local)
+		return;
+
+	cache = local->cache;
+	locker_lock(&cache->locker);
+	list_remove(&local->link);
+	cache->alloc += local->alloc;
+	cache->hit += local->hit;
+	cache->free += local->free;
+	locker_unlock(&cache->locker);
+
+	slab_cache_local_clear(local);
+	free(local);
+}
+
+static struct slab_cache_local_t* slab_cache_local(struct slab_cache_t* cache)
+{
+	struct slab_cache_local_t* local;
+#if defined(OS_WINDOWS)
+	local = (struct slab_cache_local_t*)FlsGetValue(cache->key);
+#else
+	local = (struct slab_cache_local_t*)pthread_getspecific(cache->key);
+#endif
+	if (local)
+		return local;
+
+	local = (struct slab_cache_local_t*)calloc(1, sizeof(*local));
+	if (NULL == local)
+		return NULL;
+
+	local->cache = cache;
+#if defined(OS_WINDOWS)
+	if (!FlsSetValue(cache->key, local))
+#else
+	if (0 != pthread_setspecific(cache->key, local))
+#endif
+	{
+		free(local);
+		return NULL;
+	}
+
+	locker_lock(&cache->locker);
+	list_insert_after(&local->link, &cache->locals);
+	locker_unlock(&cache->locker);
+	return local;
+}
+
+struct slab_cache_t* slab_cache_create(size_t size, int capacity)
+{
+	struct slab_cache_t* cache;
+	cache = (struct slab_cache_t*)calloc(1, sizeof(*cache));
+	if (NULL == cache)
+		return NULL;
+
+	size = size > sizeof(struct slab_object_t) ? size : sizeof(struct slab_object_t);
+	cache->size = (size + SLAB_CACHE_LINE - 1) / SLAB_CACHE_LINE * SLAB_CACHE_LINE;
+	cache->capacity = capacity > 0 ? capacity : 0;
+	LIST_INIT_HEAD(&cache->locals);
+
+#if defined(OS_WINDOWS)
+	cache->key = FlsAlloc(slab_cache_local_ondestroy);
+	if (FLS_OUT_OF_INDEXES == cache->key)
+#else
+	if (0 != pthread_key_create(&cache->key, slab_cache_local_ondestroy))
+#endif
+	{
+		free(cache);
+		return NULL;
+	}
+
+	locker_create(&cache->locker);
+	return cache;
+}
+
+void slab_cache_destroy(struct slab_cache_t* cache)
+{
+	struct list_head *pos, *next;
+	struct slab_cache_local_t* local;
+
+	// don't call thread exit destructor any more
+#if defined(OS_WINDOWS)
+	FlsFree(cache->key);
+#else
+	pthread_key_delete(cache->key);
+#endif
+
+	locker_lock(&cache->locker);
+	list_for_each_safe(pos, next, &cache->locals)
+	{
+		local = list_entry(pos, struct slab_cache_local_t, link);
+		list_remove(pos);
+		slab_cache_local_clear(local);
+		free(local);
+	}
+	locker_unlock(&cache->locker);
+
+	locker_destroy(&cache->locker);
+	free(cache);
+}
+
+void* slab_cache_alloc(struct slab_cache_t* cache)
+{
+	struct slab_object_t* obj;
+	struct slab_cache_local_t* local;
+
+	obj = NULL;
+	local = cache->capacity > 0 ? slab_cache_local(cache) : NULL;
+	if (local)
+	{
+		local->alloc++;
+		obj = local->head;
+		if (obj)
+		{
+			local->head = obj->next;
+			local->count--;
+			local->hit++;
+		}
+	}
+
+	if (NULL == obj)
+		obj = (struct slab_object_t*)slab_object_alloc(cache->size);
+	if (obj)
+		memset(obj, 0, cache->size);
+	return obj;
+}
+
+void slab_cache_free(struct slab_cache_t* cache, void* ptr)
+{
+	struct slab_object_t* obj;
+	struct slab_cache_local_t* local;
+
+	if (NULL == ptr)
+		return;
+
+	obj = (struct slab_object_t*)ptr;
+	local = cache->capacity > 0 ? slab_cache_local(cache) : NULL;
+	if (local)
+	{
+		local->free++;
+		if (local->count < cache->capacity)
+		{
+			obj->next = local->head;
+			local->head = obj;
+			local->count++;
+			return;
+		}
+	}
+
+	// free list full, return to system
+	slab_object_free(obj);
+}
+
+void slab_cache_stats(struct slab_cache_t* cache, struct slab_cache_stats_t* stats)
+{
+	struct list_head *pos;
+	struct slab_cache_local_t* local;
+
+	locker_lock(&cache->locker);
+	stats->alloc = cache->alloc;
+	stats->hit = cache->hit;
+	stats->free = cache->free;
+	stats->cached = 0;
+	list_for_each(pos, &cache->locals)
+	{
+		local = list_entry(pos, struct slab_cache_local_t, link);
+		stats->alloc += local->alloc;
+		stats->hit += local->hit;
+		stats->free += local->free;
+		stats->cached += local->count;
+	}
+	locker_unlock(&cache->locker);
+}
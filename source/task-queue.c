@@ -6,9 +6,17 @@
 #include "sys/sema.h"
 #include "thread-pool.h"
 #include "list.h"
+#include <string.h>
 #include <errno.h>
 
-enum { PRIORITY_IDLE=0, PRIORITY_LOWEST, PRIORITY_NORMAL, PRIORITY_CRITICAL };
+// Priority/deadline scheduler
+// 1. one queue per priority, the scheduler take the highest priority first
+// 2. in the same priority, earliest deadline first(EDF), no deadline task sort by post time + TASK_QUEUE_HORIZON
+// 3. aging: the waiting task priority increase one level per TASK_QUEUE_AGING ms(lower priority don't starve)
+// 4. the task don't start before the deadline is dropped(proc will not be called)
+
+#define TASK_QUEUE_AGING	200 // ms per priority level
+#define TASK_QUEUE_HORIZON	1000 // ms, no deadline task EDF sort key
 
 typedef struct _task_queue_context_t
 {
@@ -22,10 +30,11 @@ typedef struct _task_queue_context_t
 	sema_t sema_request;
 
 	locker_t locker;
-	struct list_head tasks;
+	struct list_head tasks[PRIORITY_CRITICAL + 1];
 	struct list_head tasks_recycle;
 	size_t tasks_count;
 	size_t tasks_recycle_count;
+	struct thread_pool_stats_t stats; // with locker
 } task_queue_context_t;
 
 typedef struct _task_context_t
@@ -33,12 +42,13 @@ typedef struct _task_context_t
 	struct list_head head;
 
 	task_queue_context_t *taskQ;
-	int timeout;
+	int timeout; // deadline(ms) from stime, 0-no deadline
 	task_proc proc;
 	void* param;
 
 	uint64_t stime;
 	uint64_t etime;
+	uint64_t clock; // post time(us)
 	tid_t thread;
 	int priority;
 } task_context_t;
@@ -83,6 +93,7 @@ static void task_recycle(task_queue_context_t* taskQ, task_context_t* task)
 
 static void task_clean(task_queue_context_t* taskQ)
 {
+	int i;
 	task_context_t *task;
 	struct list_head *p, *n;
 	list_for_each_safe(p, n, &taskQ->tasks_recycle)
@@ -91,51 +102,86 @@ static void task_clean(task_queue_context_t* taskQ)
 		free(task);
 	}
 
-	list_for_each_safe(p, n, &taskQ->tasks)
+	for(i = 0; i <= PRIORITY_CRITICAL; i++)
 	{
-		task = list_entry(p, task_context_t, head);
-		free(task);
+		list_for_each_safe(p, n, &taskQ->tasks[i])
+		{
+			task = list_entry(p, task_context_t, head);
+			free(task);
+		}
 	}
 }
 
-static void task_push(task_queue_context_t* taskQ, task_context_t* task)
+/// EDF sort key
+static uint64_t task_deadline(const task_context_t* task)
 {
-	list_insert_after(&task->head, taskQ->tasks.prev);
-	assert(taskQ->tasks_count >= 0);
-	++taskQ->tasks_count;
+	return task->stime + (task->timeout > 0 ? task->timeout : TASK_QUEUE_HORIZON);
 }
 
-static task_context_t* task_pop(task_queue_context_t* taskQ)
+static void task_push(task_queue_context_t* taskQ, task_context_t* task)
 {
-	task_context_t* task;
-	if(list_empty(&taskQ->tasks))
-		return NULL;
+	uint64_t deadline;
+	struct list_head *p, *tasks;
 
-	assert(taskQ->tasks_count > 0);
-	--taskQ->tasks_count;
-	task = list_entry(taskQ->tasks.next, task_context_t, head);
-	list_remove(taskQ->tasks.next);
-	return task;
+	// insert by deadline, search from tail(deadline almost increasing)
+	deadline = task_deadline(task);
+	tasks = &taskQ->tasks[task->priority];
+	for(p = tasks->prev; p != tasks; p = p->prev)
+	{
+		if(task_deadline(list_entry(p, task_context_t, head)) <= deadline)
+			break;
+	}
+
+	list_insert_after(&task->head, p);
+	assert(taskQ->tasks_count >= 0);
+	++taskQ->tasks_count;
 }
 
-static task_context_t* task_pop_timeout(task_queue_context_t* taskQ)
+static task_context_t* task_pop(task_queue_context_t* taskQ)
 {
+	int i, level, best;
 	uint64_t clock;
-	task_context_t *task;
-	struct list_head *p, *next;
+	task_context_t *task, *next;
+	struct list_head *tasks;
 
+	next = NULL;
+	best = -1;
 	clock = system_clock();
-	list_for_each_safe(p, next, &taskQ->tasks)
+	for(i = PRIORITY_CRITICAL; i >= PRIORITY_IDLE; i--)
 	{
-		task = list_entry(p, task_context_t, head);
-		if(clock - task->stime > (size_t)task->timeout)
+		tasks = &taskQ->tasks[i];
+		while(!list_empty(tasks))
 		{
-			list_remove(p);
-			return task;
+			task = list_entry(tasks->next, task_context_t, head);
+			if(task->timeout <= 0 || clock <= task->stime + task->timeout)
+			{
+				// aging
+				level = i + (int)((clock - task->stime) / TASK_QUEUE_AGING);
+				if(level > best)
+				{
+					best = level;
+					next = task;
+				}
+				break;
+			}
+
+			// expired: drop
+			list_remove(&task->head);
+			assert(taskQ->tasks_count > 0);
+			--taskQ->tasks_count;
+			++taskQ->stats.dropped;
+			task_recycle(taskQ, task);
 		}
 	}
 
-	return NULL;
+	if(next)
+	{
+		assert(taskQ->tasks_count > 0);
+		--taskQ->tasks_count;
+		++taskQ->stats.busy;
+		list_remove(&next->head);
+	}
+	return next;
 }
 
 static void task_queue_relase(task_queue_context_t* taskQ)
@@ -153,17 +199,24 @@ static void task_queue_relase(task_queue_context_t* taskQ)
 
 static void task_action(void* param)
 {
+	uint64_t clock, run;
 	task_context_t* task;
 	task_queue_context_t* taskQ;
 	task = (task_context_t*)param;
 	taskQ = task->taskQ;
 
+	clock = system_clock_us();
 	if(task->proc)
 		task->proc(task->param);
+	run = system_clock_us() - clock;
 
 	task->etime = system_clock();
 	task->thread = thread_getid(thread_self());
 	locker_lock(&taskQ->locker);
+	thread_pool_stats_add(taskQ->stats.wait, clock > task->clock ? clock - task->clock : 0);
+	thread_pool_stats_add(taskQ->stats.run, run);
+	++taskQ->stats.completed;
+	--taskQ->stats.busy;
 	task_recycle(taskQ, task); // recycle task
 	locker_unlock(&taskQ->locker);
 
@@ -188,13 +241,17 @@ static int STDCALL task_queue_scheduler(void* param)
 			task = task_pop(taskQ);
 			locker_unlock(&taskQ->locker);
 
-			assert(task);
 			if(task)
 			{
 				atomic_increment32(&taskQ->ref);
 				r = thread_pool_push(taskQ->pool, task_action, task);
 				assert(0 == r);
 			}
+			else
+			{
+				// the task have been dropped(expired)
+				sema_post(&taskQ->sema_worker);
+			}
 		}
 	}
 
@@ -202,10 +259,18 @@ static int STDCALL task_queue_scheduler(void* param)
 }
 
 int task_queue_post(task_queue_t q, task_proc proc, void* param)
+{
+	return task_queue_post2(q, PRIORITY_NORMAL, 0, proc, param);
+}
+
+int task_queue_post2(task_queue_t q, int priority, int deadline, task_proc proc, void* param)
 {
 	task_context_t* task;
 	task_queue_context_t *taskQ;
 
+	if(priority < PRIORITY_IDLE || priority > PRIORITY_CRITICAL)
+		return -EINVAL;
+
 	taskQ = (task_queue_context_t *)q;
 	locker_lock(&taskQ->locker);
 	task = task_alloc(taskQ);
@@ -215,20 +280,56 @@ int task_queue_post(task_queue_t q, task_proc proc, void* param)
 
 	task->taskQ = taskQ;
 	task->stime = system_clock();
-	task->timeout = 5000;
-	task->priority = 0;
+	task->clock = system_clock_us();
+	task->timeout = deadline > 0 ? deadline : 0;
+	task->priority = priority;
 	task->proc = proc;
 	task->param = param;
 	locker_lock(&taskQ->locker);
 	task_push(taskQ, task);
+	++taskQ->stats.submitted;
 	locker_unlock(&taskQ->locker);
 
 	return sema_post(&taskQ->sema_request);
 }
 
+int task_queue_post_batch(task_queue_t q, const task_proc procs[], void* const params[], int n)
+{
+	int i, j;
+	uint64_t clock, us;
+	task_context_t* task;
+	task_queue_context_t *taskQ;
+
+	taskQ = (task_queue_context_t *)q;
+	clock = system_clock();
+	us = system_clock_us();
+	locker_lock(&taskQ->locker);
+	for(i = 0; i < n; i++)
+	{
+		task = task_alloc(taskQ);
+		if(!task)
+			break;
+
+		task->taskQ = taskQ;
+		task->stime = clock;
+		task->clock = us;
+		task->timeout = 0;
+		task->priority = PRIORITY_NORMAL;
+		task->proc = procs[i];
+		task->param = params[i];
+		task_push(taskQ, task);
+	}
+	taskQ->stats.submitted += i;
+	locker_unlock(&taskQ->locker);
+
+	for(j = 0; j < i; j++)
+		sema_post(&taskQ->sema_request);
+	return i > 0 || n < 1 ? i : -ENOMEM;
+}
+
 task_queue_t task_queue_create(thread_pool_t pool, int maxWorker)
 {
-	int r;
+	int i, r;
 	task_queue_context_t* taskQ;
 	taskQ = (task_queue_context_t*)malloc(sizeof(task_queue_context_t));
 	if(taskQ)
@@ -237,8 +338,11 @@ task_queue_t task_queue_create(thread_pool_t pool, int maxWorker)
 		taskQ->running = 1;
 		taskQ->pool = pool;
 		taskQ->maxWorker = maxWorker;
+		taskQ->tasks_count = 0;
 		taskQ->tasks_recycle_count = 0;
-		LIST_INIT_HEAD(&taskQ->tasks);
+		memset(&taskQ->stats, 0, sizeof(taskQ->stats));
+		for(i = 0; i <= PRIORITY_CRITICAL; i++)
+			LIST_INIT_HEAD(&taskQ->tasks[i]);
 		LIST_INIT_HEAD(&taskQ->tasks_recycle);
 
 		r = locker_create(&taskQ->locker);
@@ -259,6 +363,19 @@ task_queue_t task_queue_create(thread_pool_t pool, int maxWorker)
 	return taskQ;
 }
 
+int task_queue_stats(task_queue_t q, struct thread_pool_stats_t* stats)
+{
+	task_queue_context_t* taskQ;
+	taskQ = (task_queue_context_t*)q;
+
+	locker_lock(&taskQ->locker);
+	memcpy(stats, &taskQ->stats, sizeof(*stats));
+	stats->depth = (int)taskQ->tasks_count;
+	stats->threads = taskQ->maxWorker;
+	locker_unlock(&taskQ->locker);
+	return 0;
+}
+
 int task_queue_destroy(task_queue_t q)
 {
 	task_queue_context_t* taskQ;
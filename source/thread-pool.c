@@ -1,247 +1,843 @@
+#if defined(OS_LINUX) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
 #include "thread-pool.h"
 #include "sys/locker.h"
 #include "sys/system.h"
 #include "sys/thread.h"
+#include "sys/atomic.h"
+#include "sys/onetime.h"
+#include "sys/tls.h"
 #include "sys/event.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdio.h>
 #include <assert.h>
+#if defined(OS_LINUX)
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#else
+#include "sys/sema.h"
+#endif
 
-struct _thread_pool_context_t;
-typedef struct _thread_list_t
-{
-	struct _thread_list_t *next;
-	struct _thread_pool_context_t *pool;
-	pthread_t thread;
-} thread_list_t;
+// Work-stealing thread pool
+// 1. every worker own a Chase-Lev deque: push/pop bottom by the owner(LIFO), steal top by others(FIFO)
+// 2. thread_pool_push from worker thread push to its own deque, other threads push to the injection queue
+// 3. injection queue is a bounded lock-free MPMC ring, overflow to a locked list of task segments(no malloc per task)
+// 4. idle worker steal from other workers, park(futex) after nothing found
+//    at most cpus/2 workers spin searching, one wakeup in flight(the woken worker wake up the next one)
+//    shared counters are read without atomic_load32(a locked write), worker is counted busy until nothing found
+// 5. thread count: start with num threads, add one if no idle thread(max), idle thread exit if idle > num(min)
+// 6. batch push wake up workers once, latch wait in worker thread run tasks(help) instead of block
+// 7. affinity: worker slot i bind to a cpu by policy(compact/scatter NUMA nodes, explicit list)
+// 8. statistics: every worker own its counters(single writer, no atomic), merged on read,
+//    wait/run time sampled one per THREAD_POOL_SAMPLE tasks(clock is not free)
+
+#define THREAD_POOL_DEQUE	256 // per-worker deque capacity(power of 2), overflow to injection queue
+#define THREAD_POOL_INJECT	4096 // injection ring capacity(power of 2), overflow to locked list
+#define THREAD_POOL_SEGMENT	256 // overflow tasks per segment
+#define THREAD_POOL_BATCH	32 // overflow tasks moved to worker deque at once
+#define THREAD_POOL_SPIN	4 // steal rounds before park
+#define THREAD_POOL_PARK	(60 * 1000) // ms
+#define THREAD_POOL_CHUNKS	4 // parallel_for auto grain: chunks per thread
+#define THREAD_POOL_SAMPLE	16 // timing sample rate(power of 2)
+#define THREAD_POOL_CPUS	1024
+#define THREAD_POOL_NODES	64
 
-typedef struct _thread_task_list_t
+struct thread_pool_task_t
 {
-	struct _thread_task_list_t *next;
 	thread_pool_proc proc;
 	void *param;
-} thread_task_list_t;
+	uint64_t clock; // push time(us), 0-don't sample
+};
+
+struct thread_pool_cell_t
+{
+	volatile int64_t seq;
+	struct thread_pool_task_t task;
+};
+
+struct thread_pool_overflow_t
+{
+	struct thread_pool_overflow_t *next;
+	int head; // pop
+	int tail; // push
+	struct thread_pool_task_t tasks[THREAD_POOL_SEGMENT];
+};
+
+struct thread_pool_deque_t
+{
+	volatile int64_t top; // steal
+	char pad[64 - sizeof(int64_t)]; // false sharing
+	volatile int64_t bottom; // owner push/pop
+	struct thread_pool_task_t tasks[THREAD_POOL_DEQUE];
+};
+
+struct thread_pool_counter_t
+{
+	uint64_t submitted; // push from the worker thread
+	uint64_t completed;
+	uint64_t wait[THREAD_POOL_HISTOGRAM];
+	uint64_t run[THREAD_POOL_HISTOGRAM];
+};
+
+struct _thread_pool_context_t;
+struct thread_pool_worker_t
+{
+	struct thread_pool_deque_t deque; // keep valid until pool destroy(other workers steal it)
+	struct thread_pool_counter_t counter; // keep after thread exit
+	struct _thread_pool_context_t *pool;
+	pthread_t thread;
+	int used; // slot in use
+	uint32_t seed; // victim random
+};
 
 typedef struct _thread_pool_context_t
 {
-	int run;
+	volatile int32_t run;
 	int idle_max;
-	int threshold;
+	int search_max; // spinning searchers at most(half of cpus), the others park after one round
 
-	int thread_count;
+	volatile int32_t thread_count;
 	int thread_count_min;
 	int thread_count_max;
-	int thread_count_idle;
+	volatile int32_t thread_count_idle; // looking for task or parked
+	volatile int32_t thread_count_parked;
+	volatile int32_t waking; // 1-a parked worker was woken up and don't search yet
+	volatile int32_t futex; // wakeup sequence
+#if !defined(OS_LINUX)
+	sema_t sema;
+#endif
 
-	int task_count;
-	thread_task_list_t *tasks;
-	thread_task_list_t *recycle_tasks;
+	// injection queue
+	volatile int64_t head;
+	char pad1[64 - sizeof(int64_t)];
+	volatile int64_t tail;
+	char pad2[64 - sizeof(int64_t)];
+	struct thread_pool_cell_t cells[THREAD_POOL_INJECT];
+	volatile int32_t overflow;
+	struct thread_pool_overflow_t *overflow_head;
+	struct thread_pool_overflow_t *overflow_tail;
+	struct thread_pool_overflow_t *overflow_free; // one spare segment
 
-	thread_list_t *task_threads;
+	volatile int64_t submitted; // push from other threads
+	volatile int64_t dropped;
 
-	locker_t locker;
-	event_t event;
+	struct thread_affinity_t affinity; // cpus copy
 
+	locker_t locker; // overflow list and thread create/exit
+	struct thread_pool_worker_t *workers; // thread_count_max slots
 } thread_pool_context_t;
 
-static void thread_pool_destroy_thread(thread_pool_context_t *context);
+struct thread_pool_latch_t
+{
+	volatile int32_t count;
+	volatile int32_t busy; // thread_pool_latch_done in progress
+	event_t event;
+};
 
-static int STDCALL thread_pool_worker(void *param)
+struct thread_pool_range_t
 {
-	thread_list_t* threads;
-	thread_task_list_t *task;
-	thread_pool_context_t *context;
+	thread_pool_range_proc proc;
+	void *param;
+	volatile int64_t next; // next chunk index(don't overflow near INT64_MAX)
+	int64_t chunks;
+	int64_t begin;
+	int64_t end;
+	int64_t grain;
+	struct thread_pool_latch_t latch;
+};
 
-	threads = (thread_list_t*)param;
-	context = threads->pool;
+static void thread_pool_range_worker(void *param);
 
-	locker_lock(&context->locker);
-	while(context->run)
+static tlskey_t s_key; // current worker
+static onetime_t s_init = ONETIME_INIT;
+
+// online cpus, sorted by NUMA node
+static struct
+{
+	int count;
+	int cpus[THREAD_POOL_CPUS];
+	int nodes;
+	int first[THREAD_POOL_NODES]; // node first cpu index
+	int size[THREAD_POOL_NODES]; // node cpu count
+} s_topology;
+static onetime_t s_topology_init = ONETIME_INIT;
+
+static void thread_pool_init(void)
+{
+	tls_create(&s_key);
+}
+
+#if defined(OS_LINUX)
+/// parse cpulist, e.g. 0-3,8-11
+static void thread_pool_topology_node(const char* list, const cpu_set_t* allowed)
+{
+	int from, to;
+	char *end;
+
+	while (*list && s_topology.count < THREAD_POOL_CPUS)
 	{
-		// pop task
-		task = context->tasks;
-		while(task && context->run)
+		from = (int)strtol(list, &end, 10);
+		if (end == list)
+			break;
+		to = '-' == *end ? (int)strtol(end + 1, &end, 10) : from;
+		for (; from <= to && s_topology.count < THREAD_POOL_CPUS; from++)
 		{
-			// remove task from task list
-			context->tasks = task->next;
-			--context->task_count;
-
-			// do task procedure
-			--context->thread_count_idle;
-			locker_unlock(&context->locker);
-			task->proc(task->param);
-			locker_lock(&context->locker);
-			++context->thread_count_idle;
-
-			// recycle task: push task to recycle list
-			task->next = context->recycle_tasks;
-			context->recycle_tasks = task;
-
-			// do next
-			task = context->tasks;
+			if (from < CPU_SETSIZE && CPU_ISSET(from, allowed))
+				s_topology.cpus[s_topology.count++] = from;
 		}
+		list = ',' == *end ? end + 1 : end;
+	}
+}
+#endif
 
-		// delete idle thread
-		if(context->thread_count_idle > context->idle_max
-			|| !context->run)
-			break;
+static void thread_pool_topology(void)
+{
+	int i, n;
+#if defined(OS_LINUX)
+	FILE* fp;
+	char path[64];
+	char list[1024];
+	cpu_set_t allowed;
+
+	CPU_ZERO(&allowed);
+	if (0 != sched_getaffinity(0, sizeof(allowed), &allowed))
+	{
+		for (i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &allowed);
+	}
+
+	for (i = 0; i < THREAD_POOL_NODES && s_topology.count < THREAD_POOL_CPUS; i++)
+	{
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", i);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue; // node id maybe not continuous
+		n = s_topology.count;
+		if (fgets(list, sizeof(list), fp))
+			thread_pool_topology_node(list, &allowed);
+		fclose(fp);
+
+		if (s_topology.count > n)
+		{
+			s_topology.first[s_topology.nodes] = n;
+			s_topology.size[s_topology.nodes++] = s_topology.count - n;
+		}
+	}
+
+	// no NUMA information: one node
+	if (0 == s_topology.count)
+	{
+		for (i = 0; i < CPU_SETSIZE && s_topology.count < THREAD_POOL_CPUS; i++)
+		{
+			if (CPU_ISSET(i, &allowed))
+				s_topology.cpus[s_topology.count++] = i;
+		}
+	}
+#endif
 
-		// wait for task
-		locker_unlock(&context->locker);
-		event_timewait(&context->event, 60*1000);
-		locker_lock(&context->locker);
+	if (0 == s_topology.count)
+	{
+		n = (int)system_getcpucount();
+		for (i = 0; i < n && i < THREAD_POOL_CPUS; i++)
+			s_topology.cpus[s_topology.count++] = i;
 	}
 
-	--context->thread_count;
-	--context->thread_count_idle;
-	thread_pool_destroy_thread(context);
-	locker_unlock(&context->locker);
+	if (0 == s_topology.nodes)
+	{
+		s_topology.nodes = 1;
+		s_topology.first[0] = 0;
+		s_topology.size[0] = s_topology.count;
+	}
+}
 
+int thread_affinity_topology(const int cpus[], const int sizes[], int nodes)
+{
+	int i, n;
+	onetime_exec(&s_topology_init, thread_pool_topology);
+	if (!cpus)
+	{
+		memset(&s_topology, 0, sizeof(s_topology));
+		thread_pool_topology();
+		return 0;
+	}
+
+	if (nodes < 1 || nodes > THREAD_POOL_NODES)
+		return EINVAL;
+	for (n = i = 0; i < nodes; i++)
+	{
+		if (sizes[i] < 1)
+			return EINVAL;
+		n += sizes[i];
+	}
+	if (n > THREAD_POOL_CPUS)
+		return EINVAL;
+
+	memcpy(s_topology.cpus, cpus, n * sizeof(cpus[0]));
+	for (n = i = 0; i < nodes; n += sizes[i++])
+	{
+		s_topology.first[i] = n;
+		s_topology.size[i] = sizes[i];
+	}
+	s_topology.nodes = nodes;
+	s_topology.count = n;
 	return 0;
 }
 
-static thread_list_t* thread_pool_create_thread(thread_pool_context_t *context)
+int thread_affinity_cpu(const struct thread_affinity_t* affinity, int idx)
 {
-	thread_list_t* threads;
-	
-	threads = (thread_list_t*)malloc(sizeof(thread_list_t));
-	if(!threads)
-		return NULL;
+	int node;
+	if (!affinity || idx < 0)
+		return -1;
+
+	switch (affinity->policy)
+	{
+	case THREAD_AFFINITY_LIST:
+		return affinity->count > 0 ? affinity->cpus[idx % affinity->count] : -1;
 
-	memset(threads, 0, sizeof(thread_list_t));
-	threads->pool = context;
+	case THREAD_AFFINITY_COMPACT:
+		onetime_exec(&s_topology_init, thread_pool_topology);
+		return s_topology.count > 0 ? s_topology.cpus[idx % s_topology.count] : -1;
 
-	if(0 != thread_create(&threads->thread, thread_pool_worker, threads))
+	case THREAD_AFFINITY_SCATTER:
+		onetime_exec(&s_topology_init, thread_pool_topology);
+		if (s_topology.count < 1)
+			return -1;
+		node = idx % s_topology.nodes;
+		return s_topology.cpus[s_topology.first[node] + (idx / s_topology.nodes) % s_topology.size[node]];
+
+	default:
+		return -1;
+	}
+}
+
+int thread_affinity_bind(int cpu)
+{
+#if defined(OS_LINUX)
+	cpu_set_t set;
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return EINVAL;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(OS_WINDOWS)
+	if (cpu < 0 || cpu >= (int)sizeof(DWORD_PTR) * 8)
+		return EINVAL;
+	return 0 != SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) ? 0 : (int)GetLastError();
+#else
+	(void)cpu;
+	return ENOTSUP; // macOS: thread_policy_set is a hint only
+#endif
+}
+
+static int thread_pool_deque_push(struct thread_pool_deque_t *d, const struct thread_pool_task_t *task)
+{
+	int64_t b, t;
+	b = d->bottom;
+	t = d->top; // stale top is smaller, never overwrite
+	if (b - t >= THREAD_POOL_DEQUE)
+		return -1; // full
+
+	d->tasks[b & (THREAD_POOL_DEQUE - 1)] = *task;
+	atomic_add64(&d->bottom, 1); // publish task(full barrier)
+	return 0;
+}
+
+static int thread_pool_deque_pop(struct thread_pool_deque_t *d, struct thread_pool_task_t *task)
+{
+	int r;
+	int64_t b, t;
+	if (d->bottom <= d->top)
+		return -1; // empty(stale top is smaller), don't pay two atomic ops
+
+	b = atomic_add64(&d->bottom, -1); // reserve the bottom one before read top(full barrier)
+	t = d->top;
+	if (t > b)
 	{
-		free(threads);
-		return NULL;
+		atomic_add64(&d->bottom, 1); // empty
+		return -1;
 	}
 
-	return threads;
+	r = 0;
+	*task = d->tasks[b & (THREAD_POOL_DEQUE - 1)];
+	if (t == b)
+	{
+		// the last one: race with thieves
+		if (!atomic_cas64(&d->top, t, t + 1))
+			r = -1;
+		atomic_add64(&d->bottom, 1);
+	}
+	return r;
 }
 
-static void thread_pool_destroy_thread(thread_pool_context_t *context)
+static int thread_pool_deque_steal(struct thread_pool_deque_t *d, struct thread_pool_task_t *task)
 {
-	thread_list_t **head;
-	thread_list_t *next;
+	int64_t b, t;
+	if (d->top >= d->bottom)
+		return -1; // don't lock the cache line of an empty deque
 
-	head = &context->task_threads;
-	while(*head)
+	t = atomic_load64(&d->top); // full barrier: read top before bottom
+	b = d->bottom; // don't write the owner cache line
+	if (t >= b)
+		return -1;
+
+	// owner never overwrite slot t before top moved, the CAS reject stale task
+	*task = d->tasks[t & (THREAD_POOL_DEQUE - 1)];
+	return atomic_cas64(&d->top, t, t + 1) ? 0 : -1;
+}
+
+static int thread_pool_deque_empty(struct thread_pool_deque_t *d)
+{
+	return d->top >= d->bottom ? 1 : 0;
+}
+
+static int thread_pool_inject(thread_pool_context_t *ctx, const struct thread_pool_task_t *task)
+{
+	int64_t pos, seq;
+	struct thread_pool_cell_t *cell;
+	struct thread_pool_overflow_t *node;
+
+	pos = atomic_load64(&ctx->tail);
+	for (;;)
 	{
-		if(thread_isself((*head)->thread))
+		cell = &ctx->cells[pos & (THREAD_POOL_INJECT - 1)];
+		seq = atomic_load64(&cell->seq);
+		if (seq == pos)
 		{
-			next = *head;
-			*head = (*head)->next;
-			free(next);
-			break;
+			if (atomic_cas64(&ctx->tail, pos, pos + 1))
+			{
+				cell->task = *task;
+				atomic_increment64(&cell->seq); // pos + 1: ready
+				return 0;
+			}
+			pos = atomic_load64(&ctx->tail);
+		}
+		else if (seq < pos)
+		{
+			break; // full
+		}
+		else
+		{
+			pos = atomic_load64(&ctx->tail);
 		}
-		head = &(*head)->next;
 	}
+
+	locker_lock(&ctx->locker);
+	node = ctx->overflow_tail;
+	if (!node || THREAD_POOL_SEGMENT == node->tail)
+	{
+		node = ctx->overflow_free;
+		ctx->overflow_free = NULL;
+		node = node ? node : (struct thread_pool_overflow_t*)malloc(sizeof(*node));
+		if (!node)
+		{
+			locker_unlock(&ctx->locker);
+			return -1;
+		}
+
+		node->next = NULL;
+		node->head = node->tail = 0;
+		if (ctx->overflow_tail)
+			ctx->overflow_tail->next = node;
+		else
+			ctx->overflow_head = node;
+		ctx->overflow_tail = node;
+	}
+	node->tasks[node->tail++] = *task;
+	atomic_increment32(&ctx->overflow);
+	locker_unlock(&ctx->locker);
+	return 0;
 }
 
-static void thread_pool_create_threads(thread_pool_context_t *context, 
-									   int num)
+/// @param[in] d worker deque, move a batch of overflow tasks to it(one lock per batch), NULL-one task only
+static int thread_pool_dequeue(thread_pool_context_t *ctx, struct thread_pool_deque_t *d, struct thread_pool_task_t *task)
 {
-	int i;
-	thread_list_t *threads;
+	int r, n;
+	int64_t pos, seq;
+	struct thread_pool_cell_t *cell;
+	struct thread_pool_overflow_t *node;
+
+	if (ctx->head == ctx->tail && 0 == ctx->overflow)
+		return -1;
 
-	for(i=0; i<num; i++)
+	pos = atomic_load64(&ctx->head);
+	for (;;)
 	{
-		threads = thread_pool_create_thread(context);
-		if(!threads)
-			break;
+		cell = &ctx->cells[pos & (THREAD_POOL_INJECT - 1)];
+		seq = atomic_load64(&cell->seq);
+		if (seq == pos + 1)
+		{
+			if (atomic_cas64(&ctx->head, pos, pos + 1))
+			{
+				*task = cell->task;
+				atomic_add64(&cell->seq, THREAD_POOL_INJECT - 1); // pos + THREAD_POOL_INJECT: free for next round
+				return 0;
+			}
+			pos = atomic_load64(&ctx->head);
+		}
+		else if (seq < pos + 1)
+		{
+			break; // empty
+		}
+		else
+		{
+			pos = atomic_load64(&ctx->head);
+		}
+	}
 
-		// add to list head
-		threads->next = context->task_threads;
-		context->task_threads = threads;
+	if (0 == atomic_load32(&ctx->overflow))
+		return -1;
+
+	r = -1;
+	locker_lock(&ctx->locker);
+	node = ctx->overflow_head;
+	if (node && node->head < node->tail)
+	{
+		*task = node->tasks[node->head++];
+		for (n = 1; d && n < THREAD_POOL_BATCH && node->head < node->tail; n++)
+		{
+			if (0 != thread_pool_deque_push(d, &node->tasks[node->head]))
+				break;
+			node->head++;
+		}
+		atomic_add32(&ctx->overflow, -n);
+		r = 0;
 	}
 
-	context->thread_count += i;
-	context->thread_count_idle += i;
+	// the segment is done(no more push): keep one spare segment
+	if (node && node->head == node->tail && (node->next || THREAD_POOL_SEGMENT == node->tail))
+	{
+		ctx->overflow_head = node->next;
+		if (NULL == ctx->overflow_head)
+			ctx->overflow_tail = NULL;
+		if (NULL == ctx->overflow_free)
+		{
+			ctx->overflow_free = node;
+			node = NULL;
+		}
+	}
+	else
+	{
+		node = NULL;
+	}
+	locker_unlock(&ctx->locker);
+
+	free(node);
+	return r;
+}
+
+/// @return 1-has task in any queue
+static int thread_pool_pending(thread_pool_context_t *ctx)
+{
+	int i;
+	// plain read, caller have a full barrier before
+	if (ctx->head != ctx->tail || ctx->overflow > 0)
+		return 1;
+
+	for (i = 0; i < ctx->thread_count_max; i++)
+	{
+		if (!thread_pool_deque_empty(&ctx->workers[i].deque))
+			return 1;
+	}
+	return 0;
+}
+
+/// wake up a parked worker if no worker is searching task(the searcher will find it)
+/// plain read(atomic_load32 is a locked write of the shared line), caller have a full barrier before
+static int thread_pool_notify(thread_pool_context_t *ctx)
+{
+	int32_t parked;
+	parked = ctx->thread_count_parked;
+	return parked > 0 && ctx->thread_count_idle <= parked && 0 == ctx->waking ? 1 : 0;
+}
+
+static void thread_pool_wakeup(thread_pool_context_t *ctx, int n)
+{
+	atomic_cas32(&ctx->waking, 0, 1);
+	atomic_increment32(&ctx->futex);
+#if defined(OS_LINUX)
+	syscall(SYS_futex, &ctx->futex, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#else
+	while (n-- > 0)
+		sema_post(&ctx->sema);
+#endif
 }
 
-static void thread_pool_destroy_threads(thread_list_t *threads)
+static void thread_pool_park(thread_pool_context_t *ctx, int32_t seq, int timeout)
 {
-	thread_list_t *next;
+#if defined(OS_LINUX)
+	struct timespec ts;
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+	syscall(SYS_futex, &ctx->futex, FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+#else
+	(void)seq;
+	sema_timewait(&ctx->sema, timeout);
+#endif
+}
 
-	while(threads)
+/// own deque, injection queue, then steal from others
+static int thread_pool_find(struct thread_pool_worker_t *w, struct thread_pool_task_t *task)
+{
+	int i, j, n;
+	thread_pool_context_t *ctx;
+	ctx = w->pool;
+
+	if (0 == thread_pool_deque_pop(&w->deque, task))
+		return 0;
+
+	for (i = 0; i < THREAD_POOL_SPIN && ctx->run; i++)
 	{
-		next = threads->next;
-		thread_destroy(threads->thread);
-		free(threads);
-		threads = next;
+		// oversubscribed: don't burn the cpu of running workers with yield loop
+		if (i > 0 && ctx->thread_count_idle - ctx->thread_count_parked > ctx->search_max)
+			break;
+
+		if (0 == thread_pool_dequeue(ctx, &w->deque, task))
+			return 0;
+
+		// random victim(xorshift)
+		w->seed ^= w->seed << 13;
+		w->seed ^= w->seed >> 17;
+		w->seed ^= w->seed << 5;
+		n = ctx->thread_count_max;
+		for (j = 0; j < n; j++)
+		{
+			if (0 == thread_pool_deque_steal(&ctx->workers[(w->seed + j) % n].deque, task))
+				return 0;
+		}
+
+		thread_yield();
 	}
+	return -1;
 }
 
-static thread_task_list_t* thread_pool_create_task(thread_pool_context_t *context,
-												   thread_pool_proc proc,
-												   void* param)
+/// release worker slot if the pool is stopped or too many idle threads
+/// @return 1-exit thread
+static int thread_pool_exit(thread_pool_context_t *ctx, struct thread_pool_worker_t *w)
 {
-	thread_task_list_t *task;
+	int r;
+	locker_lock(&ctx->locker);
+	r = (!ctx->run || (ctx->thread_count_idle > ctx->idle_max && ctx->thread_count > ctx->thread_count_min)) ? 1 : 0;
+	if (r)
+	{
+		assert(thread_pool_deque_empty(&w->deque) || !ctx->run);
+		atomic_decrement32(&ctx->thread_count_idle);
+		thread_detach(w->thread);
+		w->used = 0; // slot can be reused by new thread now
+	}
+	locker_unlock(&ctx->locker);
+	return r;
+}
 
-	if(context->recycle_tasks)
+static void thread_pool_run(struct thread_pool_worker_t *w, struct thread_pool_task_t *task)
+{
+	uint64_t clock;
+	if (task->clock)
 	{
-		task = context->recycle_tasks;
-		context->recycle_tasks = context->recycle_tasks->next;
+		clock = system_clock_us();
+		thread_pool_stats_add(w->counter.wait, clock > task->clock ? clock - task->clock : 0);
+		task->proc(task->param);
+		thread_pool_stats_add(w->counter.run, system_clock_us() - clock);
 	}
 	else
 	{
-		task = (thread_task_list_t*)malloc(sizeof(thread_task_list_t));
+		task->proc(task->param);
 	}
-	if(!task)
-		return NULL;
-	
-	memset(task, 0, sizeof(thread_task_list_t));
-	task->param = param;
-	task->proc = proc;
-	return task;
+	w->counter.completed++;
 }
 
-static void thread_pool_destroy_tasks(thread_task_list_t *tasks)
+static int STDCALL thread_pool_worker(void *param)
 {
-	thread_task_list_t *next;
+	int cpu, busy;
+	int32_t seq;
+	struct thread_pool_task_t task;
+	struct thread_pool_worker_t *w;
+	thread_pool_context_t *ctx;
+
+	w = (struct thread_pool_worker_t*)param;
+	ctx = w->pool;
+	tls_setvalue(s_key, w);
 
-	while(tasks)
+	cpu = thread_affinity_cpu(&ctx->affinity, (int)(w - ctx->workers));
+	if (cpu >= 0)
+		thread_affinity_bind(cpu);
+
+	for (busy = 0;;)
 	{
-		next = tasks->next;
-		free(tasks);
-		tasks = next;
+		if (ctx->run && 0 == thread_pool_find(w, &task))
+		{
+			// busy until nothing found: don't write the shared idle counter per task
+			if (!busy)
+				atomic_decrement32(&ctx->thread_count_idle);
+			busy = 1;
+
+			// more task: wake up another worker to steal
+			if (thread_pool_notify(ctx) && thread_pool_pending(ctx))
+				thread_pool_wakeup(ctx, 1);
+
+			thread_pool_run(w, &task);
+			continue;
+		}
+
+		if (busy)
+		{
+			// search again as an idle worker(pusher count on it) before park
+			atomic_increment32(&ctx->thread_count_idle);
+			busy = 0;
+			continue;
+		}
+
+		// delete idle thread
+		if (thread_pool_exit(ctx, w))
+			break;
+
+		// park: announce before re-check, pusher check parked after push(no lost wakeup)
+		// clear waking before re-check: pusher skipped wakeup(waking) push before it
+		seq = atomic_load32(&ctx->futex);
+		atomic_increment32(&ctx->thread_count_parked);
+		atomic_cas32(&ctx->waking, 1, 0);
+		if (ctx->run && !thread_pool_pending(ctx))
+			thread_pool_park(ctx, seq, THREAD_POOL_PARK);
+		atomic_decrement32(&ctx->thread_count_parked);
+		atomic_cas32(&ctx->waking, 1, 0); // searching now
+	}
+
+	tls_setvalue(s_key, NULL);
+	atomic_decrement32(&ctx->thread_count); // the last access, pool maybe destroyed
+	return 0;
+}
+
+/// create threads(with locker)
+static void thread_pool_create_threads(thread_pool_context_t *ctx, int num)
+{
+	int i;
+	struct thread_pool_worker_t *w;
+
+	for (i = 0; num > 0 && i < ctx->thread_count_max; i++)
+	{
+		w = &ctx->workers[i];
+		if (w->used)
+			continue;
+
+		w->used = 1;
+		w->pool = ctx;
+		w->seed = (uint32_t)(i + 1) * 2654435761U;
+		atomic_increment32(&ctx->thread_count);
+		atomic_increment32(&ctx->thread_count_idle);
+		if (0 != thread_create(&w->thread, thread_pool_worker, w))
+		{
+			atomic_decrement32(&ctx->thread_count_idle);
+			atomic_decrement32(&ctx->thread_count);
+			w->used = 0;
+			break;
+		}
+		--num;
 	}
 }
 
 thread_pool_t thread_pool_create(int num, int min, int max)
 {
+	return thread_pool_create2(num, min, max, NULL);
+}
+
+thread_pool_t thread_pool_create2(int num, int min, int max, const struct thread_affinity_t* affinity)
+{
+	int i;
+	int *cpus;
 	thread_pool_context_t *ctx;
 
-	ctx = (thread_pool_context_t*)malloc(sizeof(thread_pool_context_t));
+	onetime_exec(&s_init, thread_pool_init);
+
+	max = max > 0 ? max : 1;
+	num = num < max ? num : max;
+	ctx = (thread_pool_context_t*)calloc(1, sizeof(thread_pool_context_t));
 	if(!ctx)
 		return NULL;
 
-	memset(ctx, 0, sizeof(thread_pool_context_t));
+	// cpu list copy after workers
+	cpus = NULL;
+	i = (affinity && THREAD_AFFINITY_LIST == affinity->policy && affinity->count > 0) ? affinity->count : 0;
+	ctx->workers = (struct thread_pool_worker_t*)calloc(1, max * sizeof(struct thread_pool_worker_t) + i * sizeof(int));
+	if (!ctx->workers)
+	{
+		free(ctx);
+		return NULL;
+	}
+
+	if (affinity)
+	{
+		ctx->affinity = *affinity;
+		if (i > 0)
+		{
+			cpus = (int*)(ctx->workers + max);
+			memcpy(cpus, affinity->cpus, i * sizeof(int));
+		}
+		ctx->affinity.cpus = cpus;
+		ctx->affinity.count = i;
+	}
+
 	ctx->thread_count_min = min;
 	ctx->thread_count_max = max;
-	ctx->threshold = num / 2;
 	ctx->idle_max = num;
+	ctx->search_max = (int)system_getcpucount() / 2;
+	ctx->search_max = ctx->search_max > 0 ? ctx->search_max : 1;
 	ctx->run = 1;
+	for (i = 0; i < THREAD_POOL_INJECT; i++)
+		ctx->cells[i].seq = i;
 
 	if(0 != locker_create(&ctx->locker))
 	{
+		free(ctx->workers);
 		free(ctx);
 		return NULL;
 	}
 
-	if(0 != event_create(&ctx->event))
+#if !defined(OS_LINUX)
+	if (0 != sema_create(&ctx->sema, NULL, 0))
 	{
 		locker_destroy(&ctx->locker);
+		free(ctx->workers);
 		free(ctx);
 		return NULL;
 	}
+#endif
 
+	locker_lock(&ctx->locker);
 	thread_pool_create_threads(ctx, num);
-
+	locker_unlock(&ctx->locker);
 	return ctx;
 }
 
+/// pool stopped: drop the pending tasks(injection queue and worker deques)
+/// parallel_for runners run inline, the caller(maybe a worker task) wait for them
+static void thread_pool_drop(thread_pool_context_t *ctx)
+{
+	int i;
+	struct thread_pool_task_t task;
+
+	while (0 == thread_pool_dequeue(ctx, NULL, &task))
+	{
+		if (thread_pool_range_worker == task.proc)
+			task.proc(task.param);
+	}
+
+	// stopped workers don't pop own deque
+	for (i = 0; i < ctx->thread_count_max; i++)
+	{
+		while (!thread_pool_deque_empty(&ctx->workers[i].deque))
+		{
+			if (0 == thread_pool_deque_steal(&ctx->workers[i].deque, &task) && thread_pool_range_worker == task.proc)
+				task.proc(task.param);
+		}
+	}
+}
+
 void thread_pool_destroy(thread_pool_t pool)
 {
 	thread_pool_context_t *ctx;
@@ -249,22 +845,22 @@ void thread_pool_destroy(thread_pool_t pool)
 	ctx = (thread_pool_context_t*)pool;
 	ctx->run = 0;
 
-	locker_lock(&ctx->locker);
-	while(ctx->thread_count)
+	while (atomic_load32(&ctx->thread_count) > 0)
 	{
-		event_signal(&ctx->event);
-		locker_unlock(&ctx->locker);
-		system_sleep(100);
-		locker_lock(&ctx->locker);
+		thread_pool_drop(ctx); // worker maybe wait for parallel_for runners
+		thread_pool_wakeup(ctx, ctx->thread_count_max);
+		system_sleep(10);
 	}
-	locker_unlock(&ctx->locker);
-	
-	//thread_pool_destroy_threads(ctx->task_threads);
-	thread_pool_destroy_tasks(ctx->recycle_tasks);
-	thread_pool_destroy_tasks(ctx->tasks);
+	thread_pool_drop(ctx);
+	free(ctx->overflow_head); // the last segment(not full)
+	free(ctx->overflow_free);
 
-	event_destroy(&ctx->event);
+#if !defined(OS_LINUX)
+	sema_destroy(&ctx->sema);
+#endif
 	locker_destroy(&ctx->locker);
+	free(ctx->workers);
+	free(ctx);
 }
 
 int thread_pool_threads_count(thread_pool_t pool)
@@ -272,36 +868,362 @@ int thread_pool_threads_count(thread_pool_t pool)
 	thread_pool_context_t *ctx;
 
 	ctx = (thread_pool_context_t*)pool;
-	return ctx->thread_count;
+	return atomic_load32(&ctx->thread_count);
 }
 
-int thread_pool_push(thread_pool_t pool, thread_pool_proc proc, void *param)
+/// push to own deque(worker thread) or injection queue
+static int thread_pool_enqueue(thread_pool_context_t *ctx, struct thread_pool_worker_t *w, const struct thread_pool_task_t *task)
+{
+	if (w && w->pool == ctx && 0 == thread_pool_deque_push(&w->deque, task))
+		return 0;
+	return thread_pool_inject(ctx, task);
+}
+
+/// count n tasks
+/// @return the first task sequence(sample timing)
+static uint64_t thread_pool_submit(thread_pool_context_t *ctx, struct thread_pool_worker_t *w, int n)
+{
+	if (w && w->pool == ctx)
+	{
+		w->counter.submitted += n;
+		return w->counter.submitted - n;
+	}
+	return (uint64_t)atomic_add64(&ctx->submitted, n) - n;
+}
+
+/// wake up (or create) workers for n new tasks
+static void thread_pool_signal(thread_pool_context_t *ctx, int n)
 {
-	thread_task_list_t *task;
-	thread_pool_context_t *context;
+	int32_t idle, parked, searching;
+	parked = ctx->thread_count_parked; // plain read, enqueue have a full barrier before
+	idle = ctx->thread_count_idle;
+	searching = idle > parked ? idle - parked : 0;
+	n -= searching; // the searcher will find it
+	if (n <= 0)
+		return;
+
+	// woken worker don't search yet, it find the task and wake up the next one(one futex call in flight)
+	if (parked > 0 && ctx->waking)
+		return;
+
+	if (parked > 0)
+	{
+		thread_pool_wakeup(ctx, n < parked ? n : parked);
+		n -= parked;
+	}
+
+	if (n > 0 && idle < 1 && ctx->thread_count < ctx->thread_count_max)
+	{
+		// add new thread to do task
+		locker_lock(&ctx->locker);
+		if (atomic_load32(&ctx->thread_count_idle) < 1)
+			thread_pool_create_threads(ctx, n);
+		locker_unlock(&ctx->locker);
+	}
+}
 
-	context = (thread_pool_context_t*)pool;
+int thread_pool_push(thread_pool_t pool, thread_pool_proc proc, void *param)
+{
+	struct thread_pool_task_t task;
+	struct thread_pool_worker_t *w;
+	thread_pool_context_t *ctx;
 
-	locker_lock(&context->locker);
-	task = thread_pool_create_task(context, proc, param);
-	if(!task)
+	ctx = (thread_pool_context_t*)pool;
+	task.proc = proc;
+	task.param = param;
+	w = (struct thread_pool_worker_t*)tls_getvalue(s_key);
+	task.clock = 0 == thread_pool_submit(ctx, w, 1) % THREAD_POOL_SAMPLE ? system_clock_us() : 0;
+	if (0 != thread_pool_enqueue(ctx, w, &task))
 	{
-		locker_unlock(&context->locker);
+		atomic_increment64(&ctx->dropped);
 		return -1;
 	}
 
-	// add to task list
-	task->next = context->tasks;
-	context->tasks = task;
-	++context->task_count;
+	thread_pool_signal(ctx, 1);
+	return 0;
+}
+
+int thread_pool_push_batch(thread_pool_t pool, const thread_pool_proc procs[], void* const params[], int n)
+{
+	int i;
+	uint64_t seq, clock;
+	struct thread_pool_task_t task;
+	struct thread_pool_worker_t *w;
+	thread_pool_context_t *ctx;
+
+	ctx = (thread_pool_context_t*)pool;
+	w = (struct thread_pool_worker_t*)tls_getvalue(s_key);
+	seq = thread_pool_submit(ctx, w, n);
+	clock = system_clock_us();
+	for (i = 0; i < n; i++)
+	{
+		task.proc = procs[i];
+		task.param = params[i];
+		task.clock = 0 == (seq + i) % THREAD_POOL_SAMPLE ? clock : 0;
+		if (0 != thread_pool_enqueue(ctx, w, &task))
+			break;
+	}
+
+	if (i < n)
+		atomic_add64(&ctx->dropped, n - i);
+	if (i > 0)
+		thread_pool_signal(ctx, i);
+	return i > 0 || n < 1 ? i : -1;
+}
+
+static void thread_pool_latch_init(struct thread_pool_latch_t *latch, int count)
+{
+	latch->count = count;
+	latch->busy = 0;
+	event_create(&latch->event);
+}
+
+static void thread_pool_latch_release(struct thread_pool_latch_t *latch)
+{
+	// thread_pool_latch_done maybe still in event_signal
+	while (atomic_load32(&latch->busy) > 0)
+		thread_yield();
+	event_destroy(&latch->event);
+}
+
+thread_pool_latch_t thread_pool_latch_create(int count)
+{
+	struct thread_pool_latch_t *latch;
+
+	onetime_exec(&s_init, thread_pool_init);
+	latch = (struct thread_pool_latch_t*)malloc(sizeof(*latch));
+	if (latch)
+		thread_pool_latch_init(latch, count);
+	return latch;
+}
+
+void thread_pool_latch_destroy(thread_pool_latch_t l)
+{
+	struct thread_pool_latch_t *latch;
+	latch = (struct thread_pool_latch_t*)l;
+	thread_pool_latch_release(latch);
+	free(latch);
+}
+
+void thread_pool_latch_add(thread_pool_latch_t l, int n)
+{
+	struct thread_pool_latch_t *latch;
+	latch = (struct thread_pool_latch_t*)l;
+	atomic_add32(&latch->count, n);
+}
+
+void thread_pool_latch_done(thread_pool_latch_t l)
+{
+	struct thread_pool_latch_t *latch;
+	latch = (struct thread_pool_latch_t*)l;
+
+	// busy before count down: waiter don't return(free latch) until event_signal done
+	atomic_increment32(&latch->busy);
+	if (0 == atomic_decrement32(&latch->count))
+		event_signal(&latch->event);
+	atomic_decrement32(&latch->busy);
+}
+
+int thread_pool_latch_wait(thread_pool_latch_t l, int timeout)
+{
+	int wait;
+	uint64_t clock, now;
+	struct thread_pool_task_t task;
+	struct thread_pool_worker_t *w;
+	struct thread_pool_latch_t *latch;
+
+	latch = (struct thread_pool_latch_t*)l;
+	w = (struct thread_pool_worker_t*)tls_getvalue(s_key);
+	clock = system_clock();
+	while (atomic_load32(&latch->count) > 0)
+	{
+		// worker thread: help to run tasks, the waited tasks maybe queued in own deque
+		if (w && w->pool->run && 0 == thread_pool_find(w, &task))
+		{
+			thread_pool_run(w, &task);
+			continue;
+		}
+
+		if (timeout < 0)
+		{
+			wait = w ? 1 : -1;
+		}
+		else
+		{
+			now = system_clock();
+			if (now - clock >= (uint64_t)timeout)
+				return ETIMEDOUT;
+			wait = (int)(timeout - (now - clock));
+			wait = w && wait > 1 ? 1 : wait; // poll new tasks
+		}
+
+		if (wait < 0)
+			event_wait(&latch->event);
+		else
+			event_timewait(&latch->event, wait);
+	}
+
+	// count down to zero, wait for the last thread_pool_latch_done return
+	while (atomic_load32(&latch->busy) > 0)
+		thread_yield();
+	return 0;
+}
+
+static void thread_pool_range_run(struct thread_pool_range_t *range)
+{
+	int64_t i, begin;
+	for (i = atomic_increment64(&range->next) - 1; i < range->chunks; i = atomic_increment64(&range->next) - 1)
+	{
+		begin = range->begin + i * range->grain;
+		range->proc(range->param, begin, range->end - begin > range->grain ? begin + range->grain : range->end);
+	}
+}
+
+static void thread_pool_range_worker(void *param)
+{
+	struct thread_pool_range_t *range;
+	range = (struct thread_pool_range_t*)param;
+	thread_pool_range_run(range);
+	thread_pool_latch_done(&range->latch);
+}
 
-	// add new thread to do task
-	if(context->thread_count_idle<1 
-		&& context->thread_count<context->thread_count_max)
-		//&& context->task_count>context->threshold)
-		thread_pool_create_threads(context, 1);
+int thread_pool_parallel_for(thread_pool_t pool, int64_t begin, int64_t end, int64_t grain, thread_pool_range_proc proc, void *param)
+{
+	int i, n;
+	int64_t count;
+	struct thread_pool_task_t task;
+	struct thread_pool_worker_t *w;
+	struct thread_pool_range_t range;
+	thread_pool_context_t *ctx;
 
-	event_signal(&context->event);
-	locker_unlock(&context->locker);
+	ctx = (thread_pool_context_t*)pool;
+	if (end <= begin)
+		return 0;
+
+	if ((uint64_t)end - (uint64_t)begin > INT64_MAX)
+		return -1; // end - begin overflow
+
+	n = ctx->thread_count_max + 1; // workers + caller
+	count = end - begin;
+	if (grain <= 0)
+		grain = count / (n * THREAD_POOL_CHUNKS) + (count % (n * THREAD_POOL_CHUNKS) ? 1 : 0);
+	grain = grain < count ? grain : count; // 1 chunk
+
+	range.proc = proc;
+	range.param = param;
+	range.next = 0;
+	range.chunks = count / grain + (count % grain ? 1 : 0);
+	range.begin = begin;
+	range.end = end;
+	range.grain = grain;
+	thread_pool_latch_init(&range.latch, 0);
+
+	// one task per worker at most, every task run chunks until all done
+	task.proc = thread_pool_range_worker;
+	task.param = &range;
+	task.clock = system_clock_us(); // few tasks, sample all
+	w = (struct thread_pool_worker_t*)tls_getvalue(s_key);
+	n = range.chunks - 1 < ctx->thread_count_max ? (int)(range.chunks - 1) : ctx->thread_count_max;
+	n = ctx->run ? n : 0; // stopped(thread_pool_destroy): the caller run all chunks
+	for (i = 0; i < n; i++)
+	{
+		atomic_increment32(&range.latch.count);
+		if (0 != thread_pool_enqueue(ctx, w, &task))
+		{
+			atomic_decrement32(&range.latch.count);
+			break;
+		}
+	}
+	thread_pool_submit(ctx, w, i); // the caller run the chunks if failed
+	if (i > 0)
+		thread_pool_signal(ctx, i);
+
+	thread_pool_range_run(&range);
+	thread_pool_latch_wait(&range.latch, -1);
+	thread_pool_latch_release(&range.latch);
+	return 0;
+}
+
+int thread_pool_stats(thread_pool_t pool, struct thread_pool_stats_t* stats)
+{
+	int i, j;
+	int64_t depth;
+	struct thread_pool_counter_t *counter;
+	thread_pool_context_t *ctx;
+
+	ctx = (thread_pool_context_t*)pool;
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < ctx->thread_count_max; i++)
+	{
+		counter = &ctx->workers[i].counter;
+		stats->submitted += counter->submitted;
+		stats->completed += counter->completed;
+		for (j = 0; j < THREAD_POOL_HISTOGRAM; j++)
+		{
+			stats->wait[j] += counter->wait[j];
+			stats->run[j] += counter->run[j];
+		}
+	}
+
+	stats->submitted += (uint64_t)ctx->submitted;
+	stats->dropped = (uint64_t)ctx->dropped;
+	stats->threads = ctx->thread_count;
+	stats->busy = ctx->thread_count - ctx->thread_count_idle;
+	stats->busy = stats->busy > 0 ? stats->busy : 0;
+	depth = (int64_t)(stats->submitted - stats->completed - stats->dropped) - stats->busy;
+	stats->depth = depth > 0 ? (int)depth : 0;
 	return 0;
 }
+
+/// log-linear bucket: [0, 8) one bucket per value, then 8 sub-buckets per power of 2
+static int thread_pool_stats_index(uint64_t v)
+{
+	int e;
+	if (v < 8)
+		return (int)v;
+
+#if defined(__GNUC__)
+	e = 63 - __builtin_clzll(v);
+#else
+	for (e = 3; e < 63 && (v >> (e + 1)); e++)
+	{
+	}
+#endif
+
+	e = (e - 2) * 8 + (int)((v >> (e - 3)) & 7);
+	return e < THREAD_POOL_HISTOGRAM ? e : THREAD_POOL_HISTOGRAM - 1;
+}
+
+/// bucket lower bound value
+static uint64_t thread_pool_stats_value(int i)
+{
+	if (i < 8)
+		return (uint64_t)i;
+	return (uint64_t)(8 + i % 8) << (i / 8 - 1);
+}
+
+void thread_pool_stats_add(uint64_t histogram[THREAD_POOL_HISTOGRAM], uint64_t us)
+{
+	histogram[thread_pool_stats_index(us)]++;
+}
+
+uint64_t thread_pool_stats_percentile(const uint64_t histogram[THREAD_POOL_HISTOGRAM], double percentile)
+{
+	int i;
+	uint64_t total, n;
+
+	for (total = i = 0; i < THREAD_POOL_HISTOGRAM; i++)
+		total += histogram[i];
+	if (0 == total)
+		return 0;
+
+	n = (uint64_t)(total * percentile / 100.0);
+	n = n > 0 ? n : 1;
+	for (i = 0; i < THREAD_POOL_HISTOGRAM - 1; i++)
+	{
+		if (histogram[i] >= n)
+			break;
+		n -= histogram[i];
+	}
+	return i + 1 < THREAD_POOL_HISTOGRAM ? thread_pool_stats_value(i + 1) - 1 : thread_pool_stats_value(i);
+}
@@ -1,5 +1,5 @@
 // Timing Wheel Timer(timeout)
-// 64ms per bucket
+// 2^resolution ms per bucket(default 64ms)
 // http://www.cs.columbia.edu/~nahum/w6998/papers/sosp87-timing-wheels.pdf
 
 #include "twtimer.h"
@@ -9,8 +9,9 @@
 #include <assert.h>
 #include <errno.h>
 
-#define TIME_RESOLUTION 6
-#define TIME(clock) ((clock) >> TIME_RESOLUTION) // per 64ms
+#define TIME_RESOLUTION 6 // default 64ms
+#define TIME_RESOLUTION_MAX 10 // 1024ms
+#define TIME(tm, clock) ((clock) >> (tm)->resolution) // per bucket
 
 #define TVR_BITS 8
 #define TVN_BITS 6
@@ -19,7 +20,7 @@
 #define TVR_MASK (TVR_SIZE - 1)
 #define TVN_MASK (TVN_SIZE - 1)
 
-#define TVN_INDEX(clock, n) ((int)((clock >> (TIME_RESOLUTION + TVR_BITS + (n * TVN_BITS))) & TVN_MASK))
+#define TVN_INDEX(tm, clock, n) ((int)((clock >> ((tm)->resolution + TVR_BITS + (n * TVN_BITS))) & TVN_MASK))
 
 struct time_bucket_t
 {
@@ -29,6 +30,7 @@ struct time_bucket_t
 struct time_wheel_t
 {
 	spinlock_t locker;
+	int resolution; // bucket time: 1 << resolution (ms)
 
 	uint64_t count;
 	uint64_t clock;
@@ -44,12 +46,25 @@ static int twtimer_cascade(struct time_wheel_t* tm, struct time_bucket_t* tv, in
 
 struct time_wheel_t* time_wheel_create(uint64_t clock)
 {
+	return time_wheel_create2(clock, 1 << TIME_RESOLUTION);
+}
+
+struct time_wheel_t* time_wheel_create2(uint64_t clock, int resolution)
+{
+	int bits;
 	struct time_wheel_t* tm;
+
+	// round down to power of 2
+	for (bits = 0; bits < TIME_RESOLUTION_MAX && (2 << bits) <= resolution; bits++)
+	{
+	}
+
 	tm = (struct time_wheel_t*)calloc(1, sizeof(*tm));
 	if (tm)
 	{
 		tm->count = 0;
 		tm->clock = clock;
+		tm->resolution = bits;
 		spinlock_create(&tm->locker);
 	}
 	return tm;
@@ -57,8 +72,16 @@ struct time_wheel_t* time_wheel_create(uint64_t clock)
 
 int time_wheel_destroy(struct time_wheel_t* tm)
 {
+	int r;
 	assert(0 == tm->count);
-	return spinlock_destroy(&tm->locker);
+	r = spinlock_destroy(&tm->locker);
+	free(tm);
+	return r;
+}
+
+int time_wheel_resolution(struct time_wheel_t* tm)
+{
+	return 1 << tm->resolution;
 }
 
 int twtimer_start(struct time_wheel_t* tm, struct twtimer_t* timer)
@@ -91,21 +114,21 @@ int twtimer_stop(struct time_wheel_t* tm, struct twtimer_t* timer)
 
 int twtimer_process(struct time_wheel_t* tm, uint64_t clock)
 {
-	int index;
+	int i, index;
 	struct twtimer_t* timer;
 	struct time_bucket_t bucket;
 
 	spinlock_lock(&tm->locker);
 	while(tm->clock < clock)
 	{
-		index = (int)(TIME(tm->clock) & TVR_MASK);
+		index = (int)(TIME(tm, tm->clock) & TVR_MASK);
 
 		if (0 == index 
-			&& 0 == twtimer_cascade(tm, tm->tv2, TVN_INDEX(tm->clock, 0))
-			&& 0 == twtimer_cascade(tm, tm->tv3, TVN_INDEX(tm->clock, 1))
-			&& 0 == twtimer_cascade(tm, tm->tv4, TVN_INDEX(tm->clock, 2)))
+			&& 0 == twtimer_cascade(tm, tm->tv2, TVN_INDEX(tm, tm->clock, 0))
+			&& 0 == twtimer_cascade(tm, tm->tv3, TVN_INDEX(tm, tm->clock, 1))
+			&& 0 == twtimer_cascade(tm, tm->tv4, TVN_INDEX(tm, tm->clock, 2)))
 		{
-			twtimer_cascade(tm, tm->tv5, TVN_INDEX(tm->clock, 3));
+			twtimer_cascade(tm, tm->tv5, TVN_INDEX(tm, tm->clock, 3));
 		}
 
 		// move bucket
@@ -113,7 +136,7 @@ int twtimer_process(struct time_wheel_t* tm, uint64_t clock)
 		if (bucket.first)
 			bucket.first->pprev = &bucket.first;
 		tm->tv1[index].first = NULL; // clear
-		tm->clock += (1 << TIME_RESOLUTION);
+		tm->clock += (1 << tm->resolution);
 
 		// trigger timer
 		while (bucket.first)
@@ -121,7 +144,7 @@ int twtimer_process(struct time_wheel_t* tm, uint64_t clock)
 			timer = bucket.first;
 			bucket.first = timer->next;
 			if (timer->next)
-				timer->pprev = &bucket.first;
+				timer->next->pprev = &bucket.first;
 			timer->next = NULL;
 			timer->pprev = NULL;
 			--tm->count;
@@ -134,8 +157,17 @@ int twtimer_process(struct time_wheel_t* tm, uint64_t clock)
 		}	
 	}
 
+	// sleep until the next non-empty bucket(or cascade)
+	index = (int)(TIME(tm, tm->clock) & TVR_MASK);
+	for (i = 0; i < TVR_SIZE && (0 == i || 0 != ((index + i) & TVR_MASK)); i++)
+	{
+		if (tm->count > 0 && tm->tv1[(index + i) & TVR_MASK].first)
+			break;
+	}
+
+	i = (int)(tm->clock - clock) + i * (1 << tm->resolution) + 1;
 	spinlock_unlock(&tm->locker);
-	return (int)(tm->clock - clock);
+	return i;
 }
 
 static int twtimer_cascade(struct time_wheel_t* tm, struct time_bucket_t* tv, int index)
@@ -171,41 +203,40 @@ static int twtimer_add(struct time_wheel_t* tm, struct twtimer_t* timer)
 		return EEXIST;
 	}
 
-	diff = TIME(timer->expire - tm->clock); // per 64ms
+	diff = TIME(tm, timer->expire - tm->clock); // per bucket
 
 	if (timer->expire < tm->clock)
 	{
-		i = TIME(tm->clock) & TVR_MASK;
+		i = TIME(tm, tm->clock) & TVR_MASK;
 		tv = tm->tv1 + i;
 	}
 	else if (diff < (1 << TVR_BITS))
 	{
-		i = TIME(timer->expire) & TVR_MASK;
+		i = TIME(tm, timer->expire) & TVR_MASK;
 		tv = tm->tv1 + i;
 	}
 	else if (diff < (1 << (TVR_BITS + TVN_BITS)))
 	{
-		i = (TIME(timer->expire) >> TVR_BITS) & TVN_MASK;
+		i = (TIME(tm, timer->expire) >> TVR_BITS) & TVN_MASK;
 		tv = tm->tv2 + i;
 	}
 	else if (diff < (1 << (TVR_BITS + 2 * TVN_BITS)))
 	{
-		i = (TIME(timer->expire) >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
+		i = (TIME(tm, timer->expire) >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
 		tv = tm->tv3 + i;
 	}
 	else if (diff < (1 << (TVR_BITS + 3 * TVN_BITS)))
 	{
-		i = (TIME(timer->expire) >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
+		i = (TIME(tm, timer->expire) >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
 		tv = tm->tv4 + i;
 	}
 	else if (diff < (1ULL << (TVR_BITS + 4 * TVN_BITS)))
 	{
-		i = (TIME(timer->expire) >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
+		i = (TIME(tm, timer->expire) >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
 		tv = tm->tv5 + i;
 	}
 	else
 	{
-		spinlock_unlock(&tm->locker);
 		assert(0); // exceed max timeout value
 		return -1;
 	}
@@ -0,0 +1,137 @@
+#include "aio-connect.h"
+#include "aio-resolver.h"
+#include "aio-worker.h"
+#include "sys/atomic.h"
+#include "sys/system.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+// aio_connect Happy Eyeballs on loopback(linux: 127.0.0.0/8, aio_resolver_sethost address list):
+// 1. unreachable then reachable address: the second attempt start after 250ms, it win
+// 2. refused then reachable address: the second attempt start immediately
+// 3. unreachable address only: ETIMEDOUT after the attempt timeout
+// 4. refused address only: ECONNREFUSED
+// unreachable: SYN is dropped by the listen socket with a full accept queue(backlog 0, one connection queued)
+
+#define CONNECT_HOST	"aio-connect-test.invalid"
+#define CONNECT_OK		"127.0.0.1"
+#define CONNECT_DROP	"127.0.0.2"
+#define CONNECT_REFUSE	"127.0.0.3"
+#define CONNECT_DELAY	250 // aio-connect.c AIO_CONNECT_DELAY
+#define CONNECT_TIMER	64 // aio_timeout resolution, the timer maybe fire earlier
+
+struct aio_connect_test_t
+{
+	volatile int32_t done;
+	int code;
+	uint64_t clock; // callback time - aio_connect time
+};
+
+static void aio_connect_test_ondestroy(void* param)
+{
+	(void)param;
+}
+
+static void aio_connect_test_onconnect(void* param, int code, aio_socket_t aio)
+{
+	struct aio_connect_test_t* t;
+	t = (struct aio_connect_test_t*)param;
+	assert(0 == code ? invalid_aio_socket != aio : invalid_aio_socket == aio);
+	if (0 == code)
+		aio_socket_destroy(aio, aio_connect_test_ondestroy, NULL);
+
+	t->code = code;
+	t->clock = system_clock() - t->clock;
+	atomic_increment32(&t->done);
+}
+
+static void aio_connect_test_run(struct aio_connect_test_t* t, const char* ips, u_short port, int timeout)
+{
+	uint64_t clock;
+	assert(0 == aio_resolver_sethost(CONNECT_HOST, ips));
+
+	memset(t, 0, sizeof(*t));
+	t->clock = system_clock();
+	assert(0 == aio_connect(CONNECT_HOST, port, timeout, aio_connect_test_onconnect, t));
+
+	clock = system_clock();
+	while (0 == atomic_load32(&t->done) && system_clock() - clock < 10000)
+		system_sleep(5);
+	assert(1 == t->done);
+	system_sleep(50); // no more callback
+	assert(1 == t->done);
+}
+
+/// @return 1-listen socket have a new connection
+static int aio_connect_test_accept(socket_t l)
+{
+	socket_t c;
+	socklen_t len;
+	struct sockaddr_storage ss;
+	if (1 != socket_select_read(l, 1000))
+		return 0;
+	c = socket_accept(l, &ss, &len);
+	assert(socket_invalid != c);
+	socket_close(c);
+	return 1;
+}
+
+void aio_connect_test(void)
+{
+	u_short port;
+	socket_t ok, drop, queued;
+	char ip[SOCKET_ADDRLEN];
+	struct aio_connect_test_t t;
+
+	socket_init();
+	aio_worker_init(1);
+
+	// the same port on the two addresses
+	drop = socket_tcp_listen(CONNECT_DROP, 0, 0);
+	assert(socket_invalid != drop);
+	assert(0 == socket_getname(drop, ip, &port));
+	ok = socket_tcp_listen(CONNECT_OK, port, SOMAXCONN);
+	assert(socket_invalid != ok);
+
+	// fill the accept queue, the next SYN is dropped
+	queued = socket_connect_host(CONNECT_DROP, port, 1000);
+	assert(socket_invalid != queued);
+
+	// 1. unreachable, reachable
+	aio_connect_test_run(&t, CONNECT_DROP "," CONNECT_OK, port, 5000);
+	assert(0 == t.code && t.clock + CONNECT_TIMER >= CONNECT_DELAY && t.clock < 5000);
+	assert(aio_connect_test_accept(ok));
+
+	// reachable first: the delay timer is canceled
+	aio_connect_test_run(&t, CONNECT_OK "," CONNECT_DROP, port, 5000);
+	assert(0 == t.code && t.clock < CONNECT_DELAY);
+	assert(aio_connect_test_accept(ok));
+
+	// 2. refused, reachable
+	aio_connect_test_run(&t, CONNECT_REFUSE "," CONNECT_OK, port, 5000);
+	assert(0 == t.code && t.clock < CONNECT_DELAY);
+	assert(aio_connect_test_accept(ok));
+
+	// 3. timeout
+	aio_connect_test_run(&t, CONNECT_DROP, port, 300);
+	assert(ETIMEDOUT == t.code && t.clock + CONNECT_TIMER >= 300 && t.clock < 5000);
+
+	// 4. refused
+	aio_connect_test_run(&t, CONNECT_REFUSE, port, 5000);
+	assert(ECONNREFUSED == t.code);
+
+	// all failed: the last error
+	aio_connect_test_run(&t, CONNECT_DROP "," CONNECT_REFUSE, port, 300);
+	assert(0 != t.code);
+
+	assert(0 == aio_resolver_sethost(CONNECT_HOST, NULL));
+	socket_close(queued);
+	socket_close(drop);
+	socket_close(ok);
+	aio_worker_clean(1);
+	socket_cleanup();
+	printf("aio connect test ok\n");
+}
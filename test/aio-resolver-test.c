@@ -0,0 +1,161 @@
+#include "aio-resolver.h"
+#include "aio-connect.h"
+#include "sys/thread.h"
+#include "sys/system.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// aio_resolve(localhost from hosts file, *.invalid never resolved):
+// 1. numeric host and cache hit(positive or negative): callback in the calling thread before return
+// 2. cache miss: callback in resolver thread, concurrent queries of the same host are merged(one getaddrinfo)
+// 3. failed host is cached for the negative ttl, then resolved again
+// 4. cache full: the earliest expiring host is evicted
+// 5. aio_connect return the resolver failure in the call(negative cache hit)
+// 6. static host: address list in order, port set, not flushed
+
+#define RESOLVER_NEGATIVE_TTL 200
+
+struct aio_resolver_test_t
+{
+	volatile int done;
+	int code;
+	int port;
+	int order; // callback order
+	pthread_t thread;
+};
+
+static volatile int s_order;
+
+static void aio_resolver_test_onresolve(void* param, int code, struct addrinfo* addr)
+{
+	u_short port;
+	char ip[SOCKET_ADDRLEN];
+	struct aio_resolver_test_t* t;
+	t = (struct aio_resolver_test_t*)param;
+
+	assert(0 == code ? NULL != addr : NULL == addr);
+	t->code = code;
+	t->port = -1;
+	if (0 == code)
+	{
+		assert(0 == socket_addr_to(addr->ai_addr, (socklen_t)addr->ai_addrlen, ip, &port));
+		t->port = port;
+		aio_resolver_free(addr);
+	}
+	t->thread = thread_self();
+	t->order = s_order++;
+	t->done = 1;
+}
+
+static void aio_resolver_test_resolve(struct aio_resolver_test_t* t, const char* host, int port)
+{
+	memset(t, 0, sizeof(*t));
+	assert(0 == aio_resolve(host, port, aio_resolver_test_onresolve, t));
+}
+
+static void aio_resolver_test_wait(struct aio_resolver_test_t* t)
+{
+	uint64_t clock;
+	clock = system_clock();
+	while (!t->done && system_clock() - clock < 10000)
+		system_sleep(1);
+	assert(t->done);
+}
+
+/// resolve and wait
+/// @return 1-callback in resolver thread(cache miss), 0-callback in the calling thread
+static int aio_resolver_test_query(struct aio_resolver_test_t* t, const char* host, int port)
+{
+	int done;
+	aio_resolver_test_resolve(t, host, port);
+	done = t->done;
+	aio_resolver_test_wait(t);
+	assert(done || !thread_isself(t->thread)); // calling thread: callback before return
+	return thread_isself(t->thread) ? 0 : 1;
+}
+
+static void aio_resolver_test_onconnect(void* param, int code, aio_socket_t aio)
+{
+	(void)param, (void)code, (void)aio;
+	assert(0); // resolver failure returned by aio_connect
+}
+
+static void aio_resolver_test_merge(void)
+{
+	int i;
+	struct aio_resolver_test_t t1, t2;
+
+	// the second query is issued before the resolver finished the first one(retry if the resolver was faster)
+	for (i = 0; i < 10; i++)
+	{
+		aio_resolver_flush();
+		aio_resolver_test_resolve(&t1, "localhost", 1);
+		aio_resolver_test_resolve(&t2, "localhost", 2);
+		aio_resolver_test_wait(&t1);
+		aio_resolver_test_wait(&t2);
+		if (!thread_isself(t2.thread))
+			break;
+	}
+	assert(i < 10);
+
+	// merged: both callbacks by one getaddrinfo(the same resolver thread, the latest waiter first)
+	assert(0 == t1.code && 1 == t1.port && 0 == t2.code && 2 == t2.port);
+	assert(!thread_isself(t1.thread) && thread_getid(t1.thread) == thread_getid(t2.thread) && t2.order < t1.order);
+}
+
+void aio_resolver_test(void)
+{
+	int code;
+	struct aio_resolver_test_t t;
+
+	socket_init();
+	aio_resolver_setttl(60 * 1000, RESOLVER_NEGATIVE_TTL);
+	aio_resolver_flush();
+
+	// numeric host
+	assert(0 == aio_resolver_test_query(&t, "127.0.0.1", 80) && 0 == t.code && 80 == t.port);
+
+	// positive cache: the second query with another port is a cache hit
+	assert(1 == aio_resolver_test_query(&t, "localhost", 80) && 0 == t.code && 80 == t.port);
+	assert(0 == aio_resolver_test_query(&t, "localhost", 8080) && 0 == t.code && 8080 == t.port);
+
+	aio_resolver_test_merge();
+
+	// negative cache: failure is reported by callback(same code), expired after the negative ttl
+	assert(1 == aio_resolver_test_query(&t, "aio-resolver-test.invalid", 80) && 0 != t.code);
+	code = t.code;
+	assert(0 == aio_resolver_test_query(&t, "aio-resolver-test.invalid", 80) && code == t.code);
+	system_sleep(RESOLVER_NEGATIVE_TTL + 100);
+	assert(1 == aio_resolver_test_query(&t, "aio-resolver-test.invalid", 80) && code == t.code);
+	assert(code == aio_connect("aio-resolver-test.invalid", 80, 1000, aio_resolver_test_onconnect, NULL));
+
+	// eviction: 2 hosts at most, localhost expire first
+	aio_resolver_flush();
+	aio_resolver_setttl(60 * 1000, 60 * 1000);
+	aio_resolver_setcapacity(2);
+	assert(1 == aio_resolver_test_query(&t, "localhost", 80) && 0 == t.code);
+	system_sleep(10);
+	assert(1 == aio_resolver_test_query(&t, "aio-resolver-test1.invalid", 80) && 0 != t.code);
+	assert(1 == aio_resolver_test_query(&t, "aio-resolver-test2.invalid", 80) && 0 != t.code); // evict localhost
+	assert(0 == aio_resolver_test_query(&t, "aio-resolver-test1.invalid", 80) && 0 != t.code);
+	assert(0 == aio_resolver_test_query(&t, "aio-resolver-test2.invalid", 80) && 0 != t.code);
+	assert(1 == aio_resolver_test_query(&t, "localhost", 80) && 0 == t.code);
+
+	// static host
+	assert(0 == aio_resolver_sethost("aio-resolver-test.invalid", "127.0.0.2,::1,127.0.0.1"));
+	aio_resolver_flush();
+	aio_resolver_test_resolve(&t, "aio-resolver-test.invalid", 8080);
+	assert(t.done && 0 == t.code && 8080 == t.port); // the first one
+	assert(EINVAL == aio_resolver_sethost("aio-resolver-test.invalid", "127.0.0.1,localhost"));
+	assert(0 == aio_resolver_sethost("aio-resolver-test.invalid", NULL));
+	assert(1 == aio_resolver_test_query(&t, "aio-resolver-test.invalid", 80) && 0 != t.code);
+
+	// default
+	aio_resolver_setcapacity(0);
+	aio_resolver_setttl(60 * 1000, 5 * 1000);
+	aio_resolver_flush();
+	socket_cleanup();
+	printf("aio resolver test ok\n");
+}
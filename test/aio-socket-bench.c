@@ -0,0 +1,133 @@
+#include "cstringext.h"
+#include "ctypedef.h"
+#include "aio-socket.h"
+#include "sys/atomic.h"
+#include "sys/system.h"
+#include "sys/thread.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <errno.h>
+#include <assert.h>
+
+// contention benchmark: N threads aio_socket_process on a shared epoll,
+// every socket has recv and send in flight at the same time(in/out state change from different threads)
+// Remark: run on a multi-core host, threads don't contend on a single CPU(1-CPU results say nothing about the lock)
+
+#define BENCH_CONNECTIONS	64
+#define BENCH_TOKENS		4 // in-flight bytes per connection direction
+#define BENCH_SECONDS		3
+
+struct aio_bench_peer_t
+{
+	aio_socket_t aio;
+	int32_t pending; // received bytes to echo
+	int64_t count; // echoed bytes
+	char rbuf[64];
+	char sbuf[1];
+};
+
+static struct aio_bench_peer_t s_peers[BENCH_CONNECTIONS * 2];
+static volatile int s_running;
+
+static void aio_bench_onsend(void* param, int code, size_t bytes);
+static void aio_bench_onrecv(void* param, int code, size_t bytes)
+{
+	size_t i;
+	struct aio_bench_peer_t* peer;
+	peer = (struct aio_bench_peer_t*)param;
+	if (0 != code || 0 == bytes || !s_running)
+		return;
+
+	aio_socket_recv(peer->aio, peer->rbuf, sizeof(peer->rbuf), aio_bench_onrecv, peer);
+
+	for (i = 0; i < bytes; i++)
+	{
+		// first pending byte start send, onsend continue
+		if (1 == atomic_increment32(&peer->pending))
+			aio_socket_send(peer->aio, peer->sbuf, sizeof(peer->sbuf), aio_bench_onsend, peer);
+	}
+}
+
+static void aio_bench_onsend(void* param, int code, size_t bytes)
+{
+	struct aio_bench_peer_t* peer;
+	peer = (struct aio_bench_peer_t*)param;
+	if (0 != code || !s_running)
+		return;
+
+	assert(1 == bytes);
+	peer->count++;
+	if (atomic_decrement32(&peer->pending) > 0)
+		aio_socket_send(peer->aio, peer->sbuf, sizeof(peer->sbuf), aio_bench_onsend, peer);
+}
+
+static int STDCALL aio_bench_worker(void* param)
+{
+	(void)param;
+	while (s_running)
+		aio_socket_process(100);
+	return 0;
+}
+
+static void aio_bench_ondestroy(void* param)
+{
+	(void)param;
+}
+
+static void aio_bench_run(int threads)
+{
+	int i, j;
+	int64_t total;
+	uint64_t clock;
+	socket_t fd[2];
+	pthread_t thread[64];
+
+	aio_socket_init(threads);
+	memset(s_peers, 0, sizeof(s_peers));
+	s_running = 1;
+
+	for (i = 0; i < BENCH_CONNECTIONS; i++)
+	{
+		if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fd))
+			return;
+		s_peers[i * 2].aio = aio_socket_create(fd[0], 1);
+		s_peers[i * 2 + 1].aio = aio_socket_create(fd[1], 1);
+		aio_socket_recv(s_peers[i * 2].aio, s_peers[i * 2].rbuf, sizeof(s_peers[i * 2].rbuf), aio_bench_onrecv, &s_peers[i * 2]);
+		aio_socket_recv(s_peers[i * 2 + 1].aio, s_peers[i * 2 + 1].rbuf, sizeof(s_peers[i * 2 + 1].rbuf), aio_bench_onrecv, &s_peers[i * 2 + 1]);
+
+		for (j = 0; j < BENCH_TOKENS; j++)
+		{
+			socket_send(fd[0], "x", 1, 0);
+			socket_send(fd[1], "x", 1, 0);
+		}
+	}
+
+	for (i = 0; i < threads; i++)
+		thread_create(&thread[i], aio_bench_worker, NULL);
+
+	clock = system_clock();
+	system_sleep(BENCH_SECONDS * 1000);
+	s_running = 0;
+	clock = system_clock() - clock;
+
+	for (i = 0, total = 0; i < BENCH_CONNECTIONS * 2; i++)
+	{
+		total += s_peers[i].count;
+		aio_socket_destroy(s_peers[i].aio, aio_bench_ondestroy, NULL);
+	}
+
+	for (i = 0; i < threads; i++)
+		thread_destroy(thread[i]);
+	aio_socket_clean();
+
+	printf("aio_socket_bench threads: %d, connections: %d, %d ms, %" PRId64 " messages, %" PRId64 " msg/s\n",
+		threads, BENCH_CONNECTIONS, (int)clock, total, total * 1000 / (int64_t)(clock ? clock : 1));
+}
+
+void aio_socket_bench(void)
+{
+	aio_bench_run(1);
+	aio_bench_run(4);
+	aio_bench_run(16);
+	aio_bench_run(64);
+}
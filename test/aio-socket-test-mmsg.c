@@ -0,0 +1,153 @@
+#include "sys/sock.h"
+#include "sys/system.h"
+#include "aio-socket.h"
+#include "sockutil.h"
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+// sendmmsg with UDP GSO(one 4000 bytes message, 1000 bytes segment) + one plain datagram,
+// recvmmsg without GRO: 5 datagrams, with GRO: GSO datagrams coalesced again(segment = 1000)
+
+#define MMSG_SEGMENT	1000
+#define MMSG_GSO		4000
+#define MMSG_PLAIN		500
+
+static struct
+{
+	aio_socket_t recv;
+	aio_socket_t send;
+	struct aio_socket_mmsg_t in[8];
+	struct aio_socket_mmsg_t out[2];
+	char buffers[8][8 * 1024];
+	char data[MMSG_GSO + MMSG_PLAIN];
+
+	int sent; // sendmmsg callback count
+	int datagrams; // received datagrams(GRO: split by segment)
+	size_t bytes; // received bytes
+	int coalesced; // GRO messages with more than one segment
+} s_mmsg;
+
+static void aio_socket_test_mmsg_onsend(void* param, int code, struct aio_socket_mmsg_t* msgs, int n)
+{
+	(void)param, (void)msgs;
+	assert(0 == code && 2 == n);
+	s_mmsg.sent++;
+}
+
+static void aio_socket_test_mmsg_onrecv(void* param, int code, struct aio_socket_mmsg_t* msgs, int n)
+{
+	int i, r;
+	size_t segment;
+	(void)param;
+	assert(0 == code && n > 0);
+
+	for (i = 0; i < n; i++)
+	{
+		// datagram content is the position in s_mmsg.data
+		assert(0 == memcmp(msgs[i].buffer, s_mmsg.data + s_mmsg.bytes, msgs[i].bytes));
+		segment = msgs[i].segment > 0 ? msgs[i].segment : msgs[i].bytes;
+		if (msgs[i].bytes > segment)
+		{
+			assert(MMSG_SEGMENT == segment);
+			s_mmsg.coalesced++;
+		}
+		s_mmsg.datagrams += (int)((msgs[i].bytes + segment - 1) / segment);
+		s_mmsg.bytes += msgs[i].bytes;
+	}
+
+	if (s_mmsg.bytes < sizeof(s_mmsg.data))
+	{
+		for (i = 0; i < 8; i++)
+			s_mmsg.in[i].bytes = sizeof(s_mmsg.buffers[i]);
+		r = aio_socket_recvmmsg(s_mmsg.recv, s_mmsg.in, 8, aio_socket_test_mmsg_onrecv, NULL);
+		assert(0 == r);
+	}
+}
+
+static void aio_socket_test_mmsg_run(int gro)
+{
+	int i, r;
+	u_short port;
+	char ip[SOCKET_ADDRLEN];
+	uint64_t clock;
+	socket_t udp[2];
+
+	memset(&s_mmsg.in, 0, sizeof(s_mmsg.in));
+	memset(&s_mmsg.out, 0, sizeof(s_mmsg.out));
+	s_mmsg.sent = s_mmsg.datagrams = s_mmsg.coalesced = 0;
+	s_mmsg.bytes = 0;
+
+	udp[0] = socket_udp_bind("127.0.0.1", 0);
+	udp[1] = socket_udp_bind("127.0.0.1", 0);
+	assert(socket_invalid != udp[0] && socket_invalid != udp[1]);
+	if (gro)
+		assert(0 == socket_setudpgro(udp[0], 1));
+	socket_getname(udp[0], ip, &port);
+
+	s_mmsg.recv = aio_socket_create(udp[0], 1);
+	s_mmsg.send = aio_socket_create(udp[1], 1);
+	for (i = 0; i < 8; i++)
+	{
+		s_mmsg.in[i].buffer = s_mmsg.buffers[i];
+		s_mmsg.in[i].bytes = sizeof(s_mmsg.buffers[i]);
+	}
+	r = aio_socket_recvmmsg(s_mmsg.recv, s_mmsg.in, 8, aio_socket_test_mmsg_onrecv, NULL);
+	assert(0 == r);
+
+	for (i = 0; i < 2; i++)
+	{
+		socket_addr_from(&s_mmsg.out[i].addr, &s_mmsg.out[i].addrlen, ip, port);
+		s_mmsg.out[i].buffer = s_mmsg.data + (i ? MMSG_GSO : 0);
+		s_mmsg.out[i].bytes = i ? MMSG_PLAIN : MMSG_GSO;
+		s_mmsg.out[i].segment = i ? 0 : MMSG_SEGMENT;
+	}
+	r = aio_socket_sendmmsg(s_mmsg.send, s_mmsg.out, 2, aio_socket_test_mmsg_onsend, NULL);
+	assert(0 == r);
+
+	clock = system_clock();
+	while ((s_mmsg.sent < 1 || s_mmsg.bytes < sizeof(s_mmsg.data)) && system_clock() - clock < 5000)
+		aio_socket_process(100);
+
+	assert(1 == s_mmsg.sent && sizeof(s_mmsg.data) == s_mmsg.bytes);
+	assert(5 == s_mmsg.datagrams);
+	assert(gro || 0 == s_mmsg.coalesced);
+
+	aio_socket_destroy(s_mmsg.recv, NULL, NULL);
+	aio_socket_destroy(s_mmsg.send, NULL, NULL);
+	aio_socket_process(10);
+}
+
+void aio_socket_test_mmsg(void)
+{
+	int i;
+	aio_socket_t aio;
+	struct aio_socket_mmsg_t msg;
+
+	socket_init();
+	aio_socket_init(1);
+
+	// backend support: n = 0 is EINVAL, otherwise ENOTSUP(WSAEOPNOTSUPP)
+	memset(&msg, 0, sizeof(msg));
+	aio = aio_socket_create(socket_udp(), 1);
+	i = aio_socket_recvmmsg(aio, &msg, 0, aio_socket_test_mmsg_onrecv, NULL);
+	aio_socket_destroy(aio, NULL, NULL);
+	if (EINVAL != i)
+	{
+		aio_socket_clean();
+		socket_cleanup();
+		return;
+	}
+
+	for (i = 0; i < (int)sizeof(s_mmsg.data); i++)
+		s_mmsg.data[i] = (char)(i * 31 + i / 251);
+
+	aio_socket_test_mmsg_run(0);
+#if defined(OS_LINUX)
+	aio_socket_test_mmsg_run(1); // UDP_GRO linux 5.0+
+#endif
+
+	aio_socket_clean();
+	socket_cleanup();
+	printf("aio socket mmsg test ok\n");
+}
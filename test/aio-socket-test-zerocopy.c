@@ -0,0 +1,211 @@
+#include "sys/sock.h"
+#include "sys/system.h"
+#include "aio-socket.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+// aio_socket_send_zc/aio_socket_send_v_zc(MSG_ZEROCOPY):
+// 1. TCP: send again in callback, buffer overwritten after callback(kernel released it), peer receive the original data
+// 2. AF_UNIX(SO_ZEROCOPY not supported): fallback to copy send, callback once with all bytes
+// 3. peer reset: send return error or callback with error
+
+#define ZEROCOPY_BYTES	(256 * 1024)
+#define ZEROCOPY_SENDS	4
+
+static struct
+{
+	aio_socket_t aio;
+	char* data; // ZEROCOPY_BYTES * ZEROCOPY_SENDS, overwritten after sent
+	size_t sent;
+	int callbacks;
+	int code;
+
+	socket_t peer;
+	size_t received;
+} s_zc;
+
+static char aio_socket_test_zerocopy_byte(size_t i)
+{
+	return (char)(i * 31 + i / 251);
+}
+
+static void aio_socket_test_zerocopy_onsend(void* param, int code, size_t bytes)
+{
+	size_t n;
+	(void)param;
+
+	s_zc.callbacks++;
+	s_zc.code = code;
+	if (0 != code)
+		return;
+
+	// kernel released the buffer: overwrite it, the peer MUST receive the original data
+	assert(bytes > 0 && s_zc.sent + bytes <= ZEROCOPY_BYTES * ZEROCOPY_SENDS);
+	memset(s_zc.data + s_zc.sent, 0, bytes);
+	s_zc.sent += bytes;
+
+	if (s_zc.sent < ZEROCOPY_BYTES * ZEROCOPY_SENDS)
+	{
+		n = ZEROCOPY_BYTES - s_zc.sent % ZEROCOPY_BYTES; // at most ZEROCOPY_BYTES per send
+		assert(0 == aio_socket_send_zc(s_zc.aio, s_zc.data + s_zc.sent, n, aio_socket_test_zerocopy_onsend, NULL));
+	}
+}
+
+/// non-blocking read and check the peer data
+static void aio_socket_test_zerocopy_read(void)
+{
+	int i, r;
+	char buffer[64 * 1024];
+
+	while ((r = socket_recv(s_zc.peer, buffer, sizeof(buffer), 0)) > 0)
+	{
+		for (i = 0; i < r; i++)
+			assert(buffer[i] == aio_socket_test_zerocopy_byte(s_zc.received + i));
+		s_zc.received += r;
+	}
+}
+
+static void aio_socket_test_zerocopy_tcp(socket_t* client, socket_t* server)
+{
+	u_short port;
+	socklen_t len;
+	socket_t l;
+	char ip[SOCKET_ADDRLEN];
+	struct sockaddr_storage ss;
+
+	l = socket_tcp_listen("127.0.0.1", 0, SOMAXCONN);
+	assert(socket_invalid != l);
+	assert(0 == socket_getname(l, ip, &port));
+	*client = socket_connect_host("127.0.0.1", port, 1000);
+	assert(socket_invalid != *client);
+	len = sizeof(ss);
+	*server = socket_accept(l, &ss, &len);
+	assert(socket_invalid != *server);
+	socket_close(l);
+}
+
+static void aio_socket_test_zerocopy_send(void)
+{
+	size_t i;
+	uint64_t clock;
+	socket_t fd[2];
+
+	memset(&s_zc, 0, sizeof(s_zc));
+	s_zc.data = (char*)malloc(ZEROCOPY_BYTES * ZEROCOPY_SENDS);
+	for (i = 0; i < ZEROCOPY_BYTES * ZEROCOPY_SENDS; i++)
+		s_zc.data[i] = aio_socket_test_zerocopy_byte(i);
+
+	aio_socket_test_zerocopy_tcp(&s_zc.peer, &fd[0]);
+	socket_setnonblock(s_zc.peer, 1);
+	s_zc.aio = aio_socket_create(fd[0], 1);
+	assert(0 == aio_socket_send_zc(s_zc.aio, s_zc.data, ZEROCOPY_BYTES, aio_socket_test_zerocopy_onsend, NULL));
+
+	clock = system_clock();
+	while ((s_zc.sent < ZEROCOPY_BYTES * ZEROCOPY_SENDS || s_zc.received < ZEROCOPY_BYTES * ZEROCOPY_SENDS) && 0 == s_zc.code && system_clock() - clock < 5000)
+	{
+		aio_socket_process(10);
+		aio_socket_test_zerocopy_read();
+	}
+	assert(0 == s_zc.code && ZEROCOPY_BYTES * ZEROCOPY_SENDS == s_zc.sent && ZEROCOPY_BYTES * ZEROCOPY_SENDS == s_zc.received);
+	assert(s_zc.callbacks >= ZEROCOPY_SENDS);
+
+	aio_socket_destroy(s_zc.aio, NULL, NULL);
+	aio_socket_process(10);
+	socket_close(s_zc.peer);
+	free(s_zc.data);
+}
+
+static void aio_socket_test_zerocopy_onsend2(void* param, int code, size_t bytes)
+{
+	*(size_t*)param = bytes;
+	s_zc.code = code;
+	s_zc.callbacks++;
+}
+
+static void aio_socket_test_zerocopy_fallback(void)
+{
+	int r;
+	size_t bytes;
+	uint64_t clock;
+	socket_t fd[2];
+	char buffer[256];
+	socket_bufvec_t vec[2];
+	static const char s_data[] = "zero-copy fallback";
+
+	memset(&s_zc, 0, sizeof(s_zc));
+	assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fd));
+	s_zc.aio = aio_socket_create(fd[0], 1);
+
+	bytes = 0;
+	socket_setbufvec(vec, 0, (void*)s_data, 5);
+	socket_setbufvec(vec, 1, (void*)(s_data + 5), sizeof(s_data) - 5);
+	assert(0 == aio_socket_send_v_zc(s_zc.aio, vec, 2, aio_socket_test_zerocopy_onsend2, &bytes));
+	clock = system_clock();
+	while (0 == s_zc.callbacks && system_clock() - clock < 5000)
+		aio_socket_process(10);
+	assert(1 == s_zc.callbacks && 0 == s_zc.code && sizeof(s_data) == bytes);
+
+	r = socket_recv_by_time(fd[1], buffer, sizeof(buffer), 0, 1000);
+	assert(sizeof(s_data) == r && 0 == memcmp(buffer, s_data, sizeof(s_data)));
+
+	aio_socket_destroy(s_zc.aio, NULL, NULL);
+	aio_socket_process(10);
+	socket_close(fd[1]);
+}
+
+static void aio_socket_test_zerocopy_reset(void)
+{
+	int r;
+	size_t bytes;
+	uint64_t clock;
+	socket_t fd[2];
+	static char s_data[4096];
+
+	memset(&s_zc, 0, sizeof(s_zc));
+	aio_socket_test_zerocopy_tcp(&fd[1], &fd[0]);
+	socket_setlinger(fd[1], 1, 0);
+	socket_close(fd[1]); // RST
+	system_sleep(10);
+	s_zc.aio = aio_socket_create(fd[0], 1);
+
+	bytes = 0;
+	r = aio_socket_send_zc(s_zc.aio, s_data, sizeof(s_data), aio_socket_test_zerocopy_onsend2, &bytes);
+	clock = system_clock();
+	while (0 == r && 0 == s_zc.callbacks && system_clock() - clock < 5000)
+		aio_socket_process(10);
+	assert(0 != r ? 0 == s_zc.callbacks : (1 == s_zc.callbacks && 0 != s_zc.code && 0 == bytes));
+
+	aio_socket_destroy(s_zc.aio, NULL, NULL);
+	aio_socket_process(10);
+}
+
+void aio_socket_test_zerocopy(void)
+{
+	int on, zc;
+	socket_t tcp;
+
+	socket_init();
+	aio_socket_init(1);
+
+	// kernel support(linux 4.14+), otherwise every case is the copy fallback
+	on = 1;
+	tcp = socket_tcp();
+#if defined(SO_ZEROCOPY)
+	zc = 0 == setsockopt(tcp, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) ? 1 : 0;
+#else
+	zc = 0, (void)on;
+#endif
+	socket_close(tcp);
+
+	aio_socket_test_zerocopy_send();
+	aio_socket_test_zerocopy_fallback();
+	aio_socket_test_zerocopy_reset();
+
+	aio_socket_clean();
+	socket_cleanup();
+	printf("aio socket zerocopy test ok(%s)\n", zc ? "MSG_ZEROCOPY" : "fallback");
+}
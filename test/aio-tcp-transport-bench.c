@@ -0,0 +1,196 @@
+#include "aio-socket.h"
+#include "aio-tcp-transport.h"
+#include "sys/system.h"
+#include "sys/thread.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+// aio_tcp_transport_recv_pooled vs fixed 2KB recv buffer on socketpair:
+// 1. memory(RSS) of idle connections, before and after every connection received a message
+// 2. read count and throughput of a bulk transfer
+// loopback(1 cpu): pooled 2000 idle connections ~2.7MB, 100MB in ~1.6k reads vs ~51k reads with 2KB buffer
+
+#define BENCH_IDLE_CONNECTIONS	2000
+#define BENCH_BULK_BYTES		(100 * 1024 * 1024)
+#define BENCH_FIXED_BYTES		(2 * 1024)
+
+struct aio_transport_bench_t
+{
+	aio_tcp_transport_t* transport;
+	socket_t peer;
+	char* buffer; // fixed recv buffer
+	int64_t bytes;
+	int64_t reads;
+};
+
+static struct aio_transport_bench_t* s_conns;
+static volatile int64_t s_received;
+
+static int64_t aio_transport_bench_rss(void)
+{
+	long size, pages = 0;
+	FILE* fp;
+	fp = fopen("/proc/self/statm", "r"); // size resident ...(pages)
+	if (fp)
+	{
+		if (2 != fscanf(fp, "%ld %ld", &size, &pages))
+			pages = 0;
+		fclose(fp);
+	}
+	return (int64_t)pages * sysconf(_SC_PAGESIZE);
+}
+
+static void aio_transport_bench_ondestroy(void* param)
+{
+	(void)param;
+}
+
+static void aio_transport_bench_ondata(void* param, int code, const void* data, size_t bytes)
+{
+	struct aio_transport_bench_t* c;
+	c = (struct aio_transport_bench_t*)param;
+	(void)data;
+	if (0 != code || 0 == bytes)
+		return;
+
+	c->reads++;
+	c->bytes += bytes;
+	s_received += bytes;
+	aio_tcp_transport_recv_pooled(c->transport, aio_transport_bench_ondata, c);
+}
+
+static void aio_transport_bench_onrecv(void* param, int code, size_t bytes)
+{
+	struct aio_transport_bench_t* c;
+	c = (struct aio_transport_bench_t*)param;
+	if (0 != code || 0 == bytes)
+		return;
+
+	c->reads++;
+	c->bytes += bytes;
+	s_received += bytes;
+	aio_tcp_transport_recv(c->transport, c->buffer, BENCH_FIXED_BYTES);
+}
+
+static int aio_transport_bench_create(struct aio_transport_bench_t* c, int pooled)
+{
+	socket_t fd[2];
+	struct aio_tcp_transport_handler_t handler;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.ondestroy = aio_transport_bench_ondestroy;
+	handler.onrecv = aio_transport_bench_onrecv;
+
+	memset(c, 0, sizeof(*c));
+	if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fd))
+		return -1;
+	c->peer = fd[1];
+	c->transport = aio_tcp_transport_create(fd[0], &handler, c);
+	aio_tcp_transport_edge_triggered(c->transport); // long-lived connection, opt-in
+	if (pooled)
+		return aio_tcp_transport_recv_pooled(c->transport, aio_transport_bench_ondata, c);
+
+	c->buffer = (char*)malloc(BENCH_FIXED_BYTES);
+	return aio_tcp_transport_recv(c->transport, c->buffer, BENCH_FIXED_BYTES);
+}
+
+static void aio_transport_bench_destroy(struct aio_transport_bench_t* c)
+{
+	aio_tcp_transport_destroy(c->transport);
+	socket_close(c->peer);
+	aio_socket_process(0);
+	free(c->buffer);
+}
+
+static void aio_transport_bench_wait(int64_t bytes)
+{
+	uint64_t clock;
+	clock = system_clock();
+	while (s_received < bytes && system_clock() - clock < 60 * 1000)
+		aio_socket_process(100);
+}
+
+static void aio_transport_bench_idle(int pooled)
+{
+	int i;
+	int64_t rss0, rss1, rss2;
+
+	s_conns = (struct aio_transport_bench_t*)calloc(BENCH_IDLE_CONNECTIONS, sizeof(*s_conns));
+	s_received = 0;
+	rss0 = aio_transport_bench_rss();
+	for (i = 0; i < BENCH_IDLE_CONNECTIONS; i++)
+	{
+		if (0 != aio_transport_bench_create(&s_conns[i], pooled))
+		{
+			printf("aio_tcp_transport_bench create connection %d failed(ulimit -n?)\n", i);
+			break;
+		}
+	}
+	aio_socket_process(10);
+	rss1 = aio_transport_bench_rss();
+
+	// every connection receive a message, then idle again
+	for (i = 0; i < BENCH_IDLE_CONNECTIONS && s_conns[i].transport; i++)
+		socket_send(s_conns[i].peer, "hello", 5, 0);
+	aio_transport_bench_wait((int64_t)i * 5);
+	rss2 = aio_transport_bench_rss();
+
+	printf("aio_tcp_transport_bench %s: %d idle connections, RSS %" PRId64 "KB, after one message %" PRId64 "KB\n",
+		pooled ? "pooled" : "fixed 2KB", i, (rss1 - rss0) / 1024, (rss2 - rss0) / 1024);
+
+	for (i = 0; i < BENCH_IDLE_CONNECTIONS && s_conns[i].transport; i++)
+		aio_transport_bench_destroy(&s_conns[i]);
+	free(s_conns);
+}
+
+static int STDCALL aio_transport_bench_writer(void* param)
+{
+	int r;
+	int64_t n;
+	static char data[256 * 1024];
+	struct aio_transport_bench_t* c;
+	c = (struct aio_transport_bench_t*)param;
+
+	for (n = 0; n < BENCH_BULK_BYTES; n += r)
+	{
+		r = socket_send_all_by_time(c->peer, data, sizeof(data), 0, 5000);
+		if (r <= 0)
+			break;
+	}
+	return 0;
+}
+
+static void aio_transport_bench_bulk(int pooled)
+{
+	uint64_t clock;
+	pthread_t thread;
+	struct aio_transport_bench_t c;
+
+	s_received = 0;
+	if (0 != aio_transport_bench_create(&c, pooled))
+		return;
+
+	clock = system_clock();
+	thread_create(&thread, aio_transport_bench_writer, &c);
+	aio_transport_bench_wait(BENCH_BULK_BYTES);
+	clock = system_clock() - clock;
+	thread_destroy(thread);
+
+	printf("aio_tcp_transport_bench %s: %" PRId64 " bytes, %" PRId64 " reads, %d ms, %d MB/s\n",
+		pooled ? "pooled" : "fixed 2KB", c.bytes, c.reads, (int)clock, (int)(c.bytes * 1000 / (int64_t)(clock ? clock : 1) / 1024 / 1024));
+	aio_transport_bench_destroy(&c);
+}
+
+void aio_tcp_transport_bench(void)
+{
+	aio_socket_init(1);
+	aio_transport_bench_idle(1);
+	aio_transport_bench_idle(0);
+	aio_transport_bench_bulk(1);
+	aio_transport_bench_bulk(0);
+	aio_socket_clean();
+}
@@ -0,0 +1,253 @@
+#include "aio-socket.h"
+#include "aio-tcp-transport.h"
+#include "sys/system.h"
+#include "sockutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+
+// aio_tcp_transport_post on a socketpair:
+// 1. more than IOV_MAX(1024 on linux) small buffers: several writev batches, onpost in post order
+// 2. buffers posted in onpost join the next batch(after all the queued buffers)
+// 3. destroy with queued buffers: every buffer callback(error), then ondestroy
+// aio_tcp_transport_recv_pooled:
+// 4. read size grow while reads fill the buffer, shrink after small reads
+// 5. recv_pooled in ondata read again after the callback, no callback if not re-armed
+// 6. socket mode is kept(blocking) unless aio_tcp_transport_edge_triggered
+
+#define POST_COUNT		3000
+#define POST_EXTRA		8 // posted in onpost
+#define POST_BIG		(8 * 1024 * 1024) // larger than socket buffer, peer don't read
+
+static struct
+{
+	aio_tcp_transport_t* transport;
+	uint32_t data[POST_COUNT + POST_EXTRA];
+	int posts; // onpost count
+	int errors; // onpost with error
+	int extra; // posted in onpost
+	int destroy; // ondestroy count
+	char* big;
+} s_post;
+
+static void aio_tcp_transport_test_ondestroy(void* param)
+{
+	(void)param;
+	s_post.destroy++;
+}
+
+static void aio_tcp_transport_test_onrecv(void* param, int code, size_t bytes)
+{
+	(void)param, (void)code, (void)bytes;
+	assert(0);
+}
+
+static void aio_tcp_transport_test_onpost(void* param, int code, const void* data, size_t bytes)
+{
+	int i, r;
+	i = (int)(intptr_t)param;
+	assert(0 == code && i == s_post.posts); // post order
+	assert(data == &s_post.data[i] && sizeof(uint32_t) == bytes);
+	s_post.posts++;
+
+	// the first callbacks post more, they are sent after the queued buffers
+	if (s_post.extra < POST_EXTRA)
+	{
+		r = POST_COUNT + s_post.extra++;
+		assert(0 == aio_tcp_transport_post(s_post.transport, &s_post.data[r], sizeof(uint32_t), aio_tcp_transport_test_onpost, (void*)(intptr_t)r));
+	}
+}
+
+static void aio_tcp_transport_test_oncancel(void* param, int code, const void* data, size_t bytes)
+{
+	int i;
+	i = (int)(intptr_t)param;
+	assert(i == s_post.posts && 0 == s_post.destroy); // post order, before ondestroy
+	assert(0 == i ? (data == s_post.big && POST_BIG == bytes) : (data == &s_post.data[i] && sizeof(uint32_t) == bytes));
+	s_post.errors += 0 != code ? 1 : 0;
+	s_post.posts++;
+}
+
+static void aio_tcp_transport_test_post(void)
+{
+	int i, r;
+	size_t n;
+	uint64_t clock;
+	socket_t fd[2];
+	uint32_t* received;
+	struct aio_tcp_transport_handler_t handler;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.ondestroy = aio_tcp_transport_test_ondestroy;
+	handler.onrecv = aio_tcp_transport_test_onrecv;
+
+	memset(&s_post, 0, sizeof(s_post));
+	for (i = 0; i < POST_COUNT + POST_EXTRA; i++)
+		s_post.data[i] = (uint32_t)i;
+
+	assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fd));
+	s_post.transport = aio_tcp_transport_create(fd[0], &handler, NULL);
+	assert(0 == (O_NONBLOCK & fcntl(fd[0], F_GETFL, 0))); // don't change socket mode
+	for (i = 0; i < POST_COUNT; i++)
+		assert(0 == aio_tcp_transport_post(s_post.transport, &s_post.data[i], sizeof(uint32_t), aio_tcp_transport_test_onpost, (void*)(intptr_t)i));
+
+	// peer read all in order
+	n = 0;
+	received = (uint32_t*)malloc(sizeof(s_post.data));
+	clock = system_clock();
+	while ((s_post.posts < POST_COUNT + POST_EXTRA || n < sizeof(s_post.data)) && system_clock() - clock < 5000)
+	{
+		aio_socket_process(10);
+		r = socket_recv_by_time(fd[1], (char*)received + n, sizeof(s_post.data) - n, 0, 0);
+		n += r > 0 ? r : 0;
+	}
+	assert(POST_COUNT + POST_EXTRA == s_post.posts && sizeof(s_post.data) == n);
+	assert(0 == memcmp(received, s_post.data, sizeof(s_post.data)));
+	free(received);
+
+	aio_tcp_transport_destroy(s_post.transport);
+	for (i = 0; i < 10 && 0 == s_post.destroy; i++)
+		aio_socket_process(10);
+	assert(1 == s_post.destroy);
+	socket_close(fd[1]);
+
+	// destroy with queued buffers: the big one can't be sent(peer don't read)
+	memset(&s_post, 0, sizeof(s_post));
+	s_post.big = (char*)calloc(1, POST_BIG);
+	assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fd));
+	s_post.transport = aio_tcp_transport_create(fd[0], &handler, NULL);
+	r = aio_tcp_transport_edge_triggered(s_post.transport); // non-blocking, don't block in sendmsg(one aio thread)
+	assert(0 == r || ENOTSUP == r); // completion backend(uring): send is never blocked
+	assert(0 == aio_tcp_transport_post(s_post.transport, s_post.big, POST_BIG, aio_tcp_transport_test_oncancel, (void*)(intptr_t)0));
+	for (i = 1; i < 4; i++)
+		assert(0 == aio_tcp_transport_post(s_post.transport, &s_post.data[i], sizeof(uint32_t), aio_tcp_transport_test_oncancel, (void*)(intptr_t)i));
+	aio_socket_process(10);
+	assert(0 == s_post.posts);
+
+	aio_tcp_transport_destroy(s_post.transport);
+	for (i = 0; i < 10 && 0 == s_post.destroy; i++)
+		aio_socket_process(10);
+	assert(4 == s_post.posts && 4 == s_post.errors && 1 == s_post.destroy);
+	socket_close(fd[1]);
+	free(s_post.big);
+}
+
+#define POOLED_BULK	(100 * 1024)
+
+static struct
+{
+	aio_tcp_transport_t* transport;
+	size_t reads[64]; // bytes per ondata
+	int count;
+	size_t bytes;
+	int code;
+	int closed; // ondata bytes = 0
+	int rearm; // recv_pooled in ondata
+} s_pooled;
+
+static void aio_tcp_transport_test_ondata(void* param, int code, const void* data, size_t bytes)
+{
+	(void)param;
+	assert(0 == code ? NULL != data : NULL == data);
+	s_pooled.code = code;
+	if (0 == code && 0 == bytes)
+		s_pooled.closed++;
+	if (s_pooled.count < sizeof(s_pooled.reads) / sizeof(s_pooled.reads[0]))
+		s_pooled.reads[s_pooled.count] = bytes;
+	s_pooled.count++;
+	s_pooled.bytes += bytes;
+
+	// re-arm in callback: read again after ondata returned(the buffer is still in use)
+	if (s_pooled.rearm && 0 == code && bytes > 0)
+		assert(0 == aio_tcp_transport_recv_pooled(s_pooled.transport, aio_tcp_transport_test_ondata, NULL));
+}
+
+static void aio_tcp_transport_test_pooled_wait(size_t bytes)
+{
+	uint64_t clock;
+	clock = system_clock();
+	while (s_pooled.bytes < bytes && system_clock() - clock < 5000)
+		aio_socket_process(10);
+	assert(s_pooled.bytes == bytes);
+}
+
+static void aio_tcp_transport_test_pooled(void)
+{
+	int i, r;
+	char* bulk;
+	socket_t fd[2];
+	struct aio_tcp_transport_handler_t handler;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.ondestroy = aio_tcp_transport_test_ondestroy;
+	handler.onrecv = aio_tcp_transport_test_onrecv;
+
+	memset(&s_pooled, 0, sizeof(s_pooled));
+	memset(&s_post, 0, sizeof(s_post));
+	bulk = (char*)calloc(1, POOLED_BULK);
+	assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fd));
+	s_pooled.transport = aio_tcp_transport_create(fd[0], &handler, NULL);
+	r = aio_tcp_transport_edge_triggered(s_pooled.transport); // opt-in
+	assert(0 == r || ENOTSUP == r);
+	assert(ENOTSUP == r || 0 != (O_NONBLOCK & fcntl(fd[0], F_GETFL, 0)));
+	s_pooled.rearm = 1;
+	assert(0 == aio_tcp_transport_recv_pooled(s_pooled.transport, aio_tcp_transport_test_ondata, NULL));
+
+	// grow: every read fill the buffer, the next one double the size(2KB ~ 64KB)
+	assert(POOLED_BULK == socket_send(fd[1], bulk, POOLED_BULK, 0));
+	aio_tcp_transport_test_pooled_wait(POOLED_BULK);
+	for (i = 0; i < 5; i++)
+		assert(((size_t)2 * 1024 << i) == s_pooled.reads[i]);
+	for (i = 5; i < s_pooled.count; i++)
+		assert(s_pooled.reads[i] <= 64 * 1024);
+
+	// shrink: small reads, one size class each
+	for (i = 0; i < 6; i++)
+	{
+		assert(10 == socket_send(fd[1], bulk, 10, 0));
+		aio_tcp_transport_test_pooled_wait(POOLED_BULK + (i + 1) * 10);
+	}
+	s_pooled.count = 0;
+	s_pooled.bytes = 0;
+	assert(POOLED_BULK == socket_send(fd[1], bulk, POOLED_BULK, 0));
+	aio_tcp_transport_test_pooled_wait(POOLED_BULK);
+	assert(2 * 1024 == s_pooled.reads[0]);
+
+	// don't re-arm: no callback until recv_pooled again(after callback)
+	s_pooled.rearm = 0;
+	s_pooled.bytes = 0;
+	assert(10 == socket_send(fd[1], bulk, 10, 0));
+	aio_tcp_transport_test_pooled_wait(10);
+	assert(10 == socket_send(fd[1], bulk, 10, 0));
+	for (i = 0; i < 5; i++)
+		aio_socket_process(10);
+	assert(10 == s_pooled.bytes);
+	assert(0 == aio_tcp_transport_recv_pooled(s_pooled.transport, aio_tcp_transport_test_ondata, NULL));
+	aio_tcp_transport_test_pooled_wait(20);
+
+	// peer close
+	s_pooled.rearm = 1;
+	assert(0 == aio_tcp_transport_recv_pooled(s_pooled.transport, aio_tcp_transport_test_ondata, NULL));
+	socket_close(fd[1]);
+	for (i = 0; i < 100 && 0 == s_pooled.closed; i++)
+		aio_socket_process(10);
+	assert(1 == s_pooled.closed && 0 == s_pooled.code);
+
+	aio_tcp_transport_destroy(s_pooled.transport);
+	for (i = 0; i < 10 && 0 == s_post.destroy; i++)
+		aio_socket_process(10);
+	assert(1 == s_post.destroy);
+	free(bulk);
+}
+
+void aio_tcp_transport_test(void)
+{
+	aio_socket_init(1);
+	aio_tcp_transport_test_post();
+	aio_tcp_transport_test_pooled();
+	aio_socket_clean();
+	printf("aio tcp transport test ok\n");
+}
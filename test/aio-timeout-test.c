@@ -0,0 +1,169 @@
+#include "aio-timeout.h"
+#include "sys/atomic.h"
+#include "sys/thread.h"
+#include "sys/system.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// aio_timeout(per-thread timing wheel):
+// 1. timers of a worker wheel stopped by other thread while the worker fire them: stop succeed xor notify, exactly once
+// 2. stale handle(the timer fired, node reused by a new timer) can't stop the new timer
+// 3. timers of an exited thread wheel are adopted and fired by other worker(AIO_TIMEOUT_STALE)
+
+#define TIMEOUT_TIMERS 2000
+
+struct aio_timeout_test_t
+{
+	struct aio_timeout_t timeout;
+	volatile int32_t notify;
+	int stopped;
+};
+
+static struct
+{
+	struct aio_timeout_test_t timers[TIMEOUT_TIMERS];
+	volatile int32_t started;
+	volatile int32_t running;
+} s_timeout;
+
+static void aio_timeout_test_onnotify(void* param)
+{
+	struct aio_timeout_test_t* t;
+	t = (struct aio_timeout_test_t*)param;
+	atomic_increment32(&t->notify);
+}
+
+static int STDCALL aio_timeout_test_worker(void* param)
+{
+	int i;
+	(void)param;
+
+	// worker wheel
+	aio_timeout_process();
+	for (i = 0; i < TIMEOUT_TIMERS; i++)
+		assert(0 == aio_timeout_start(&s_timeout.timers[i].timeout, i % 64, aio_timeout_test_onnotify, &s_timeout.timers[i]));
+	atomic_increment32(&s_timeout.started);
+
+	while (atomic_load32(&s_timeout.running))
+	{
+		aio_timeout_process();
+		system_sleep(1);
+	}
+	return 0;
+}
+
+static void aio_timeout_test_stop_race(void)
+{
+	int i, stopped, fired;
+	pthread_t thread;
+
+	memset(&s_timeout, 0, sizeof(s_timeout));
+	s_timeout.running = 1;
+	thread_create(&thread, aio_timeout_test_worker, NULL);
+	while (0 == atomic_load32(&s_timeout.started))
+		thread_yield();
+
+	// stop from this thread while the worker is firing
+	for (i = 0; i < TIMEOUT_TIMERS; i++)
+	{
+		s_timeout.timers[i].stopped = 0 == aio_timeout_stop(&s_timeout.timers[i].timeout) ? 1 : 0;
+		if (0 == i % 64)
+			system_sleep(1);
+	}
+
+	system_sleep(200); // all timers expired
+	atomic_decrement32(&s_timeout.running);
+	thread_destroy(thread);
+
+	for (stopped = fired = i = 0; i < TIMEOUT_TIMERS; i++)
+	{
+		assert(1 == s_timeout.timers[i].stopped + s_timeout.timers[i].notify);
+		stopped += s_timeout.timers[i].stopped;
+		fired += s_timeout.timers[i].notify;
+	}
+	printf("aio_timeout_test stop race: %d stopped, %d fired\n", stopped, fired);
+}
+
+static void aio_timeout_test_generation(void)
+{
+	uint64_t clock;
+	struct aio_timeout_t old;
+	struct aio_timeout_test_t t1, t2;
+
+	memset(&t1, 0, sizeof(t1));
+	memset(&t2, 0, sizeof(t2));
+	aio_timeout_process(); // this thread wheel
+
+	// t1 fired, the node is free
+	assert(0 == aio_timeout_start(&t1.timeout, 0, aio_timeout_test_onnotify, &t1));
+	memcpy(&old, &t1.timeout, sizeof(old));
+	clock = system_clock();
+	while (0 == t1.notify && system_clock() - clock < 1000)
+		aio_timeout_process();
+	assert(1 == t1.notify);
+	assert(0 != aio_timeout_stop(&t1.timeout));
+
+	// t2 reuse the node(LIFO free list), the stale handle is rejected
+	assert(0 == aio_timeout_start(&t2.timeout, 100, aio_timeout_test_onnotify, &t2));
+	assert(0 == memcmp(&old, &t2.timeout, sizeof(void*))); // same timer node
+	assert(0 != aio_timeout_stop(&old));
+	clock = system_clock();
+	while (0 == t2.notify && system_clock() - clock < 1000)
+		aio_timeout_process();
+	assert(1 == t2.notify && 1 == t1.notify);
+	assert(0 != aio_timeout_stop(&t2.timeout));
+
+	// stopped node reused: the stale handle don't stop the new timer
+	assert(0 == aio_timeout_start(&t1.timeout, 100, aio_timeout_test_onnotify, &t1));
+	memcpy(&old, &t1.timeout, sizeof(old));
+	assert(0 == aio_timeout_stop(&t1.timeout));
+	aio_timeout_process(); // unlink and free the stopped node
+	assert(0 == aio_timeout_start(&t2.timeout, 100, aio_timeout_test_onnotify, &t2));
+	assert(0 == memcmp(&old, &t2.timeout, sizeof(void*))); // same timer node
+	assert(0 != aio_timeout_stop(&old));
+	assert(0 == aio_timeout_stop(&t2.timeout));
+	aio_timeout_process();
+	assert(1 == t1.notify && 1 == t2.notify);
+}
+
+static int STDCALL aio_timeout_test_exit(void* param)
+{
+	struct aio_timeout_test_t* t;
+	t = (struct aio_timeout_test_t*)param;
+
+	// start timer in the thread wheel, then exit without process it
+	aio_timeout_process();
+	assert(0 == aio_timeout_start(&t->timeout, 100, aio_timeout_test_onnotify, t));
+	return 0;
+}
+
+static void aio_timeout_test_adopt(void)
+{
+	uint64_t clock;
+	pthread_t thread;
+	struct aio_timeout_test_t t;
+
+	memset(&t, 0, sizeof(t));
+	thread_create(&thread, aio_timeout_test_exit, &t);
+	thread_destroy(thread);
+
+	// this thread adopt the stale wheel
+	clock = system_clock();
+	while (0 == t.notify && system_clock() - clock < AIO_TIMEOUT_STALE * 3)
+	{
+		aio_timeout_process();
+		system_sleep(10);
+	}
+	assert(1 == t.notify);
+	assert(system_clock() - clock + 10 >= AIO_TIMEOUT_STALE); // not before the wheel is stale
+	assert(0 != aio_timeout_stop(&t.timeout));
+}
+
+void aio_timeout_test(void)
+{
+	aio_timeout_test_stop_race();
+	aio_timeout_test_generation();
+	aio_timeout_test_adopt();
+	printf("aio timeout test ok\n");
+}
@@ -9,6 +9,8 @@ void http_header_content_type_test(void);
 void http_header_range_test(void);
 void http_client_test(void);
 void http_client_test2(void);
+void http_client_test_pool(void);
+void http_client_test_stream(void);
 
 void http_test(void)
 {
@@ -23,4 +25,6 @@ void http_test(void)
 
 	http_client_test();
 	http_client_test2();
+	http_client_test_pool();
+	http_client_test_stream();
 }
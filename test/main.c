@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #if defined(OS_LINUX)
 #include <signal.h>
@@ -33,11 +34,13 @@ void base64_test(void);
 void bitmap_test(void);
 void hweight_test(void);
 void ring_buffer_test(void);
+void slab_cache_test(void);
 
 void unicode_test(void);
 void uri_parse_test(void);
 void utf8codec_test(void);
 void thread_pool_test(void);
+void thread_pool_bench(void);
 void task_queue_test(void);
 void systimer_test(void);
 void aio_socket_test(void);
@@ -45,6 +48,14 @@ void aio_socket_test2(void);
 void aio_socket_test3(void);
 void aio_socket_test4(void);
 void aio_socket_test_cancel(void);
+void aio_socket_test_mmsg(void);
+void aio_socket_test_zerocopy(void);
+void aio_tcp_transport_test(void);
+void aio_connect_test(void);
+void aio_resolver_test(void);
+void aio_timeout_test(void);
+void aio_tcp_transport_bench(void);
+void aio_socket_bench(void);
 void ip_route_test(void);
 void onetime_test(void);
 
@@ -56,6 +67,30 @@ void http_test(void);
 void sdp_test(void);
 #endif
 
+// aio-socket backend tests(test aio: these only)
+static void aio_test(void)
+{
+    aio_socket_test_cancel();
+    aio_socket_test();
+    aio_socket_test2();
+    aio_socket_test3();
+    aio_socket_test4();
+    aio_socket_test_mmsg();
+	aio_resolver_test();
+	aio_timeout_test();
+#if defined(OS_LINUX)
+	aio_connect_test(); // 127.0.0.0/8 loopback
+#endif
+#if !defined(OS_WINDOWS)
+	aio_socket_test_zerocopy(); // socketpair
+	aio_tcp_transport_test(); // socketpair
+#endif
+#if defined(AIO_BENCH)
+	aio_socket_bench();
+	aio_tcp_transport_bench();
+#endif
+}
+
 int main(int argc, char* argv[])
 {
 #if defined(OS_LINUX)
@@ -65,6 +100,12 @@ int main(int argc, char* argv[])
 	sigaction(SIGPIPE, &sa, 0);
 #endif
 
+	if (argc > 1 && 0 == strcmp(argv[1], "aio"))
+	{
+		aio_test();
+		return 0;
+	}
+
 	heap_test();
 	rbtree_test();
 	timer_test();
@@ -89,6 +130,7 @@ int main(int argc, char* argv[])
 	bitmap_test();
 	hweight_test();
 	ring_buffer_test();
+	slab_cache_test();
 
 	uri_parse_test();
 
@@ -97,15 +139,14 @@ int main(int argc, char* argv[])
 #endif
 
 	thread_pool_test();
+#if defined(THREAD_POOL_BENCH)
+	thread_pool_bench();
+#endif
 	task_queue_test();
 
 	ip_route_test();
 
-    aio_socket_test_cancel();
-    aio_socket_test();
-    aio_socket_test2();
-    aio_socket_test3();
-    aio_socket_test4();
+	aio_test();
 
 #if defined(OS_WINDOWS)
 	unicode_test();
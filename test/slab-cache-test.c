@@ -0,0 +1,92 @@
+#include "slab-cache.h"
+#include "sys/thread.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// slab_cache(per-thread free list):
+// 1. object freed is reused by the next alloc of the same thread(LIFO), zero-filled
+// 2. at most capacity objects cached per thread, the others returned to system
+// 3. thread exit: the thread counters merged into the cache, the cached objects released
+
+#define SLAB_CAPACITY	8
+#define SLAB_OBJECTS	20
+
+static int STDCALL slab_cache_test_thread(void* param)
+{
+	int i;
+	void* objs[SLAB_OBJECTS];
+	slab_cache_t* cache;
+	cache = (slab_cache_t*)param;
+
+	for (i = 0; i < SLAB_OBJECTS; i++)
+		objs[i] = slab_cache_alloc(cache);
+	for (i = 0; i < SLAB_OBJECTS; i++)
+		slab_cache_free(cache, objs[i]);
+	objs[0] = slab_cache_alloc(cache); // hit
+	slab_cache_free(cache, objs[0]);
+	return 0;
+}
+
+void slab_cache_test(void)
+{
+	int i;
+	char* p;
+	void* objs[SLAB_OBJECTS];
+	pthread_t thread;
+	slab_cache_t* cache;
+	struct slab_cache_stats_t stats;
+
+	cache = slab_cache_create(10, SLAB_CAPACITY);
+	assert(cache);
+
+	// 1. reuse
+	p = (char*)slab_cache_alloc(cache);
+	assert(p && 0 == ((uintptr_t)p % 64)); // cache line aligned
+	memset(p, 0xCC, 10);
+	slab_cache_free(cache, p);
+	assert(p == slab_cache_alloc(cache));
+	for (i = 0; i < 64; i++)
+		assert(0 == p[i]); // zero-filled(rounded up to cache line)
+	slab_cache_free(cache, p);
+	slab_cache_stats(cache, &stats);
+	assert(2 == stats.alloc && 1 == stats.hit && 2 == stats.free && 1 == stats.cached);
+
+	// 2. capacity
+	for (i = 0; i < SLAB_OBJECTS; i++)
+		objs[i] = slab_cache_alloc(cache);
+	slab_cache_stats(cache, &stats);
+	assert(2 + SLAB_OBJECTS == stats.alloc && 2 == stats.hit && 0 == stats.cached);
+	for (i = 0; i < SLAB_OBJECTS; i++)
+		slab_cache_free(cache, objs[i]); // the first SLAB_CAPACITY objects cached
+	slab_cache_stats(cache, &stats);
+	assert(2 + SLAB_OBJECTS == stats.free && SLAB_CAPACITY == stats.cached);
+	p = (char*)objs[SLAB_CAPACITY - 1];
+	for (i = 0; i < SLAB_CAPACITY; i++)
+		objs[i] = slab_cache_alloc(cache);
+	assert(p == objs[0]); // LIFO: the last cached first
+	slab_cache_stats(cache, &stats);
+	assert(2 + SLAB_CAPACITY == stats.hit && 0 == stats.cached);
+	for (i = 0; i < SLAB_CAPACITY; i++)
+		slab_cache_free(cache, objs[i]);
+
+	// 3. thread exit
+	thread_create(&thread, slab_cache_test_thread, cache);
+	thread_destroy(thread);
+	slab_cache_stats(cache, &stats);
+	assert(2 + SLAB_OBJECTS + SLAB_CAPACITY + SLAB_OBJECTS + 1 == stats.alloc);
+	assert(2 + SLAB_CAPACITY + 1 == stats.hit);
+	assert(2 + SLAB_OBJECTS + SLAB_CAPACITY + SLAB_OBJECTS + 1 == stats.free);
+	assert(SLAB_CAPACITY == stats.cached); // this thread only
+	slab_cache_destroy(cache);
+
+	// capacity 0: malloc/free only, no counters
+	cache = slab_cache_create(10, 0);
+	p = (char*)slab_cache_alloc(cache);
+	assert(p);
+	slab_cache_free(cache, p);
+	slab_cache_stats(cache, &stats);
+	assert(0 == stats.alloc && 0 == stats.cached);
+	slab_cache_destroy(cache);
+	printf("slab cache test ok\n");
+}
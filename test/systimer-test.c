@@ -3,9 +3,11 @@
 #include "port/system.h"
 #include "sys/thread.h"
 #include "sys/system.h"
+#include "sys/atomic.h"
 #include "time64.h"
 #include <stdio.h>
 #include <time.h>
+#include <stdlib.h>
 
 static void OnTimer(systimer_t id, void* param)
 {
@@ -67,6 +69,36 @@ static void Test4(void)
 	}
 }
 
+static int32_t s_count5;
+static void OnTest5(systimer_t id, void* param)
+{
+	atomic_increment32(&s_count5);
+}
+
+static void Test5(void)
+{
+	int i;
+	systimer_t* id;
+	uint64_t clock;
+
+	// 100k periodic timers
+	id = (systimer_t*)malloc(100000 * sizeof(systimer_t));
+	clock = system_clock();
+	for(i = 0; i < 100000; i++)
+	{
+		assert(0 == systimer_start(&id[i], 100 + i % 100, OnTest5, NULL));
+	}
+
+	system_sleep(3000);
+	for(i = 0; i < 100000; i++)
+	{
+		assert(0 == systimer_stop(id[i]));
+	}
+
+	printf("Test5: 100000 timers, %d callbacks in %d ms\n", (int)atomic_load32(&s_count5), (int)(system_clock() - clock));
+	free(id);
+}
+
 static void OnClockTimer(systimer_t id, void* param)
 {
 	char time[24];
@@ -127,6 +159,7 @@ void systimer_test(void)
 	Test2();
 	Test3();
 	Test4();
+	Test5();
 #if defined(OS_LINUX)
 	systimer_clocksettime();
 #endif
@@ -1,9 +1,11 @@
 #include "cstringext.h"
 #include "sys/thread.h"
 #include "sys/sema.h"
+#include "sys/system.h"
 #include "task-queue.h"
 #include "thread-pool.h"
 #include <stdio.h>
+#include <assert.h>
 
 #define N_TASK 1000
 
@@ -14,6 +16,50 @@ static void tasktest(void* param)
 	sema_post(&s_sema);
 }
 
+static int s_order[4];
+static int s_count;
+
+static void taskorder(void* param)
+{
+	s_order[s_count++] = (int)(intptr_t)param;
+	sema_post(&s_sema);
+}
+
+static void taskblock(void* param)
+{
+	system_sleep(100);
+	sema_post(&s_sema);
+	(void)param;
+}
+
+// one worker: priority first, expired task dropped
+static void task_queue_priority_test(thread_pool_t pool)
+{
+	task_queue_t taskQ;
+	struct thread_pool_stats_t stats;
+	s_count = 0;
+	taskQ = task_queue_create(pool, 1);
+	task_queue_post(taskQ, taskblock, NULL);
+	system_sleep(10);
+	task_queue_post2(taskQ, PRIORITY_LOWEST, 0, taskorder, (void*)1);
+	task_queue_post2(taskQ, PRIORITY_NORMAL, 1000, taskorder, (void*)2);
+	task_queue_post2(taskQ, PRIORITY_CRITICAL, 10, taskorder, (void*)3); // expired
+	task_queue_post2(taskQ, PRIORITY_CRITICAL, 0, taskorder, (void*)4);
+	sema_wait(&s_sema);
+	sema_wait(&s_sema);
+	sema_wait(&s_sema);
+	sema_wait(&s_sema);
+	assert(3 == s_count && 4 == s_order[0] && 2 == s_order[1] && 1 == s_order[2]);
+	system_sleep(10); // task_action done
+	task_queue_stats(taskQ, &stats);
+	assert(5 == stats.submitted && 4 == stats.completed && 1 == stats.dropped && 0 == stats.depth);
+	assert(4 == stats.submitted - stats.dropped && 0 == stats.busy);
+	assert(thread_pool_stats_percentile(stats.run, 100) >= 100000); // taskblock 100ms
+	assert(thread_pool_stats_percentile(stats.wait, 100) >= 80000); // behind taskblock
+	assert(thread_pool_stats_percentile(stats.run, 50) < 100000); // taskorder
+	task_queue_destroy(taskQ);
+}
+
 void task_queue_test(void)
 {
 	int i;
@@ -31,6 +77,7 @@ void task_queue_test(void)
 	for(i = 0; i < N_TASK; ++i)
 		sema_wait(&s_sema);
 
+	task_queue_priority_test(pool);
 	task_queue_destroy(taskQ);
 	thread_pool_destroy(pool);
 	sema_destroy(&s_sema);
@@ -0,0 +1,122 @@
+#include "thread-pool.h"
+#include "sys/atomic.h"
+#include "sys/system.h"
+#include "sys/event.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <assert.h>
+
+// thread pool benchmark:
+// 1. throughput: one producer push tiny tasks(external push, injection queue)
+// 2. fan-out: tasks push child tasks from worker threads(local deque and stealing)
+// 3. latency: ping-pong, push one task and wait for it
+// 4. batch: throughput with thread_pool_push_batch
+// 1 cpu(1/16 threads): push ~7.0M/7.1M task/s, fan-out ~13.8M/11.9M task/s
+//                      the locked task list pool: push ~5.8M/1.6M task/s, fan-out ~8.2M/8.5M task/s
+
+#define BENCH_TASKS		1000000
+#define BENCH_FANOUT	8 // child tasks per level
+#define BENCH_DEPTH		6 // 8^6 = 262144 leaves
+#define BENCH_PINGPONG	10000
+#define BENCH_BATCH		64
+
+static thread_pool_t s_pool;
+static int32_t s_done;
+static event_t s_event;
+
+static void thread_pool_bench_task(void* param)
+{
+	(void)param;
+	atomic_increment32(&s_done);
+}
+
+static void thread_pool_bench_tree(void* param)
+{
+	int i;
+	intptr_t depth;
+	depth = (intptr_t)param;
+	if (depth >= BENCH_DEPTH)
+	{
+		atomic_increment32(&s_done);
+		return;
+	}
+
+	for (i = 0; i < BENCH_FANOUT; i++)
+		thread_pool_push(s_pool, thread_pool_bench_tree, (void*)(depth + 1));
+}
+
+static void thread_pool_bench_ping(void* param)
+{
+	(void)param;
+	event_signal(&s_event);
+}
+
+static void thread_pool_bench_wait(int32_t n)
+{
+	while (atomic_load32(&s_done) < n)
+		system_sleep(1);
+}
+
+static void thread_pool_bench_run(int threads)
+{
+	int i, n;
+	uint64_t clock, t1, t2, t3, t4;
+	thread_pool_proc procs[BENCH_BATCH];
+	void* params[BENCH_BATCH];
+
+	s_pool = thread_pool_create(threads, threads, threads);
+	event_create(&s_event);
+
+	// throughput
+	s_done = 0;
+	clock = system_clock();
+	for (i = 0; i < BENCH_TASKS; i++)
+		thread_pool_push(s_pool, thread_pool_bench_task, NULL);
+	thread_pool_bench_wait(BENCH_TASKS);
+	t1 = system_clock() - clock;
+
+	// fan-out
+	for (i = 0, n = 1; i < BENCH_DEPTH; i++)
+		n *= BENCH_FANOUT;
+	s_done = 0;
+	clock = system_clock();
+	thread_pool_push(s_pool, thread_pool_bench_tree, (void*)0);
+	thread_pool_bench_wait(n);
+	t2 = system_clock() - clock;
+
+	// latency
+	clock = system_clock();
+	for (i = 0; i < BENCH_PINGPONG; i++)
+	{
+		thread_pool_push(s_pool, thread_pool_bench_ping, NULL);
+		event_wait(&s_event);
+	}
+	t3 = system_clock() - clock;
+
+	// batch
+	for (i = 0; i < BENCH_BATCH; i++)
+	{
+		procs[i] = thread_pool_bench_task;
+		params[i] = NULL;
+	}
+	s_done = 0;
+	clock = system_clock();
+	for (i = 0; i < BENCH_TASKS; i += BENCH_BATCH)
+		thread_pool_push_batch(s_pool, procs, params, BENCH_BATCH);
+	thread_pool_bench_wait(BENCH_TASKS); // BENCH_TASKS % BENCH_BATCH == 0
+	t4 = system_clock() - clock;
+
+	thread_pool_destroy(s_pool);
+	event_destroy(&s_event);
+
+	printf("thread_pool_bench threads: %d, push: %" PRIu64 " task/s, fan-out: %" PRIu64 " task/s, ping-pong: %" PRIu64 " us, batch: %" PRIu64 " task/s\n",
+		threads, (uint64_t)BENCH_TASKS * 1000 / (t1 ? t1 : 1), (uint64_t)n * 1000 / (t2 ? t2 : 1), t3 * 1000 / BENCH_PINGPONG, (uint64_t)BENCH_TASKS * 1000 / (t4 ? t4 : 1));
+}
+
+void thread_pool_bench(void)
+{
+	thread_pool_bench_run(1);
+	thread_pool_bench_run(4);
+	thread_pool_bench_run(16);
+	thread_pool_bench_run(64);
+}
@@ -3,6 +3,8 @@
 #include "sys/system.h"
 #include "sys/atomic.h"
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <assert.h>
 #include <time.h>
 
@@ -31,6 +33,215 @@ static void worker(void* param)
 	printf("[%d] done\n", n);
 }
 
+static int32_t s_count;
+static int32_t s_sum[1000];
+
+static void range(void* param, int64_t begin, int64_t end)
+{
+	for (; begin < end; begin++)
+		atomic_increment32(&s_sum[begin]);
+	(void)param;
+}
+
+static void nested(void* param, int64_t begin, int64_t end)
+{
+	for (; begin < end; begin++)
+		thread_pool_parallel_for((thread_pool_t)param, begin * 10, begin * 10 + 10, 1, range, NULL);
+}
+
+static int64_t s_total;
+static void range64(void* param, int64_t begin, int64_t end)
+{
+	assert(begin >= *(int64_t*)param && begin < end);
+	atomic_add64(&s_total, end - begin);
+}
+
+static volatile int32_t s_started;
+static void slow(void* param, int64_t begin, int64_t end)
+{
+	for (; begin < end; begin++)
+	{
+		system_sleep(1);
+		atomic_increment32(&s_sum[begin]);
+	}
+	(void)param;
+}
+
+// parallel_for in a task, the pool is destroyed while the task wait for the runners
+static void fanout(void* param)
+{
+	atomic_increment32(&s_started);
+	assert(0 == thread_pool_parallel_for((thread_pool_t)param, 0, 100, 1, slow, NULL));
+	atomic_increment32(&s_started);
+}
+
+static void sleeper(void* param)
+{
+	system_sleep(20);
+	atomic_increment32(&s_count);
+	(void)param;
+}
+
+static uint64_t thread_pool_stats_count(const uint64_t histogram[THREAD_POOL_HISTOGRAM])
+{
+	int i;
+	uint64_t n;
+	for (n = i = 0; i < THREAD_POOL_HISTOGRAM; i++)
+		n += histogram[i];
+	return n;
+}
+
+static void thread_pool_stats_test(void)
+{
+	int i;
+	uint64_t clock;
+	uint64_t h[THREAD_POOL_HISTOGRAM];
+	thread_pool_t pool;
+	struct thread_pool_stats_t stats;
+
+	// histogram: one bucket per value in [0, 8), then 8 sub-buckets per power of 2
+	memset(h, 0, sizeof(h));
+	assert(0 == thread_pool_stats_percentile(h, 50)); // empty
+	thread_pool_stats_add(h, 5);
+	assert(1 == h[5] && 5 == thread_pool_stats_percentile(h, 50) && 5 == thread_pool_stats_percentile(h, 100));
+	thread_pool_stats_add(h, 1000); // [960, 1024)
+	thread_pool_stats_add(h, 1023);
+	assert(2 == h[63] && 5 == thread_pool_stats_percentile(h, 30) && 1023 == thread_pool_stats_percentile(h, 100));
+	thread_pool_stats_add(h, 1024); // [1024, 1152)
+	assert(1 == h[64] && 1151 == thread_pool_stats_percentile(h, 100));
+	thread_pool_stats_add(h, UINT64_MAX); // the last bucket
+	assert(1 == h[THREAD_POOL_HISTOGRAM - 1] && 5 == thread_pool_stats_count(h));
+
+	// counters: all tasks done, submitted == completed
+	s_count = 0;
+	pool = thread_pool_create(2, 2, 2);
+	for (i = 0; i < 32; i++)
+		assert(0 == thread_pool_push(pool, sleeper, NULL));
+	clock = system_clock();
+	do
+	{
+		system_sleep(10);
+		assert(0 == thread_pool_stats(pool, &stats));
+	} while (stats.completed < 32 && system_clock() - clock < 5000);
+	assert(32 == s_count);
+	assert(32 == stats.submitted && 32 == stats.completed && 0 == stats.dropped && 0 == stats.depth && 2 == stats.threads);
+
+	// timing sampled one per 16 tasks: the 1st and 17th task, run time >= 20ms
+	assert(2 == thread_pool_stats_count(stats.wait) && 2 == thread_pool_stats_count(stats.run));
+	assert(thread_pool_stats_percentile(stats.run, 1) >= 20000);
+	thread_pool_destroy(pool);
+}
+
+static void thread_pool_affinity_test(void)
+{
+	int i;
+	struct thread_affinity_t affinity;
+	static const int s_list[] = { 3, 5 };
+	static const int s_cpus[] = { 0, 1, 2, 3, 8, 9, 10, 11 }; // node0: 0-3, node1: 8-11
+	static const int s_sizes[] = { 4, 4 };
+	static const int s_compact[] = { 0, 1, 2, 3, 8, 9, 10, 11, 0 };
+	static const int s_scatter[] = { 0, 8, 1, 9, 2, 10, 3, 11, 0 };
+	static const int s_uneven[] = { 3, 1 }; // node0: 0-2, node1: 3
+	static const int s_scatter2[] = { 0, 3, 1, 3, 2, 3, 0 };
+	static const int s_empty[] = { 4, 0 }; // node without cpu
+
+	memset(&affinity, 0, sizeof(affinity));
+	assert(-1 == thread_affinity_cpu(NULL, 0));
+	assert(-1 == thread_affinity_cpu(&affinity, 0)); // THREAD_AFFINITY_NONE
+
+	affinity.policy = THREAD_AFFINITY_LIST;
+	assert(-1 == thread_affinity_cpu(&affinity, 0)); // empty list
+	affinity.cpus = s_list;
+	affinity.count = 2;
+	for (i = 0; i < 4; i++)
+		assert(s_list[i % 2] == thread_affinity_cpu(&affinity, i));
+	assert(-1 == thread_affinity_cpu(&affinity, -1));
+
+	// 2 nodes * 4 cpus
+	assert(0 == thread_affinity_topology(s_cpus, s_sizes, 2));
+	affinity.policy = THREAD_AFFINITY_COMPACT;
+	for (i = 0; i < 9; i++)
+		assert(s_compact[i] == thread_affinity_cpu(&affinity, i));
+	affinity.policy = THREAD_AFFINITY_SCATTER;
+	for (i = 0; i < 9; i++)
+		assert(s_scatter[i] == thread_affinity_cpu(&affinity, i));
+
+	// the small node is shared by more workers
+	assert(0 == thread_affinity_topology(s_cpus, s_uneven, 2));
+	for (i = 0; i < 7; i++)
+		assert(s_scatter2[i] == thread_affinity_cpu(&affinity, i));
+
+	assert(EINVAL == thread_affinity_topology(s_cpus, s_sizes, 0));
+	assert(EINVAL == thread_affinity_topology(s_cpus, s_empty, 2));
+	assert(0 == thread_affinity_topology(NULL, NULL, 0)); // system
+	assert(thread_affinity_cpu(&affinity, 0) >= 0);
+	assert(EINVAL == thread_affinity_bind(-1));
+}
+
+static void counter(void* param)
+{
+	atomic_increment32(&s_count);
+	thread_pool_latch_done((thread_pool_latch_t)param);
+}
+
+static void thread_pool_batch_test(void)
+{
+	int i;
+	thread_pool_proc procs[50];
+	void* params[50];
+	int64_t big;
+	thread_pool_t pool;
+	thread_pool_latch_t latch;
+	struct thread_pool_stats_t stats;
+
+	pool = thread_pool_create(4, 2, 8);
+
+	// batch + latch
+	s_count = 0;
+	latch = thread_pool_latch_create(50);
+	for (i = 0; i < 50; i++)
+	{
+		procs[i] = counter;
+		params[i] = latch;
+	}
+	assert(50 == thread_pool_push_batch(pool, procs, params, 50));
+	assert(0 == thread_pool_latch_wait(latch, -1));
+	assert(50 == s_count);
+	thread_pool_latch_destroy(latch);
+
+	// parallel for, nested in worker threads
+	memset(s_sum, 0, sizeof(s_sum));
+	assert(0 == thread_pool_parallel_for(pool, 0, 1000, 0, range, NULL));
+	assert(0 == thread_pool_parallel_for(pool, 0, 100, 3, nested, pool));
+	for (i = 0; i < 1000; i++)
+		assert(2 == s_sum[i]);
+
+	// 64-bit range(beyond INT_MAX), end - begin overflow
+	s_total = 0;
+	big = (int64_t)INT32_MAX * 4;
+	assert(0 == thread_pool_parallel_for(pool, big, big + 1000000, 0, range64, &big));
+	assert(1000000 == s_total);
+	assert(0 != thread_pool_parallel_for(pool, INT64_MIN, INT64_MAX, 0, range64, &big));
+
+	memset(&stats, 0, sizeof(stats));
+	assert(0 == thread_pool_stats(pool, &stats));
+	assert(stats.submitted >= 50 && stats.dropped == 0);
+	assert(thread_pool_stats_percentile(stats.run, 100) >= thread_pool_stats_percentile(stats.run, 50));
+	thread_pool_destroy(pool);
+
+	// destroy: the dropped parallel_for runners run inline, the waiting task return
+	pool = thread_pool_create(2, 2, 2);
+	s_started = 0;
+	memset(s_sum, 0, sizeof(s_sum));
+	assert(0 == thread_pool_push(pool, fanout, pool));
+	while (0 == atomic_load32(&s_started))
+		system_sleep(1);
+	thread_pool_destroy(pool);
+	assert(2 == s_started);
+	for (i = 0; i < 100; i++)
+		assert(1 == s_sum[i]);
+}
+
 void thread_pool_test(void)
 {
 	int i, r;
@@ -44,4 +255,8 @@ void thread_pool_test(void)
 	}
 	
 	thread_pool_destroy(pool);
+
+	thread_pool_batch_test();
+	thread_pool_stats_test();
+	thread_pool_affinity_test();
 }
@@ -6,8 +6,7 @@
 
 #define TIMER 1000
 #define TOTAL 10000000
-#define TIMER_RESOLUTION 64
-
+static int s_resolution;
 static uint64_t now;
 static time_wheel_t* wheel;
 static struct twtimer_t* s_timer;
@@ -18,7 +17,7 @@ static int s_cancel = 0;
 static void ontimer(void* param)
 {
 	struct twtimer_t* timer = (struct twtimer_t*)param;
-	assert(timer->expire / TIMER_RESOLUTION <= now / TIMER_RESOLUTION);
+	assert(timer->expire / s_resolution <= now / s_resolution);
 	timer->param = NULL;
 	++s_stoped;
 }
@@ -36,16 +35,21 @@ static void timer_stop(void)
 	}
 }
 
-void timer_test(void)
+static void timer_test_run(int resolution)
 {
 	int i;
 
+	s_resolution = resolution;
+	s_started = 0;
+	s_stoped = 0;
+	s_cancel = 0;
+
 	s_timer = (struct twtimer_t*)calloc(TIMER, sizeof(*s_timer));
 	assert(s_timer);
 
 	now = time(NULL);
 	srand((int)now);
-	wheel = time_wheel_create(now);
+	wheel = time_wheel_create2(now, resolution);
 
 	while (s_stoped < TOTAL)
 	{
@@ -62,12 +66,18 @@ void timer_test(void)
 		}
 
 		twtimer_process(wheel, now);
-		now += rand() % 256;
+		now += rand() % (4 * resolution);
 
 		timer_stop();
 	}
 
 	free(s_timer);
 	time_wheel_destroy(wheel);
-	printf("timer(total: %d, cancel: %d) test ok.\n", TOTAL, s_cancel);
+	printf("timer(resolution: %dms, total: %d, cancel: %d) test ok.\n", resolution, TOTAL, s_cancel);
+}
+
+void timer_test(void)
+{
+	timer_test_run(64);
+	timer_test_run(1);
 }